@@ -71,6 +71,95 @@ handlebars_helper!(freeFunctionToType: |function: Function| {
     let typename = function.input_params[0].typename.clone();
     typename[0..typename.len() - 1].to_string()
 });
+handlebars_helper!(freeFunctionToHandleName: |function: Function| {
+    let name = &function.name;
+    format!("{}_ptr", &name[8..name.len() - 5])
+});
+handlebars_helper!(functionIsCallbackSetter: |function: Function| {
+    let setter_pattern = Regex::new(r"^gosling_context_set_\w+_callback$").unwrap();
+    if !setter_pattern.is_match(&function.name) {
+        return Ok(FALSE);
+    }
+    let input_params = &function.input_params;
+    if input_params.len() != 3 {
+        return Ok(FALSE);
+    }
+    if input_params[0].typename != "gosling_context*" {
+        return Ok(FALSE);
+    }
+    if !input_params[1].typename.ends_with("_callback_t") {
+        return Ok(FALSE);
+    }
+    if input_params[2].typename != "gosling_error**" {
+        return Ok(FALSE);
+    }
+    return Ok(TRUE);
+});
+handlebars_helper!(callbackSetterToWrapperName: |function: Function| {
+    function.name[8..].to_string()
+});
+handlebars_helper!(callbackSetterToHandlerName: |function: Function| {
+    // gosling_context_set_{handler}_callback
+    let name = &function.name;
+    name[20..name.len() - 9].to_string()
+});
+handlebars_helper!(callbackSetterToReturnType: |function: Function, callbacks: Vec<Function>| {
+    callback_setter_to_callback(&function, &callbacks).return_param.clone()
+});
+handlebars_helper!(callbackSetterToTrampolineParams: |function: Function, callbacks: Vec<Function>| {
+    let callback = callback_setter_to_callback(&function, &callbacks);
+    callback
+        .input_params
+        .iter()
+        .map(|param| format!("{} {}", param.typename, param.name))
+        .collect::<Vec<String>>()
+        .join(", ")
+});
+handlebars_helper!(callbackSetterToHandlerArgs: |function: Function, callbacks: Vec<Function>| {
+    let callback = callback_setter_to_callback(&function, &callbacks);
+    let params = &callback.input_params;
+
+    // pointer and length/size pairs are handed to the handler as a single
+    // non-owning view
+    let mut args: Vec<String> = Default::default();
+    let mut i = 0;
+    while i < params.len() {
+        let param = &params[i];
+        let next = params.get(i + 1);
+        let view = match (param.typename.as_str(), next) {
+            ("const char*", Some(next)) if next.name == format!("{}_length", param.name) => {
+                Some(format!("std::string_view({}, {})", param.name, next.name))
+            }
+            ("const uint8_t*", Some(next)) if next.name == format!("{}_size", param.name) => {
+                Some(format!("gosling::span<const uint8_t>({}, {})", param.name, next.name))
+            }
+            ("uint8_t*", Some(next)) if next.name == format!("{}_size", param.name) => {
+                Some(format!("gosling::span<uint8_t>({}, {})", param.name, next.name))
+            }
+            _ => None,
+        };
+        match view {
+            Some(view) => {
+                args.push(view);
+                i += 2;
+            }
+            None => {
+                args.push(param.name.clone());
+                i += 1;
+            }
+        }
+    }
+    args.join(", ")
+});
+
+// find the callback type registered by a gosling_context_set_*_callback() function
+fn callback_setter_to_callback<'a>(function: &Function, callbacks: &'a [Function]) -> &'a Function {
+    let typename = &function.input_params[1].typename;
+    match callbacks.iter().find(|callback| &callback.name == typename) {
+        Some(callback) => callback,
+        None => panic!("callback type not found: {}", typename),
+    }
+}
 
 fn main() {
 
@@ -90,6 +179,13 @@ fn main() {
     handlebars.register_helper("functionToObjectParam", Box::new(functionToObjectParam));
     handlebars.register_helper("toStringFunctionToSizeConstant", Box::new(toStringFunctionToSizeConstant));
     handlebars.register_helper("freeFunctionToType", Box::new(freeFunctionToType));
+    handlebars.register_helper("freeFunctionToHandleName", Box::new(freeFunctionToHandleName));
+    handlebars.register_helper("functionIsCallbackSetter", Box::new(functionIsCallbackSetter));
+    handlebars.register_helper("callbackSetterToWrapperName", Box::new(callbackSetterToWrapperName));
+    handlebars.register_helper("callbackSetterToHandlerName", Box::new(callbackSetterToHandlerName));
+    handlebars.register_helper("callbackSetterToReturnType", Box::new(callbackSetterToReturnType));
+    handlebars.register_helper("callbackSetterToTrampolineParams", Box::new(callbackSetterToTrampolineParams));
+    handlebars.register_helper("callbackSetterToHandlerArgs", Box::new(callbackSetterToHandlerArgs));
 
     handlebars.register_template_file("header", template).unwrap();
 
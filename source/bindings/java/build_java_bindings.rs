@@ -30,6 +30,11 @@ handlebars_helper!(aliasToClassName: |name: String| {
     name.to_upper_camel_case()
 });
 
+handlebars_helper!(constantToJavaName: |name: String| {
+    // constants from tor-interface have no gosling_ prefix to strip
+    name.strip_prefix("gosling_").unwrap_or(&name).to_uppercase()
+});
+
 handlebars_helper!(functionToNativeMethodName: |name: String| {
     assert!(name.starts_with("gosling_"));
     let name = &name[8..];
@@ -91,8 +96,9 @@ handlebars_helper!(inputParamsToJavaParams: |params: Vec<Param>| {
             }
             "char*" => "Out<String>".to_string(),
             "const char*" => "String".to_string(),
-            "const uint8_t*" => "byte[]".to_string(),
-            "uint8_t*" => "byte[]".to_string(),
+            // buffers are passed as direct ByteBuffers so neither side copies them
+            "const uint8_t*" => "java.nio.ByteBuffer".to_string(),
+            "uint8_t*" => "java.nio.ByteBuffer".to_string(),
             "const uint16_t*" => "int[]".to_string(),
             "gosling_handshake_handle_t" => "long".to_string(),
             "gosling_tcp_socket_t" => "java.net.Socket".to_string(),
@@ -107,7 +113,9 @@ handlebars_helper!(inputParamsToJavaParams: |params: Vec<Param>| {
 
                 assert!(other.starts_with("gosling_"), "found {}", other);
 
-                if other.ends_with("**") {
+                if let Some(element) = other.strip_suffix("*const*") {
+                    format!("{}[]", element[8..].to_upper_camel_case())
+                } else if other.ends_with("**") {
                     format!("Out<{}>", other[8..].to_upper_camel_case())
                 } else if other.ends_with("*") {
                     other[8..other.len() - 1].to_upper_camel_case()
@@ -141,6 +149,7 @@ handlebars_helper!(inputParamsToJNIParams: |params: Vec<Param>| {
     jni_args.push("jclass".to_string());
     for param in params {
         let jni_typename = match param.typename.as_ref() {
+            "bool" => "jboolean".to_string(),
             "uint8_t" => "jshort".to_string(),
             "uint16_t" => "jint".to_string(),
             "const uint16_t*" => "jintArray".to_string(),
@@ -159,6 +168,7 @@ handlebars_helper!(inputParamsToJNIParams: |params: Vec<Param>| {
             }
             "char*" => "jobject".to_string(),
             "const char*" => "jstring".to_string(),
+            "const uint8_t*" => "jobject".to_string(),
             "gosling_handshake_handle_t" | "gosling_circuit_token_t" => "jlong".to_string(),
             other => {
                 let other = if other.starts_with("const ") {
@@ -169,7 +179,9 @@ handlebars_helper!(inputParamsToJNIParams: |params: Vec<Param>| {
 
                 assert!(other.starts_with("gosling_"), "found '{}'", other);
 
-                if other.ends_with("**") || other.ends_with("*") || other.ends_with("_callback_t") {
+                if other.ends_with("*const*") {
+                    "jobjectArray".to_string()
+                } else if other.ends_with("**") || other.ends_with("*") || other.ends_with("_callback_t") {
                     "jobject".to_string()
                 } else {
                     panic!("unhandled typename: {}", other);
@@ -182,7 +194,7 @@ handlebars_helper!(inputParamsToJNIParams: |params: Vec<Param>| {
     jni_args.join(", ")
 });
 
-handlebars_helper!(marshallJNIParams: |function_name: String, params: Vec<Param>| {
+handlebars_helper!(marshallJNIParams: |function_name: String, return_type: String, params: Vec<Param>| {
     let mut marshall_lines: Vec<String> = Default::default();
     macro_rules! cpp_src {
         ($($arg:tt)*) => {
@@ -194,11 +206,60 @@ handlebars_helper!(marshallJNIParams: |function_name: String, params: Vec<Param>
         };
     }
 
+    // read buffers in place from direct java.nio.ByteBuffers; these are resolved first
+    // so we can bail out with the IllegalArgumentException before acquiring anything
+    // which would need releasing
+    for param in params.iter().filter(|param| param.typename == "const uint8_t*") {
+        let name: &str = param.name.as_ref();
+        cpp_src!("const uint8_t* {name}_native = nullptr;");
+        cpp_src!("size_t {name}_remaining = 0;");
+        cpp_src!("if (!g_jni_glue->get_direct_byte_buffer_region(env, {name}, {name}_native, {name}_remaining)) {{");
+        if return_type == "void" {
+            cpp_src!("    return;");
+        } else {
+            cpp_src!("    return {{}};");
+        }
+        cpp_src!("}}");
+    }
+
+    // unwrap arrays of GoslingHandles; arrays passed together must be the same length
+    // and share a single _count param
+    let handle_array_pattern = Regex::new(r"^const (?P<alias>gosling_\w+)\*const\*$").unwrap();
+    let handle_arrays: Vec<&Param> = params.iter().filter(|param| handle_array_pattern.is_match(&param.typename)).collect();
+    for param in handle_arrays.iter() {
+        let name: &str = param.name.as_ref();
+        let caps = handle_array_pattern.captures(&param.typename).unwrap();
+        let alias = caps.name("alias").unwrap().as_str();
+        cpp_src!("const size_t {name}_length = ({name} ? static_cast<size_t>(env->GetArrayLength({name})) : 0);");
+        cpp_src!("std::vector<const {alias}*> {name}_handles({name}_length);");
+        cpp_src!("for (size_t i = 0; i < {name}_length; i++) {{");
+        cpp_src!("    jobject element = env->GetObjectArrayElement({name}, static_cast<jsize>(i));");
+        cpp_src!("    {name}_handles[i] = reinterpret_cast<const {alias}*>(g_jni_glue->jobject_handle_to_void_pointer(env, element));");
+        cpp_src!("    env->DeleteLocalRef(element);");
+        cpp_src!("}}");
+        cpp_src!("const {alias}* const* {name}_native = {name}_handles.data();");
+    }
+    if let Some((first, rest)) = handle_arrays.split_first() {
+        if !rest.is_empty() {
+            let first = &first.name;
+            let mismatched: Vec<String> = rest.iter().map(|param| format!("{}_length != {first}_length", param.name)).collect();
+            cpp_src!("if ({}) {{", mismatched.join(" || "));
+            cpp_src!("    env->ThrowNew(g_jni_glue->illegal_argument_exception_class, \"arrays must be the same length\");");
+            if return_type == "void" {
+                cpp_src!("    return;");
+            } else {
+                cpp_src!("    return {{}};");
+            }
+            cpp_src!("}}");
+        }
+    }
+
     for param in &params {
         let name: &str = param.name.as_ref();
         let typename: &str = param.typename.as_ref();
 
         match typename {
+            "bool" => cpp_src!("const bool {name}_native = ({name} == JNI_TRUE);"),
             // TODO: ensure the passed in values are in valid range for native type
             "uint8_t" => cpp_src!("const uint8_t {name}_native = static_cast<uint8_t>({name});"),
             "const uint16_t*" => {
@@ -212,9 +273,13 @@ handlebars_helper!(marshallJNIParams: |function_name: String, params: Vec<Param>
                 cpp_src!("const auto* {name}_native = {name}_count_native ? {name}_unique.get() : nullptr;");
             },
             "uint16_t" => cpp_src!("const uint16_t {name}_native = static_cast<uint16_t>({name});"),
+            "uint32_t" => cpp_src!("const uint32_t {name}_native = static_cast<uint32_t>({name});"),
             "const char*" => {
                 cpp_src!("const char* {name}_native = ({name} ? env->GetStringUTFChars({name}, nullptr) : nullptr);");
             },
+            "const uint8_t*" => {
+                // already marshalled above
+            },
             "char*" => {
                 // marshalled in as a jstring
                 let fromto_pattern = Regex::new(r"^gosling_(?P<from>\w+)_to_(?P<to>\w+)$").unwrap();
@@ -225,7 +290,11 @@ handlebars_helper!(marshallJNIParams: |function_name: String, params: Vec<Param>
                 cpp_src!("char {name}_native[{buffer_size}] = {{}};");
             },
             "size_t" => {
-                if name.ends_with("_length") {
+                let buffer_name = name.strip_suffix("_size").unwrap_or_default();
+                if params.iter().any(|param| param.name == buffer_name && param.typename == "const uint8_t*") {
+                    // handle size param for a const uint8_t* buffer
+                    cpp_src!("const size_t {name}_native = {buffer_name}_remaining;");
+                } else if name.ends_with("_length") {
                     // handle length param for a const char* utf8 string
                     let jstring_name = &name[..name.len() - 7];
                     cpp_src!("const size_t {name}_native = ({jstring_name} ? static_cast<size_t>(env->GetStringUTFLength({jstring_name})) : 0);");
@@ -238,7 +307,15 @@ handlebars_helper!(marshallJNIParams: |function_name: String, params: Vec<Param>
                     let buffer_size = format!("{}_{}_SIZE", from.to_uppercase(), to.to_uppercase());
                     cpp_src!("constexpr size_t {name}_native = {buffer_size};");
                 } else if name.ends_with("_count") {
-                    // no-op for arrays of primitives
+                    let array_name = name.strip_suffix("_count").unwrap_or_default();
+                    if params.iter().any(|param| param.name == array_name) {
+                        // no-op for arrays of primitives
+                    } else if let Some(param) = handle_arrays.first() {
+                        // handle count param for arrays of GoslingHandles
+                        cpp_src!("const size_t {name}_native = {}_length;", param.name);
+                    } else {
+                        panic!("unhandled argument => {name}: {typename}");
+                    }
                 } else {
                     panic!("unhandled argument => {name}: {typename}");
                 }
@@ -255,7 +332,9 @@ handlebars_helper!(marshallJNIParams: |function_name: String, params: Vec<Param>
                 let out_gosling_pointer_pattern = Regex::new(r"^gosling_\w+\*\*$").unwrap();
                 let gosling_callback_pattern = Regex::new(r"^gosling_\w+_callback_t$").unwrap();
 
-                if const_gosling_pointer_pattern.is_match(&typename) ||
+                if handle_array_pattern.is_match(&typename) {
+                    // already marshalled above
+                } else if const_gosling_pointer_pattern.is_match(&typename) ||
                    gosling_pointer_pattern.is_match(&typename) {
                     cpp_src!("{typename} {name}_native = reinterpret_cast<{typename}>(g_jni_glue->jobject_handle_to_void_pointer(env, {name}));");
                     if name.starts_with("in_") {
@@ -341,7 +420,7 @@ handlebars_helper!(marshallNativeResults: |return_type: String, params: Vec<Para
         let typename: &str = param.typename.as_ref();
 
         match typename {
-            "uint8_t" | "uint16_t" | "size_t" | "gosling_handshake_handle_t" | "gosling_circuit_token_t" | "const uint16_t*" => (),
+            "bool" | "uint8_t" | "uint16_t" | "uint32_t" | "size_t" | "gosling_handshake_handle_t" | "gosling_circuit_token_t" | "const uint16_t*" | "const uint8_t*" => (),
             "const char*" => {
                 cpp_src!("env->ReleaseStringUTFChars({name}, {name}_native);");
             },
@@ -357,18 +436,19 @@ handlebars_helper!(marshallNativeResults: |return_type: String, params: Vec<Para
             _ => {
                 let const_gosling_pointer_pattern = Regex::new(r"^const gosling_\w+\*$").unwrap();
                 let gosling_pointer_pattern = Regex::new(r"^gosling_\w+\*$").unwrap();
-                let out_gosling_pointer_pattern = Regex::new(r"^gosling_(?P<java_typename>\w+)\*\*$").unwrap();
+                let out_gosling_pointer_pattern = Regex::new(r"^(?P<alias>gosling_\w+)\*\*$").unwrap();
                 let gosling_callback_pattern = Regex::new(r"^gosling_\w+_callback_t$").unwrap();
 
-                if const_gosling_pointer_pattern.is_match(&typename) ||
+                if typename.ends_with("*const*") {
+                    // arrays of GoslingHandles are only borrowed
+                } else if const_gosling_pointer_pattern.is_match(&typename) ||
                    gosling_pointer_pattern.is_match(&typename) {
                     // nothing to do here
                 } else if out_gosling_pointer_pattern.is_match(&typename) {
                     let caps = out_gosling_pointer_pattern.captures(&typename).unwrap();
-                    let java_typename = caps.name("java_typename").unwrap().as_str();
-                    let java_typename = java_typename.to_upper_camel_case();
+                    let alias = caps.name("alias").unwrap().as_str();
 
-                    cpp_src!("g_jni_glue->set_out_jobject_handle(env, {name}, \"net/blueprintforfreespeech/gosling/Gosling${java_typename}\", {name}_dest);");
+                    cpp_src!("g_jni_glue->set_out_jobject_handle(env, {name}, g_jni_glue->{alias}_class, {name}_dest);");
                 } else if gosling_callback_pattern.is_match(&typename) {
                     // nothing to do here
                 } else {
@@ -436,15 +516,13 @@ handlebars_helper!(marshallNativeParams: |input_params: Vec<Param>| {
                     panic!("unexpected param -> {name} : {typename}");
                 }
             },
+            // wrap the native buffers rather than copying them; the wrappers are only
+            // valid for the duration of the callback
             "const uint8_t*" => {
-                cpp_src!("jbyteArray {name}_jni = env->NewByteArray({name}_size);");
-                cpp_src!("env->SetByteArrayRegion({name}_jni, 0, {name}_size, reinterpret_cast<const jbyte*>({name}));");
+                cpp_src!("jobject {name}_jni = g_jni_glue->new_read_only_byte_buffer(env, {name}, {name}_size);");
             },
             "uint8_t*" => {
-                cpp_src!("jbyteArray {name}_jni = env->NewByteArray({name}_size);");
-                cpp_src!("jbyte* {name}_jni_buffer = env->GetByteArrayElements({name}_jni, nullptr);");
-                cpp_src!("std::fill({name}_jni_buffer, {name}_jni_buffer + {name}_size, jbyte(0));");
-                cpp_src!("env->ReleaseByteArrayElements({name}_jni, {name}_jni_buffer, 0);");
+                cpp_src!("jobject {name}_jni = env->NewDirectByteBuffer({name}, static_cast<jlong>({name}_size));");
             },
             "gosling_handshake_handle_t" => cpp_src!("const jlong {name}_jni = static_cast<jlong>({name});"),
             "gosling_tcp_socket_t" => {
@@ -456,7 +534,7 @@ handlebars_helper!(marshallNativeParams: |input_params: Vec<Param>| {
                 assert!(typename.ends_with("*"));
 
                 match typename {
-                    "gosling_context*" => cpp_src!("jobject {name}_jni = g_jni_glue->void_pointer_to_jobject_handle(env, \"net/blueprintforfreespeech/gosling/Gosling$Context\", {name}, true);"),
+                    "gosling_context*" => cpp_src!("jobject {name}_jni = g_jni_glue->void_pointer_to_jobject_handle(env, g_jni_glue->gosling_context_class, {name}, true);"),
                     _ => {
                         if typename.starts_with("const gosling_") {
                             let typename = &typename[6..];
@@ -465,8 +543,7 @@ handlebars_helper!(marshallNativeParams: |input_params: Vec<Param>| {
                             let typename = &typename[..typename.len() - 1];
                             cpp_src!("::{typename}_clone(&{name}_clone, {name}, &{name}_clone_error);");
                             cpp_src!("assert({name}_clone_error == nullptr);");
-                            let classname = typename[8..].to_upper_camel_case();
-                            cpp_src!("jobject {name}_jni = g_jni_glue->void_pointer_to_jobject_handle(env, \"net/blueprintforfreespeech/gosling/Gosling${classname}\", {name}_clone, false);");
+                            cpp_src!("jobject {name}_jni = g_jni_glue->void_pointer_to_jobject_handle(env, g_jni_glue->{typename}_class, {name}_clone, false);");
                         } else {
                             panic!("unhandled param -> {name}: {typename}");
                         }
@@ -478,45 +555,17 @@ handlebars_helper!(marshallNativeParams: |input_params: Vec<Param>| {
     marshall_lines.join("\n")
 });
 
-handlebars_helper!(callJavaCallback: |name: String, return_type: String, input_params: Vec<Param>| {
-    let mut marshall_lines: Vec<String> = Default::default();
-    macro_rules! cpp_src {
-        ($($arg:tt)*) => {
-            {
-                let line = format!($($arg)*);
-                let indented_line = format!("    {}", line);
-                marshall_lines.push(indented_line);
-            }
-        };
-    }
-
-    match return_type.as_ref() {
-        "void" => (),
-        "bool" => cpp_src!("jboolean result_jni = JNI_FALSE;"),
-        "size_t" => cpp_src!("jlong result_jni = jlong(0);"),
-        __ => panic!("unhandled return -> {return_type}"),
-    };
-    cpp_src!("if (std::lock_guard<std::mutex> lock(g_jni_glue->listener_map_mutex); true) {{");
-    cpp_src!("    auto it = g_jni_glue->listener_map.find(context);");
-    cpp_src!("    assert(it != g_jni_glue->listener_map.end());");
-    let jni_callback_name = &name[8..name.len()-2];
-    cpp_src!("    const jobject& callback_jni = it->second.{jni_callback_name};");
-    cpp_src!("    assert(callback_jni != nullptr);");
-    cpp_src!("    jclass jc = env->GetObjectClass(callback_jni);");
-    cpp_src!("    assert(jc != nullptr);");
-    let callback_name = jni_callback_name[..jni_callback_name.len() - 9].to_upper_camel_case();
-    let method_name = format!("on{callback_name}Event");
-    cpp_src!("    const auto method_name = \"{method_name}\";");
-
+// the JNI signature of the Java listener method called by a native callback
+fn callback_method_signature(return_type: &str, input_params: &[Param]) -> String {
     let mut method_params_signature: Vec<String> = Default::default();
-    for param in &input_params {
+    for param in input_params {
         let name: &str = param.name.as_ref();
         let typename: &str = param.typename.as_ref();
         let param_signature = match typename {
             "bool" => "Z".to_string(),
             "uint32_t" | "gosling_handshake_handle_t" => "J".to_string(),
             "const char*" => "Ljava/lang/String;".to_string(),
-            "const uint8_t*" | "uint8_t*" => "[B".to_string(),
+            "const uint8_t*" | "uint8_t*" => "Ljava/nio/ByteBuffer;".to_string(),
             "gosling_tcp_socket_t" => "Ljava/net/Socket;".to_string(),
             "size_t" => {
                 if name.ends_with("_size") || name.ends_with("_length") {
@@ -541,17 +590,46 @@ handlebars_helper!(callJavaCallback: |name: String, return_type: String, input_p
         method_params_signature.push(param_signature);
     }
     let method_params_signature = method_params_signature.join("");
-    let method_return_signature = match return_type.as_ref() {
+    let method_return_signature = match return_type {
         "void" => "V",
         "bool" => "Z",
         "size_t" => "J",
         _ => panic!("unhandled return -> {return_type}"),
     };
 
-    let method_signature = format!("({method_params_signature}){method_return_signature}");
-    cpp_src!("    const auto method_signature = \"{method_signature}\";");
-    cpp_src!("    jmethodID method_id = env->GetMethodID(jc, method_name, method_signature);");
-    cpp_src!("    assert(method_id != nullptr);");
+    format!("({method_params_signature}){method_return_signature}")
+}
+
+handlebars_helper!(callbackMethodSignature: |return_type: String, input_params: Vec<Param>| {
+    callback_method_signature(&return_type, &input_params)
+});
+
+handlebars_helper!(callJavaCallback: |name: String, return_type: String, input_params: Vec<Param>| {
+    let mut marshall_lines: Vec<String> = Default::default();
+    macro_rules! cpp_src {
+        ($($arg:tt)*) => {
+            {
+                let line = format!($($arg)*);
+                let indented_line = format!("    {}", line);
+                marshall_lines.push(indented_line);
+            }
+        };
+    }
+
+    match return_type.as_ref() {
+        "void" => (),
+        "bool" => cpp_src!("jboolean result_jni = JNI_FALSE;"),
+        "size_t" => cpp_src!("jlong result_jni = jlong(0);"),
+        __ => panic!("unhandled return -> {return_type}"),
+    };
+    cpp_src!("if (std::lock_guard<std::mutex> lock(g_jni_glue->listener_map_mutex); true) {{");
+    cpp_src!("    auto it = g_jni_glue->listener_map.find(context);");
+    cpp_src!("    assert(it != g_jni_glue->listener_map.end());");
+    let jni_callback_name = &name[8..name.len()-2];
+    cpp_src!("    const jobject& callback_jni = it->second.{jni_callback_name};");
+    cpp_src!("    assert(callback_jni != nullptr);");
+    // method ids are resolved once in JNI_OnLoad
+    cpp_src!("    const jmethodID method_id = g_jni_glue->{jni_callback_name}_method;");
 
     let mut call_method_params: Vec<String> = Default::default();
     call_method_params.push("callback_jni".to_string());
@@ -597,13 +675,8 @@ handlebars_helper!(marshallJNIResults: |return_type: String, input_params: Vec<P
 
         match typename {
             "bool" | "uint32_t" | "size_t" | "gosling_handshake_handle_t" => {},
-            "const char*" |"const uint8_t*" => cpp_src!("env->DeleteLocalRef({name}_jni);"),
-            "uint8_t*" => {
-                cpp_src!("{name}_jni_buffer = env->GetByteArrayElements({name}_jni, nullptr);");
-                cpp_src!("std::copy({name}_jni_buffer, {name}_jni_buffer + {name}_size, {name});");
-                cpp_src!("env->ReleaseByteArrayElements({name}_jni, {name}_jni_buffer, JNI_ABORT);");
-                cpp_src!("env->DeleteLocalRef({name}_jni);");
-            }
+            // the listener wrote straight into uint8_t* buffers, nothing to copy back
+            "const char*" | "const uint8_t*" | "uint8_t*" => cpp_src!("env->DeleteLocalRef({name}_jni);"),
             "gosling_tcp_socket_t" => cpp_src!("env->DeleteLocalRef({name}_jni);"),
             _ => {
                 assert!(typename.starts_with("gosling_") || typename.starts_with("const gosling_"));
@@ -642,6 +715,7 @@ fn main() {
 
     // .java helpers
     handlebars.register_helper("aliasToClassName", Box::new(aliasToClassName));
+    handlebars.register_helper("constantToJavaName", Box::new(constantToJavaName));
     handlebars.register_helper("functionToNativeMethodName", Box::new(functionToNativeMethodName));
     handlebars.register_helper("aliasToNativeFreeMethodName", Box::new(aliasToNativeFreeMethodName));
     handlebars.register_helper("callbackToInterfaceName", Box::new(callbackToInterfaceName));
@@ -658,6 +732,7 @@ fn main() {
     handlebars.register_helper("callbackNameToMapName", Box::new(callbackNameToMapName));
     handlebars.register_helper("inputParamsToNativeParams", Box::new(inputParamsToNativeParams));
     handlebars.register_helper("marshallNativeParams", Box::new(marshallNativeParams));
+    handlebars.register_helper("callbackMethodSignature", Box::new(callbackMethodSignature));
     handlebars.register_helper("callJavaCallback", Box::new(callJavaCallback));
     handlebars.register_helper("marshallJNIResults", Box::new(marshallJNIResults));
 
@@ -33,6 +33,8 @@ handlebars_helper!(snakeCaseToCamelCase: |snake_case: String| {
 });
 
 handlebars_helper!(nativeTypeToPythonType: |native_type: String| {
+    // ctypes has no const pointers, so arrays of gosling objects are plain double pointers
+    let native_type = native_type.replace("*const*", "**");
     let mut pointer_count = 0;
     let native_type = if native_type.ends_with("**") {
         pointer_count = 2;
@@ -24,11 +24,18 @@ int main() try {
     TERM.register_command("help", example::help);
     TERM.register_command("exit", example::exit);
 
+    // how long we may go without checking for keyboard input
+    constexpr uint32_t INPUT_TIMEOUT_MILLISECONDS = 16;
+
     while (!EXIT_REQUESTED) {
         if (GOSLING_CONTEXT) {
+            // sleep until gosling has work for us rather than spinning
+            ::gosling_context_wait_events(GOSLING_CONTEXT.get(), INPUT_TIMEOUT_MILLISECONDS, throw_on_error());
             ::gosling_context_poll_events(GOSLING_CONTEXT.get(), throw_on_error());
+            TERM.update(0);
+        } else {
+            TERM.update(INPUT_TIMEOUT_MILLISECONDS);
         }
-        TERM.update();
 
         for(auto it = ENDPOINT_CONNECTIONS.begin(); it != ENDPOINT_CONNECTIONS.end();) {
             const auto& peer_id = it->first;
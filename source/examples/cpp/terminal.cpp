@@ -10,7 +10,7 @@ namespace example {
         ::noecho();  // Don't echo input
         ::mousemask(0, NULL); // Disable mouse events
         ::keypad(stdscr, TRUE); // Enable special key handling
-        ::timeout(16); // timeout getch() after 16 milliseconds
+        ::timeout(0); // getch() does not block, see update()
 
         this->render();
     }
@@ -47,10 +47,14 @@ namespace example {
         this->render();
     }
 
-    void terminal::update() {
+    void terminal::update(int timeout_milliseconds) {
         string command;
         bool dirty = false;
-        for (int inputChar = getch(); inputChar != ERR; inputChar = getch()) {
+        // only block waiting for the first keypress
+        ::timeout(timeout_milliseconds);
+        int inputChar = getch();
+        ::timeout(0);
+        for (; inputChar != ERR; inputChar = getch()) {
 
             switch(inputChar) {
             case '\n':
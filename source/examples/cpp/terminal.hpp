@@ -11,7 +11,8 @@ namespace example {
 
         void write_line();
         void write_line(string line);
-        void update();
+        // process pending keyboard input, blocking up to timeout_milliseconds for it
+        void update(int timeout_milliseconds);
     private:
         void render();
         void handle_command(string input);
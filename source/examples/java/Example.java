@@ -66,13 +66,13 @@ public class Example {
 
         // Identity Client Callbacks
 
-        public long onIdentityClientHandshakeChallengeResponseSizeEvent(Context context, long handshake_handle, byte[] challenge_buffer) {
+        public long onIdentityClientHandshakeChallengeResponseSizeEvent(Context context, long handshake_handle, java.nio.ByteBuffer challenge_buffer) {
             return Example.EMPTY_BSON.length;
         }
-        public void onIdentityClientHandshakeBuildChallengeResponseEvent(Context context, long handshake_handle, byte[] challenge_buffer, byte[] out_challenge_response_buffer) {
+        public void onIdentityClientHandshakeBuildChallengeResponseEvent(Context context, long handshake_handle, java.nio.ByteBuffer challenge_buffer, java.nio.ByteBuffer out_challenge_response_buffer) {
             System.out.println("> " + name + ": Builds Client Challenge Response");
-            assert out_challenge_response_buffer.length == Example.EMPTY_BSON.length;
-            System.arraycopy(Example.EMPTY_BSON, 0, out_challenge_response_buffer, 0, Example.EMPTY_BSON.length);
+            assert out_challenge_response_buffer.capacity() == Example.EMPTY_BSON.length;
+            out_challenge_response_buffer.put(Example.EMPTY_BSON);
         }
         public void onIdentityClientHandshakeCompletedEvent(Context context, long handshake_handle, V3OnionServiceId identity_service_id, V3OnionServiceId endpoint_service_id, String endpoint_name, X25519PrivateKey client_auth_private_key) {
             this.identityClientHandshakeComplete = true;
@@ -101,12 +101,12 @@ public class Example {
         public long onIdentityServerHandshakeChallengeSizeEvent(Context context, long handshake_handle) {
             return Example.EMPTY_BSON.length;
         }
-        public void onIdentityServerHandshakeBuildChallengeEvent(Context context, long handshake_handle, byte[] out_challenge_buffer) {
+        public void onIdentityServerHandshakeBuildChallengeEvent(Context context, long handshake_handle, java.nio.ByteBuffer out_challenge_buffer) {
             System.out.println("> " + this.name + ": Builds Server Challenge");
-            assert out_challenge_buffer.length == Example.EMPTY_BSON.length;
-            System.arraycopy(Example.EMPTY_BSON, 0, out_challenge_buffer, 0, Example.EMPTY_BSON.length);
+            assert out_challenge_buffer.capacity() == Example.EMPTY_BSON.length;
+            out_challenge_buffer.put(Example.EMPTY_BSON);
         }
-        public boolean onIdentityServerHandshakeVerifyChallengeResponseEvent(Context context, long handshake_handle, byte[] challenge_response_buffer) {
+        public boolean onIdentityServerHandshakeVerifyChallengeResponseEvent(Context context, long handshake_handle, java.nio.ByteBuffer challenge_response_buffer) {
             return true;
         }
 
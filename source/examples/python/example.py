@@ -1,3 +1,6 @@
+import asyncio
+import sys
+
 from cgosling import *
 
 def handle_error(err):
@@ -62,10 +65,27 @@ def main():
     gosling_context_bootstrap_tor(context, pointer(err))
     handle_error(err)
 
+    if '--asyncio' in sys.argv:
+        asyncio.run(async_bootstrap(context))
+        return
+
     while not bootstrap_complete:
+        gosling_context_wait_events(context, 100, pointer(err))
+        handle_error(err)
         gosling_context_poll_events(context, pointer(err))
         handle_error(err)
 
+# poll the context's events in batches from an asyncio event loop rather than
+# through callbacks
+async def async_bootstrap(context):
+    async_context = GoslingAsyncContext(context)
+    async for event in async_context.events():
+        if event.event_type == GOSLING_EVENT_TYPE_TOR_BOOTSTRAP_STATUS_RECEIVED:
+            print("python: bootstrap status", event.data.tor_bootstrap_status_received.progress)
+        elif event.event_type == GOSLING_EVENT_TYPE_TOR_BOOTSTRAP_COMPLETED:
+            print("python: bootstrap complete")
+            break
+
 # The following block ensures that the main function is only executed when the script is run directly
 if __name__ == "__main__":
     main()
\ No newline at end of file
@@ -118,6 +118,7 @@ pub fn init_context(globals: &mut Globals, args: &Vec<String>) -> Result<()> {
         allowed_ports: None,
         pluggable_transports: None,
         bridge_lines: None,
+        unix_domain_sockets: false,
     };
     let tor_client = Box::new(LegacyTorClient::new(tor_config)?);
 
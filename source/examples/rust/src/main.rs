@@ -70,6 +70,7 @@ fn main() -> Result<()> {
                         handle,
                         client_service_id,
                         requested_endpoint,
+                        ..
                     } => {
                         globals.term.write_line(format!("  {client_service_id} requesting endpoint").as_str());
                         // validate the request and build a challenge object for the client
@@ -0,0 +1,54 @@
+// standard
+use std::alloc::{GlobalAlloc, Layout, System};
+use std::sync::atomic::{AtomicUsize, Ordering};
+
+//
+// Allocation Counter
+//
+
+// Wraps the system allocator and counts every allocation so benchmarks can
+// report allocations alongside criterion's timing and throughput numbers
+pub struct CountingAllocator;
+
+static ALLOCATIONS: AtomicUsize = AtomicUsize::new(0);
+static ALLOCATED_BYTES: AtomicUsize = AtomicUsize::new(0);
+
+unsafe impl GlobalAlloc for CountingAllocator {
+    unsafe fn alloc(&self, layout: Layout) -> *mut u8 {
+        ALLOCATIONS.fetch_add(1, Ordering::Relaxed);
+        ALLOCATED_BYTES.fetch_add(layout.size(), Ordering::Relaxed);
+        System.alloc(layout)
+    }
+
+    unsafe fn dealloc(&self, ptr: *mut u8, layout: Layout) {
+        System.dealloc(ptr, layout)
+    }
+
+    unsafe fn realloc(&self, ptr: *mut u8, layout: Layout, new_size: usize) -> *mut u8 {
+        ALLOCATIONS.fetch_add(1, Ordering::Relaxed);
+        ALLOCATED_BYTES.fetch_add(new_size, Ordering::Relaxed);
+        System.realloc(ptr, layout, new_size)
+    }
+}
+
+// Runs f() iterations times and prints the average number of allocations and
+// allocated bytes per iteration
+pub fn report_allocations<F: FnMut()>(name: &str, iterations: usize, mut f: F) {
+    // warm up any lazily initialised state and re-usable buffers
+    f();
+
+    let allocations_begin = ALLOCATIONS.load(Ordering::Relaxed);
+    let allocated_bytes_begin = ALLOCATED_BYTES.load(Ordering::Relaxed);
+    for _ in 0..iterations {
+        f();
+    }
+    let allocations = ALLOCATIONS.load(Ordering::Relaxed) - allocations_begin;
+    let allocated_bytes = ALLOCATED_BYTES.load(Ordering::Relaxed) - allocated_bytes_begin;
+
+    println!(
+        "{}: {:.1} allocations/iter, {:.1} bytes/iter",
+        name,
+        allocations as f64 / iterations as f64,
+        allocated_bytes as f64 / iterations as f64
+    );
+}
@@ -52,8 +52,24 @@ struct Data {
     aliases: Vec<Alias>,
     callbacks: Vec<Function>,
     functions: Vec<Function>,
+    // functions using NATIVE_TYPES or listed in NATIVE_FUNCTIONS, which the Java
+    // bindings do not render
+    native_functions: Vec<Function>,
 }
 
+// types declared by hand in the C header template whose layout the other
+// language bindings do not (yet) know how to represent
+const NATIVE_TYPES: [&str; 2] = ["gosling_event", "gosling_metrics"];
+
+fn is_native_type(typename: &str) -> bool {
+    let typename = typename.trim_start_matches("const ").trim_end_matches('*');
+    NATIVE_TYPES.contains(&typename)
+}
+
+// functions which are only meaningful to native event loops, e.g. because they
+// return an OS handle
+const NATIVE_FUNCTIONS: [&str; 1] = ["gosling_context_get_event_fd"];
+
 fn preprocess_any(source: String, features: &Vec<&str>) -> String {
 
     let block_regex = Regex::new(r"(?m)(?<anyblock>#if \(?(defined\(([A-Z_]+)\)( \|\| )?)+\)?([^#]*\n)*#endif\n\n)").unwrap();
@@ -171,6 +187,7 @@ fn parse_header(source: &str) -> Data {
     let mut aliases: Vec<Alias> = Default::default();
     let mut callbacks: Vec<Function> = Default::default();
     let mut functions: Vec<Function> = Default::default();
+    let mut native_functions: Vec<Function> = Default::default();
 
     config_flags.push(ConfigFlag {
         comments: vec!["Defined if cgosling is built with mock tor-provider support".to_string()],
@@ -244,12 +261,22 @@ fn parse_header(source: &str) -> Data {
             let r = r.trim().replace(" *", "*");
 
             let params = parse_param(p);
-            functions.push(Function {
+            let function = Function {
                 name: n.to_string(),
                 return_param: r,
                 input_params: params,
                 comments,
-            });
+            };
+            if NATIVE_FUNCTIONS.contains(&function.name.as_str())
+                || function
+                    .input_params
+                    .iter()
+                    .any(|param| is_native_type(&param.typename))
+            {
+                native_functions.push(function);
+            } else {
+                functions.push(function);
+            }
         }
     }
 
@@ -259,6 +286,7 @@ fn parse_header(source: &str) -> Data {
         aliases,
         callbacks,
         functions,
+        native_functions,
     }
 }
 
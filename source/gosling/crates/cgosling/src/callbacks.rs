@@ -24,6 +24,8 @@ pub(crate) struct EventCallbacks {
         GoslingIdentityClientHandshakeChallengeResponseSizeCallback,
     pub identity_client_build_challenge_response_callback:
         GoslingIdentityClientHandshakeBuildChallengeResponseCallback,
+    pub identity_client_challenge_response_callback:
+        GoslingIdentityClientHandshakeChallengeResponseCallback,
     pub identity_client_handshake_completed_callback:
         GoslingIdentityClientHandshakeCompletedCallback,
     pub identity_client_handshake_failed_callback: GoslingIdentityClientHandshakeFailedCallback,
@@ -38,6 +40,7 @@ pub(crate) struct EventCallbacks {
         GoslingIdentityServerHandshakeChallengeSizeCallback,
     pub identity_server_build_challenge_callback:
         GoslingIdentityServerHandshakeBuildChallengeCallback,
+    pub identity_server_challenge_callback: GoslingIdentityServerHandshakeChallengeCallback,
     pub identity_server_verify_challenge_response_callback:
         GoslingIdentityServerHandshakeVerifyChallengeResponseCallback,
     pub identity_server_handshake_completed_callback:
@@ -144,6 +147,39 @@ pub type GoslingIdentityClientHandshakeBuildChallengeResponseCallback = Option<
     ) -> (),
 >;
 
+/// The function pointer type for the identity client handshake challenge response
+/// callback. This callback is called when a client is ready to build a challenge
+/// response object, and replaces the challenge response size callback and build
+/// challenge response callback pair with a single call. If set, it takes precedence
+/// over that pair.
+///
+/// The callback writes the challenge response into out_challenge_response_buffer and
+/// returns the number of bytes it requires. If the returned size is larger than
+/// out_challenge_response_buffer_size then nothing has been written; the buffer is
+/// grown to the returned size and the callback is called once more.
+///
+/// @param context: the context associated with this event
+/// @param handshake_handle: the handshake handle this callback is associated with
+/// @param challenge_buffer: the source buffer containing a BSON document received
+///  from the  identity server to serve as an endpoint request challenge
+/// @param challenge_buffer_size: the number of bytes in challenge_buffer
+/// @param out_challenge_response_buffer: the destination buffer for the callback
+///  to write a BSON document representing the endpoint request challenge response
+///  object
+/// @param out_challenge_response_buffer_size: the number of bytes allocated in
+///  out_challenge_response_buffer
+/// @return the number of bytes required to store the challenge response object
+pub type GoslingIdentityClientHandshakeChallengeResponseCallback = Option<
+    extern "C" fn(
+        context: *mut GoslingContext,
+        handshake_handle: GoslingHandshakeHandle,
+        challenge_buffer: *const u8,
+        challenge_buffer_size: usize,
+        out_challenge_response_buffer: *mut u8,
+        out_challenge_response_buffer_size: usize,
+    ) -> usize,
+>;
+
 /// The function pointer type for the identity client handshake completed callback. This
 /// callback is called whenever the client successfully completes a handshake with an
 /// identity server and is granted access to an endpoint server.
@@ -271,6 +307,32 @@ pub type GoslingIdentityServerHandshakeBuildChallengeCallback = Option<
     ) -> (),
 >;
 
+/// The function pointer type for the server handshake challenge callback. This
+/// callback is called when a server needs to build a challenge object, and replaces
+/// the challenge size callback and build challenge callback pair with a single call.
+/// If set, it takes precedence over that pair.
+///
+/// The callback writes the challenge into out_challenge_buffer and returns the
+/// number of bytes it requires. If the returned size is larger than
+/// out_challenge_buffer_size then nothing has been written; the buffer is grown to
+/// the returned size and the callback is called once more.
+///
+/// @param context: the context associated with this event
+/// @param handshake_handle: the handshake handle this callback is associated with
+/// @param out_challenge_buffer: the destination buffer for the callback
+///  to write a BSON document representing the endpoint request challenge object
+/// @param out_challenge_buffer_size: the number of bytes allocated in
+///  out_challenge_buffer
+/// @return the number of bytes required to store the challenge object
+pub type GoslingIdentityServerHandshakeChallengeCallback = Option<
+    extern "C" fn(
+        context: *mut GoslingContext,
+        handshake_handle: GoslingHandshakeHandle,
+        out_challenge_buffer: *mut u8,
+        out_challenge_buffer_size: usize,
+    ) -> usize,
+>;
+
 /// The function poointer type for the server handshake verify challenge response
 /// callback. This callback is called when a server needs to verify a challenge
 /// response object.
@@ -513,8 +575,8 @@ macro_rules! impl_callback_setter {
     ($callback_type:tt, $context:expr, $callback:expr, $error:expr) => {
         paste::paste! {
             translate_failures((), $error, || -> anyhow::Result<()> {
-                let mut context_tuple_registry = get_context_tuple_registry();
-                let context = match context_tuple_registry.get_mut($context as usize) {
+                let context_tuple_registry = get_context_tuple_registry();
+                let mut context = match context_tuple_registry.get_mut($context as usize) {
                     Some(context) => context,
                     None => {
                         bail_invalid_handle!(context);
@@ -618,6 +680,28 @@ pub extern "C" fn gosling_context_set_identity_client_build_challenge_response_c
     );
 }
 
+/// Sets the identity client challenge response callback for the specified context.
+/// When set, it is used instead of the challenge response size and build challenge
+/// response callbacks.
+///
+/// @param context: the context to register the callback to
+/// @param callback: the callback to register
+/// @param  error: filled on error
+#[no_mangle]
+#[cfg_attr(feature = "impl-lib", rename_impl)]
+pub extern "C" fn gosling_context_set_identity_client_challenge_response_callback(
+    context: *mut GoslingContext,
+    callback: GoslingIdentityClientHandshakeChallengeResponseCallback,
+    error: *mut *mut GoslingError,
+) {
+    impl_callback_setter!(
+        identity_client_challenge_response_callback,
+        context,
+        callback,
+        error
+    );
+}
+
 /// Set the identity client handshake completed callback for the specified context.
 ///
 /// @param context: the context to register the callback to
@@ -773,6 +857,22 @@ pub extern "C" fn gosling_context_set_identity_server_build_challenge_callback(
     );
 }
 
+/// Sets the identity server challenge callback for the specified context. When set,
+/// it is used instead of the challenge size and build challenge callbacks.
+///
+/// @param context: the context to register the callback to
+/// @param callback: the callback to register
+/// @param  error: filled on error
+#[no_mangle]
+#[cfg_attr(feature = "impl-lib", rename_impl)]
+pub extern "C" fn gosling_context_set_identity_server_challenge_callback(
+    context: *mut GoslingContext,
+    callback: GoslingIdentityServerHandshakeChallengeCallback,
+    error: *mut *mut GoslingError,
+) {
+    impl_callback_setter!(identity_server_challenge_callback, context, callback, error);
+}
+
 /// Sets the identity server verify challenge response callback for the specified context.
 ///
 /// @param context: the context to register the callback to
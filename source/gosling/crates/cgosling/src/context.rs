@@ -35,6 +35,11 @@ use crate::tor_provider::*;
 // };
 const SMALLEST_BSON_DOC_SIZE: usize = 5;
 
+// initial size of the buffer handed to the single-pass challenge callbacks; this
+// matches the identity message size budget gosling_context_init() passes to
+// Context::new() so any challenge which could actually be sent fits on the first call
+const CHALLENGE_BUFFER_INITIAL_SIZE: usize = 4096;
+
 /// A handle for an in-progress identity handhskae
 pub type GoslingHandshakeHandle = usize;
 #[cfg(any(target_os = "linux", target_os = "macos"))]
@@ -46,7 +51,12 @@ pub type GoslingTcpSocket = RawSocket;
 /// A context object associated with a single peer identity
 pub struct GoslingContext;
 /// cbindgen:ignore
-type ContextTuple = (Context, EventCallbacks, Option<VecDeque<ContextEvent>>);
+type ContextTuple = (
+    Context,
+    EventCallbacks,
+    Option<VecDeque<ContextEvent>>,
+    EventArena,
+);
 define_registry! {ContextTuple}
 
 /// Frees a gosling_context object
@@ -91,11 +101,11 @@ pub unsafe extern "C" fn gosling_context_init(
             None => bail_invalid_handle!(tor_provider),
         };
 
-        // get our identity key
-        let ed25519_private_key_registry = get_ed25519_private_key_registry();
+        // get our identity key; copied out so we do not hold its registry
+        // shard locked while inserting into the context registry
         let identity_private_key =
-            match ed25519_private_key_registry.get(identity_private_key as usize) {
-                Some(identity_private_key) => identity_private_key,
+            match get_ed25519_private_key_registry().get(identity_private_key as usize) {
+                Some(identity_private_key) => identity_private_key.clone(),
                 None => bail_invalid_handle!(identity_private_key),
             };
 
@@ -107,10 +117,15 @@ pub unsafe extern "C" fn gosling_context_init(
             Duration::from_secs(60),
             4096,
             Some(Duration::from_secs(60)),
-            identity_private_key.clone(),
+            identity_private_key,
         )?;
 
-        let handle = get_context_tuple_registry().insert((context, Default::default(), None));
+        let handle = get_context_tuple_registry().insert((
+            context,
+            Default::default(),
+            None,
+            Default::default(),
+        ));
         *out_context = handle as *mut GoslingContext;
 
         Ok(())
@@ -130,8 +145,8 @@ pub extern "C" fn gosling_context_bootstrap_tor(
     translate_failures((), error, || -> anyhow::Result<()> {
         ensure_not_null!(context);
 
-        let mut context_tuple_registry = get_context_tuple_registry();
-        let context = match context_tuple_registry.get_mut(context as usize) {
+        let context_tuple_registry = get_context_tuple_registry();
+        let mut context = match context_tuple_registry.get_mut(context as usize) {
             Some(context) => context,
             None => bail_invalid_handle!(context),
         };
@@ -139,8 +154,297 @@ pub extern "C" fn gosling_context_bootstrap_tor(
     });
 }
 
+/// Set the number of threads gosling_context_poll_events() uses to drive in-progress identity and
+/// endpoint handshakes. By default handshakes are driven one after another on the calling thread.
+/// The worker threads are spawned by this call and park between calls to
+/// gosling_context_poll_events(). Event callbacks are always called on the thread calling gosling_context_poll_events() and in
+/// the same order regardless of this setting.
+///
+/// @param context: the context object to configure
+/// @param worker_threads: the maximum number of threads to use, including the calling thread; 0 uses
+///  the available parallelism reported by the OS, and 1 (the default) disables multi-threading
+/// @param error: filled on error
+#[no_mangle]
+#[cfg_attr(feature = "impl-lib", rename_impl)]
+pub extern "C" fn gosling_context_set_handshake_worker_threads(
+    context: *mut GoslingContext,
+    worker_threads: u16,
+    error: *mut *mut GoslingError,
+) {
+    translate_failures((), error, || -> anyhow::Result<()> {
+        ensure_not_null!(context);
+
+        let context_tuple_registry = get_context_tuple_registry();
+        let mut context = match context_tuple_registry.get_mut(context as usize) {
+            Some(context) => context,
+            None => bail_invalid_handle!(context),
+        };
+        context
+            .0
+            .set_handshake_worker_threads(worker_threads.into())?;
+        Ok(())
+    });
+}
+
+/// Set the maximum number of incoming identity and endpoint connections
+/// gosling_context_poll_events() accepts per call. By default the identity server and every
+/// endpoint server each accept at most one connection per call. The budget is shared by the
+/// identity server and every endpoint server, which take turns accepting one connection at a
+/// time, each call starting with the server after the last one to accept in the previous call.
+/// Connections closed by admission control do not count against the budget. It only limits
+/// accepts: every in-progress handshake is still advanced by one step per call.
+///
+/// @param context: the context object to configure
+/// @param max_accepts: the maximum number of connections to accept per call; 0 accepts every
+///  pending connection
+/// @param error: filled on error
+#[no_mangle]
+#[cfg_attr(feature = "impl-lib", rename_impl)]
+pub extern "C" fn gosling_context_set_max_accepts_per_update(
+    context: *mut GoslingContext,
+    max_accepts: u32,
+    error: *mut *mut GoslingError,
+) {
+    translate_failures((), error, || -> anyhow::Result<()> {
+        ensure_not_null!(context);
+
+        let context_tuple_registry = get_context_tuple_registry();
+        let mut context = match context_tuple_registry.get_mut(context as usize) {
+            Some(context) => context,
+            None => bail_invalid_handle!(context),
+        };
+        context
+            .0
+            .set_max_accepts_per_update(Some(max_accepts as usize));
+        Ok(())
+    });
+}
+
+/// Set the number of endpoint and client-auth private keys the context generates ahead of time on
+/// a background thread. By default the keys needed to complete identity handshakes are generated
+/// by gosling_context_poll_events() as each handshake needs them; with a key pool they are only
+/// dequeued, and are generated inline only while a burst of handshakes has emptied the pool.
+///
+/// @param context: the context object to configure
+/// @param pool_size: the number of keys of each type to keep ready; 0 (the default) disables the
+///  key pool
+/// @param error: filled on error
+#[no_mangle]
+#[cfg_attr(feature = "impl-lib", rename_impl)]
+pub extern "C" fn gosling_context_set_key_pool_size(
+    context: *mut GoslingContext,
+    pool_size: u32,
+    error: *mut *mut GoslingError,
+) {
+    translate_failures((), error, || -> anyhow::Result<()> {
+        ensure_not_null!(context);
+
+        let context_tuple_registry = get_context_tuple_registry();
+        let mut context = match context_tuple_registry.get_mut(context as usize) {
+            Some(context) => context,
+            None => bail_invalid_handle!(context),
+        };
+        context.0.set_key_pool_size(pool_size as usize)?;
+        Ok(())
+    });
+}
+
+/// Set the number of finished handshakes' message buffers the context keeps for re-use by new
+/// handshakes. Identity and endpoint handshakes share the pool, so each in-progress handshake holds
+/// a few buffers no larger than the larger of the identity and endpoint maximum message sizes;
+/// recycling them rather than freeing them lets servers handling a steady stream of handshakes
+/// re-use the same allocations.
+///
+/// @param context: the context object to configure
+/// @param pool_size: the number of handshakes' buffers to keep; 0 disables re-use, and the
+///  default is 64
+/// @param error: filled on error
+#[no_mangle]
+#[cfg_attr(feature = "impl-lib", rename_impl)]
+pub extern "C" fn gosling_context_set_session_pool_size(
+    context: *mut GoslingContext,
+    pool_size: u32,
+    error: *mut *mut GoslingError,
+) {
+    translate_failures((), error, || -> anyhow::Result<()> {
+        ensure_not_null!(context);
+
+        let context_tuple_registry = get_context_tuple_registry();
+        let mut context = match context_tuple_registry.get_mut(context as usize) {
+            Some(context) => context,
+            None => bail_invalid_handle!(context),
+        };
+        context.0.set_session_pool_size(pool_size as usize);
+        Ok(())
+    });
+}
+
+/// Set the maximum number of incoming identity handshakes the context drives at once. Connections
+/// accepted while the limit is reached are closed straight away, before any session state or
+/// cryptography is spent on them.
+///
+/// @param context: the context object to configure
+/// @param max_handshakes: the maximum number of concurrent incoming identity handshakes; 0 (the
+///  default) is unlimited
+/// @param error: filled on error
+#[no_mangle]
+#[cfg_attr(feature = "impl-lib", rename_impl)]
+pub extern "C" fn gosling_context_set_max_identity_server_handshakes(
+    context: *mut GoslingContext,
+    max_handshakes: u32,
+    error: *mut *mut GoslingError,
+) {
+    translate_failures((), error, || -> anyhow::Result<()> {
+        ensure_not_null!(context);
+
+        let context_tuple_registry = get_context_tuple_registry();
+        let mut context = match context_tuple_registry.get_mut(context as usize) {
+            Some(context) => context,
+            None => bail_invalid_handle!(context),
+        };
+        context
+            .0
+            .set_max_identity_server_handshakes(max_handshakes as usize);
+        Ok(())
+    });
+}
+
+/// Limit the rate at which each identity client may begin identity handshakes with the context.
+/// Each client may begin up to burst handshakes at once and regains one handshake every
+/// refill_interval_milliseconds. Handshakes beyond a client's limit fail as soon as the client has
+/// identified itself, before the identity_server_client_allowed() callback is called.
+///
+/// @param context: the context object to configure
+/// @param burst: the number of handshakes a client may begin at once; 0 (the default) disables
+///  rate limiting
+/// @param refill_interval_milliseconds: the time it takes a client to regain one handshake
+/// @param error: filled on error
+#[no_mangle]
+#[cfg_attr(feature = "impl-lib", rename_impl)]
+pub extern "C" fn gosling_context_set_identity_client_rate_limit(
+    context: *mut GoslingContext,
+    burst: u32,
+    refill_interval_milliseconds: u32,
+    error: *mut *mut GoslingError,
+) {
+    translate_failures((), error, || -> anyhow::Result<()> {
+        ensure_not_null!(context);
+
+        let context_tuple_registry = get_context_tuple_registry();
+        let mut context = match context_tuple_registry.get_mut(context as usize) {
+            Some(context) => context,
+            None => bail_invalid_handle!(context),
+        };
+        context.0.set_identity_client_rate_limit(
+            burst,
+            Duration::from_millis(refill_interval_milliseconds.into()),
+        );
+        Ok(())
+    });
+}
+
+/// Enable or disable early rejection of incoming identity handshakes. By default, handshakes whose
+/// client is not allowed or whose requested endpoint is not supported run to completion before the
+/// identity_server_handshake_rejected() callback is called, so clients learn nothing from when
+/// they are rejected. With early rejection enabled such handshakes are rejected in reply to the
+/// client's first request instead: the identity server challenge callbacks are not called and no
+/// signatures are verified.
+///
+/// @param context: the context object to configure
+/// @param early_rejection: whether to reject handshakes early
+/// @param error: filled on error
+#[no_mangle]
+#[cfg_attr(feature = "impl-lib", rename_impl)]
+pub extern "C" fn gosling_context_set_identity_server_early_rejection(
+    context: *mut GoslingContext,
+    early_rejection: bool,
+    error: *mut *mut GoslingError,
+) {
+    translate_failures((), error, || -> anyhow::Result<()> {
+        ensure_not_null!(context);
+
+        let context_tuple_registry = get_context_tuple_registry();
+        let mut context = match context_tuple_registry.get_mut(context as usize) {
+            Some(context) => context,
+            None => bail_invalid_handle!(context),
+        };
+        context
+            .0
+            .set_identity_server_early_rejection(early_rejection);
+        Ok(())
+    });
+}
+
+/// Set the maximum number of endpoint servers the context publishes at once. Once the limit is
+/// reached, activating further endpoint servers deactivates the active endpoint servers with the
+/// lowest priority first, and among those the least recently active. Lowering the limit
+/// deactivates endpoint servers in the same order straight away.
+///
+/// @param context: the context object to configure
+/// @param max_endpoint_servers: the maximum number of active endpoint servers; 0 (the default) is
+///  unlimited
+/// @param error: filled on error
+#[no_mangle]
+#[cfg_attr(feature = "impl-lib", rename_impl)]
+pub extern "C" fn gosling_context_set_max_published_endpoint_servers(
+    context: *mut GoslingContext,
+    max_endpoint_servers: u32,
+    error: *mut *mut GoslingError,
+) {
+    translate_failures((), error, || -> anyhow::Result<()> {
+        ensure_not_null!(context);
+
+        let context_tuple_registry = get_context_tuple_registry();
+        let mut context = match context_tuple_registry.get_mut(context as usize) {
+            Some(context) => context,
+            None => bail_invalid_handle!(context),
+        };
+        context
+            .0
+            .set_max_published_endpoint_servers(max_endpoint_servers as usize);
+        Ok(())
+    });
+}
+
+/// Set how long an endpoint server may go without accepting a connection before
+/// gosling_context_poll_events() deactivates it. Activating an endpoint server counts as activity.
+///
+/// @param context: the context object to configure
+/// @param idle_timeout_milliseconds: the time after which idle endpoint servers are deactivated; 0
+///  (the default) keeps endpoint servers active until they are deactivated or stopped
+/// @param error: filled on error
+#[no_mangle]
+#[cfg_attr(feature = "impl-lib", rename_impl)]
+pub extern "C" fn gosling_context_set_endpoint_server_idle_timeout(
+    context: *mut GoslingContext,
+    idle_timeout_milliseconds: u32,
+    error: *mut *mut GoslingError,
+) {
+    translate_failures((), error, || -> anyhow::Result<()> {
+        ensure_not_null!(context);
+
+        let context_tuple_registry = get_context_tuple_registry();
+        let mut context = match context_tuple_registry.get_mut(context as usize) {
+            Some(context) => context,
+            None => bail_invalid_handle!(context),
+        };
+        let idle_timeout = match idle_timeout_milliseconds {
+            0 => None,
+            idle_timeout_milliseconds => {
+                Some(Duration::from_millis(idle_timeout_milliseconds.into()))
+            }
+        };
+        context.0.set_endpoint_server_idle_timeout(idle_timeout);
+        Ok(())
+    });
+}
+
 /// Start the identity server so that clients may request endpoints
 ///
+/// May be called before bootstrap has completed, in which case the identity server is started
+/// along with any endpoint servers started in the meantime as one batch once it has; any
+/// failure to do so is reported by gosling_context_poll_events()
+///
 /// @param context: the gosling context whose identity server to start
 /// @param error: filled on error
 #[no_mangle]
@@ -152,8 +456,8 @@ pub extern "C" fn gosling_context_start_identity_server(
     translate_failures((), error, || -> anyhow::Result<()> {
         ensure_not_null!(context);
 
-        let mut context_tuple_registry = get_context_tuple_registry();
-        let context = match context_tuple_registry.get_mut(context as usize) {
+        let context_tuple_registry = get_context_tuple_registry();
+        let mut context = match context_tuple_registry.get_mut(context as usize) {
             Some(context) => context,
             None => bail_invalid_handle!(context),
         };
@@ -174,8 +478,8 @@ pub extern "C" fn gosling_context_stop_identity_server(
     translate_failures((), error, || -> anyhow::Result<()> {
         ensure_not_null!(context);
 
-        let mut context_tuple_registry = get_context_tuple_registry();
-        let context = match context_tuple_registry.get_mut(context as usize) {
+        let context_tuple_registry = get_context_tuple_registry();
+        let mut context = match context_tuple_registry.get_mut(context as usize) {
             Some(context) => context,
             None => bail_invalid_handle!(context),
         };
@@ -185,6 +489,11 @@ pub extern "C" fn gosling_context_stop_identity_server(
 
 /// Start an endpoint server so the confirmed contact may connect
 ///
+/// May be called before bootstrap has completed, in which case the endpoint server is started
+/// along with the identity server and any other endpoint servers started in the meantime as one
+/// batch once it has; any failure to do so is reported by gosling_context_poll_events(). Restarting
+/// a process's endpoint servers this way avoids starting their onion services one by one
+///
 /// @param context: the gosling context with the given endpoint to start
 /// @param endpoint_private_key: the ed25519 private key needed to start the endpoint
 ///  onion service
@@ -212,8 +521,8 @@ pub extern "C" fn gosling_context_start_endpoint_server(
         ensure_not_null!(client_identity);
         ensure_not_null!(client_auth_public_key);
 
-        let mut context_tuple_registry = get_context_tuple_registry();
-        let context = match context_tuple_registry.get_mut(context as usize) {
+        let context_tuple_registry = get_context_tuple_registry();
+        let mut context = match context_tuple_registry.get_mut(context as usize) {
             Some(context) => context,
             None => bail_invalid_handle!(context),
         };
@@ -270,8 +579,8 @@ pub extern "C" fn gosling_context_stop_endpoint_server(
         ensure_not_null!(context);
         ensure_not_null!(endpoint_private_key);
 
-        let mut context_tuple_registry = get_context_tuple_registry();
-        let context = match context_tuple_registry.get_mut(context as usize) {
+        let context_tuple_registry = get_context_tuple_registry();
+        let mut context = match context_tuple_registry.get_mut(context as usize) {
             Some(context) => context,
             None => bail_invalid_handle!(context),
         };
@@ -283,93 +592,367 @@ pub extern "C" fn gosling_context_stop_endpoint_server(
                 None => bail_invalid_handle!(endpoint_private_key),
             };
 
-        let endpoint_identity = V3OnionServiceId::from_private_key(endpoint_private_key);
+        let endpoint_identity = V3OnionServiceId::from_private_key(&endpoint_private_key);
         Ok(context.0.endpoint_server_stop(endpoint_identity)?)
     });
 }
 
-/// Connect to and begin a handshake to request an endpoint from the given identity server
+/// Register an endpoint server without publishing it. Registered endpoint servers lie dormant,
+/// holding just their keys and no onion service, until activated with
+/// gosling_context_activate_endpoint_server(), so applications with many contacts may register
+/// an endpoint server for each of them and only publish those currently in use
 ///
-/// @param context: the context to request an endpoint server for
-/// @param identity_service_id: the service id of the identity server we want to request an endpoint server
-///  from
-/// @param endpoint_name: the name of the endpoint server to request
-/// @param endpoint_name_length: the number of chars in endpoin_name not including any null-terminator
+/// @param context: the gosling context to register the endpoint server with
+/// @param endpoint_private_key: the ed25519 private key needed to start the endpoint
+///  onion service
+/// @param endpoint_name: the ascii-encoded name of the endpoint server
+/// @param endpoint_name_length: the number of chars in endpoint name not including any null-terminator
+/// @param client_identity: the v3 onion service id of the gosling client associated with this endpoint
+/// @param client_auth_public_key: the x25519 public key used to encrypt the onion service descriptor
 /// @param error: filled on error
 #[no_mangle]
 #[cfg_attr(feature = "impl-lib", rename_impl)]
-pub extern "C" fn gosling_context_begin_identity_handshake(
+pub extern "C" fn gosling_context_register_endpoint_server(
     context: *mut GoslingContext,
-    identity_service_id: *const GoslingV3OnionServiceId,
+    endpoint_private_key: *const GoslingEd25519PrivateKey,
     endpoint_name: *const c_char,
     endpoint_name_length: usize,
+    client_identity: *const GoslingV3OnionServiceId,
+    client_auth_public_key: *const GoslingX25519PublicKey,
     error: *mut *mut GoslingError,
-) -> GoslingHandshakeHandle {
-    translate_failures(
-        !0usize,
-        error,
-        || -> anyhow::Result<GoslingHandshakeHandle> {
-            ensure_not_null!(context);
-            ensure_not_null!(identity_service_id);
-            ensure_not_null!(endpoint_name);
-            ensure_not_equal!(endpoint_name_length, 0);
+) {
+    translate_failures((), error, || -> anyhow::Result<()> {
+        ensure_not_null!(context);
+        ensure_not_null!(endpoint_private_key);
+        ensure_not_null!(endpoint_name);
+        ensure_not_equal!(endpoint_name_length, 0);
+        ensure_not_null!(client_identity);
+        ensure_not_null!(client_auth_public_key);
 
-            let mut context_tuple_registry = get_context_tuple_registry();
-            let context = match context_tuple_registry.get_mut(context as usize) {
-                Some(context) => context,
-                None => bail_invalid_handle!(context),
+        let context_tuple_registry = get_context_tuple_registry();
+        let mut context = match context_tuple_registry.get_mut(context as usize) {
+            Some(context) => context,
+            None => bail_invalid_handle!(context),
+        };
+
+        let endpoint_name =
+            unsafe { std::slice::from_raw_parts(endpoint_name as *const u8, endpoint_name_length) };
+        let endpoint_name = std::str::from_utf8(endpoint_name)?.to_string();
+        if !endpoint_name.is_ascii() {
+            bail!("endpoint_name must be an ascii string");
+        }
+
+        let ed25519_private_key_registry = get_ed25519_private_key_registry();
+        let endpoint_private_key =
+            match ed25519_private_key_registry.get(endpoint_private_key as usize) {
+                Some(ed25519_private_key) => ed25519_private_key,
+                None => bail_invalid_handle!(endpoint_private_key),
             };
 
-            let v3_onion_service_id_registry = get_v3_onion_service_id_registry();
-            let identity_service_id =
-                match v3_onion_service_id_registry.get(identity_service_id as usize) {
-                    Some(v3_onion_service_id) => v3_onion_service_id,
-                    None => bail_invalid_handle!(identity_service_id),
-                };
+        let v3_onion_service_id_registry = get_v3_onion_service_id_registry();
+        let client_identity = match v3_onion_service_id_registry.get(client_identity as usize) {
+            Some(v3_onion_service_id) => v3_onion_service_id,
+            None => bail_invalid_handle!(client_identity),
+        };
 
-            let endpoint_name = unsafe {
-                std::slice::from_raw_parts(endpoint_name as *const u8, endpoint_name_length)
+        let x25519_public_key_registry = get_x25519_public_key_registry();
+        let client_auth_public_key =
+            match x25519_public_key_registry.get(client_auth_public_key as usize) {
+                Some(x25519_public_key) => x25519_public_key,
+                None => bail_invalid_handle!(client_auth_public_key),
             };
-            let endpoint_name = std::str::from_utf8(endpoint_name)?.to_string();
-            if !endpoint_name.is_ascii() {
-                bail!("endpoint_name must be an ascii string")
-            }
 
-            Ok(context
-                .0
-                .identity_client_begin_handshake(identity_service_id.clone(), endpoint_name)?)
-        },
-    )
+        Ok(context
+            .0
+            .endpoint_servers_register(vec![EndpointServerConfig {
+                endpoint_private_key: endpoint_private_key.clone(),
+                endpoint_name,
+                client_identity: client_identity.clone(),
+                client_auth: client_auth_public_key.clone(),
+                priority: 0,
+                active: false,
+            }])?)
+    });
 }
 
-/// Abort an in-progress identity client handshake
+/// Activate a registered endpoint server. Its onion service is published during the next
+/// gosling_context_poll_events() call, in one batch with every other endpoint server activated in
+/// the meantime, and the endpoint_server_published callback is called every time an endpoint server
+/// is activated. Should this exceed the maximum set with
+/// gosling_context_set_max_published_endpoint_servers(), the active endpoint servers with the
+/// lowest priority, and then the least recently active, are deactivated to make room
 ///
-/// @param context: the context associated with the identity client handshake handle
-/// @param handshake_handle: the handle associated with the identity client handshake
+/// @param context: the gosling context associated with the endpoint server
+/// @param endpoint_private_key: the ed25519 private key associated with the endpoint server to
+///  activate
 /// @param error: filled on error
 #[no_mangle]
 #[cfg_attr(feature = "impl-lib", rename_impl)]
-pub extern "C" fn gosling_context_abort_identity_client_handshake(
+pub extern "C" fn gosling_context_activate_endpoint_server(
     context: *mut GoslingContext,
-    handshake_handle: GoslingHandshakeHandle,
+    endpoint_private_key: *const GoslingEd25519PrivateKey,
     error: *mut *mut GoslingError,
 ) {
     translate_failures((), error, || -> anyhow::Result<()> {
         ensure_not_null!(context);
+        ensure_not_null!(endpoint_private_key);
 
-        let mut context_tuple_registry = get_context_tuple_registry();
-        let context = match context_tuple_registry.get_mut(context as usize) {
+        let context_tuple_registry = get_context_tuple_registry();
+        let mut context = match context_tuple_registry.get_mut(context as usize) {
             Some(context) => context,
             None => bail_invalid_handle!(context),
         };
 
-        Ok(context
-            .0
-            .identity_client_abort_handshake(handshake_handle)?)
+        let ed25519_private_key_registry = get_ed25519_private_key_registry();
+        let endpoint_private_key =
+            match ed25519_private_key_registry.get(endpoint_private_key as usize) {
+                Some(ed25519_private_key) => ed25519_private_key,
+                None => bail_invalid_handle!(endpoint_private_key),
+            };
+
+        let endpoint_identity = V3OnionServiceId::from_private_key(&endpoint_private_key);
+        Ok(context.0.endpoint_servers_activate(&[endpoint_identity])?)
+    });
+}
+
+/// Deactivate an endpoint server, leaving it registered but dormant until it is activated again.
+/// Its onion service is torn down during the next gosling_context_poll_events() call, in one batch
+/// with every other endpoint server deactivated in the meantime
+///
+/// @param context: the gosling context associated with the endpoint server
+/// @param endpoint_private_key: the ed25519 private key associated with the endpoint server to
+///  deactivate
+/// @param error: filled on error
+#[no_mangle]
+#[cfg_attr(feature = "impl-lib", rename_impl)]
+pub extern "C" fn gosling_context_deactivate_endpoint_server(
+    context: *mut GoslingContext,
+    endpoint_private_key: *const GoslingEd25519PrivateKey,
+    error: *mut *mut GoslingError,
+) {
+    translate_failures((), error, || -> anyhow::Result<()> {
+        ensure_not_null!(context);
+        ensure_not_null!(endpoint_private_key);
+
+        let context_tuple_registry = get_context_tuple_registry();
+        let mut context = match context_tuple_registry.get_mut(context as usize) {
+            Some(context) => context,
+            None => bail_invalid_handle!(context),
+        };
+
+        let ed25519_private_key_registry = get_ed25519_private_key_registry();
+        let endpoint_private_key =
+            match ed25519_private_key_registry.get(endpoint_private_key as usize) {
+                Some(ed25519_private_key) => ed25519_private_key,
+                None => bail_invalid_handle!(endpoint_private_key),
+            };
+
+        let endpoint_identity = V3OnionServiceId::from_private_key(&endpoint_private_key);
+        Ok(context
+            .0
+            .endpoint_servers_deactivate(&[endpoint_identity])?)
+    });
+}
+
+/// Set the priority of an endpoint server; endpoint servers with a lower priority are deactivated
+/// first to respect the maximum set with gosling_context_set_max_published_endpoint_servers().
+/// Endpoint servers are registered with priority 0
+///
+/// @param context: the gosling context associated with the endpoint server
+/// @param endpoint_private_key: the ed25519 private key associated with the endpoint server
+/// @param priority: the endpoint server's new priority
+/// @param error: filled on error
+#[no_mangle]
+#[cfg_attr(feature = "impl-lib", rename_impl)]
+pub extern "C" fn gosling_context_set_endpoint_server_priority(
+    context: *mut GoslingContext,
+    endpoint_private_key: *const GoslingEd25519PrivateKey,
+    priority: u32,
+    error: *mut *mut GoslingError,
+) {
+    translate_failures((), error, || -> anyhow::Result<()> {
+        ensure_not_null!(context);
+        ensure_not_null!(endpoint_private_key);
+
+        let context_tuple_registry = get_context_tuple_registry();
+        let mut context = match context_tuple_registry.get_mut(context as usize) {
+            Some(context) => context,
+            None => bail_invalid_handle!(context),
+        };
+
+        let ed25519_private_key_registry = get_ed25519_private_key_registry();
+        let endpoint_private_key =
+            match ed25519_private_key_registry.get(endpoint_private_key as usize) {
+                Some(ed25519_private_key) => ed25519_private_key,
+                None => bail_invalid_handle!(endpoint_private_key),
+            };
+
+        let endpoint_identity = V3OnionServiceId::from_private_key(&endpoint_private_key);
+        Ok(context
+            .0
+            .endpoint_server_set_priority(&endpoint_identity, priority)?)
+    });
+}
+
+/// Connect to and begin a handshake to request an endpoint from the given identity server. This function
+/// does not block on connecting to the identity server; connection failures are reported through the
+/// identity_client_handshake_failed callback during a subsequent gosling_context_poll_events() call
+///
+/// @param context: the context to request an endpoint server for
+/// @param identity_service_id: the service id of the identity server we want to request an endpoint server
+///  from
+/// @param endpoint_name: the name of the endpoint server to request
+/// @param endpoint_name_length: the number of chars in endpoin_name not including any null-terminator
+/// @param error: filled on error
+#[no_mangle]
+#[cfg_attr(feature = "impl-lib", rename_impl)]
+pub extern "C" fn gosling_context_begin_identity_handshake(
+    context: *mut GoslingContext,
+    identity_service_id: *const GoslingV3OnionServiceId,
+    endpoint_name: *const c_char,
+    endpoint_name_length: usize,
+    error: *mut *mut GoslingError,
+) -> GoslingHandshakeHandle {
+    translate_failures(
+        !0usize,
+        error,
+        || -> anyhow::Result<GoslingHandshakeHandle> {
+            ensure_not_null!(context);
+            ensure_not_null!(identity_service_id);
+            ensure_not_null!(endpoint_name);
+            ensure_not_equal!(endpoint_name_length, 0);
+
+            let context_tuple_registry = get_context_tuple_registry();
+            let mut context = match context_tuple_registry.get_mut(context as usize) {
+                Some(context) => context,
+                None => bail_invalid_handle!(context),
+            };
+
+            let v3_onion_service_id_registry = get_v3_onion_service_id_registry();
+            let identity_service_id =
+                match v3_onion_service_id_registry.get(identity_service_id as usize) {
+                    Some(v3_onion_service_id) => v3_onion_service_id,
+                    None => bail_invalid_handle!(identity_service_id),
+                };
+
+            let endpoint_name = unsafe {
+                std::slice::from_raw_parts(endpoint_name as *const u8, endpoint_name_length)
+            };
+            let endpoint_name = std::str::from_utf8(endpoint_name)?.to_string();
+            if !endpoint_name.is_ascii() {
+                bail!("endpoint_name must be an ascii string")
+            }
+
+            Ok(context
+                .0
+                .identity_client_begin_handshake(identity_service_id.clone(), endpoint_name)?)
+        },
+    )
+}
+
+/// Abort an in-progress identity client handshake
+///
+/// @param context: the context associated with the identity client handshake handle
+/// @param handshake_handle: the handle associated with the identity client handshake
+/// @param error: filled on error
+#[no_mangle]
+#[cfg_attr(feature = "impl-lib", rename_impl)]
+pub extern "C" fn gosling_context_abort_identity_client_handshake(
+    context: *mut GoslingContext,
+    handshake_handle: GoslingHandshakeHandle,
+    error: *mut *mut GoslingError,
+) {
+    translate_failures((), error, || -> anyhow::Result<()> {
+        ensure_not_null!(context);
+
+        let context_tuple_registry = get_context_tuple_registry();
+        let mut context = match context_tuple_registry.get_mut(context as usize) {
+            Some(context) => context,
+            None => bail_invalid_handle!(context),
+        };
+
+        Ok(context
+            .0
+            .identity_client_abort_handshake(handshake_handle)?)
+    })
+}
+
+/// Prepare the context to quickly begin endpoint handshakes with the given endpoint servers by
+/// registering their client authorization keys in one batch and fetching their onion service
+/// descriptors in the background. A later gosling_context_begin_endpoint_handshake() with one of these
+/// endpoint servers then need not wait for its descriptor to be fetched. Descriptors expire, so this
+/// function may be called again periodically
+///
+/// @param context: the context which will later be opening channels
+/// @param endpoint_service_ids: an array of the endpoint servers to prepare for
+/// @param client_auth_private_keys: an array of the x25519 clienth authorization keys needed to decrypt
+///  each endpoint server's onion service descriptor, in the same order as endpoint_service_ids
+/// @param endpoint_server_count: the number of endpoint servers in both arrays; the arrays may only
+///  be null if this is 0
+/// @param error: filled on error
+#[no_mangle]
+#[cfg_attr(feature = "impl-lib", rename_impl)]
+pub unsafe extern "C" fn gosling_context_prewarm_endpoint_client(
+    context: *mut GoslingContext,
+    endpoint_service_ids: *const *const GoslingV3OnionServiceId,
+    client_auth_private_keys: *const *const GoslingX25519PrivateKey,
+    endpoint_server_count: usize,
+    error: *mut *mut GoslingError,
+) {
+    translate_failures((), error, || -> anyhow::Result<()> {
+        ensure_not_null!(context);
+        if endpoint_server_count > 0 {
+            ensure_not_null!(endpoint_service_ids);
+            ensure_not_null!(client_auth_private_keys);
+        }
+
+        let context_tuple_registry = get_context_tuple_registry();
+        let mut context = match context_tuple_registry.get_mut(context as usize) {
+            Some(context) => context,
+            None => bail_invalid_handle!(context),
+        };
+
+        let (endpoint_service_ids, client_auth_private_keys) = if endpoint_server_count > 0 {
+            (
+                std::slice::from_raw_parts(endpoint_service_ids, endpoint_server_count),
+                std::slice::from_raw_parts(client_auth_private_keys, endpoint_server_count),
+            )
+        } else {
+            (Default::default(), Default::default())
+        };
+
+        let v3_onion_service_id_registry = get_v3_onion_service_id_registry();
+        let x25519_private_key_registry = get_x25519_private_key_registry();
+        let mut endpoint_servers: Vec<(V3OnionServiceId, X25519PrivateKey)> =
+            Vec::with_capacity(endpoint_server_count);
+        for (endpoint_service_id, client_auth_private_key) in endpoint_service_ids
+            .iter()
+            .copied()
+            .zip(client_auth_private_keys.iter().copied())
+        {
+            ensure_not_null!(endpoint_service_id);
+            ensure_not_null!(client_auth_private_key);
+
+            let endpoint_service_id =
+                match v3_onion_service_id_registry.get(endpoint_service_id as usize) {
+                    Some(v3_onion_service_id) => v3_onion_service_id,
+                    None => bail_invalid_handle!(endpoint_service_id),
+                };
+            let client_auth_private_key =
+                match x25519_private_key_registry.get(client_auth_private_key as usize) {
+                    Some(x25519_private_key) => x25519_private_key,
+                    None => bail_invalid_handle!(client_auth_private_key),
+                };
+            endpoint_servers.push((endpoint_service_id.clone(), client_auth_private_key.clone()));
+        }
+
+        Ok(context.0.endpoint_client_prewarm(&endpoint_servers)?)
     })
 }
 
-/// Connect to and begin a handshake to request a channel from the given endpoint server
+/// Connect to and begin a handshake to request a channel from the given endpoint server. This function
+/// does not block on connecting to the endpoint server; connection failures are reported through the
+/// endpoint_client_handshake_failed callback during a subsequent gosling_context_poll_events() call
 ///
 /// @param context: the context which will be opening the channel
 /// @param endpoint_service_id: the endpoint server to open a channel to
@@ -398,8 +981,8 @@ pub extern "C" fn gosling_context_begin_endpoint_handshake(
             ensure_not_null!(channel_name);
             ensure_not_equal!(channel_name_length, 0);
 
-            let mut context_tuple_registry = get_context_tuple_registry();
-            let context = match context_tuple_registry.get_mut(context as usize) {
+            let context_tuple_registry = get_context_tuple_registry();
+            let mut context = match context_tuple_registry.get_mut(context as usize) {
                 Some(context) => context,
                 None => bail_invalid_handle!(context),
             };
@@ -450,8 +1033,8 @@ pub extern "C" fn gosling_context_abort_endpoint_client_handshake(
     translate_failures((), error, || -> anyhow::Result<()> {
         ensure_not_null!(context);
 
-        let mut context_tuple_registry = get_context_tuple_registry();
-        let context = match context_tuple_registry.get_mut(context as usize) {
+        let context_tuple_registry = get_context_tuple_registry();
+        let mut context = match context_tuple_registry.get_mut(context as usize) {
             Some(context) => context,
             None => bail_invalid_handle!(context),
         };
@@ -462,10 +1045,60 @@ pub extern "C" fn gosling_context_abort_endpoint_client_handshake(
     })
 }
 
+// Build a BSON document with one of the single-pass challenge callbacks. The callback
+// writes into the caller-owned buffer and returns the size it requires; only if the
+// document did not fit is the buffer grown and the callback invoked a second time. The
+// document is parsed directly out of the buffer, which is reused across events.
+fn build_bson_document<F>(
+    buffer: &mut Vec<u8>,
+    callback_name: &str,
+    mut build: F,
+) -> anyhow::Result<bson::document::Document>
+where
+    F: FnMut(*mut u8, usize) -> usize,
+{
+    if buffer.len() < CHALLENGE_BUFFER_INITIAL_SIZE {
+        buffer.resize(CHALLENGE_BUFFER_INITIAL_SIZE, 0u8);
+    }
+
+    let mut document_size = build(buffer.as_mut_ptr(), buffer.len());
+    if document_size > buffer.len() {
+        buffer.resize(document_size, 0u8);
+        document_size = build(buffer.as_mut_ptr(), buffer.len());
+        if document_size > buffer.len() {
+            bail!(
+                "{} requested {} bytes after being provided a buffer of {} bytes",
+                callback_name,
+                document_size,
+                buffer.len()
+            );
+        }
+    }
+
+    if document_size < SMALLEST_BSON_DOC_SIZE {
+        bail!(
+            "{} returned an impossibly small size '{}', smallest possible is {}",
+            callback_name,
+            document_size,
+            SMALLEST_BSON_DOC_SIZE
+        );
+    }
+
+    // convert bson blob to bson object
+    match bson::document::Document::from_reader(&buffer[..document_size]) {
+        Ok(document) => Ok(document),
+        Err(_) => bail!(
+            "failed to parse binary provided by {} as BSON document",
+            callback_name
+        ),
+    }
+}
+
 fn handle_context_event(
     event: ContextEvent,
     context: *mut GoslingContext,
     callbacks: &EventCallbacks,
+    challenge_buffer: &mut Vec<u8>,
 ) -> anyhow::Result<()> {
     match event {
         //
@@ -513,7 +1146,27 @@ fn handle_context_event(
             endpoint_challenge,
         } => {
             // construct challenge response
-            let challenge_response = if let (
+            let challenge_response = if let Some(challenge_response_callback) =
+                callbacks.identity_client_challenge_response_callback
+            {
+                let mut endpoint_challenge_buffer: Vec<u8> = Default::default();
+                endpoint_challenge.to_writer(&mut endpoint_challenge_buffer).expect("endpoint_challenge should be a valid bson::document::Document and therefore serializable to Vec<u8>");
+
+                build_bson_document(
+                    challenge_buffer,
+                    "identity_client_challenge_response_callback",
+                    |out_challenge_response_buffer, out_challenge_response_buffer_size| {
+                        challenge_response_callback(
+                            context,
+                            handle,
+                            endpoint_challenge_buffer.as_ptr(),
+                            endpoint_challenge_buffer.len(),
+                            out_challenge_response_buffer,
+                            out_challenge_response_buffer_size,
+                        )
+                    },
+                )?
+            } else if let (
                 Some(challenge_response_size_callback),
                 Some(build_challenge_response_callback),
             ) = (
@@ -553,11 +1206,11 @@ fn handle_context_event(
                     Err(_) => bail!("failed to parse binary provided by identity_client_build_challenge_response_callback as BSON document")
                 }
             } else {
-                bail!("missing required identity_client_challenge_response_size() and identity_client_build_challenge_response() callbacks");
+                bail!("missing required identity_client_challenge_response() callback or identity_client_challenge_response_size() and identity_client_build_challenge_response() callbacks");
             };
 
             match get_context_tuple_registry().get_mut(context as usize) {
-                Some(context) => context
+                Some(mut context) => context
                     .0
                     .identity_client_handle_challenge_received(handle, challenge_response)?,
                 None => bail_invalid_handle!(context),
@@ -572,7 +1225,7 @@ fn handle_context_event(
         } => {
             if let Some(callback) = callbacks.identity_client_handshake_completed_callback {
                 let (identity_service_id, endpoint_service_id) = {
-                    let mut v3_onion_service_id_registry = get_v3_onion_service_id_registry();
+                    let v3_onion_service_id_registry = get_v3_onion_service_id_registry();
                     let identity_service_id =
                         v3_onion_service_id_registry.insert(identity_service_id);
                     let endpoint_service_id =
@@ -598,7 +1251,7 @@ fn handle_context_event(
 
                 // cleanup
                 {
-                    let mut v3_onion_service_id_registry = get_v3_onion_service_id_registry();
+                    let v3_onion_service_id_registry = get_v3_onion_service_id_registry();
                     v3_onion_service_id_registry.remove(identity_service_id);
                     v3_onion_service_id_registry.remove(endpoint_service_id);
                 }
@@ -631,6 +1284,7 @@ fn handle_context_event(
             handle,
             client_service_id,
             requested_endpoint,
+            early_rejection,
         } => {
             let client_allowed = match callbacks.identity_server_client_allowed_callback {
                 Some(callback) => {
@@ -659,10 +1313,25 @@ fn handle_context_event(
                 }
                 None => bail!("missing required identity_server_endpoint_supported() callback"),
             };
-            let endpoint_challenge = if let (
-                Some(challenge_size_callback),
-                Some(build_challenge_callback),
-            ) = (
+
+            // handshakes rejected early never send their challenge, so don't build one
+            let rejected_early = early_rejection && !(client_allowed && endpoint_supported);
+            let endpoint_challenge = if rejected_early {
+                bson::document::Document::new()
+            } else if let Some(challenge_callback) = callbacks.identity_server_challenge_callback {
+                build_bson_document(
+                    challenge_buffer,
+                    "identity_server_challenge_callback",
+                    |out_challenge_buffer, out_challenge_buffer_size| {
+                        challenge_callback(
+                            context,
+                            handle,
+                            out_challenge_buffer,
+                            out_challenge_buffer_size,
+                        )
+                    },
+                )?
+            } else if let (Some(challenge_size_callback), Some(build_challenge_callback)) = (
                 callbacks.identity_server_challenge_size_callback,
                 callbacks.identity_server_build_challenge_callback,
             ) {
@@ -688,11 +1357,11 @@ fn handle_context_event(
                     Err(_) => bail!("failed to parse binary provided by identity_server_build_challenge_callback as BSON document")
                 }
             } else {
-                bail!("missing required identity_server_challenge_size() and identity_server_build_challenge() callbacks");
+                bail!("missing required identity_server_challenge() callback or identity_server_challenge_size() and identity_server_build_challenge() callbacks");
             };
 
             match get_context_tuple_registry().get_mut(context as usize) {
-                Some(context) => context.0.identity_server_handle_endpoint_request_received(
+                Some(mut context) => context.0.identity_server_handle_endpoint_request_received(
                     handle,
                     client_allowed,
                     endpoint_supported,
@@ -727,7 +1396,7 @@ fn handle_context_event(
             };
 
             match get_context_tuple_registry().get_mut(context as usize) {
-                Some(context) => context
+                Some(mut context) => context
                     .0
                     .identity_server_handle_challenge_response_received(
                         handle,
@@ -745,7 +1414,7 @@ fn handle_context_event(
         } => {
             if let Some(callback) = callbacks.identity_server_handshake_completed_callback {
                 let endpoint_private_key = {
-                    let mut ed25519_private_key_registry = get_ed25519_private_key_registry();
+                    let ed25519_private_key_registry = get_ed25519_private_key_registry();
                     ed25519_private_key_registry.insert(endpoint_private_key)
                 };
 
@@ -753,12 +1422,12 @@ fn handle_context_event(
                     .expect("endpoint_name should be a valid ASCII string and not have an intermediate null byte");
 
                 let client_service_id = {
-                    let mut v3_onion_service_id_registry = get_v3_onion_service_id_registry();
+                    let v3_onion_service_id_registry = get_v3_onion_service_id_registry();
                     v3_onion_service_id_registry.insert(client_service_id)
                 };
 
                 let client_auth_public_key = {
-                    let mut x25519_public_key_registry = get_x25519_public_key_registry();
+                    let x25519_public_key_registry = get_x25519_public_key_registry();
                     x25519_public_key_registry.insert(client_auth_public_key)
                 };
 
@@ -818,7 +1487,7 @@ fn handle_context_event(
         } => {
             if let Some(callback) = callbacks.endpoint_client_handshake_completed_callback {
                 let endpoint_service_id = {
-                    let mut v3_onion_service_id_registry = get_v3_onion_service_id_registry();
+                    let v3_onion_service_id_registry = get_v3_onion_service_id_registry();
                     v3_onion_service_id_registry.insert(endpoint_service_id)
                 };
                 let channel_name0 = CString::new(channel_name.as_str())
@@ -860,7 +1529,7 @@ fn handle_context_event(
         } => {
             if let Some(callback) = callbacks.endpoint_server_published_callback {
                 let endpoint_service_id = {
-                    let mut v3_onion_service_id_registry = get_v3_onion_service_id_registry();
+                    let v3_onion_service_id_registry = get_v3_onion_service_id_registry();
                     v3_onion_service_id_registry.insert(endpoint_service_id)
                 };
                 let endpoint_name0 = CString::new(endpoint_name.as_str())
@@ -891,7 +1560,7 @@ fn handle_context_event(
             {
                 Some(callback) => {
                     let client_service_id = {
-                        let mut v3_onion_service_id_registry = get_v3_onion_service_id_registry();
+                        let v3_onion_service_id_registry = get_v3_onion_service_id_registry();
                         v3_onion_service_id_registry.insert(client_service_id)
                     };
                     let requested_channel0 = CString::new(requested_channel.as_str()).expect("requested_channel should be a valid ASCII string and not have an intermediate null byte",
@@ -912,7 +1581,7 @@ fn handle_context_event(
             };
 
             match get_context_tuple_registry().get_mut(context as usize) {
-                Some(context) => context
+                Some(mut context) => context
                     .0
                     .endpoint_server_handle_channel_request_received(handle, channel_supported)?,
                 None => return Err(anyhow!("context is invalid")),
@@ -927,7 +1596,7 @@ fn handle_context_event(
         } => {
             if let Some(callback) = callbacks.endpoint_server_handshake_completed_callback {
                 let (endpoint_service_id, client_service_id) = {
-                    let mut v3_onion_service_id_registry = get_v3_onion_service_id_registry();
+                    let v3_onion_service_id_registry = get_v3_onion_service_id_registry();
                     let endpoint_service_id =
                         v3_onion_service_id_registry.insert(endpoint_service_id);
                     let client_service_id = v3_onion_service_id_registry.insert(client_service_id);
@@ -954,7 +1623,7 @@ fn handle_context_event(
 
                 // cleanup
                 {
-                    let mut v3_onion_service_id_registry = get_v3_onion_service_id_registry();
+                    let v3_onion_service_id_registry = get_v3_onion_service_id_registry();
                     v3_onion_service_id_registry.remove(endpoint_service_id);
                     v3_onion_service_id_registry.remove(client_service_id);
                 }
@@ -989,6 +1658,105 @@ fn handle_context_event(
     Ok(())
 }
 
+/// Block the calling thread until the gosling context has work for gosling_context_poll_events():
+/// a listener or in-progress handshake socket is ready, the tor provider signals new events, a
+/// previous poll left work unfinished, or the timeout elapses. Idle applications should call this
+/// between calls to gosling_context_poll_events() rather than spinning or sleeping. Other threads
+/// may continue to use the gosling library while this function blocks.
+///
+/// @param context: the context object to wait on
+/// @param timeout_milliseconds: the maximum number of milliseconds to wait; the wait may end
+///  early, e.g. to time out quiet handshakes
+/// @param error: filled on error
+#[no_mangle]
+#[cfg_attr(feature = "impl-lib", rename_impl)]
+pub extern "C" fn gosling_context_wait_events(
+    context: *mut GoslingContext,
+    timeout_milliseconds: u32,
+    error: *mut *mut GoslingError,
+) {
+    translate_failures((), error, || -> anyhow::Result<()> {
+        ensure_not_null!(context);
+
+        // we must not hold the context's registry shard locked while blocking
+        // or every other context in that shard would block with us
+        let waiter = {
+            let context_tuple_registry = get_context_tuple_registry();
+            let context = match context_tuple_registry.get(context as usize) {
+                Some(context) => context,
+                None => bail_invalid_handle!(context),
+            };
+            // events left over from a failed callback are already waiting
+            if context.2.is_some() {
+                return Ok(());
+            }
+            context
+                .0
+                .event_waiter(Some(Duration::from_millis(timeout_milliseconds.into())))?
+        };
+        Ok(waiter.wait()?)
+    });
+}
+
+/// Prepare the gosling context to be waited on by an external event loop (e.g. Python's asyncio or
+/// libuv) instead of with gosling_context_wait_events(). Returns a file descriptor which becomes
+/// readable when the context has work for gosling_context_poll_events(), along with the longest
+/// the caller may wait on it before polling the context's events regardless.
+///
+/// The descriptor only watches the sockets the context had when this function was called, so this
+/// function must be called again before each wait. Once the descriptor is readable or the timeout
+/// elapses, call gosling_context_wait_events() with a timeout of 0 to reset the descriptor and then
+/// poll the context's events. The descriptor is owned by the context and must not be closed, read or
+/// written by the caller.
+///
+/// @param context: the context object to wait on
+/// @param out_timeout_milliseconds: returned maximum number of milliseconds to wait, UINT32_MAX to
+///  wait indefinitely
+/// @param error: filled on error
+/// @return a file descriptor to wait on until it is readable, or -1 if the context already has
+///  work and should be polled without waiting
+#[no_mangle]
+#[cfg_attr(feature = "impl-lib", rename_impl)]
+#[cfg(any(target_os = "linux", target_os = "macos"))]
+pub extern "C" fn gosling_context_get_event_fd(
+    context: *mut GoslingContext,
+    out_timeout_milliseconds: *mut u32,
+    error: *mut *mut GoslingError,
+) -> RawFd {
+    translate_failures(-1, error, || -> anyhow::Result<RawFd> {
+        ensure_not_null!(context);
+        ensure_not_null!(out_timeout_milliseconds);
+
+        let context_tuple_registry = get_context_tuple_registry();
+        let context = match context_tuple_registry.get(context as usize) {
+            Some(context) => context,
+            None => bail_invalid_handle!(context),
+        };
+
+        // events left over from a failed callback are already waiting
+        let waiter = if context.2.is_some() {
+            None
+        } else {
+            Some(context.0.event_waiter(None)?)
+        };
+
+        let (fd, timeout) = match &waiter {
+            Some(waiter) => match waiter.as_raw_fd() {
+                Some(fd) => (fd, waiter.timeout()),
+                None => (-1, Some(Duration::ZERO)),
+            },
+            None => (-1, Some(Duration::ZERO)),
+        };
+        let timeout = match timeout {
+            Some(timeout) => u32::try_from(timeout.as_millis()).unwrap_or(u32::MAX),
+            None => u32::MAX,
+        };
+        unsafe { *out_timeout_milliseconds = timeout };
+
+        Ok(fd)
+    })
+}
+
 /// Update the internal gosling context state and process event callbacks
 ///
 /// @param context: the context object we are updating
@@ -1002,11 +1770,11 @@ pub extern "C" fn gosling_context_poll_events(
     translate_failures((), error, || -> anyhow::Result<()> {
         // we need to scope the context registry explicitly here
         // in case our callbacks want to call any gosling functions
-        // to avoid deadlock (since a mutex is held while the context_tuple_registry
-        // is accesible)
+        // to avoid deadlock (since the context's registry shard is locked
+        // while the context is accesible)
         let (mut context_events, callbacks) =
             match get_context_tuple_registry().get_mut(context as usize) {
-                Some(context) => {
+                Some(mut context) => {
                     // get our new events
                     let mut new_events = context.0.update()?;
                     // get a copy of our callbacks
@@ -1029,14 +1797,18 @@ pub extern "C" fn gosling_context_poll_events(
                 None => bail_invalid_handle!(context),
             };
 
-        // consume the events and trigger any callbacks
+        // consume the events and trigger any callbacks; challenge documents are
+        // built into one buffer shared by every event in this poll
+        let mut challenge_buffer: Vec<u8> = Default::default();
         while let Some(event) = context_events.pop_front() {
-            let result = handle_context_event(event, context, &callbacks);
+            let result = handle_context_event(event, context, &callbacks, &mut challenge_buffer);
             if result.is_err() {
                 // if we have remaining events to consume, save them off on
                 // the context
                 if !context_events.is_empty() {
-                    if let Some(context) = get_context_tuple_registry().get_mut(context as usize) {
+                    if let Some(mut context) =
+                        get_context_tuple_registry().get_mut(context as usize)
+                    {
                         context.2 = Some(context_events);
                     }
                 }
@@ -1047,3 +1819,1058 @@ pub extern "C" fn gosling_context_poll_events(
         Ok(())
     });
 }
+
+//
+// Batched Events
+//
+
+/// A gosling_event of this type is a tor_bootstrap_status_received event
+pub const GOSLING_EVENT_TYPE_TOR_BOOTSTRAP_STATUS_RECEIVED: u32 = 0;
+/// A gosling_event of this type is a tor_bootstrap_completed event
+pub const GOSLING_EVENT_TYPE_TOR_BOOTSTRAP_COMPLETED: u32 = 1;
+/// A gosling_event of this type is a tor_log_received event
+pub const GOSLING_EVENT_TYPE_TOR_LOG_RECEIVED: u32 = 2;
+/// A gosling_event of this type is an identity_client_challenge_received event
+pub const GOSLING_EVENT_TYPE_IDENTITY_CLIENT_CHALLENGE_RECEIVED: u32 = 3;
+/// A gosling_event of this type is an identity_client_handshake_completed event
+pub const GOSLING_EVENT_TYPE_IDENTITY_CLIENT_HANDSHAKE_COMPLETED: u32 = 4;
+/// A gosling_event of this type is an identity_client_handshake_failed event
+pub const GOSLING_EVENT_TYPE_IDENTITY_CLIENT_HANDSHAKE_FAILED: u32 = 5;
+/// A gosling_event of this type is an identity_server_published event
+pub const GOSLING_EVENT_TYPE_IDENTITY_SERVER_PUBLISHED: u32 = 6;
+/// A gosling_event of this type is an identity_server_handshake_started event
+pub const GOSLING_EVENT_TYPE_IDENTITY_SERVER_HANDSHAKE_STARTED: u32 = 7;
+/// A gosling_event of this type is an identity_server_endpoint_request_received event
+pub const GOSLING_EVENT_TYPE_IDENTITY_SERVER_ENDPOINT_REQUEST_RECEIVED: u32 = 8;
+/// A gosling_event of this type is an identity_server_challenge_response_received event
+pub const GOSLING_EVENT_TYPE_IDENTITY_SERVER_CHALLENGE_RESPONSE_RECEIVED: u32 = 9;
+/// A gosling_event of this type is an identity_server_handshake_completed event
+pub const GOSLING_EVENT_TYPE_IDENTITY_SERVER_HANDSHAKE_COMPLETED: u32 = 10;
+/// A gosling_event of this type is an identity_server_handshake_rejected event
+pub const GOSLING_EVENT_TYPE_IDENTITY_SERVER_HANDSHAKE_REJECTED: u32 = 11;
+/// A gosling_event of this type is an identity_server_handshake_failed event
+pub const GOSLING_EVENT_TYPE_IDENTITY_SERVER_HANDSHAKE_FAILED: u32 = 12;
+/// A gosling_event of this type is an endpoint_client_handshake_completed event
+pub const GOSLING_EVENT_TYPE_ENDPOINT_CLIENT_HANDSHAKE_COMPLETED: u32 = 13;
+/// A gosling_event of this type is an endpoint_client_handshake_failed event
+pub const GOSLING_EVENT_TYPE_ENDPOINT_CLIENT_HANDSHAKE_FAILED: u32 = 14;
+/// A gosling_event of this type is an endpoint_server_published event
+pub const GOSLING_EVENT_TYPE_ENDPOINT_SERVER_PUBLISHED: u32 = 15;
+/// A gosling_event of this type is an endpoint_server_handshake_started event
+pub const GOSLING_EVENT_TYPE_ENDPOINT_SERVER_HANDSHAKE_STARTED: u32 = 16;
+/// A gosling_event of this type is an endpoint_server_channel_request_received event
+pub const GOSLING_EVENT_TYPE_ENDPOINT_SERVER_CHANNEL_REQUEST_RECEIVED: u32 = 17;
+/// A gosling_event of this type is an endpoint_server_handshake_completed event
+pub const GOSLING_EVENT_TYPE_ENDPOINT_SERVER_HANDSHAKE_COMPLETED: u32 = 18;
+/// A gosling_event of this type is an endpoint_server_handshake_rejected event
+pub const GOSLING_EVENT_TYPE_ENDPOINT_SERVER_HANDSHAKE_REJECTED: u32 = 19;
+/// A gosling_event of this type is an endpoint_server_handshake_failed event
+pub const GOSLING_EVENT_TYPE_ENDPOINT_SERVER_HANDSHAKE_FAILED: u32 = 20;
+
+// The following types are the C representation of batched events returned by
+// gosling_context_poll_events_batch(); they are declared by hand in the
+// cgosling.h template so any change here must be mirrored there
+
+/// cbindgen:ignore
+#[repr(C)]
+#[derive(Clone, Copy)]
+pub struct GoslingTorBootstrapStatusReceivedEvent {
+    pub progress: u32,
+    pub tag: *const c_char,
+    pub tag_length: usize,
+    pub summary: *const c_char,
+    pub summary_length: usize,
+}
+
+/// cbindgen:ignore
+#[repr(C)]
+#[derive(Clone, Copy)]
+pub struct GoslingTorLogReceivedEvent {
+    pub line: *const c_char,
+    pub line_length: usize,
+}
+
+/// cbindgen:ignore
+#[repr(C)]
+#[derive(Clone, Copy)]
+pub struct GoslingIdentityClientChallengeReceivedEvent {
+    pub endpoint_challenge: *const u8,
+    pub endpoint_challenge_size: usize,
+}
+
+/// cbindgen:ignore
+#[repr(C)]
+#[derive(Clone, Copy)]
+pub struct GoslingIdentityClientHandshakeCompletedEvent {
+    pub identity_service_id: *const GoslingV3OnionServiceId,
+    pub endpoint_service_id: *const GoslingV3OnionServiceId,
+    pub endpoint_name: *const c_char,
+    pub endpoint_name_length: usize,
+    pub client_auth_private_key: *const GoslingX25519PrivateKey,
+}
+
+/// cbindgen:ignore
+#[repr(C)]
+#[derive(Clone, Copy)]
+pub struct GoslingIdentityServerEndpointRequestReceivedEvent {
+    pub client_service_id: *const GoslingV3OnionServiceId,
+    pub requested_endpoint: *const c_char,
+    pub requested_endpoint_length: usize,
+}
+
+/// cbindgen:ignore
+#[repr(C)]
+#[derive(Clone, Copy)]
+pub struct GoslingIdentityServerChallengeResponseReceivedEvent {
+    pub challenge_response: *const u8,
+    pub challenge_response_size: usize,
+}
+
+/// cbindgen:ignore
+#[repr(C)]
+#[derive(Clone, Copy)]
+pub struct GoslingIdentityServerHandshakeCompletedEvent {
+    pub endpoint_private_key: *const GoslingEd25519PrivateKey,
+    pub endpoint_name: *const c_char,
+    pub endpoint_name_length: usize,
+    pub client_service_id: *const GoslingV3OnionServiceId,
+    pub client_auth_public_key: *const GoslingX25519PublicKey,
+}
+
+/// cbindgen:ignore
+#[repr(C)]
+#[derive(Clone, Copy)]
+pub struct GoslingIdentityServerHandshakeRejectedEvent {
+    pub client_allowed: bool,
+    pub client_requested_endpoint_valid: bool,
+    pub client_proof_signature_valid: bool,
+    pub client_auth_signature_valid: bool,
+    pub challenge_response_valid: bool,
+}
+
+/// cbindgen:ignore
+#[repr(C)]
+#[derive(Clone, Copy)]
+pub struct GoslingEndpointClientHandshakeCompletedEvent {
+    pub endpoint_service_id: *const GoslingV3OnionServiceId,
+    pub channel_name: *const c_char,
+    pub channel_name_length: usize,
+    pub stream: GoslingTcpSocket,
+}
+
+/// cbindgen:ignore
+#[repr(C)]
+#[derive(Clone, Copy)]
+pub struct GoslingEndpointServerPublishedEvent {
+    pub endpoint_service_id: *const GoslingV3OnionServiceId,
+    pub endpoint_name: *const c_char,
+    pub endpoint_name_length: usize,
+}
+
+/// cbindgen:ignore
+#[repr(C)]
+#[derive(Clone, Copy)]
+pub struct GoslingEndpointServerChannelRequestReceivedEvent {
+    pub client_service_id: *const GoslingV3OnionServiceId,
+    pub requested_channel: *const c_char,
+    pub requested_channel_length: usize,
+}
+
+/// cbindgen:ignore
+#[repr(C)]
+#[derive(Clone, Copy)]
+pub struct GoslingEndpointServerHandshakeCompletedEvent {
+    pub endpoint_service_id: *const GoslingV3OnionServiceId,
+    pub client_service_id: *const GoslingV3OnionServiceId,
+    pub channel_name: *const c_char,
+    pub channel_name_length: usize,
+    pub stream: GoslingTcpSocket,
+}
+
+/// cbindgen:ignore
+#[repr(C)]
+#[derive(Clone, Copy)]
+pub struct GoslingEndpointServerHandshakeRejectedEvent {
+    pub client_allowed: bool,
+    pub client_requested_channel_valid: bool,
+    pub client_proof_signature_valid: bool,
+}
+
+/// cbindgen:ignore
+#[repr(C)]
+#[derive(Clone, Copy)]
+pub struct GoslingHandshakeFailedEvent {
+    pub reason: *const GoslingError,
+}
+
+/// cbindgen:ignore
+#[repr(C)]
+#[derive(Clone, Copy)]
+pub union GoslingEventData {
+    pub empty: (),
+    pub tor_bootstrap_status_received: GoslingTorBootstrapStatusReceivedEvent,
+    pub tor_log_received: GoslingTorLogReceivedEvent,
+    pub identity_client_challenge_received: GoslingIdentityClientChallengeReceivedEvent,
+    pub identity_client_handshake_completed: GoslingIdentityClientHandshakeCompletedEvent,
+    pub identity_server_endpoint_request_received:
+        GoslingIdentityServerEndpointRequestReceivedEvent,
+    pub identity_server_challenge_response_received:
+        GoslingIdentityServerChallengeResponseReceivedEvent,
+    pub identity_server_handshake_completed: GoslingIdentityServerHandshakeCompletedEvent,
+    pub identity_server_handshake_rejected: GoslingIdentityServerHandshakeRejectedEvent,
+    pub endpoint_client_handshake_completed: GoslingEndpointClientHandshakeCompletedEvent,
+    pub endpoint_server_published: GoslingEndpointServerPublishedEvent,
+    pub endpoint_server_channel_request_received: GoslingEndpointServerChannelRequestReceivedEvent,
+    pub endpoint_server_handshake_completed: GoslingEndpointServerHandshakeCompletedEvent,
+    pub endpoint_server_handshake_rejected: GoslingEndpointServerHandshakeRejectedEvent,
+    pub handshake_failed: GoslingHandshakeFailedEvent,
+}
+
+/// cbindgen:ignore
+#[repr(C)]
+#[derive(Clone, Copy)]
+pub struct GoslingEvent {
+    pub event_type: u32,
+    pub handle: GoslingHandshakeHandle,
+    pub data: GoslingEventData,
+}
+
+// Owns the strings, buffers and gosling objects referenced by the events most
+// recently returned from gosling_context_poll_events_batch(); everything is
+// released on the context's next batched poll (or when the context is freed)
+#[derive(Default)]
+pub(crate) struct EventArena {
+    strings: Vec<CString>,
+    buffers: Vec<Vec<u8>>,
+    errors: Vec<usize>,
+    ed25519_private_keys: Vec<usize>,
+    x25519_private_keys: Vec<usize>,
+    x25519_public_keys: Vec<usize>,
+    v3_onion_service_ids: Vec<usize>,
+}
+
+impl EventArena {
+    fn string(&mut self, string: String) -> (*const c_char, usize) {
+        let length = string.len();
+        let string0 =
+            CString::new(string).expect("event strings should not have an intermediate null byte");
+        // the CString's heap allocation does not move when the CString does
+        let ptr = string0.as_ptr();
+        self.strings.push(string0);
+        (ptr, length)
+    }
+
+    fn bson(&mut self, document: bson::document::Document) -> (*const u8, usize) {
+        let mut buffer: Vec<u8> = Default::default();
+        document.to_writer(&mut buffer).expect("document should be a valid bson::document::Document and therefore serializable to Vec<u8>");
+        let (ptr, size) = (buffer.as_ptr(), buffer.len());
+        self.buffers.push(buffer);
+        (ptr, size)
+    }
+
+    fn error(&mut self, reason: gosling::context::Error) -> *const GoslingError {
+        let key = get_error_registry().insert(Error::new(format!("{:?}", reason).as_str()));
+        self.errors.push(key);
+        key as *const GoslingError
+    }
+
+    fn ed25519_private_key(
+        &mut self,
+        private_key: Ed25519PrivateKey,
+    ) -> *const GoslingEd25519PrivateKey {
+        let key = get_ed25519_private_key_registry().insert(private_key);
+        self.ed25519_private_keys.push(key);
+        key as *const GoslingEd25519PrivateKey
+    }
+
+    fn x25519_private_key(
+        &mut self,
+        private_key: X25519PrivateKey,
+    ) -> *const GoslingX25519PrivateKey {
+        let key = get_x25519_private_key_registry().insert(private_key);
+        self.x25519_private_keys.push(key);
+        key as *const GoslingX25519PrivateKey
+    }
+
+    fn x25519_public_key(&mut self, public_key: X25519PublicKey) -> *const GoslingX25519PublicKey {
+        let key = get_x25519_public_key_registry().insert(public_key);
+        self.x25519_public_keys.push(key);
+        key as *const GoslingX25519PublicKey
+    }
+
+    fn v3_onion_service_id(
+        &mut self,
+        service_id: V3OnionServiceId,
+    ) -> *const GoslingV3OnionServiceId {
+        let key = get_v3_onion_service_id_registry().insert(service_id);
+        self.v3_onion_service_ids.push(key);
+        key as *const GoslingV3OnionServiceId
+    }
+
+    fn clear(&mut self) {
+        self.strings.clear();
+        self.buffers.clear();
+        for key in self.errors.drain(..) {
+            get_error_registry().remove(key);
+        }
+        for key in self.ed25519_private_keys.drain(..) {
+            get_ed25519_private_key_registry().remove(key);
+        }
+        for key in self.x25519_private_keys.drain(..) {
+            get_x25519_private_key_registry().remove(key);
+        }
+        for key in self.x25519_public_keys.drain(..) {
+            get_x25519_public_key_registry().remove(key);
+        }
+        for key in self.v3_onion_service_ids.drain(..) {
+            get_v3_onion_service_id_registry().remove(key);
+        }
+    }
+}
+
+impl Drop for EventArena {
+    fn drop(&mut self) {
+        self.clear();
+    }
+}
+
+// convert a ContextEvent to its C representation, moving anything it refers
+// to into arena
+fn context_event_to_gosling_event(event: ContextEvent, arena: &mut EventArena) -> GoslingEvent {
+    const NO_HANDLE: GoslingHandshakeHandle = !0usize;
+
+    let (event_type, handle, data) = match event {
+        //
+        // Tor Events
+        //
+        ContextEvent::TorBootstrapStatusReceived {
+            progress,
+            tag,
+            summary,
+        } => {
+            let (tag, tag_length) = arena.string(tag);
+            let (summary, summary_length) = arena.string(summary);
+            (
+                GOSLING_EVENT_TYPE_TOR_BOOTSTRAP_STATUS_RECEIVED,
+                NO_HANDLE,
+                GoslingEventData {
+                    tor_bootstrap_status_received: GoslingTorBootstrapStatusReceivedEvent {
+                        progress,
+                        tag,
+                        tag_length,
+                        summary,
+                        summary_length,
+                    },
+                },
+            )
+        }
+        ContextEvent::TorBootstrapCompleted => (
+            GOSLING_EVENT_TYPE_TOR_BOOTSTRAP_COMPLETED,
+            NO_HANDLE,
+            GoslingEventData { empty: () },
+        ),
+        ContextEvent::TorLogReceived { line } => {
+            let (line, line_length) = arena.string(line);
+            (
+                GOSLING_EVENT_TYPE_TOR_LOG_RECEIVED,
+                NO_HANDLE,
+                GoslingEventData {
+                    tor_log_received: GoslingTorLogReceivedEvent { line, line_length },
+                },
+            )
+        }
+        //
+        // Identity Client Events
+        //
+        ContextEvent::IdentityClientChallengeReceived {
+            handle,
+            endpoint_challenge,
+        } => {
+            let (endpoint_challenge, endpoint_challenge_size) = arena.bson(endpoint_challenge);
+            (
+                GOSLING_EVENT_TYPE_IDENTITY_CLIENT_CHALLENGE_RECEIVED,
+                handle,
+                GoslingEventData {
+                    identity_client_challenge_received:
+                        GoslingIdentityClientChallengeReceivedEvent {
+                            endpoint_challenge,
+                            endpoint_challenge_size,
+                        },
+                },
+            )
+        }
+        ContextEvent::IdentityClientHandshakeCompleted {
+            handle,
+            identity_service_id,
+            endpoint_service_id,
+            endpoint_name,
+            client_auth_private_key,
+        } => {
+            let identity_service_id = arena.v3_onion_service_id(identity_service_id);
+            let endpoint_service_id = arena.v3_onion_service_id(endpoint_service_id);
+            let (endpoint_name, endpoint_name_length) = arena.string(endpoint_name);
+            let client_auth_private_key = arena.x25519_private_key(client_auth_private_key);
+            (
+                GOSLING_EVENT_TYPE_IDENTITY_CLIENT_HANDSHAKE_COMPLETED,
+                handle,
+                GoslingEventData {
+                    identity_client_handshake_completed:
+                        GoslingIdentityClientHandshakeCompletedEvent {
+                            identity_service_id,
+                            endpoint_service_id,
+                            endpoint_name,
+                            endpoint_name_length,
+                            client_auth_private_key,
+                        },
+                },
+            )
+        }
+        ContextEvent::IdentityClientHandshakeFailed { handle, reason } => (
+            GOSLING_EVENT_TYPE_IDENTITY_CLIENT_HANDSHAKE_FAILED,
+            handle,
+            GoslingEventData {
+                handshake_failed: GoslingHandshakeFailedEvent {
+                    reason: arena.error(reason),
+                },
+            },
+        ),
+        //
+        // Identity Server Events
+        //
+        ContextEvent::IdentityServerPublished => (
+            GOSLING_EVENT_TYPE_IDENTITY_SERVER_PUBLISHED,
+            NO_HANDLE,
+            GoslingEventData { empty: () },
+        ),
+        ContextEvent::IdentityServerHandshakeStarted { handle } => (
+            GOSLING_EVENT_TYPE_IDENTITY_SERVER_HANDSHAKE_STARTED,
+            handle,
+            GoslingEventData { empty: () },
+        ),
+        ContextEvent::IdentityServerEndpointRequestReceived {
+            handle,
+            client_service_id,
+            requested_endpoint,
+            ..
+        } => {
+            let client_service_id = arena.v3_onion_service_id(client_service_id);
+            let (requested_endpoint, requested_endpoint_length) = arena.string(requested_endpoint);
+            (
+                GOSLING_EVENT_TYPE_IDENTITY_SERVER_ENDPOINT_REQUEST_RECEIVED,
+                handle,
+                GoslingEventData {
+                    identity_server_endpoint_request_received:
+                        GoslingIdentityServerEndpointRequestReceivedEvent {
+                            client_service_id,
+                            requested_endpoint,
+                            requested_endpoint_length,
+                        },
+                },
+            )
+        }
+        ContextEvent::IdentityServerChallengeResponseReceived {
+            handle,
+            challenge_response,
+        } => {
+            let (challenge_response, challenge_response_size) = arena.bson(challenge_response);
+            (
+                GOSLING_EVENT_TYPE_IDENTITY_SERVER_CHALLENGE_RESPONSE_RECEIVED,
+                handle,
+                GoslingEventData {
+                    identity_server_challenge_response_received:
+                        GoslingIdentityServerChallengeResponseReceivedEvent {
+                            challenge_response,
+                            challenge_response_size,
+                        },
+                },
+            )
+        }
+        ContextEvent::IdentityServerHandshakeCompleted {
+            handle,
+            endpoint_private_key,
+            endpoint_name,
+            client_service_id,
+            client_auth_public_key,
+        } => {
+            let endpoint_private_key = arena.ed25519_private_key(endpoint_private_key);
+            let (endpoint_name, endpoint_name_length) = arena.string(endpoint_name);
+            let client_service_id = arena.v3_onion_service_id(client_service_id);
+            let client_auth_public_key = arena.x25519_public_key(client_auth_public_key);
+            (
+                GOSLING_EVENT_TYPE_IDENTITY_SERVER_HANDSHAKE_COMPLETED,
+                handle,
+                GoslingEventData {
+                    identity_server_handshake_completed:
+                        GoslingIdentityServerHandshakeCompletedEvent {
+                            endpoint_private_key,
+                            endpoint_name,
+                            endpoint_name_length,
+                            client_service_id,
+                            client_auth_public_key,
+                        },
+                },
+            )
+        }
+        ContextEvent::IdentityServerHandshakeRejected {
+            handle,
+            client_allowed,
+            client_requested_endpoint_valid,
+            client_proof_signature_valid,
+            client_auth_signature_valid,
+            challenge_response_valid,
+        } => (
+            GOSLING_EVENT_TYPE_IDENTITY_SERVER_HANDSHAKE_REJECTED,
+            handle,
+            GoslingEventData {
+                identity_server_handshake_rejected: GoslingIdentityServerHandshakeRejectedEvent {
+                    client_allowed,
+                    client_requested_endpoint_valid,
+                    client_proof_signature_valid,
+                    client_auth_signature_valid,
+                    challenge_response_valid,
+                },
+            },
+        ),
+        ContextEvent::IdentityServerHandshakeFailed { handle, reason } => (
+            GOSLING_EVENT_TYPE_IDENTITY_SERVER_HANDSHAKE_FAILED,
+            handle,
+            GoslingEventData {
+                handshake_failed: GoslingHandshakeFailedEvent {
+                    reason: arena.error(reason),
+                },
+            },
+        ),
+        //
+        // Endpoint Client Events
+        //
+        ContextEvent::EndpointClientHandshakeCompleted {
+            handle,
+            endpoint_service_id,
+            channel_name,
+            stream,
+        } => {
+            let endpoint_service_id = arena.v3_onion_service_id(endpoint_service_id);
+            let (channel_name, channel_name_length) = arena.string(channel_name);
+
+            #[cfg(any(target_os = "linux", target_os = "macos"))]
+            let stream = stream.into_raw_fd();
+            #[cfg(target_os = "windows")]
+            let stream = stream.into_raw_socket();
+
+            (
+                GOSLING_EVENT_TYPE_ENDPOINT_CLIENT_HANDSHAKE_COMPLETED,
+                handle,
+                GoslingEventData {
+                    endpoint_client_handshake_completed:
+                        GoslingEndpointClientHandshakeCompletedEvent {
+                            endpoint_service_id,
+                            channel_name,
+                            channel_name_length,
+                            stream,
+                        },
+                },
+            )
+        }
+        ContextEvent::EndpointClientHandshakeFailed { handle, reason } => (
+            GOSLING_EVENT_TYPE_ENDPOINT_CLIENT_HANDSHAKE_FAILED,
+            handle,
+            GoslingEventData {
+                handshake_failed: GoslingHandshakeFailedEvent {
+                    reason: arena.error(reason),
+                },
+            },
+        ),
+        //
+        // Endpoint Server Events
+        //
+        ContextEvent::EndpointServerPublished {
+            endpoint_service_id,
+            endpoint_name,
+        } => {
+            let endpoint_service_id = arena.v3_onion_service_id(endpoint_service_id);
+            let (endpoint_name, endpoint_name_length) = arena.string(endpoint_name);
+            (
+                GOSLING_EVENT_TYPE_ENDPOINT_SERVER_PUBLISHED,
+                NO_HANDLE,
+                GoslingEventData {
+                    endpoint_server_published: GoslingEndpointServerPublishedEvent {
+                        endpoint_service_id,
+                        endpoint_name,
+                        endpoint_name_length,
+                    },
+                },
+            )
+        }
+        ContextEvent::EndpointServerHandshakeStarted { handle } => (
+            GOSLING_EVENT_TYPE_ENDPOINT_SERVER_HANDSHAKE_STARTED,
+            handle,
+            GoslingEventData { empty: () },
+        ),
+        ContextEvent::EndpointServerChannelRequestReceived {
+            handle,
+            client_service_id,
+            requested_channel,
+        } => {
+            let client_service_id = arena.v3_onion_service_id(client_service_id);
+            let (requested_channel, requested_channel_length) = arena.string(requested_channel);
+            (
+                GOSLING_EVENT_TYPE_ENDPOINT_SERVER_CHANNEL_REQUEST_RECEIVED,
+                handle,
+                GoslingEventData {
+                    endpoint_server_channel_request_received:
+                        GoslingEndpointServerChannelRequestReceivedEvent {
+                            client_service_id,
+                            requested_channel,
+                            requested_channel_length,
+                        },
+                },
+            )
+        }
+        ContextEvent::EndpointServerHandshakeCompleted {
+            handle,
+            endpoint_service_id,
+            client_service_id,
+            channel_name,
+            stream,
+        } => {
+            let endpoint_service_id = arena.v3_onion_service_id(endpoint_service_id);
+            let client_service_id = arena.v3_onion_service_id(client_service_id);
+            let (channel_name, channel_name_length) = arena.string(channel_name);
+
+            #[cfg(any(target_os = "linux", target_os = "macos"))]
+            let stream = stream.into_raw_fd();
+            #[cfg(target_os = "windows")]
+            let stream = stream.into_raw_socket();
+
+            (
+                GOSLING_EVENT_TYPE_ENDPOINT_SERVER_HANDSHAKE_COMPLETED,
+                handle,
+                GoslingEventData {
+                    endpoint_server_handshake_completed:
+                        GoslingEndpointServerHandshakeCompletedEvent {
+                            endpoint_service_id,
+                            client_service_id,
+                            channel_name,
+                            channel_name_length,
+                            stream,
+                        },
+                },
+            )
+        }
+        ContextEvent::EndpointServerHandshakeRejected {
+            handle,
+            client_allowed,
+            client_requested_channel_valid,
+            client_proof_signature_valid,
+        } => (
+            GOSLING_EVENT_TYPE_ENDPOINT_SERVER_HANDSHAKE_REJECTED,
+            handle,
+            GoslingEventData {
+                endpoint_server_handshake_rejected: GoslingEndpointServerHandshakeRejectedEvent {
+                    client_allowed,
+                    client_requested_channel_valid,
+                    client_proof_signature_valid,
+                },
+            },
+        ),
+        ContextEvent::EndpointServerHandshakeFailed { handle, reason } => (
+            GOSLING_EVENT_TYPE_ENDPOINT_SERVER_HANDSHAKE_FAILED,
+            handle,
+            GoslingEventData {
+                handshake_failed: GoslingHandshakeFailedEvent {
+                    reason: arena.error(reason),
+                },
+            },
+        ),
+    };
+
+    GoslingEvent {
+        event_type,
+        handle,
+        data,
+    }
+}
+
+/// Update the internal gosling context state and return its events in a caller-provided array
+/// rather than through event callbacks; registered event callbacks are not called. Strings,
+/// buffers and gosling objects referenced by the returned events are owned by the context and
+/// remain valid until the next call to gosling_context_poll_events_batch() with this context (or
+/// until the context is freed), so they must be copied (e.g. with gosling_*_clone()) to be retained.
+/// Returned tcp sockets are owned by the caller.
+///
+/// Events which would otherwise be answered by a required callback must instead be answered with
+/// the matching function before the handshake can progress:
+/// - GOSLING_EVENT_TYPE_IDENTITY_CLIENT_CHALLENGE_RECEIVED:
+///  gosling_context_identity_client_handle_challenge_received()
+/// - GOSLING_EVENT_TYPE_IDENTITY_SERVER_ENDPOINT_REQUEST_RECEIVED:
+///  gosling_context_identity_server_handle_endpoint_request_received()
+/// - GOSLING_EVENT_TYPE_IDENTITY_SERVER_CHALLENGE_RESPONSE_RECEIVED:
+///  gosling_context_identity_server_handle_challenge_response_received()
+/// - GOSLING_EVENT_TYPE_ENDPOINT_SERVER_CHANNEL_REQUEST_RECEIVED:
+///  gosling_context_endpoint_server_handle_channel_request_received()
+///
+/// Events which do not fit in out_events are kept for the next call, in which case
+/// gosling_context_wait_events() returns immediately.
+///
+/// @param context: the context object we are updating
+/// @param out_events: array of out_events_capacity events to fill
+/// @param out_events_capacity: the maximum number of events to return
+/// @param error: filled on error
+/// @return the number of events written to out_events
+#[no_mangle]
+#[cfg_attr(feature = "impl-lib", rename_impl)]
+pub unsafe extern "C" fn gosling_context_poll_events_batch(
+    context: *mut GoslingContext,
+    out_events: *mut GoslingEvent,
+    out_events_capacity: usize,
+    error: *mut *mut GoslingError,
+) -> usize {
+    translate_failures(0, error, || -> anyhow::Result<usize> {
+        ensure_not_null!(context);
+        ensure_not_null!(out_events);
+
+        let context_tuple_registry = get_context_tuple_registry();
+        let mut context = match context_tuple_registry.get_mut(context as usize) {
+            Some(context) => context,
+            None => bail_invalid_handle!(context),
+        };
+        let (context, _callbacks, context_events, arena) = &mut *context;
+
+        // the previous batch's events may no longer be used
+        arena.clear();
+
+        // only ask for more events if there is room for them; the leftover events
+        // stay saved until the update has succeeded so a failing one loses nothing
+        let saved_events = context_events.as_ref().map_or(0, |events| events.len());
+        let mut new_events = if saved_events < out_events_capacity {
+            context.update()?
+        } else {
+            Default::default()
+        };
+        let mut events = std::mem::take(context_events).unwrap_or_default();
+        events.append(&mut new_events);
+
+        let count = events.len().min(out_events_capacity);
+        for (index, event) in events.drain(..count).enumerate() {
+            std::ptr::write(
+                out_events.add(index),
+                context_event_to_gosling_event(event, arena),
+            );
+        }
+
+        // save off whatever did not fit for next time
+        if !events.is_empty() {
+            *context_events = Some(events);
+        }
+
+        Ok(count)
+    })
+}
+
+/// Answer a GOSLING_EVENT_TYPE_IDENTITY_CLIENT_CHALLENGE_RECEIVED event returned from
+/// gosling_context_poll_events_batch() with the identity client's challenge response
+///
+/// @param context: the context associated with the identity client handshake handle
+/// @param handshake_handle: the handle associated with the identity client handshake
+/// @param challenge_response: the challenge response as a bson document
+/// @param challenge_response_size: the number of bytes in challenge_response
+/// @param error: filled on error
+#[no_mangle]
+#[cfg_attr(feature = "impl-lib", rename_impl)]
+pub extern "C" fn gosling_context_identity_client_handle_challenge_received(
+    context: *mut GoslingContext,
+    handshake_handle: GoslingHandshakeHandle,
+    challenge_response: *const u8,
+    challenge_response_size: usize,
+    error: *mut *mut GoslingError,
+) {
+    translate_failures((), error, || -> anyhow::Result<()> {
+        ensure_not_null!(context);
+        ensure_not_null!(challenge_response);
+
+        if challenge_response_size < SMALLEST_BSON_DOC_SIZE {
+            bail!(
+                "challenge_response_size must be at least {}",
+                SMALLEST_BSON_DOC_SIZE
+            );
+        }
+        let challenge_response =
+            unsafe { std::slice::from_raw_parts(challenge_response, challenge_response_size) };
+        let challenge_response =
+            match bson::document::Document::from_reader(Cursor::new(challenge_response)) {
+                Ok(challenge_response) => challenge_response,
+                Err(_) => bail!("failed to parse challenge_response as BSON document"),
+            };
+
+        let context_tuple_registry = get_context_tuple_registry();
+        let mut context = match context_tuple_registry.get_mut(context as usize) {
+            Some(context) => context,
+            None => bail_invalid_handle!(context),
+        };
+        Ok(context
+            .0
+            .identity_client_handle_challenge_received(handshake_handle, challenge_response)?)
+    })
+}
+
+/// Answer a GOSLING_EVENT_TYPE_IDENTITY_SERVER_ENDPOINT_REQUEST_RECEIVED event returned from
+/// gosling_context_poll_events_batch() with the identity server's decisions and endpoint challenge
+///
+/// @param context: the context associated with the identity server handshake handle
+/// @param handshake_handle: the handle associated with the identity server handshake
+/// @param client_allowed: true if the requesting client is allowed to request an endpoint
+/// @param endpoint_supported: true if the requested endpoint is supported
+/// @param endpoint_challenge: the endpoint challenge to send to the client as a bson document
+/// @param endpoint_challenge_size: the number of bytes in endpoint_challenge
+/// @param error: filled on error
+#[no_mangle]
+#[cfg_attr(feature = "impl-lib", rename_impl)]
+pub extern "C" fn gosling_context_identity_server_handle_endpoint_request_received(
+    context: *mut GoslingContext,
+    handshake_handle: GoslingHandshakeHandle,
+    client_allowed: bool,
+    endpoint_supported: bool,
+    endpoint_challenge: *const u8,
+    endpoint_challenge_size: usize,
+    error: *mut *mut GoslingError,
+) {
+    translate_failures((), error, || -> anyhow::Result<()> {
+        ensure_not_null!(context);
+        ensure_not_null!(endpoint_challenge);
+
+        if endpoint_challenge_size < SMALLEST_BSON_DOC_SIZE {
+            bail!(
+                "endpoint_challenge_size must be at least {}",
+                SMALLEST_BSON_DOC_SIZE
+            );
+        }
+        let endpoint_challenge =
+            unsafe { std::slice::from_raw_parts(endpoint_challenge, endpoint_challenge_size) };
+        let endpoint_challenge =
+            match bson::document::Document::from_reader(Cursor::new(endpoint_challenge)) {
+                Ok(endpoint_challenge) => endpoint_challenge,
+                Err(_) => bail!("failed to parse endpoint_challenge as BSON document"),
+            };
+
+        let context_tuple_registry = get_context_tuple_registry();
+        let mut context = match context_tuple_registry.get_mut(context as usize) {
+            Some(context) => context,
+            None => bail_invalid_handle!(context),
+        };
+        Ok(context.0.identity_server_handle_endpoint_request_received(
+            handshake_handle,
+            client_allowed,
+            endpoint_supported,
+            endpoint_challenge,
+        )?)
+    })
+}
+
+/// Answer a GOSLING_EVENT_TYPE_IDENTITY_SERVER_CHALLENGE_RESPONSE_RECEIVED event returned from
+/// gosling_context_poll_events_batch() with the result of verifying the client's challenge response
+///
+/// @param context: the context associated with the identity server handshake handle
+/// @param handshake_handle: the handle associated with the identity server handshake
+/// @param challenge_response_valid: true if the client's challenge response is valid
+/// @param error: filled on error
+#[no_mangle]
+#[cfg_attr(feature = "impl-lib", rename_impl)]
+pub extern "C" fn gosling_context_identity_server_handle_challenge_response_received(
+    context: *mut GoslingContext,
+    handshake_handle: GoslingHandshakeHandle,
+    challenge_response_valid: bool,
+    error: *mut *mut GoslingError,
+) {
+    translate_failures((), error, || -> anyhow::Result<()> {
+        ensure_not_null!(context);
+
+        let context_tuple_registry = get_context_tuple_registry();
+        let mut context = match context_tuple_registry.get_mut(context as usize) {
+            Some(context) => context,
+            None => bail_invalid_handle!(context),
+        };
+        Ok(context
+            .0
+            .identity_server_handle_challenge_response_received(
+                handshake_handle,
+                challenge_response_valid,
+            )?)
+    })
+}
+
+/// Answer a GOSLING_EVENT_TYPE_ENDPOINT_SERVER_CHANNEL_REQUEST_RECEIVED event returned from
+/// gosling_context_poll_events_batch() with whether the requested channel is supported
+///
+/// @param context: the context associated with the endpoint server handshake handle
+/// @param handshake_handle: the handle associated with the endpoint server handshake
+/// @param channel_supported: true if the requested channel is supported
+/// @param error: filled on error
+#[no_mangle]
+#[cfg_attr(feature = "impl-lib", rename_impl)]
+pub extern "C" fn gosling_context_endpoint_server_handle_channel_request_received(
+    context: *mut GoslingContext,
+    handshake_handle: GoslingHandshakeHandle,
+    channel_supported: bool,
+    error: *mut *mut GoslingError,
+) {
+    translate_failures((), error, || -> anyhow::Result<()> {
+        ensure_not_null!(context);
+
+        let context_tuple_registry = get_context_tuple_registry();
+        let mut context = match context_tuple_registry.get_mut(context as usize) {
+            Some(context) => context,
+            None => bail_invalid_handle!(context),
+        };
+        Ok(context
+            .0
+            .endpoint_server_handle_channel_request_received(handshake_handle, channel_supported)?)
+    })
+}
+
+//
+// Metrics
+//
+
+/// The number of buckets in a gosling_histogram
+pub const GOSLING_HISTOGRAM_BUCKETS: usize = 26;
+static_assertions::const_assert_eq!(
+    GOSLING_HISTOGRAM_BUCKETS,
+    gosling::metrics::HISTOGRAM_BUCKETS
+);
+
+// The following types are the C representation of the metrics snapshot returned by
+// gosling_context_get_metrics(); they are declared by hand in the cgosling.h
+// template so any change here must be mirrored there
+
+/// cbindgen:ignore
+#[repr(C)]
+#[derive(Clone, Copy)]
+pub struct GoslingHistogram {
+    pub buckets: [u64; GOSLING_HISTOGRAM_BUCKETS],
+    pub sum_microseconds: u64,
+}
+
+impl From<gosling::metrics::HistogramSnapshot> for GoslingHistogram {
+    fn from(histogram: gosling::metrics::HistogramSnapshot) -> Self {
+        Self {
+            buckets: histogram.buckets,
+            sum_microseconds: histogram.sum_micros,
+        }
+    }
+}
+
+/// cbindgen:ignore
+#[repr(C)]
+#[derive(Clone, Copy)]
+pub struct GoslingHandshakeMetrics {
+    pub started: u64,
+    pub completed: u64,
+    pub rejected: u64,
+    pub failed: u64,
+    pub timed_out: u64,
+    pub aborted: u64,
+    pub in_progress: u64,
+    pub bytes_read: u64,
+    pub bytes_written: u64,
+    pub duration: GoslingHistogram,
+    pub connect: GoslingHistogram,
+    pub step: GoslingHistogram,
+    pub application_wait: GoslingHistogram,
+}
+
+impl From<gosling::metrics::HandshakeMetrics> for GoslingHandshakeMetrics {
+    fn from(metrics: gosling::metrics::HandshakeMetrics) -> Self {
+        Self {
+            started: metrics.started,
+            completed: metrics.completed,
+            rejected: metrics.rejected,
+            failed: metrics.failed,
+            timed_out: metrics.timed_out,
+            aborted: metrics.aborted,
+            in_progress: metrics.in_progress,
+            bytes_read: metrics.bytes_read,
+            bytes_written: metrics.bytes_written,
+            duration: metrics.duration.into(),
+            connect: metrics.connect.into(),
+            step: metrics.step.into(),
+            application_wait: metrics.application_wait.into(),
+        }
+    }
+}
+
+/// cbindgen:ignore
+#[repr(C)]
+#[derive(Clone, Copy)]
+pub struct GoslingMetrics {
+    pub enabled: bool,
+    pub identity_client: GoslingHandshakeMetrics,
+    pub identity_server: GoslingHandshakeMetrics,
+    pub endpoint_client: GoslingHandshakeMetrics,
+    pub endpoint_server: GoslingHandshakeMetrics,
+    pub update: GoslingHistogram,
+    pub tor_provider_update: GoslingHistogram,
+    pub signature_verification: GoslingHistogram,
+    pub accept: GoslingHistogram,
+    pub connections_accepted: u64,
+    pub accept_budget_exhausted: u64,
+    pub pending_connects: u64,
+    pub events_returned: u64,
+    pub pending_events: u64,
+    pub connections_shed: u64,
+    pub handshakes_rate_limited: u64,
+    pub handshakes_rejected_early: u64,
+}
+
+/// Get a snapshot of the context's counters and latency histograms; out_metrics->enabled is false
+/// (and every counter and histogram zero) unless cgosling was built with the metrics feature. The
+/// in-progress, pending-connect, pending-event and admission control counts are always filled in.
+///
+/// @param context: the context whose metrics to get
+/// @param out_metrics: returned metrics snapshot
+/// @param error: filled on error
+#[no_mangle]
+#[cfg_attr(feature = "impl-lib", rename_impl)]
+pub unsafe extern "C" fn gosling_context_get_metrics(
+    context: *mut GoslingContext,
+    out_metrics: *mut GoslingMetrics,
+    error: *mut *mut GoslingError,
+) {
+    translate_failures((), error, || -> anyhow::Result<()> {
+        ensure_not_null!(context);
+        ensure_not_null!(out_metrics);
+
+        let context_tuple_registry = get_context_tuple_registry();
+        let context = match context_tuple_registry.get(context as usize) {
+            Some(context) => context,
+            None => bail_invalid_handle!(context),
+        };
+        let metrics = context.0.metrics();
+        let admission_stats = context.0.identity_server_admission_stats();
+        // events left over from a poll whose callback failed or whose batch was full
+        let pending_events = context.2.as_ref().map_or(0usize, |events| events.len());
+
+        std::ptr::write(
+            out_metrics,
+            GoslingMetrics {
+                enabled: metrics.enabled,
+                identity_client: metrics.identity_client.into(),
+                identity_server: metrics.identity_server.into(),
+                endpoint_client: metrics.endpoint_client.into(),
+                endpoint_server: metrics.endpoint_server.into(),
+                update: metrics.update.into(),
+                tor_provider_update: metrics.tor_provider_update.into(),
+                signature_verification: metrics.signature_verification.into(),
+                accept: metrics.accept.into(),
+                connections_accepted: metrics.connections_accepted,
+                accept_budget_exhausted: metrics.accept_budget_exhausted,
+                pending_connects: metrics.pending_connects,
+                events_returned: metrics.events_returned,
+                pending_events: pending_events as u64,
+                connections_shed: admission_stats.connections_shed,
+                handshakes_rate_limited: admission_stats.handshakes_rate_limited,
+                handshakes_rejected_early: admission_stats.handshakes_rejected_early,
+            },
+        );
+        Ok(())
+    })
+}
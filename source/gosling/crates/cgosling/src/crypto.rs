@@ -548,7 +548,7 @@ pub unsafe extern "C" fn gosling_v3_onion_service_id_from_ed25519_private_key(
                     Some(ed25519_private_key) => ed25519_private_key,
                     None => bail_invalid_handle!(ed25519_private_key),
                 };
-            V3OnionServiceId::from_private_key(ed25519_private_key)
+            V3OnionServiceId::from_private_key(&ed25519_private_key)
         };
 
         let handle = get_v3_onion_service_id_registry().insert(service_id);
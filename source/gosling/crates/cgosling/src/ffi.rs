@@ -31,6 +31,7 @@ pub(crate) const BRIDGE_LINE_TAG: usize = 0xA;
 pub(crate) const TOR_PROVIDER_CONFIG_TAG: usize = 0xB;
 pub(crate) const TOR_PROVIDER_TAG: usize = 0xC;
 pub(crate) const CONTEXT_TUPLE_TAG: usize = 0xD;
+pub(crate) const SHARED_TOR_PROVIDER_TAG: usize = 0xE;
 
 /// A handle for the gosling library
 pub struct GoslingLibrary;
@@ -88,6 +89,7 @@ pub extern "C" fn gosling_library_free(in_library: *mut GoslingLibrary) {
         clear_pluggable_transport_config_registry();
         #[cfg(feature = "legacy-tor-provider")]
         clear_bridge_line_registry();
+        clear_shared_tor_provider_registry();
         clear_tor_provider_registry();
         clear_tor_provider_config_registry();
         clear_context_tuple_registry();
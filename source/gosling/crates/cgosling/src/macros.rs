@@ -5,20 +5,14 @@ macro_rules! define_registry {
             // ensure tag fits in 4 bits
             static_assertions::const_assert!([<$type:snake:upper _TAG>] <= 0b1111);
 
-            static [<$type:snake:upper _REGISTRY>]: std::sync::Mutex<crate::object_registry::ObjectRegistry<$type, { [<$type:snake:upper _TAG>] }, 4>> = std::sync::Mutex::new(crate::object_registry::ObjectRegistry::new());
+            static [<$type:snake:upper _REGISTRY>]: crate::object_registry::ObjectRegistry<$type, { [<$type:snake:upper _TAG>] }, 4> = crate::object_registry::ObjectRegistry::new();
 
-            pub(crate) fn [<get_ $type:snake _registry>]<'a>() -> std::sync::MutexGuard<'a, crate::object_registry::ObjectRegistry<$type, { [<$type:snake:upper _TAG>] }, 4>> {
-                match [<$type:snake:upper _REGISTRY>].lock() {
-                    Ok(registry) => registry,
-                    Err(_) => unreachable!("another thread panicked while holding this registry's mutex"),
-                }
+            pub(crate) fn [<get_ $type:snake _registry>]() -> &'static crate::object_registry::ObjectRegistry<$type, { [<$type:snake:upper _TAG>] }, 4> {
+                &[<$type:snake:upper _REGISTRY>]
             }
 
             pub(crate) fn [<clear_ $type:snake _registry>]() {
-                match [<$type:snake:upper _REGISTRY>].lock() {
-                    Ok(mut registry) => *registry = crate::object_registry::ObjectRegistry::new(),
-                    Err(_) => unreachable!("another thread panicked while holding this registry's mutex"),
-                }
+                [<$type:snake:upper _REGISTRY>].clear();
             }
         }
     }
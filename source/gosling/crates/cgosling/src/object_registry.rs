@@ -1,6 +1,10 @@
 // standard
 use std::collections::BTreeMap;
+use std::ops::{Deref, DerefMut};
 use std::option::Option;
+use std::ptr::NonNull;
+use std::sync::atomic::{AtomicUsize, Ordering};
+use std::sync::{Mutex, MutexGuard};
 
 // An ObjectRegistry<T> maintains ownership of objects and maps them to usize keys
 // which can be safely handed out to external consumers as opaque pointer.
@@ -9,31 +13,95 @@ use std::option::Option;
 // detail) while the low bits are a user-provided tag used to disambiguate keys from different
 // ObjectRegistry's.
 //
+// The registry may be shared between threads. Objects are spread across
+// SHARD_COUNT independently locked shards (selected by the unique identifier
+// portion of their key) so that threads working with different objects (e.g.
+// one Context per thread) do not serialise on a single registry-wide lock.
+// Accessing an object locks only its shard for the lifetime of the returned
+// RegistryGuard (or RegistryGuardMut).
+//
 // T: the type we are storing in the registry
 // TAG: a usize constant which occupy the low bits of returned keys
 // TAG_BITS: the number of bits needed to store the tag (the remainder of the usize bits are used
 //   for the unique id portion of the returne dkeys)
 pub struct ObjectRegistry<T, const TAG: usize, const TAG_BITS: u32> {
-    // our internal mapping from handles to Ts
-    map: Option<BTreeMap<usize, T>>,
+    // our internal mappings from handles to Ts
+    shards: [Mutex<BTreeMap<usize, T>>; SHARD_COUNT],
     // number of Ts registered to this registry over its lifetime
-    counter: usize,
+    counter: AtomicUsize,
 }
 
 // Rust only supports 8-bit bytes
 const BITS_PER_BYTE: u32 = 8;
 
+// number of independently locked maps per registry; keys handed out
+// consecutively land in different shards
+const SHARD_COUNT: usize = 16;
+
+// A locked reference to an object owned by an ObjectRegistry; other objects
+// in the same shard are inaccessible until this is dropped
+pub struct RegistryGuard<'a, T> {
+    // keeps our shard locked (and so value valid) while we are alive
+    _shard: MutexGuard<'a, BTreeMap<usize, T>>,
+    value: NonNull<T>,
+}
+
+impl<T> Deref for RegistryGuard<'_, T> {
+    type Target = T;
+
+    fn deref(&self) -> &T {
+        // value points into the map owned by the shard we have locked
+        unsafe { self.value.as_ref() }
+    }
+}
+
+// A locked mutable reference to an object owned by an ObjectRegistry; other
+// objects in the same shard are inaccessible until this is dropped
+pub struct RegistryGuardMut<'a, T> {
+    // keeps our shard locked (and so value valid) while we are alive
+    _shard: MutexGuard<'a, BTreeMap<usize, T>>,
+    value: NonNull<T>,
+}
+
+impl<T> Deref for RegistryGuardMut<'_, T> {
+    type Target = T;
+
+    fn deref(&self) -> &T {
+        // value points into the map owned by the shard we have locked
+        unsafe { self.value.as_ref() }
+    }
+}
+
+impl<T> DerefMut for RegistryGuardMut<'_, T> {
+    fn deref_mut(&mut self) -> &mut T {
+        // value points into the map owned by the shard we have locked, and
+        // was borrowed from it mutably
+        unsafe { self.value.as_mut() }
+    }
+}
+
 impl<T, const TAG: usize, const TAG_BITS: u32> ObjectRegistry<T, TAG, TAG_BITS> {
     // the number of bits available to the counter portion of an object key
     const COUNTER_BITS: u32 = std::mem::size_of::<usize>() as u32 * BITS_PER_BYTE - TAG_BITS;
     // the largest value the counter portion of the key can be without rolling over to 0
     const COUNTER_MAX: usize = !0usize >> TAG_BITS;
+    // used to initialise our shards in a const context
+    #[allow(clippy::declare_interior_mutable_const)]
+    const EMPTY_SHARD: Mutex<BTreeMap<usize, T>> = Mutex::new(BTreeMap::new());
 
     // return the next key to return on successful insertion
-    fn next_key(&mut self) -> usize {
-        assert!(self.counter < Self::COUNTER_MAX);
-        self.counter += 1;
-        (self.counter << TAG_BITS) | TAG
+    fn next_key(&self) -> usize {
+        let counter = self.counter.fetch_add(1, Ordering::Relaxed) + 1;
+        assert!(counter <= Self::COUNTER_MAX);
+        (counter << TAG_BITS) | TAG
+    }
+
+    // lock and return the shard which owns (or would own) the given key
+    fn shard(&self, key: usize) -> MutexGuard<'_, BTreeMap<usize, T>> {
+        match self.shards[(key >> TAG_BITS) % SHARD_COUNT].lock() {
+            Ok(shard) => shard,
+            Err(_) => unreachable!("another thread panicked while holding this registry's mutex"),
+        }
     }
 
     // returns a new empty ObjectRegisry
@@ -41,58 +109,62 @@ impl<T, const TAG: usize, const TAG_BITS: u32> ObjectRegistry<T, TAG, TAG_BITS>
         assert!(TAG_BITS == 0 || (TAG << Self::COUNTER_BITS) >> Self::COUNTER_BITS == TAG);
 
         ObjectRegistry {
-            map: None,
-            counter: 0,
+            shards: [Self::EMPTY_SHARD; SHARD_COUNT],
+            counter: AtomicUsize::new(0),
         }
     }
 
     // determine if the registry has an object with the specified key
     pub fn contains_key(&self, key: usize) -> bool {
-        match &self.map {
-            Some(map) => map.contains_key(&key),
-            None => false,
-        }
+        self.shard(key).contains_key(&key)
     }
 
     // remove and return an object with the specified key
-    pub fn remove(&mut self, key: usize) -> Option<T> {
-        match &mut self.map {
-            Some(map) => map.remove(&key),
-            None => None,
-        }
+    pub fn remove(&self, key: usize) -> Option<T> {
+        self.shard(key).remove(&key)
     }
 
     // add object into registry and return key to reference it
-    pub fn insert(&mut self, val: T) -> usize {
+    pub fn insert(&self, val: T) -> usize {
         let key = self.next_key();
-        match &mut self.map {
-            Some(map) => {
-                if map.insert(key, val).is_some() {
-                    panic!();
-                }
-            }
-            None => {
-                let mut map = BTreeMap::new();
-                map.insert(key, val);
-                self.map = Some(map);
-            }
+        if self.shard(key).insert(key, val).is_some() {
+            panic!();
         }
         key
     }
 
-    // gets a reference to a value by the given key
-    pub fn get(&self, key: usize) -> Option<&T> {
-        match &self.map {
-            Some(map) => map.get(&key),
-            None => None,
-        }
+    // gets a locked reference to a value by the given key
+    pub fn get(&self, key: usize) -> Option<RegistryGuard<'_, T>> {
+        let shard = self.shard(key);
+        let value = NonNull::from(shard.get(&key)?);
+        Some(RegistryGuard {
+            _shard: shard,
+            value,
+        })
     }
 
-    // gets a mutable reference to a value by the given key
-    pub fn get_mut(&mut self, key: usize) -> Option<&mut T> {
-        match &mut self.map {
-            Some(map) => map.get_mut(&key),
-            None => None,
+    // gets a locked mutable reference to a value by the given key
+    pub fn get_mut(&self, key: usize) -> Option<RegistryGuardMut<'_, T>> {
+        let mut shard = self.shard(key);
+        let value = NonNull::from(shard.get_mut(&key)?);
+        Some(RegistryGuardMut {
+            _shard: shard,
+            value,
+        })
+    }
+
+    // removes every object from the registry; the key counter keeps counting so
+    // keys handed out before clearing are never handed out again
+    pub fn clear(&self) {
+        for shard in self.shards.iter() {
+            // drop the objects after releasing the shard's lock
+            let objects = match shard.lock() {
+                Ok(mut shard) => std::mem::take(&mut *shard),
+                Err(_) => {
+                    unreachable!("another thread panicked while holding this registry's mutex")
+                }
+            };
+            drop(objects);
         }
     }
 
@@ -124,7 +196,7 @@ impl<T, const TAG: usize, const TAG_BITS: u32> ObjectRegistry<T, TAG, TAG_BITS>
 fn test_object_registry() -> anyhow::Result<()> {
     // create a new ObjectRegistry
     type Int32Registry0_16 = ObjectRegistry<i32, 1234usize, 16>;
-    let mut registry = Int32Registry0_16::new();
+    let registry = Int32Registry0_16::new();
     assert_eq!(
         Int32Registry0_16::COUNTER_BITS,
         std::mem::size_of::<usize>() as u32 * BITS_PER_BYTE - 16
@@ -141,14 +213,16 @@ fn test_object_registry() -> anyhow::Result<()> {
     assert!(registry.contains_key(key3));
 
     // check that we can get the objects back using their keys
-    assert_eq!(registry.get(key1), Some(&10));
-    assert_eq!(registry.get(key2), Some(&20));
-    assert_eq!(registry.get(key3), Some(&30));
+    assert_eq!(registry.get(key1).as_deref(), Some(&10));
+    assert_eq!(registry.get(key2).as_deref(), Some(&20));
+    assert_eq!(registry.get(key3).as_deref(), Some(&30));
 
     // check that we can get mutable references to the objects and modify them
-    let obj = registry.get_mut(key1).unwrap();
-    *obj = 100;
-    assert_eq!(registry.get(key1), Some(&100));
+    {
+        let mut obj = registry.get_mut(key1).unwrap();
+        *obj = 100;
+    }
+    assert_eq!(registry.get(key1).as_deref(), Some(&100));
 
     // check that we can remove objects from the registry and they are no longer contained
     let obj = registry.remove(key2).unwrap();
@@ -177,8 +251,8 @@ fn test_object_registry() -> anyhow::Result<()> {
 #[test]
 fn test_object_registry_key_collision() -> anyhow::Result<()> {
     // create two registries with different TAG values
-    let mut registry_a: ObjectRegistry<String, 1usize, 8> = ObjectRegistry::new();
-    let mut registry_b: ObjectRegistry<String, 2usize, 8> = ObjectRegistry::new();
+    let registry_a: ObjectRegistry<String, 1usize, 8> = ObjectRegistry::new();
+    let registry_b: ObjectRegistry<String, 2usize, 8> = ObjectRegistry::new();
 
     // insert objects into the registries
     let key_a_1 = registry_a.insert("a1".to_string());
@@ -207,7 +281,7 @@ fn test_object_registry_key_collision() -> anyhow::Result<()> {
 #[test]
 fn test_object_registry_empty_tag() -> anyhow::Result<()> {
     // create a registry with tag 0 and tag bits 0
-    let mut reg = ObjectRegistry::<i32, 0, 0>::new();
+    let reg = ObjectRegistry::<i32, 0, 0>::new();
 
     // add some values and check their keys
     let key1 = reg.insert(1);
@@ -217,3 +291,61 @@ fn test_object_registry_empty_tag() -> anyhow::Result<()> {
 
     Ok(())
 }
+
+#[test]
+fn test_object_registry_concurrent_access() -> anyhow::Result<()> {
+    const THREAD_COUNT: usize = 8;
+    const INSERT_COUNT: usize = 1000;
+
+    static REGISTRY: ObjectRegistry<usize, 1usize, 4> = ObjectRegistry::new();
+
+    // each thread inserts, modifies, reads back and removes its own objects
+    let keys: Vec<Vec<usize>> = std::thread::scope(|scope| {
+        let workers: Vec<_> = (0..THREAD_COUNT)
+            .map(|thread| {
+                scope.spawn(move || {
+                    let keys: Vec<usize> = (0..INSERT_COUNT)
+                        .map(|i| REGISTRY.insert(thread * INSERT_COUNT + i))
+                        .collect();
+                    for key in keys.iter() {
+                        *REGISTRY.get_mut(*key).unwrap() += 1;
+                    }
+                    for (i, key) in keys.iter().enumerate() {
+                        assert_eq!(
+                            REGISTRY.get(*key).as_deref(),
+                            Some(&(thread * INSERT_COUNT + i + 1))
+                        );
+                    }
+                    for key in keys.iter().step_by(2) {
+                        assert!(REGISTRY.remove(*key).is_some());
+                    }
+                    keys
+                })
+            })
+            .collect();
+        workers.into_iter().map(|w| w.join().unwrap()).collect()
+    });
+
+    // every key handed out must be unique
+    let mut all_keys: Vec<usize> = keys.iter().flatten().copied().collect();
+    all_keys.sort();
+    all_keys.dedup();
+    assert_eq!(all_keys.len(), THREAD_COUNT * INSERT_COUNT);
+
+    // only the objects which were not removed remain
+    for thread_keys in keys.iter() {
+        for (i, key) in thread_keys.iter().enumerate() {
+            assert_eq!(REGISTRY.contains_key(*key), i % 2 == 1);
+        }
+    }
+
+    // clearing drops everything, but keys are never reused
+    REGISTRY.clear();
+    assert!(!all_keys.iter().any(|key| REGISTRY.contains_key(*key)));
+    assert_eq!(
+        REGISTRY.get_counter_from_key(REGISTRY.insert(0)),
+        THREAD_COUNT * INSERT_COUNT + 1
+    );
+
+    Ok(())
+}
@@ -18,6 +18,7 @@ use tor_interface::legacy_tor_client::*;
 use tor_interface::mock_tor_client::*;
 #[cfg(feature = "legacy-tor-provider")]
 use tor_interface::proxy::*;
+use tor_interface::shared_tor_client::*;
 use tor_interface::*;
 
 // internal crates
@@ -61,6 +62,10 @@ pub struct GoslingTorProvider;
 type TorProvider = Box<dyn tor_provider::TorProvider>;
 define_registry! {TorProvider}
 
+/// A tor provider object whose tor backend may be shared by many contexts
+pub struct GoslingSharedTorProvider;
+define_registry! {SharedTorProvider}
+
 //
 // Memory freeing functions
 //
@@ -117,6 +122,19 @@ pub extern "C" fn gosling_tor_provider_free(in_tor_provider: *mut GoslingTorProv
     impl_registry_free!(in_tor_provider, TorProvider);
 }
 
+/// Frees a gosling_shared_tor_provider object; the tor providers created from it
+/// remain valid and the shared tor backend is torn down once they have also been
+/// freed
+///
+/// @param in_shared_tor_provider: the shared tor provider object to free
+#[no_mangle]
+#[cfg_attr(feature = "impl-lib", rename_impl)]
+pub extern "C" fn gosling_shared_tor_provider_free(
+    in_shared_tor_provider: *mut GoslingSharedTorProvider,
+) {
+    impl_registry_free!(in_shared_tor_provider, SharedTorProvider);
+}
+
 //
 // Proxy
 //
@@ -343,7 +361,7 @@ pub unsafe extern "C" fn gosling_pluggable_transport_config_add_cmdline_option(
 
         match get_pluggable_transport_config_registry().get_mut(pluggable_transport_config as usize)
         {
-            Some(config) => config.add_option(option.to_string()),
+            Some(mut config) => config.add_option(option.to_string()),
             None => bail_invalid_handle!(pluggable_transport_config),
         }
 
@@ -471,6 +489,7 @@ pub unsafe extern "C" fn gosling_tor_provider_config_new_bundled_legacy_client_c
             allowed_ports: None,
             pluggable_transports: None,
             bridge_lines: None,
+            unix_domain_sockets: false,
         };
 
         let handle = get_tor_provider_config_registry()
@@ -572,7 +591,7 @@ pub unsafe extern "C" fn gosling_tor_provider_config_set_proxy_config(
         ensure_not_null!(proxy_config);
 
         match get_tor_provider_config_registry().get_mut(tor_provider_config as usize) {
-            Some(tor_provider_config) => match tor_provider_config {
+            Some(mut tor_provider_config) => match &mut *tor_provider_config {
                 TorProviderConfig::LegacyTorClientConfig(LegacyTorClientConfig::BundledTor {
                     proxy_settings,
                     ..
@@ -619,7 +638,7 @@ pub unsafe extern "C" fn gosling_tor_provider_config_set_allowed_ports(
         let allowed_ports_slice =
             std::slice::from_raw_parts(allowed_ports as *const u16, allowed_ports_count);
         match get_tor_provider_config_registry().get_mut(tor_provider_config as usize) {
-            Some(tor_provider_config) => match tor_provider_config {
+            Some(mut tor_provider_config) => match &mut *tor_provider_config {
                 TorProviderConfig::LegacyTorClientConfig(LegacyTorClientConfig::BundledTor {
                     allowed_ports,
                     ..
@@ -634,6 +653,49 @@ pub unsafe extern "C" fn gosling_tor_provider_config_set_allowed_ports(
         Ok(())
     })
 }
+
+/// Set whether a tor provider config should talk to the tor daemon over
+/// unix-domain sockets rather than loopback TCP. When enabled, the tor daemon's
+/// SOCKS listener and the targets of the tor provider's onion services are
+/// unix-domain sockets in the tor provider's data directory, which must be short
+/// enough (and free of whitespace) for its socket paths to be valid. The
+/// gosling sockets returned by this tor provider are then unix-domain sockets
+/// too. A tor provider config does not need to support unix-domain sockets, so
+/// this function may fail as a result. The currently supported tor provider
+/// configs are:
+/// - Legacy Bundled Client (on unix platforms)
+///
+/// @param tor_provider_config: the tor provider config to update
+/// @param unix_domain_sockets: whether to use unix-domain sockets
+/// @param error: filled on error
+#[no_mangle]
+#[cfg(feature = "legacy-tor-provider")]
+#[cfg_attr(feature = "impl-lib", rename_impl)]
+pub unsafe extern "C" fn gosling_tor_provider_config_set_unix_domain_sockets(
+    tor_provider_config: *mut GoslingTorProviderConfig,
+    unix_domain_sockets: bool,
+    error: *mut *mut GoslingError,
+) {
+    translate_failures((), error, || -> anyhow::Result<()> {
+        ensure_not_null!(tor_provider_config);
+
+        match get_tor_provider_config_registry().get_mut(tor_provider_config as usize) {
+            Some(mut tor_provider_config) => match &mut *tor_provider_config {
+                TorProviderConfig::LegacyTorClientConfig(LegacyTorClientConfig::BundledTor {
+                    unix_domain_sockets: config_unix_domain_sockets,
+                    ..
+                }) if cfg!(unix) => {
+                    *config_unix_domain_sockets = unix_domain_sockets;
+                }
+                _ => bail!("tor_provider_config does not support this operation"),
+            },
+            None => bail_invalid_handle!(tor_provider_config),
+        }
+
+        Ok(())
+    })
+}
+
 /// Add a pluggable-transport config to a tor provider config. A tor provider config
 /// does not need to support pluggable-transport configuration, so this function may
 /// fail as a result. The currently supported tor provider configs are:
@@ -659,7 +721,7 @@ pub unsafe extern "C" fn gosling_tor_provider_config_add_pluggable_transport_con
         ensure_not_null!(pluggable_transport_config);
 
         match get_tor_provider_config_registry().get_mut(tor_provider_config as usize) {
-            Some(tor_provider_config) => match tor_provider_config {
+            Some(mut tor_provider_config) => match &mut *tor_provider_config {
                 TorProviderConfig::LegacyTorClientConfig(LegacyTorClientConfig::BundledTor {
                     pluggable_transports,
                     ..
@@ -711,7 +773,7 @@ pub unsafe extern "C" fn gosling_tor_provider_config_add_bridge_line(
         ensure_not_null!(bridge_line);
 
         match get_tor_provider_config_registry().get_mut(tor_provider_config as usize) {
-            Some(tor_provider_config) => match tor_provider_config {
+            Some(mut tor_provider_config) => match &mut *tor_provider_config {
                 TorProviderConfig::LegacyTorClientConfig(LegacyTorClientConfig::BundledTor {
                     bridge_lines,
                     ..
@@ -754,7 +816,7 @@ pub unsafe extern "C" fn gosling_tor_provider_from_tor_provider_config(
 
         let tor_provider: Box<dyn tor_provider::TorProvider> =
             match get_tor_provider_config_registry().get(tor_provider_config as usize) {
-                Some(tor_provider_config) => match tor_provider_config {
+                Some(tor_provider_config) => match &*tor_provider_config {
                     #[cfg(feature = "mock-tor-provider")]
                     TorProviderConfig::MockTorClientConfig => {
                         let tor_provider: MockTorClient = Default::default();
@@ -777,3 +839,71 @@ pub unsafe extern "C" fn gosling_tor_provider_from_tor_provider_config(
         Ok(())
     });
 }
+
+//
+// Shared Tor Provider
+//
+
+/// Create a shared tor provider which lets many contexts use a single tor provider's
+/// tor backend (e.g. one legacy tor daemon and its control connection). Each context
+/// must be given its own tor provider created with
+/// gosling_tor_provider_from_shared_tor_provider().
+///
+/// @param out_shared_tor_provider: returned shared tor provider
+/// @param in_tor_provider: the tor provider whose tor backend to share; this function
+///  consumes the tor_provider
+/// @param error: filled on error
+#[no_mangle]
+#[cfg_attr(feature = "impl-lib", rename_impl)]
+pub unsafe extern "C" fn gosling_shared_tor_provider_from_tor_provider(
+    out_shared_tor_provider: *mut *mut GoslingSharedTorProvider,
+    in_tor_provider: *mut GoslingTorProvider,
+    error: *mut *mut GoslingError,
+) {
+    translate_failures((), error, || -> anyhow::Result<()> {
+        ensure_not_null!(out_shared_tor_provider);
+        ensure_not_null!(in_tor_provider);
+
+        let tor_provider = match get_tor_provider_registry().remove(in_tor_provider as usize) {
+            Some(tor_provider) => tor_provider,
+            None => bail_invalid_handle!(in_tor_provider),
+        };
+        let shared_tor_provider = SharedTorProvider::new(tor_provider)?;
+
+        let handle = get_shared_tor_provider_registry().insert(shared_tor_provider);
+        *out_shared_tor_provider = handle as *mut GoslingSharedTorProvider;
+
+        Ok(())
+    });
+}
+
+/// Create a tor provider for one context from a shared tor provider. Tor providers
+/// created from the same shared tor provider only receive their own onion service
+/// published and connect events, and never share circuits with one another.
+///
+/// @param out_tor_provider: returned tor provider
+/// @param shared_tor_provider: the shared tor provider whose tor backend to use
+/// @param error: filled on error
+#[no_mangle]
+#[cfg_attr(feature = "impl-lib", rename_impl)]
+pub unsafe extern "C" fn gosling_tor_provider_from_shared_tor_provider(
+    out_tor_provider: *mut *mut GoslingTorProvider,
+    shared_tor_provider: *const GoslingSharedTorProvider,
+    error: *mut *mut GoslingError,
+) {
+    translate_failures((), error, || -> anyhow::Result<()> {
+        ensure_not_null!(out_tor_provider);
+        ensure_not_null!(shared_tor_provider);
+
+        let tor_provider: Box<dyn tor_provider::TorProvider> =
+            match get_shared_tor_provider_registry().get(shared_tor_provider as usize) {
+                Some(shared_tor_provider) => Box::new(shared_tor_provider.client()),
+                None => bail_invalid_handle!(shared_tor_provider),
+            };
+
+        let handle = get_tor_provider_registry().insert(tor_provider);
+        *out_tor_provider = handle as *mut GoslingTorProvider;
+
+        Ok(())
+    });
+}
@@ -145,8 +145,8 @@ pub extern "C" fn gosling_context_connect(
         ensure_not_null!(out_tcp_socket);
         ensure_not_null!(target_address);
 
-        let mut context_tuple_registry = get_context_tuple_registry();
-        let context = match context_tuple_registry.get_mut(context as usize) {
+        let context_tuple_registry = get_context_tuple_registry();
+        let mut context = match context_tuple_registry.get_mut(context as usize) {
             Some(context) => context,
             None => bail_invalid_handle!(context),
         };
@@ -446,9 +446,9 @@ pub unsafe extern "C" fn gosling_context_generate_circuit_token(
     translate_failures(!0usize, error, || -> anyhow::Result<CircuitToken> {
         ensure_not_null!(context);
 
-        let mut context_tuple_registry = get_context_tuple_registry();
+        let context_tuple_registry = get_context_tuple_registry();
         let token = match context_tuple_registry.get_mut(context as usize) {
-            Some(context) => context.0.generate_circuit_token(),
+            Some(mut context) => context.0.generate_circuit_token(),
             None => bail_invalid_handle!(context),
         };
         Ok(token)
@@ -470,9 +470,9 @@ pub unsafe extern "C" fn gosling_context_release_circuit_token(
     translate_failures((), error, || -> anyhow::Result<()> {
         ensure_not_null!(context);
 
-        let mut context_tuple_registry = get_context_tuple_registry();
+        let context_tuple_registry = get_context_tuple_registry();
         match context_tuple_registry.get_mut(context as usize) {
-            Some(context) => context.0.release_circuit_token(circuit_token),
+            Some(mut context) => context.0.release_circuit_token(circuit_token),
             None => bail_invalid_handle!(context),
         };
         Ok(())
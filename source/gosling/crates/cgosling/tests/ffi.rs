@@ -212,6 +212,78 @@ fn create_server_identity_handshake(context: *mut GoslingContext) -> anyhow::Res
     Ok(())
 }
 
+static SINGLE_PASS_CHALLENGE_BUILT: AtomicBool = AtomicBool::new(false);
+static SINGLE_PASS_CHALLENGE_RESPONSE_BUILT: AtomicBool = AtomicBool::new(false);
+
+// register the single-pass challenge callbacks, which take precedence over the
+// size-then-build callback pairs registered by create_*_identity_handshake()
+fn create_single_pass_challenge_handshake(
+    server_context: *mut GoslingContext,
+    client_context: *mut GoslingContext,
+) -> anyhow::Result<()> {
+    SINGLE_PASS_CHALLENGE_BUILT.store(false, Ordering::Relaxed);
+    SINGLE_PASS_CHALLENGE_RESPONSE_BUILT.store(false, Ordering::Relaxed);
+
+    extern "C" fn challenge_callback(
+        context: *mut GoslingContext,
+        _handshake_handle: usize,
+        out_challenge_buffer: *mut u8,
+        out_challenge_buffer_size: usize,
+    ) -> usize {
+        assert!(!context.is_null());
+        assert!(!out_challenge_buffer.is_null());
+
+        if out_challenge_buffer_size >= CHALLENGE_BSON.len() {
+            let out_challenge_buffer = unsafe {
+                std::slice::from_raw_parts_mut(out_challenge_buffer, CHALLENGE_BSON.len())
+            };
+            out_challenge_buffer.clone_from_slice(&CHALLENGE_BSON);
+            SINGLE_PASS_CHALLENGE_BUILT.store(true, Ordering::Relaxed);
+        }
+        CHALLENGE_BSON.len()
+    }
+    require_noerror!(gosling_context_set_identity_server_challenge_callback(
+        server_context,
+        Some(challenge_callback)
+    ));
+
+    extern "C" fn challenge_response_callback(
+        context: *mut GoslingContext,
+        _handshake_handle: usize,
+        challenge_buffer: *const u8,
+        challenge_buffer_size: usize,
+        out_challenge_response_buffer: *mut u8,
+        out_challenge_response_buffer_size: usize,
+    ) -> usize {
+        assert!(!context.is_null());
+        assert!(!challenge_buffer.is_null());
+        let challenge_buffer =
+            unsafe { std::slice::from_raw_parts(challenge_buffer, challenge_buffer_size) };
+        assert_eq!(challenge_buffer, CHALLENGE_BSON);
+        assert!(!out_challenge_response_buffer.is_null());
+
+        if out_challenge_response_buffer_size >= CHALLENGE_RESPONSE_BSON.len() {
+            let out_challenge_response_buffer = unsafe {
+                std::slice::from_raw_parts_mut(
+                    out_challenge_response_buffer,
+                    CHALLENGE_RESPONSE_BSON.len(),
+                )
+            };
+            out_challenge_response_buffer.clone_from_slice(&CHALLENGE_RESPONSE_BSON);
+            SINGLE_PASS_CHALLENGE_RESPONSE_BUILT.store(true, Ordering::Relaxed);
+        }
+        CHALLENGE_RESPONSE_BSON.len()
+    }
+    require_noerror!(
+        gosling_context_set_identity_client_challenge_response_callback(
+            client_context,
+            Some(challenge_response_callback)
+        )
+    );
+
+    Ok(())
+}
+
 fn create_server_endpoint_handshake(context: *mut GoslingContext) -> anyhow::Result<()> {
     extern "C" fn channel_supported_callback(
         context: *mut GoslingContext,
@@ -266,7 +338,80 @@ fn test_gosling_ffi_handshake_mock_client() -> anyhow::Result<()> {
     ));
 
     // do test
-    test_gosling_ffi_handshake_impl(library, alice_tor_provider, pat_tor_provider)
+    test_gosling_ffi_handshake_impl(library, alice_tor_provider, pat_tor_provider, false)
+}
+
+#[test]
+#[serial]
+#[cfg(feature = "mock-tor-provider")]
+fn test_gosling_ffi_handshake_single_pass_challenge_mock_client() -> anyhow::Result<()> {
+    let library = test_gosling_ffi_handshake_preamble()?;
+
+    // construct a shared mock config
+    let mut mock_tor_provider_config: *mut GoslingTorProviderConfig = ptr::null_mut();
+    require_noerror!(gosling_tor_provider_config_new_mock_client_config(
+        &mut mock_tor_provider_config
+    ));
+
+    // construct tor providers
+    let mut alice_tor_provider: *mut GoslingTorProvider = ptr::null_mut();
+    require_noerror!(gosling_tor_provider_from_tor_provider_config(
+        &mut alice_tor_provider,
+        mock_tor_provider_config
+    ));
+
+    let mut pat_tor_provider: *mut GoslingTorProvider = ptr::null_mut();
+    require_noerror!(gosling_tor_provider_from_tor_provider_config(
+        &mut pat_tor_provider,
+        mock_tor_provider_config
+    ));
+
+    // do test
+    test_gosling_ffi_handshake_impl(library, alice_tor_provider, pat_tor_provider, true)
+}
+
+#[test]
+#[serial]
+#[cfg(feature = "mock-tor-provider")]
+fn test_gosling_ffi_handshake_shared_mock_client() -> anyhow::Result<()> {
+    let library = test_gosling_ffi_handshake_preamble()?;
+
+    // construct a single mock tor provider
+    let mut mock_tor_provider_config: *mut GoslingTorProviderConfig = ptr::null_mut();
+    require_noerror!(gosling_tor_provider_config_new_mock_client_config(
+        &mut mock_tor_provider_config
+    ));
+
+    let mut mock_tor_provider: *mut GoslingTorProvider = ptr::null_mut();
+    require_noerror!(gosling_tor_provider_from_tor_provider_config(
+        &mut mock_tor_provider,
+        mock_tor_provider_config
+    ));
+
+    // and share it between alice and pat
+    let mut shared_tor_provider: *mut GoslingSharedTorProvider = ptr::null_mut();
+    require_noerror!(gosling_shared_tor_provider_from_tor_provider(
+        &mut shared_tor_provider,
+        mock_tor_provider
+    ));
+
+    let mut alice_tor_provider: *mut GoslingTorProvider = ptr::null_mut();
+    require_noerror!(gosling_tor_provider_from_shared_tor_provider(
+        &mut alice_tor_provider,
+        shared_tor_provider
+    ));
+
+    let mut pat_tor_provider: *mut GoslingTorProvider = ptr::null_mut();
+    require_noerror!(gosling_tor_provider_from_shared_tor_provider(
+        &mut pat_tor_provider,
+        shared_tor_provider
+    ));
+
+    // the contexts keep the shared tor backend alive
+    gosling_shared_tor_provider_free(shared_tor_provider);
+
+    // do test
+    test_gosling_ffi_handshake_impl(library, alice_tor_provider, pat_tor_provider, false)
 }
 
 #[test]
@@ -320,7 +465,7 @@ fn test_gosling_ffi_handshake_legacy_client() -> anyhow::Result<()> {
     ));
 
     // do test
-    test_gosling_ffi_handshake_impl(library, alice_tor_provider, pat_tor_provider)
+    test_gosling_ffi_handshake_impl(library, alice_tor_provider, pat_tor_provider, false)
 }
 
 // test bundled tor client with pluggable transport
@@ -422,7 +567,221 @@ fn test_gosling_ffi_handshake_bundled_pt_client() -> anyhow::Result<()> {
     ));
 
     // do test
-    test_gosling_ffi_handshake_impl(library, alice_tor_provider, pat_tor_provider)
+    test_gosling_ffi_handshake_impl(library, alice_tor_provider, pat_tor_provider, false)
+}
+
+#[test]
+#[serial]
+#[cfg(feature = "mock-tor-provider")]
+fn test_gosling_ffi_poll_events_batch_mock_client() -> anyhow::Result<()> {
+    // deliberately small so events are left over between polls
+    const EVENTS_CAPACITY: usize = 2;
+
+    fn poll_events_batch(
+        context: *mut GoslingContext,
+        events: &mut Vec<GoslingEvent>,
+    ) -> anyhow::Result<()> {
+        events.clear();
+        events.reserve(EVENTS_CAPACITY);
+        unsafe {
+            let mut error: *mut GoslingError = ptr::null_mut();
+            let count = gosling_context_poll_events_batch(
+                context,
+                events.as_mut_ptr(),
+                EVENTS_CAPACITY,
+                &mut error,
+            );
+            if !error.is_null() {
+                let msg = gosling_error_get_message(error);
+                let msg = format!("{:?}", CStr::from_ptr(msg));
+                gosling_error_free(error);
+                anyhow::bail!(msg);
+            }
+            assert!(count <= EVENTS_CAPACITY);
+            events.set_len(count);
+        }
+        Ok(())
+    }
+
+    let library = test_gosling_ffi_handshake_preamble()?;
+
+    let mut mock_tor_provider_config: *mut GoslingTorProviderConfig = ptr::null_mut();
+    require_noerror!(gosling_tor_provider_config_new_mock_client_config(
+        &mut mock_tor_provider_config
+    ));
+
+    let new_context =
+        |private_key: *mut GoslingEd25519PrivateKey| -> anyhow::Result<*mut GoslingContext> {
+            let mut tor_provider: *mut GoslingTorProvider = ptr::null_mut();
+            require_noerror!(gosling_tor_provider_from_tor_provider_config(
+                &mut tor_provider,
+                mock_tor_provider_config
+            ));
+            let mut context: *mut GoslingContext = ptr::null_mut();
+            require_noerror!(gosling_context_init(
+                &mut context,
+                tor_provider,
+                420,
+                420,
+                private_key
+            ));
+            require_noerror!(gosling_context_bootstrap_tor(context));
+            Ok(context)
+        };
+
+    let mut alice_private_key: *mut GoslingEd25519PrivateKey = ptr::null_mut();
+    require_noerror!(gosling_ed25519_private_key_generate(&mut alice_private_key));
+    let mut alice_identity: *mut GoslingV3OnionServiceId = ptr::null_mut();
+    require_noerror!(gosling_v3_onion_service_id_from_ed25519_private_key(
+        &mut alice_identity,
+        alice_private_key
+    ));
+    let alice_context = new_context(alice_private_key)?;
+
+    let mut pat_private_key: *mut GoslingEd25519PrivateKey = ptr::null_mut();
+    require_noerror!(gosling_ed25519_private_key_generate(&mut pat_private_key));
+    let pat_context = new_context(pat_private_key)?;
+
+    let mut events: Vec<GoslingEvent> = Default::default();
+
+    // bootstrap alice and start her identity server
+    let mut alice_identity_server_published = false;
+    let mut alice_bootstrap_complete = false;
+    while !alice_identity_server_published {
+        poll_events_batch(alice_context, &mut events)?;
+        for event in events.iter() {
+            match event.event_type {
+                GOSLING_EVENT_TYPE_TOR_BOOTSTRAP_COMPLETED => {
+                    assert!(!alice_bootstrap_complete);
+                    alice_bootstrap_complete = true;
+                    require_noerror!(gosling_context_start_identity_server(alice_context));
+                }
+                GOSLING_EVENT_TYPE_IDENTITY_SERVER_PUBLISHED => {
+                    alice_identity_server_published = true;
+                }
+                _ => (),
+            }
+        }
+    }
+
+    // bootstrap pat
+    let mut pat_bootstrap_complete = false;
+    while !pat_bootstrap_complete {
+        poll_events_batch(pat_context, &mut events)?;
+        pat_bootstrap_complete = events
+            .iter()
+            .any(|event| event.event_type == GOSLING_EVENT_TYPE_TOR_BOOTSTRAP_COMPLETED);
+    }
+
+    // pat requests an endpoint from alice
+    require_noerror!(gosling_context_begin_identity_handshake(
+        pat_context,
+        alice_identity,
+        ENDPOINT_NAME.as_ptr(),
+        ENDPOINT_NAME.to_bytes().len()
+    ));
+
+    let mut alice_handshake_completed = false;
+    let mut pat_handshake_completed = false;
+    while !alice_handshake_completed || !pat_handshake_completed {
+        poll_events_batch(alice_context, &mut events)?;
+        for event in events.iter() {
+            match event.event_type {
+                GOSLING_EVENT_TYPE_IDENTITY_SERVER_HANDSHAKE_STARTED => (),
+                GOSLING_EVENT_TYPE_IDENTITY_SERVER_ENDPOINT_REQUEST_RECEIVED => {
+                    let data = unsafe { event.data.identity_server_endpoint_request_received };
+                    let requested_endpoint = unsafe {
+                        std::slice::from_raw_parts(
+                            data.requested_endpoint as *const u8,
+                            data.requested_endpoint_length,
+                        )
+                    };
+                    assert_eq!(requested_endpoint, ENDPOINT_NAME.to_bytes());
+                    require_noerror!(
+                        gosling_context_identity_server_handle_endpoint_request_received(
+                            alice_context,
+                            event.handle,
+                            true,
+                            true,
+                            CHALLENGE_BSON.as_ptr(),
+                            CHALLENGE_BSON.len()
+                        )
+                    );
+                }
+                GOSLING_EVENT_TYPE_IDENTITY_SERVER_CHALLENGE_RESPONSE_RECEIVED => {
+                    let data = unsafe { event.data.identity_server_challenge_response_received };
+                    let challenge_response = unsafe {
+                        std::slice::from_raw_parts(
+                            data.challenge_response,
+                            data.challenge_response_size,
+                        )
+                    };
+                    assert_eq!(challenge_response, CHALLENGE_RESPONSE_BSON);
+                    require_noerror!(
+                        gosling_context_identity_server_handle_challenge_response_received(
+                            alice_context,
+                            event.handle,
+                            true
+                        )
+                    );
+                }
+                GOSLING_EVENT_TYPE_IDENTITY_SERVER_HANDSHAKE_COMPLETED => {
+                    let data = unsafe { event.data.identity_server_handshake_completed };
+                    let endpoint_name = unsafe {
+                        std::slice::from_raw_parts(
+                            data.endpoint_name as *const u8,
+                            data.endpoint_name_length,
+                        )
+                    };
+                    assert_eq!(endpoint_name, ENDPOINT_NAME.to_bytes());
+                    assert!(!data.endpoint_private_key.is_null());
+                    alice_handshake_completed = true;
+                }
+                GOSLING_EVENT_TYPE_TOR_LOG_RECEIVED => (),
+                event_type => bail!("alice received unexpected event: {}", event_type),
+            }
+        }
+
+        poll_events_batch(pat_context, &mut events)?;
+        for event in events.iter() {
+            match event.event_type {
+                GOSLING_EVENT_TYPE_IDENTITY_CLIENT_CHALLENGE_RECEIVED => {
+                    let data = unsafe { event.data.identity_client_challenge_received };
+                    let endpoint_challenge = unsafe {
+                        std::slice::from_raw_parts(
+                            data.endpoint_challenge,
+                            data.endpoint_challenge_size,
+                        )
+                    };
+                    assert_eq!(endpoint_challenge, CHALLENGE_BSON);
+                    require_noerror!(gosling_context_identity_client_handle_challenge_received(
+                        pat_context,
+                        event.handle,
+                        CHALLENGE_RESPONSE_BSON.as_ptr(),
+                        CHALLENGE_RESPONSE_BSON.len()
+                    ));
+                }
+                GOSLING_EVENT_TYPE_IDENTITY_CLIENT_HANDSHAKE_COMPLETED => {
+                    let data = unsafe { event.data.identity_client_handshake_completed };
+                    assert!(!data.endpoint_service_id.is_null());
+                    assert!(!data.client_auth_private_key.is_null());
+                    pat_handshake_completed = true;
+                }
+                GOSLING_EVENT_TYPE_TOR_LOG_RECEIVED => (),
+                event_type => bail!("pat received unexpected event: {}", event_type),
+            }
+        }
+    }
+
+    gosling_context_free(alice_context);
+    gosling_context_free(pat_context);
+    gosling_v3_onion_service_id_free(alice_identity);
+    gosling_ed25519_private_key_free(alice_private_key);
+    gosling_ed25519_private_key_free(pat_private_key);
+    gosling_tor_provider_config_free(mock_tor_provider_config);
+    gosling_library_free(library);
+
+    Ok(())
 }
 
 fn test_gosling_ffi_handshake_preamble() -> anyhow::Result<*mut GoslingLibrary> {
@@ -441,6 +800,7 @@ fn test_gosling_ffi_handshake_impl(
     library: *mut GoslingLibrary,
     alice_tor_provider: *mut GoslingTorProvider,
     pat_tor_provider: *mut GoslingTorProvider,
+    single_pass_challenge: bool,
 ) -> anyhow::Result<()> {
     // init alice
 
@@ -487,6 +847,9 @@ fn test_gosling_ffi_handshake_impl(
     ));
 
     create_client_identity_handshake(pat_context)?;
+    if single_pass_challenge {
+        create_single_pass_challenge_handshake(alice_context, pat_context)?;
+    }
 
     // bootstrap alice
 
@@ -1025,6 +1388,11 @@ fn test_gosling_ffi_handshake_impl(
         }
     }
 
+    if single_pass_challenge {
+        assert!(SINGLE_PASS_CHALLENGE_BUILT.load(Ordering::Relaxed));
+        assert!(SINGLE_PASS_CHALLENGE_RESPONSE_BUILT.load(Ordering::Relaxed));
+    }
+
     // we have to free gosling library at the end or else the backing TorProvider will go away
     // and then pat_stream and alice_stream will no longer be valid
     println!("--- free gosling library");
@@ -0,0 +1,238 @@
+// standard
+use std::time::Duration;
+
+// extern crates
+use bench_common::{report_allocations, CountingAllocator};
+use bson::doc;
+use criterion::{criterion_group, criterion_main, Criterion, Throughput};
+use tor_interface::mock_tor_client::*;
+use tor_interface::tor_crypto::*;
+
+// internal crates
+use gosling::context::*;
+
+#[global_allocator]
+static GLOBAL: CountingAllocator = CountingAllocator;
+
+// a pair of bootstrapped contexts with alice's identity server published
+struct Peers {
+    alice: Context,
+    alice_service_id: V3OnionServiceId,
+    pat: Context,
+    pat_service_id: V3OnionServiceId,
+}
+
+fn new_context() -> (Context, V3OnionServiceId) {
+    let private_key = Ed25519PrivateKey::generate();
+    let service_id = V3OnionServiceId::from_private_key(&private_key);
+    let mut context = Context::new(
+        Box::new(MockTorClient::new()),
+        420,
+        420,
+        Duration::from_secs(60),
+        4096,
+        None,
+        private_key,
+    )
+    .unwrap();
+    context.bootstrap().unwrap();
+
+    let mut bootstrap_complete = false;
+    while !bootstrap_complete {
+        for event in context.update().unwrap().drain(..) {
+            if let ContextEvent::TorBootstrapCompleted = event {
+                bootstrap_complete = true;
+            }
+        }
+    }
+    (context, service_id)
+}
+
+fn new_peers() -> Peers {
+    let (mut alice, alice_service_id) = new_context();
+    let (pat, pat_service_id) = new_context();
+
+    alice.identity_server_start().unwrap();
+    let mut identity_server_published = false;
+    while !identity_server_published {
+        for event in alice.update().unwrap().drain(..) {
+            if let ContextEvent::IdentityServerPublished = event {
+                identity_server_published = true;
+            }
+        }
+    }
+
+    Peers {
+        alice,
+        alice_service_id,
+        pat,
+        pat_service_id,
+    }
+}
+
+// runs a complete identity handshake from pat to alice, returning the endpoint
+// credentials each side receives
+fn identity_handshake(
+    peers: &mut Peers,
+) -> (
+    Ed25519PrivateKey,
+    V3OnionServiceId,
+    X25519PrivateKey,
+    X25519PublicKey,
+) {
+    let pat_handle = peers
+        .pat
+        .identity_client_begin_handshake(
+            peers.alice_service_id.clone(),
+            "bench_endpoint".to_string(),
+        )
+        .unwrap();
+
+    let mut server_result: Option<(Ed25519PrivateKey, X25519PublicKey)> = None;
+    let mut client_result: Option<(V3OnionServiceId, X25519PrivateKey)> = None;
+    while server_result.is_none() || client_result.is_none() {
+        for event in peers.alice.update().unwrap().drain(..) {
+            match event {
+                ContextEvent::IdentityServerEndpointRequestReceived { handle, .. } => peers
+                    .alice
+                    .identity_server_handle_endpoint_request_received(handle, true, true, doc! {})
+                    .unwrap(),
+                ContextEvent::IdentityServerChallengeResponseReceived { handle, .. } => peers
+                    .alice
+                    .identity_server_handle_challenge_response_received(handle, true)
+                    .unwrap(),
+                ContextEvent::IdentityServerHandshakeCompleted {
+                    endpoint_private_key,
+                    client_auth_public_key,
+                    ..
+                } => server_result = Some((endpoint_private_key, client_auth_public_key)),
+                ContextEvent::IdentityServerHandshakeStarted { .. }
+                | ContextEvent::TorLogReceived { .. } => (),
+                evt => panic!("alice.update() returned unexpected event: {:?}", evt),
+            }
+        }
+        for event in peers.pat.update().unwrap().drain(..) {
+            match event {
+                ContextEvent::IdentityClientChallengeReceived { handle, .. } => {
+                    assert_eq!(handle, pat_handle);
+                    peers
+                        .pat
+                        .identity_client_handle_challenge_received(handle, doc! {})
+                        .unwrap()
+                }
+                ContextEvent::IdentityClientHandshakeCompleted {
+                    endpoint_service_id,
+                    client_auth_private_key,
+                    ..
+                } => client_result = Some((endpoint_service_id, client_auth_private_key)),
+                ContextEvent::TorLogReceived { .. } => (),
+                evt => panic!("pat.update() returned unexpected event: {:?}", evt),
+            }
+        }
+    }
+
+    let (endpoint_private_key, client_auth_public_key) = server_result.unwrap();
+    let (endpoint_service_id, client_auth_private_key) = client_result.unwrap();
+    (
+        endpoint_private_key,
+        endpoint_service_id,
+        client_auth_private_key,
+        client_auth_public_key,
+    )
+}
+
+// runs a complete endpoint handshake from pat to alice's endpoint server
+fn endpoint_handshake(
+    peers: &mut Peers,
+    endpoint_service_id: &V3OnionServiceId,
+    client_auth_private_key: &X25519PrivateKey,
+) {
+    peers
+        .pat
+        .endpoint_client_begin_handshake(
+            endpoint_service_id.clone(),
+            client_auth_private_key.clone(),
+            "bench_channel".to_string(),
+        )
+        .unwrap();
+
+    let mut server_completed = false;
+    let mut client_completed = false;
+    while !server_completed || !client_completed {
+        for event in peers.alice.update().unwrap().drain(..) {
+            match event {
+                ContextEvent::EndpointServerChannelRequestReceived { handle, .. } => peers
+                    .alice
+                    .endpoint_server_handle_channel_request_received(handle, true)
+                    .unwrap(),
+                ContextEvent::EndpointServerHandshakeCompleted { .. } => server_completed = true,
+                ContextEvent::EndpointServerHandshakeStarted { .. }
+                | ContextEvent::TorLogReceived { .. } => (),
+                evt => panic!("alice.update() returned unexpected event: {:?}", evt),
+            }
+        }
+        for event in peers.pat.update().unwrap().drain(..) {
+            match event {
+                ContextEvent::EndpointClientHandshakeCompleted { .. } => client_completed = true,
+                ContextEvent::TorLogReceived { .. } => (),
+                evt => panic!("pat.update() returned unexpected event: {:?}", evt),
+            }
+        }
+    }
+}
+
+fn bench_identity_handshake(c: &mut Criterion) {
+    let mut peers = new_peers();
+
+    report_allocations("handshakes/identity", 20, || {
+        identity_handshake(&mut peers);
+    });
+
+    let mut group = c.benchmark_group("handshakes");
+    group.throughput(Throughput::Elements(1));
+    group.bench_function("identity", |b| b.iter(|| identity_handshake(&mut peers)));
+    group.finish();
+}
+
+fn bench_endpoint_handshake(c: &mut Criterion) {
+    let mut peers = new_peers();
+
+    // acquire endpoint credentials and publish alice's endpoint server
+    let (
+        endpoint_private_key,
+        endpoint_service_id,
+        client_auth_private_key,
+        client_auth_public_key,
+    ) = identity_handshake(&mut peers);
+    peers
+        .alice
+        .endpoint_server_start(
+            endpoint_private_key,
+            "bench_endpoint".to_string(),
+            peers.pat_service_id.clone(),
+            client_auth_public_key,
+        )
+        .unwrap();
+    let mut endpoint_server_published = false;
+    while !endpoint_server_published {
+        for event in peers.alice.update().unwrap().drain(..) {
+            if let ContextEvent::EndpointServerPublished { .. } = event {
+                endpoint_server_published = true;
+            }
+        }
+    }
+
+    report_allocations("handshakes/endpoint", 20, || {
+        endpoint_handshake(&mut peers, &endpoint_service_id, &client_auth_private_key)
+    });
+
+    let mut group = c.benchmark_group("handshakes");
+    group.throughput(Throughput::Elements(1));
+    group.bench_function("endpoint", |b| {
+        b.iter(|| endpoint_handshake(&mut peers, &endpoint_service_id, &client_auth_private_key))
+    });
+    group.finish();
+}
+
+criterion_group!(benches, bench_identity_handshake, bench_endpoint_handshake);
+criterion_main!(benches);
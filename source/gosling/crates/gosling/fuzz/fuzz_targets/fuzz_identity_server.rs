@@ -296,7 +296,7 @@ fuzz_target!(|data: HandshakeData| {
     while !alice_begin_handshake_handled {
         for event in alice.update().unwrap().drain(..) {
             match event {
-                ContextEvent::IdentityServerEndpointRequestReceived{handle, client_service_id: _, requested_endpoint} => {
+                ContextEvent::IdentityServerEndpointRequestReceived{handle, client_service_id: _, requested_endpoint, ..} => {
                     assert_eq!(handle, alice_handshake_handle);
                     assert_eq!(expected_response, ExpectedBeginHandshakeResponse::EndpointRequestReceived);
                     #[derive(PartialEq, Debug)]
@@ -1,11 +1,18 @@
 // standard
 use std::clone::Clone;
-use std::collections::{BTreeMap, HashMap, VecDeque};
+use std::collections::{BTreeMap, HashSet, VecDeque};
 use std::net::TcpStream;
-use std::time::Duration;
+#[cfg(unix)]
+use std::os::unix::io::{AsFd, AsRawFd};
+#[cfg(windows)]
+use std::os::windows::io::{AsRawSocket, AsSocket};
+use std::sync::atomic::{AtomicBool, Ordering};
+use std::sync::Arc;
+use std::time::{Duration, Instant};
 
 // extern crates
 use honk_rpc::honk_rpc::*;
+use polling::{Event, Events, Poller};
 use tor_interface::tor_crypto::*;
 use tor_interface::tor_provider::*;
 
@@ -13,17 +20,95 @@ use tor_interface::tor_provider::*;
 use crate::ascii_string::*;
 use crate::endpoint_client;
 use crate::endpoint_client::*;
+use crate::endpoint_registry::EndpointRegistry;
 use crate::endpoint_server;
 use crate::endpoint_server::*;
 use crate::identity_client;
 use crate::identity_client::*;
 use crate::identity_server;
 use crate::identity_server::*;
+use crate::key_pool::KeyPool;
+use crate::metrics::{trace_scope, HandshakeOutcome, Metrics, MetricsSnapshot, Stopwatch};
+use crate::rate_limiter::RateLimiter;
+use crate::session_pool::SessionPool;
+use crate::timer_wheel::TimerWheel;
+use crate::worker_pool::WorkerPool;
 
 /// A handle to an in-progres identity or endpoint handshake
 pub type HandshakeHandle = usize;
 const DEFAULT_ENDPOINT_TIMEOUT: Duration = Duration::from_secs(60);
 const DEFAULT_ENDPOINT_MAX_MESSAGE_SIZE: i32 = 384;
+// number of finished sessions' buffers kept for re-use by new handshakes
+const DEFAULT_SESSION_POOL_SIZE: usize = 64;
+// how often to update a TorProvider which cannot wake us up itself
+const TOR_PROVIDER_UPDATE_INTERVAL: Duration = Duration::from_millis(16);
+// all our poller registrations share a key since any readiness means update() has work
+const POLLER_KEY: usize = 0;
+// handing work to a parked worker thread and back costs about as much as a
+// handshake step, so each handshake worker thread must have at least this many
+// handshakes to drive
+const MIN_HANDSHAKES_PER_WORKER_THREAD: usize = 2;
+// batch verification amortises its cost over the batch, so each worker thread
+// must have at least this many signatures to verify
+const MIN_SIGNATURES_PER_WORKER_THREAD: usize = 8;
+
+// sockets which may be registered with a Context's poller
+#[cfg(unix)]
+trait PollerSource: AsRawFd + AsFd {}
+#[cfg(unix)]
+impl<T: AsRawFd + AsFd> PollerSource for T {}
+#[cfg(windows)]
+trait PollerSource: AsRawSocket + AsSocket {}
+#[cfg(windows)]
+impl<T: AsRawSocket + AsSocket> PollerSource for T {}
+
+// arm (or re-arm) a socket's oneshot registration with the poller
+fn poller_arm<S: PollerSource>(
+    poller: &Poller,
+    source: &S,
+    interest: Event,
+) -> Result<(), std::io::Error> {
+    // SAFETY: only sockets owned by the Context or its TorProvider are registered,
+    // and Context::poller_disarm() deletes every registration before the Context
+    // drops any of them: it runs first thing in update(), in every other method
+    // which closes listeners or handshakes, and when the Context is dropped
+    match unsafe { poller.add(source, interest) } {
+        Err(err) if err.kind() == std::io::ErrorKind::AlreadyExists => {
+            poller.modify(source, interest)
+        }
+        result => result,
+    }
+}
+
+fn min_timeout(timeout: Option<Duration>, duration: Duration) -> Option<Duration> {
+    match timeout {
+        Some(timeout) => Some(timeout.min(duration)),
+        None => Some(duration),
+    }
+}
+
+// an outgoing handshake whose connection is still being established by the TorProvider
+enum PendingConnect {
+    IdentityClient {
+        handle: HandshakeHandle,
+        identity_server_id: V3OnionServiceId,
+        endpoint: AsciiString,
+    },
+    EndpointClient {
+        handle: HandshakeHandle,
+        endpoint_server_id: V3OnionServiceId,
+        channel: AsciiString,
+    },
+}
+
+impl PendingConnect {
+    fn handle(&self) -> HandshakeHandle {
+        match self {
+            PendingConnect::IdentityClient { handle, .. }
+            | PendingConnect::EndpointClient { handle, .. } => *handle,
+        }
+    }
+}
 
 /// The error type for the [`Context`] type.
 #[derive(thiserror::Error, Debug)]
@@ -46,6 +131,10 @@ pub enum Error {
     #[error("incorrect usage: {0}")]
     IncorrectUsage(String),
 
+    /// An incoming identity handshake was shed because its client exceeded its rate limit
+    #[error("identity client {0} exceeded its handshake rate limit")]
+    ClientRateLimited(V3OnionServiceId),
+
     /// An underlying `std::io::Error`
     #[error(transparent)]
     Io(#[from] std::io::Error),
@@ -79,6 +168,58 @@ pub enum Error {
     EndpointServerError(#[from] endpoint_server::Error),
 }
 
+/// The configuration of one of a [`Context`]'s endpoint servers, see [`Context::endpoint_servers_start()`]
+#[derive(Clone)]
+pub struct EndpointServerConfig {
+    /// The ed25519 private key used to start this endpoint server's onion-service
+    pub endpoint_private_key: Ed25519PrivateKey,
+    /// The ASCII-encoded endpoint name
+    pub endpoint_name: String,
+    /// The onion-service service-id of the client which will be connecting to this endpoint server
+    pub client_identity: V3OnionServiceId,
+    /// The x25519 public-key used to encrypt the endpoint server's onion-service descriptor
+    pub client_auth: X25519PublicKey,
+    /// The endpoint server's priority, see [`Context::endpoint_server_set_priority()`]
+    pub priority: u32,
+    /// Whether the endpoint server is active, see [`Context::endpoint_servers_register()`]
+    pub active: bool,
+}
+
+// a listener's turn to accept a connection in Context::update(); identity
+// listener first, then endpoint listeners by service id
+#[derive(Clone, PartialEq, Eq, PartialOrd, Ord)]
+enum AcceptTurn {
+    IdentityListener,
+    EndpointListener(V3OnionServiceId),
+}
+
+// the outcome of a listener's turn to accept a connection
+enum Accept {
+    // a handshake was started on the accepted connection
+    Handshake,
+    // the accepted connection was closed by admission control
+    Shed,
+    // the listener has no connection to accept, or may not accept any more
+    WouldBlock,
+}
+
+// an active endpoint server's onion-service
+struct EndpointListener {
+    listener: OnionListener,
+    published: bool,
+}
+
+/// Counts of the incoming identity handshakes a [`Context`]'s admission control has turned away, see [`Context::identity_server_admission_stats()`]
+#[derive(Clone, Copy, Debug, Default, PartialEq, Eq)]
+pub struct AdmissionStats {
+    /// Connections closed on accept because the maximum number of concurrent identity server handshakes was reached
+    pub connections_shed: u64,
+    /// Handshakes failed with [`Error::ClientRateLimited`] because their client exceeded its rate limit
+    pub handshakes_rate_limited: u64,
+    /// Handshakes rejected before a challenge was sent to the client
+    pub handshakes_rejected_early: u64,
+}
+
 /// The gosling protocol implementation.
 ///
 /// The `Context` object provides various methods for starting and progressing identity and endpoint handshakes. The general usage pattern developers will follow is to construct a `Context` object, connect to the Tor Network using [`Context::bootstrap()`], optionally start an identity or endpoint servers, and listen for and handle incoming identity and endpoint clients using [`Context::update()`] and the various associated methods. Depending on the application's requirements, the developer can also initiate identity and endpoint handshakes as necessary.
@@ -99,18 +240,56 @@ pub struct Context {
     // Servers and Clients for in-process handshakes
     //
     next_handshake_handle: HandshakeHandle,
+    // maps in-flight TorProvider::connect_async() requests to their outgoing handshakes
+    pending_connects: BTreeMap<ConnectHandle, PendingConnect>,
     identity_clients: BTreeMap<HandshakeHandle, IdentityClient>,
     identity_servers: BTreeMap<HandshakeHandle, IdentityServer>,
     endpoint_clients: BTreeMap<HandshakeHandle, EndpointClient>,
     endpoint_servers: BTreeMap<HandshakeHandle, EndpointServer>,
+    // read timeouts of the above handshakes, keyed by their (unique) handles
+    handshake_timers: TimerWheel<HandshakeHandle>,
+    // threads used to drive the above handshakes in update()
+    handshake_workers: WorkerPool,
+    // maximum number of connections accepted across all listeners per update(), or
+    // None to accept at most one connection from each listener
+    max_accepts_per_update: Option<usize>,
+    // the listener whose turn to accept comes first in the next update()
+    next_accept_turn: AcceptTurn,
+    // pre-generated keys for completing identity handshakes
+    key_pool: Option<Arc<KeyPool>>,
+    // message buffers recycled from finished handshakes' sessions
+    session_pool: SessionPool,
+
+    //
+    // Admission control for incoming identity handshakes
+    //
+    max_identity_server_handshakes: usize,
+    identity_client_rate_limiter: Option<RateLimiter<V3OnionServiceId>>,
+    identity_server_early_rejection: bool,
+    admission_stats: AdmissionStats,
+
+    // counters and timings for Context::metrics()
+    metrics: Metrics,
 
     //
     // Listeners for incoming connections
     //
     identity_listener: Option<OnionListener>,
     identity_server_published: bool,
-    // maps the endpoint service id to the (enpdoint name, alowed client, onion listener tuple, published)
-    endpoint_listeners: HashMap<V3OnionServiceId, (String, V3OnionServiceId, OnionListener, bool)>,
+    // every registered endpoint server, active or dormant
+    endpoint_registry: EndpointRegistry,
+    // maps the endpoint service id to its active endpoint server's onion-service
+    endpoint_listeners: BTreeMap<V3OnionServiceId, EndpointListener>,
+    // servers started before bootstrap completed; their onion-services are all
+    // started with a single batch once it has
+    queued_identity_server: bool,
+    // as are endpoint servers activated again before the TorProvider has torn down
+    // their previous onion-service
+    queued_endpoint_servers: Vec<V3OnionServiceId>,
+    // endpoint servers deactivated since the TorProvider last tore down onion-services
+    removed_endpoint_servers: HashSet<V3OnionServiceId>,
+    max_published_endpoint_servers: usize,
+    endpoint_server_idle_timeout: Option<Duration>,
 
     //
     // Server Config Data
@@ -120,6 +299,51 @@ pub struct Context {
     identity_private_key: Ed25519PrivateKey,
     // Identity server's service id
     identity_service_id: V3OnionServiceId,
+
+    //
+    // Readiness notification for Context::wait_events()
+    //
+    poller: Arc<Poller>,
+    // event_waiter() has registered sockets which poller_disarm() must delete
+    poller_armed: AtomicBool,
+    // the TorProvider notifies our poller when it has new events
+    tor_provider_has_waker: bool,
+    // update() has work to do without any socket becoming ready
+    update_pending: bool,
+}
+
+/// Blocks until a [`Context`] has work for [`Context::update()`], see [`Context::wait_events()`].
+///
+/// A `ContextWaiter` does not borrow its `Context`, so a `Context` shared between threads may be unlocked while waiting.
+pub struct ContextWaiter {
+    // None if update() already has work to do
+    poller: Option<Arc<Poller>>,
+    timeout: Option<Duration>,
+}
+
+impl ContextWaiter {
+    /// Block the calling thread until one of the associated `Context`'s sockets becomes ready, its [`TorProvider`] signals new events, or the timeout passed to [`Context::event_waiter()`] elapses.
+    pub fn wait(self) -> Result<(), Error> {
+        if let Some(poller) = self.poller {
+            let mut events = Events::new();
+            poller.wait(&mut events, self.timeout)?;
+        }
+        Ok(())
+    }
+
+    /// The longest [`ContextWaiter::wait()`] blocks for, `None` if it waits indefinitely. A waiter for a `Context` which already has work does not block.
+    pub fn timeout(&self) -> Option<Duration> {
+        match self.poller {
+            Some(_) => self.timeout,
+            None => Some(Duration::ZERO),
+        }
+    }
+
+    /// The file descriptor of the underlying poller, for waiting on with an external event loop instead of [`ContextWaiter::wait()`]. The descriptor becomes readable whenever `wait()` would return before its timeout, and remains readable until reset by a call to `wait()` (a zero timeout suffices). Returns `None` if the associated `Context` already has work.
+    #[cfg(any(target_os = "linux", target_os = "macos"))]
+    pub fn as_raw_fd(&self) -> Option<std::os::unix::io::RawFd> {
+        self.poller.as_ref().map(|poller| poller.as_raw_fd())
+    }
 }
 
 /// Events to signal completion of asynchronous [`Context`] operations
@@ -203,6 +427,8 @@ pub enum ContextEvent {
         client_service_id: V3OnionServiceId,
         /// The ASCII-encoded name of the requested endpoint server
         requested_endpoint: String,
+        /// Whether this handshake is rejected early should the client not be allowed or the endpoint not be supported, as configured by [`Context::set_identity_server_early_rejection()`] when the handshake started
+        early_rejection: bool,
     },
 
     /// An identity server has received a challenge response from an identity client.
@@ -353,14 +579,14 @@ impl Context {
     /// - `tor_provider`: an implementation of the [`TorProvider`] trait which provides our Tor Network connectivity
     /// - `identity_port`: the virt-port this `Context`'s identity server's onion-service will listen on for new identity handshakes.
     /// - `endpoint_port`: the virt-port this `Context`'s endpoint servers' onion-services will listen on for new endpoint handshakes.
-    /// - `identity_timeout`: the maximum amount of time this `Context`' will allow an identity handshake to delay between steps before rejecting the request.
+    /// - `identity_timeout`: the maximum amount of time this `Context`' will allow an identity handshake to delay between steps before rejecting the request. For outgoing identity handshakes this includes connecting to the identity server.
     /// - `identity_max_message_size`: the maximum size of the underlying Honk-RPC BSON message this `Context`'s identity handshake will send and accept.
-    /// - `endpoint_timeout`: the maximum amount of time this `Context`' will allow an endpoint handshake to delay between steps before rejecting the request.
+    /// - `endpoint_timeout`: the maximum amount of time this `Context`' will allow an endpoint handshake to delay between steps before rejecting the request. For outgoing endpoint handshakes this includes connecting to the endpoint server.
     /// - `identity_private_key`: the ed25519 private key used to start this `Context`'s identity server's onion-service
     /// # Returns
     /// A newly constructed `Context`.
     pub fn new(
-        tor_provider: Box<dyn TorProvider>,
+        mut tor_provider: Box<dyn TorProvider>,
         identity_port: u16,
         endpoint_port: u16,
         identity_timeout: Duration,
@@ -370,6 +596,17 @@ impl Context {
     ) -> Result<Self, Error> {
         let identity_service_id = V3OnionServiceId::from_private_key(&identity_private_key);
 
+        // let the TorProvider interrupt wait_events() when it has new events
+        let poller = Arc::new(Poller::new()?);
+        let tor_provider_has_waker = {
+            let poller = Arc::downgrade(&poller);
+            tor_provider.set_event_waker(Arc::new(move || {
+                if let Some(poller) = poller.upgrade() {
+                    let _ = poller.notify();
+                }
+            }))
+        };
+
         Ok(Self {
             tor_provider,
             bootstrap_complete: false,
@@ -383,27 +620,192 @@ impl Context {
             },
 
             next_handshake_handle: Default::default(),
+            pending_connects: Default::default(),
             identity_clients: Default::default(),
             identity_servers: Default::default(),
             endpoint_clients: Default::default(),
             endpoint_servers: Default::default(),
+            handshake_timers: TimerWheel::new(Instant::now()),
+            handshake_workers: WorkerPool::new(1)?,
+            max_accepts_per_update: None,
+            next_accept_turn: AcceptTurn::IdentityListener,
+            key_pool: None,
+            session_pool: SessionPool::new(DEFAULT_SESSION_POOL_SIZE),
+
+            max_identity_server_handshakes: usize::MAX,
+            identity_client_rate_limiter: None,
+            identity_server_early_rejection: false,
+            admission_stats: Default::default(),
+
+            metrics: Default::default(),
 
             identity_listener: None,
             identity_server_published: false,
+            endpoint_registry: EndpointRegistry::new(),
             endpoint_listeners: Default::default(),
+            queued_identity_server: false,
+            queued_endpoint_servers: Default::default(),
+            removed_endpoint_servers: Default::default(),
+            max_published_endpoint_servers: usize::MAX,
+            endpoint_server_idle_timeout: None,
 
             identity_private_key,
             identity_service_id,
+
+            poller,
+            poller_armed: AtomicBool::new(false),
+            tor_provider_has_waker,
+            update_pending: true,
         })
     }
 
+    /// Set the number of threads [`Context::update()`] uses to drive in-progress identity and endpoint handshakes. By default handshakes are driven one after another on the calling thread; servers receiving bursts of concurrent handshakes may spread the work (e.g. signature verification) across several cores instead. The worker threads are spawned by this call and park between updates, owned by this `Context` until it is dropped or this is called again. Updates wake one worker for every few in-progress handshakes (or pending signatures), so updates with just a handful in flight drive them on the calling thread. [`ContextEvent`]s are returned in the same order regardless of the number of threads.
+    ///
+    /// # Parameters
+    /// - `worker_threads`: the maximum number of threads to use, including the thread calling [`Context::update()`]; `0` uses the available parallelism reported by the OS, and `1` (the default) disables multi-threading
+    pub fn set_handshake_worker_threads(&mut self, worker_threads: usize) -> Result<(), Error> {
+        let worker_threads = match worker_threads {
+            0 => std::thread::available_parallelism().map_or(1, |threads| threads.get()),
+            worker_threads => worker_threads,
+        };
+        if worker_threads != self.handshake_workers.threads() {
+            // drop the old pool first so both never hold parked threads at once
+            self.handshake_workers = WorkerPool::new(1)?;
+            self.handshake_workers = WorkerPool::new(worker_threads)?;
+        }
+        Ok(())
+    }
+
+    /// Set the maximum number of incoming identity and endpoint connections [`Context::update()`] accepts per call. By default the identity server and every endpoint server each accept at most one connection per call; servers receiving bursts of new clients may accept several at once so that the last client in a burst does not wait through as many updates (and honk-rpc timeouts) before its handshake starts. The budget is shared by the identity server and every endpoint server, which take turns accepting one connection at a time; each call starts with the server after the last one to accept in the previous call, so one busy listener cannot starve the others. Connections closed by admission control (see [`Context::set_max_identity_server_handshakes()`]) do not count against the budget, though no more than `max_accepts` (one by default) are closed per call. The budget only limits accepts: every in-progress handshake, whichever listener accepted it, is still advanced by one non-blocking step per call, so the work a call does on handshakes is bounded by the number in flight, which the budget in turn limits the growth of.
+    ///
+    /// # Parameters
+    /// - `max_accepts`: the maximum number of connections to accept per call to [`Context::update()`]; `Some(0)` accepts every pending connection, and `None` (the default) accepts at most one connection per server
+    pub fn set_max_accepts_per_update(&mut self, max_accepts: Option<usize>) {
+        self.max_accepts_per_update = max_accepts.map(|max_accepts| match max_accepts {
+            0 => usize::MAX,
+            max_accepts => max_accepts,
+        });
+    }
+
+    /// Set the number of endpoint and client-auth private keys this `Context` generates ahead of time on a background thread. By default the keys needed to complete identity handshakes are generated by [`Context::update()`] as each handshake needs them; with a key pool the handshakes only take keys which are already made, so bursts of completing handshakes do not stall the calling thread. Should a burst exhaust the pool, further keys are generated inline until it is refilled.
+    ///
+    /// # Parameters
+    /// - `pool_size`: the number of keys of each type to keep ready; `0` (the default) disables the key pool and stops its thread
+    pub fn set_key_pool_size(&mut self, pool_size: usize) -> Result<(), Error> {
+        // stop any existing pool first so two refill threads never run at once; the
+        // in-progress handshakes still referencing it fall back to inline generation
+        // once their leftover keys run out
+        if let Some(key_pool) = self.key_pool.take() {
+            key_pool.shutdown();
+        }
+        if pool_size > 0 {
+            self.key_pool = Some(Arc::new(KeyPool::new(pool_size)?));
+        }
+        Ok(())
+    }
+
+    /// Set the number of finished handshakes' honk-rpc message buffers this `Context` keeps for re-use by new handshakes. Every in-progress handshake owns one honk-rpc session, whose heap memory is that session's message buffers: a read buffer plus at most 4 spare read buffers and 16 spare write buffers. A session only grows its buffers up to its maximum message size (the `identity_max_message_size` passed to [`Context::new()`] for identity handshakes and 384 bytes for endpoint handshakes), but identity and endpoint handshakes share one pool, so an endpoint handshake may be handed buffers an identity handshake grew; every buffer is therefore bounded by the larger of the two limits. In practice a handshake exchanges a few small messages and holds a handful of buffers. When a handshake finishes its buffers are returned to the pool rather than freed, so servers handling a steady stream of handshakes re-use the same allocations instead of growing new ones for every connection, while the pool's memory stays bounded by `pool_size` times 21 such buffers.
+    ///
+    /// # Parameters
+    /// - `pool_size`: the number of sessions' buffers to keep; `0` disables re-use, and the default is 64
+    pub fn set_session_pool_size(&mut self, pool_size: usize) {
+        self.session_pool.set_capacity(pool_size);
+    }
+
+    /// Set the maximum number of incoming identity handshakes this `Context` drives at once. Connections accepted while the limit is reached are closed straight away, before any honk-rpc session or cryptography is spent on them, and are counted in [`AdmissionStats::connections_shed`].
+    ///
+    /// # Parameters
+    /// - `max_handshakes`: the maximum number of concurrent incoming identity handshakes; `0` (the default) is unlimited
+    pub fn set_max_identity_server_handshakes(&mut self, max_handshakes: usize) {
+        self.max_identity_server_handshakes = match max_handshakes {
+            0 => usize::MAX,
+            max_handshakes => max_handshakes,
+        };
+    }
+
+    /// Limit the rate at which each identity client may begin identity handshakes with this `Context`. Every client service id gets a token bucket holding up to `burst` handshakes which regains one handshake every `refill_interval`. Handshakes beyond a client's limit fail with [`Error::ClientRateLimited`] as soon as the client has identified itself, before the application is asked about the client, and are counted in [`AdmissionStats::handshakes_rate_limited`].
+    ///
+    /// # Parameters
+    /// - `burst`: the number of handshakes a client may begin at once; `0` (the default) disables rate limiting
+    /// - `refill_interval`: the time it takes a client to regain one handshake
+    pub fn set_identity_client_rate_limit(&mut self, burst: u32, refill_interval: Duration) {
+        self.identity_client_rate_limiter = match burst {
+            0 => None,
+            burst => Some(RateLimiter::new(burst, refill_interval)),
+        };
+    }
+
+    /// Enable or disable early rejection of incoming identity handshakes. By default, handshakes whose client is not allowed or whose requested endpoint is not supported run to completion (challenge, challenge-response and signature verification) before [`ContextEvent::IdentityServerHandshakeRejected`] is returned, so that clients learn nothing from when they are rejected. With early rejection enabled such handshakes are rejected in reply to the client's first request instead, without sending the endpoint challenge passed to [`Context::identity_server_handle_endpoint_request_received()`] or verifying any signatures, and are counted in [`AdmissionStats::handshakes_rejected_early`]. Only handshakes started after this call are affected.
+    pub fn set_identity_server_early_rejection(&mut self, early_rejection: bool) {
+        self.identity_server_early_rejection = early_rejection;
+    }
+
+    /// Get whether early rejection of incoming identity handshakes is enabled, see [`Context::set_identity_server_early_rejection()`].
+    pub fn get_identity_server_early_rejection(&self) -> bool {
+        self.identity_server_early_rejection
+    }
+
+    /// Set the maximum number of endpoint servers this `Context` publishes at once. Every active endpoint server has an onion-service whose descriptor tor keeps uploading, so applications with many contacts may register all of their endpoint servers (see [`Context::endpoint_servers_register()`]) but only activate those likely to be used. Once the limit is reached, activating further endpoint servers deactivates the active endpoint servers with the lowest priority (see [`Context::endpoint_server_set_priority()`]) first, and among those the least recently active. Lowering the limit deactivates endpoint servers in the same order straight away.
+    ///
+    /// # Parameters
+    /// - `max_endpoint_servers`: the maximum number of active endpoint servers; `0` (the default) is unlimited
+    pub fn set_max_published_endpoint_servers(&mut self, max_endpoint_servers: usize) {
+        self.max_published_endpoint_servers = match max_endpoint_servers {
+            0 => usize::MAX,
+            max_endpoint_servers => max_endpoint_servers,
+        };
+
+        let excess = self
+            .endpoint_registry
+            .active_count()
+            .saturating_sub(self.max_published_endpoint_servers);
+        let endpoint_service_ids = self
+            .endpoint_registry
+            .eviction_candidates(excess, |_| false);
+        self.deactivate_endpoint_servers(&endpoint_service_ids);
+    }
+
+    /// Set how long an endpoint server may go without accepting a connection before [`Context::update()`] deactivates it. Activating an endpoint server counts as activity, so a newly activated endpoint server has the whole timeout for its client to connect.
+    ///
+    /// # Parameters
+    /// - `idle_timeout`: the time after which idle endpoint servers are deactivated; `None` (the default) keeps endpoint servers active until they are deactivated or stopped
+    pub fn set_endpoint_server_idle_timeout(&mut self, idle_timeout: Option<Duration>) {
+        self.endpoint_server_idle_timeout = idle_timeout;
+    }
+
+    /// Get the number of incoming identity handshakes this `Context`'s admission control has turned away so far.
+    pub fn identity_server_admission_stats(&self) -> AdmissionStats {
+        self.admission_stats
+    }
+
+    /// Get a snapshot of this `Context`'s counters and latency histograms. Metrics are only recorded when gosling is built with the `metrics` feature, see [`MetricsSnapshot::enabled`]; the in-progress and pending-connect gauges are always filled in.
+    pub fn metrics(&self) -> MetricsSnapshot {
+        // outgoing handshakes are in progress while they wait on their connection
+        let pending_identity_clients = self
+            .pending_connects
+            .values()
+            .filter(|pending_connect| {
+                matches!(pending_connect, PendingConnect::IdentityClient { .. })
+            })
+            .count();
+        let pending_endpoint_clients = self.pending_connects.len() - pending_identity_clients;
+        self.metrics.snapshot(
+            self.identity_clients.len() + pending_identity_clients,
+            self.identity_servers.len(),
+            self.endpoint_clients.len() + pending_endpoint_clients,
+            self.endpoint_servers.len(),
+            self.pending_connects.len(),
+        )
+    }
+
     /// Initiate bootstrap of the `Context`'s owned [`TorProvider`]. Bootstrap status is communicated through [`ContextEvent`]s returned from the [`Context::update()`] method.
     pub fn bootstrap(&mut self) -> Result<(), Error> {
         self.tor_provider.bootstrap()?;
+        self.update_pending = true;
         Ok(())
     }
 
-    /// Initiate an identity handshake with an identity server. Handshake progression is communicated through  [`ContextEvent`]s returned from the [`Context::update()`] method.
+    /// Initiate an identity handshake with an identity server. This function does not block on connecting to the identity server; the connection is established in the background and handshake progression (including any connection failure) is communicated through  [`ContextEvent`]s returned from the [`Context::update()`] method.
     ///
     /// # Parameters
     /// - `identitity_server_id`: the long term identity onion-service service-id of a remote peer
@@ -428,31 +830,29 @@ impl Context {
             return Err(Error::TorNotConnected());
         }
 
-        // open tcp stream to remove ident server
-        let stream: TcpStream = self
-            .tor_provider
-            .connect(
-                (identity_server_id.clone(), self.identity_port).into(),
-                None,
-            )?
-            .into();
-        stream.set_nonblocking(true)?;
-        let mut client_rpc = Session::new(stream);
-        client_rpc.set_max_wait_time(self.identity_timeout);
-        client_rpc.set_max_message_size(self.identity_max_message_size)?;
-
-        let ident_client = IdentityClient::new(
-            client_rpc,
-            identity_server_id,
-            endpoint,
-            self.identity_private_key.clone(),
-            X25519PrivateKey::generate(),
+        // begin opening tcp stream to remote ident server; the handshake
+        // starts once the connection completes in update()
+        let connect_handle = self.tor_provider.connect_async(
+            (identity_server_id.clone(), self.identity_port).into(),
+            None,
         )?;
 
         let handshake_handle = self.next_handshake_handle;
         self.next_handshake_handle += 1;
-        self.identity_clients.insert(handshake_handle, ident_client);
+        self.pending_connects.insert(
+            connect_handle,
+            PendingConnect::IdentityClient {
+                handle: handshake_handle,
+                identity_server_id,
+                endpoint,
+            },
+        );
+        // the connect counts against the handshake's first step
+        self.handshake_timers
+            .arm(handshake_handle, Instant::now() + self.identity_timeout);
+        self.metrics.identity_client.start(handshake_handle);
 
+        self.update_pending = true;
         Ok(handshake_handle)
     }
 
@@ -464,7 +864,17 @@ impl Context {
         &mut self,
         handle: HandshakeHandle,
     ) -> Result<(), Error> {
-        if let Some(_identity_client) = self.identity_clients.remove(&handle) {
+        self.poller_disarm();
+        self.handshake_timers.cancel(handle);
+        let identity_client = self.identity_clients.remove(&handle);
+        if identity_client.is_some() || self.remove_pending_connect(handle).is_some() {
+            self.session_pool.recycle(
+                identity_client
+                    .and_then(|mut identity_client| identity_client.take_session_buffers()),
+            );
+            self.metrics
+                .identity_client
+                .finish(handle, HandshakeOutcome::Aborted);
             Ok(())
         } else {
             Err(Error::HandshakeHandleNotFound(handle))
@@ -483,6 +893,8 @@ impl Context {
     ) -> Result<(), Error> {
         if let Some(identity_client) = self.identity_clients.get_mut(&handle) {
             identity_client.send_response(challenge_response)?;
+            self.metrics.identity_client.application_wait_ended(handle);
+            self.update_pending = true;
             Ok(())
         } else {
             Err(Error::HandshakeHandleNotFound(handle))
@@ -490,27 +902,29 @@ impl Context {
     }
 
     /// Start this `Context`'s identity server. Publish status is communicated through [`ContextEvent`]s returned from the [`Context::update()`] method.
+    ///
+    /// If called before the [`ContextEvent::TorBootstrapCompleted`] event, the identity server is started together with any endpoint servers started in the meantime as one batch once bootstrap completes; any failure to do so is returned from [`Context::update()`].
     pub fn identity_server_start(&mut self) -> Result<(), Error> {
-        if !self.bootstrap_complete {
-            return Err(Error::TorNotConnected());
-        }
-        if self.identity_listener.is_some() {
+        if self.identity_listener.is_some() || self.queued_identity_server {
             return Err(Error::IncorrectUsage(
                 "identity server already started".to_string(),
             ));
         }
 
-        let identity_listener =
-            self.tor_provider
-                .listener(&self.identity_private_key, self.identity_port, None)?;
-        identity_listener.set_nonblocking(true)?;
-
-        self.identity_listener = Some(identity_listener);
-        Ok(())
+        if self.bootstrap_complete {
+            self.start_servers(true, Default::default())
+        } else {
+            self.queued_identity_server = true;
+            Ok(())
+        }
     }
 
     /// Stops this `Context`'s identity server and ends any in-progress incoming identity handshakes.
     pub fn identity_server_stop(&mut self) -> Result<(), Error> {
+        if self.queued_identity_server {
+            self.queued_identity_server = false;
+            return Ok(());
+        }
         if self.identity_listener.is_none() {
             return Err(Error::IncorrectUsage(
                 "identity server is not started".to_string(),
@@ -518,11 +932,19 @@ impl Context {
         }
 
         // clear out current identity listener
+        self.poller_disarm();
         self.identity_listener = None;
         // clear out published flag
         self.identity_server_published = false;
         // clear out any in-process identity handshakes
-        self.identity_servers = Default::default();
+        for handle in std::mem::take(&mut self.identity_servers).into_keys() {
+            self.handshake_timers.cancel(handle);
+            self.metrics
+                .identity_server
+                .finish(handle, HandshakeOutcome::Aborted);
+        }
+        // the TorProvider tears down the onion-service in update()
+        self.update_pending = true;
         Ok(())
     }
 
@@ -532,7 +954,7 @@ impl Context {
     /// - `handle`: the handle of the in-progress incoming identity handshake
     /// - `client_allowed`: whether the connected identity client is allowed to access the requested endpoint
     /// - `endpoint_supported`: whether the requested endpoint is supported
-    /// - `endpoint_challenge`: an application-specific BSON document which the connected identity client must respond to
+    /// - `endpoint_challenge`: an application-specific BSON document which the connected identity client must respond to; ignored when the handshake is rejected early, see [`Context::set_identity_server_early_rejection()`]
     pub fn identity_server_handle_endpoint_request_received(
         &mut self,
         handle: HandshakeHandle,
@@ -541,11 +963,17 @@ impl Context {
         endpoint_challenge: bson::document::Document,
     ) -> Result<(), Error> {
         if let Some(identity_server) = self.identity_servers.get_mut(&handle) {
-            Ok(identity_server.handle_endpoint_request_received(
+            identity_server.handle_endpoint_request_received(
                 client_allowed,
                 endpoint_supported,
                 endpoint_challenge,
-            )?)
+            )?;
+            if identity_server.get_early_rejection() && !(client_allowed && endpoint_supported) {
+                self.admission_stats.handshakes_rejected_early += 1;
+            }
+            self.metrics.identity_server.application_wait_ended(handle);
+            self.update_pending = true;
+            Ok(())
         } else {
             Err(Error::HandshakeHandleNotFound(handle))
         }
@@ -564,13 +992,47 @@ impl Context {
         challenge_response_valid: bool,
     ) -> Result<(), Error> {
         if let Some(identity_server) = self.identity_servers.get_mut(&handle) {
-            Ok(identity_server.handle_challenge_response_received(challenge_response_valid)?)
+            identity_server.handle_challenge_response_received(challenge_response_valid)?;
+            self.metrics.identity_server.application_wait_ended(handle);
+            self.update_pending = true;
+            Ok(())
         } else {
             Err(Error::HandshakeHandleNotFound(handle))
         }
     }
 
-    /// Initiate an endpoint handshake with an identity server. An endpoint client acquires the `endpoint_server_id` and `client_auth_key` by completing an identity handshake or through some other side-channnel. Handshake progression is communicated through [`ContextEvent`]s returned from the [`Context::update()`] method.
+    /// Prepare this `Context` to quickly begin endpoint handshakes with known endpoint servers. The client authorisation credentials of every endpoint server are registered with the underlying [`TorProvider`] in a single batch (see [`TorProvider::add_client_auth_batch()`]), and their onion-service descriptors are fetched in the background (see [`TorProvider::prefetch_descriptors()`]). A later [`Context::endpoint_client_begin_handshake()`] with one of these endpoint servers then need not wait for its descriptor to be fetched.
+    ///
+    /// Descriptors expire, so applications may call this again periodically (e.g. hourly) while a fast first connection to these endpoint servers remains important.
+    ///
+    /// # Parameters
+    /// - `endpoint_servers`: the endpoint onion-service service-ids of remote peers, each with the x25519 private-key required to decrypt its onion-service descriptor
+    pub fn endpoint_client_prewarm(
+        &mut self,
+        endpoint_servers: &[(V3OnionServiceId, X25519PrivateKey)],
+    ) -> Result<(), Error> {
+        if !self.bootstrap_complete {
+            return Err(Error::TorNotConnected());
+        }
+        if endpoint_servers.is_empty() {
+            return Ok(());
+        }
+
+        let client_auths: Vec<(&V3OnionServiceId, &X25519PrivateKey)> = endpoint_servers
+            .iter()
+            .map(|(endpoint_server_id, client_auth_key)| (endpoint_server_id, client_auth_key))
+            .collect();
+        self.tor_provider.add_client_auth_batch(&client_auths)?;
+
+        let service_ids: Vec<&V3OnionServiceId> = endpoint_servers
+            .iter()
+            .map(|(endpoint_server_id, _)| endpoint_server_id)
+            .collect();
+        self.tor_provider.prefetch_descriptors(&service_ids)?;
+        Ok(())
+    }
+
+    /// Initiate an endpoint handshake with an identity server. An endpoint client acquires the `endpoint_server_id` and `client_auth_key` by completing an identity handshake or through some other side-channnel. This function does not block on connecting to the endpoint server; the connection is established in the background and handshake progression (including any connection failure) is communicated through [`ContextEvent`]s returned from the [`Context::update()`] method.
     ///
     /// # Parameters
     /// - `endpoint_server_id`: the endpoint onion-service service-id of a remote peer
@@ -597,30 +1059,29 @@ impl Context {
 
         self.tor_provider
             .add_client_auth(&endpoint_server_id, &client_auth_key)?;
-        let stream: TcpStream = self
-            .tor_provider
-            .connect(
-                (endpoint_server_id.clone(), self.endpoint_port).into(),
-                None,
-            )?
-            .into();
-        stream.set_nonblocking(true)?;
-
-        let mut session = Session::new(stream);
-        session.set_max_wait_time(self.endpoint_timeout);
-        session.set_max_message_size(DEFAULT_ENDPOINT_MAX_MESSAGE_SIZE)?;
-
-        let endpoint_client = EndpointClient::new(
-            session,
-            endpoint_server_id,
-            channel,
-            self.identity_private_key.clone(),
-        );
+        // begin opening tcp stream to remote endpoint server; the handshake
+        // starts once the connection completes in update()
+        let connect_handle = self.tor_provider.connect_async(
+            (endpoint_server_id.clone(), self.endpoint_port).into(),
+            None,
+        )?;
 
         let handshake_handle = self.next_handshake_handle;
         self.next_handshake_handle += 1;
-        self.endpoint_clients
-            .insert(handshake_handle, endpoint_client);
+        self.pending_connects.insert(
+            connect_handle,
+            PendingConnect::EndpointClient {
+                handle: handshake_handle,
+                endpoint_server_id,
+                channel,
+            },
+        );
+        // the connect counts against the handshake's first step
+        self.handshake_timers
+            .arm(handshake_handle, Instant::now() + self.endpoint_timeout);
+        self.metrics.endpoint_client.start(handshake_handle);
+
+        self.update_pending = true;
         Ok(handshake_handle)
     }
 
@@ -632,7 +1093,17 @@ impl Context {
         &mut self,
         handle: HandshakeHandle,
     ) -> Result<(), Error> {
-        if let Some(_endpoint_client) = self.endpoint_clients.remove(&handle) {
+        self.poller_disarm();
+        self.handshake_timers.cancel(handle);
+        let endpoint_client = self.endpoint_clients.remove(&handle);
+        if endpoint_client.is_some() || self.remove_pending_connect(handle).is_some() {
+            self.session_pool.recycle(
+                endpoint_client
+                    .and_then(|mut endpoint_client| endpoint_client.take_session_buffers()),
+            );
+            self.metrics
+                .endpoint_client
+                .finish(handle, HandshakeOutcome::Aborted);
             Ok(())
         } else {
             Err(Error::HandshakeHandleNotFound(handle))
@@ -641,6 +1112,8 @@ impl Context {
 
     /// Start one of this `Context`'s endpoint servers. Publish status is communicated through [`ContextEvent`]s returned from the [`Context::update()`] method.
     ///
+    /// Equivalent to calling [`Context::endpoint_servers_start()`] with a single [`EndpointServerConfig`].
+    ///
     /// # Parameters
     /// - `endpoint_private_key`: the ed25519 private key used to start this endpoint server's onion-service
     /// - `endpoint_name`: the ASCII-encoded endpoint name
@@ -653,36 +1126,360 @@ impl Context {
         client_identity: V3OnionServiceId,
         client_auth: X25519PublicKey,
     ) -> Result<(), Error> {
-        if !self.bootstrap_complete {
-            return Err(Error::TorNotConnected());
+        self.endpoint_servers_start(vec![EndpointServerConfig {
+            endpoint_private_key,
+            endpoint_name,
+            client_identity,
+            client_auth,
+            priority: 0,
+            active: true,
+        }])
+    }
+
+    /// Start several of this `Context`'s endpoint servers at once. The endpoint servers are registered as with [`Context::endpoint_servers_register()`] and activated straight away, whatever their [`EndpointServerConfig::active`]: their onion-services are started with a single batch (see [`TorProvider::listener_batch()`]) and publish status is communicated through [`ContextEvent`]s returned from the [`Context::update()`] method. If any endpoint server fails to start, none are started. As with [`Context::endpoint_servers_activate()`], other active endpoint servers are deactivated to make room should this exceed the maximum set with [`Context::set_max_published_endpoint_servers()`].
+    ///
+    /// If called before the [`ContextEvent::TorBootstrapCompleted`] event, the endpoint servers are started together with the identity server and any other endpoint servers started in the meantime as one batch once bootstrap completes; any failure to do so is returned from [`Context::update()`].
+    ///
+    /// # Parameters
+    /// - `endpoint_servers`: the endpoint servers to start
+    pub fn endpoint_servers_start(
+        &mut self,
+        endpoint_servers: Vec<EndpointServerConfig>,
+    ) -> Result<(), Error> {
+        let endpoint_service_ids = self.register_endpoint_servers(endpoint_servers)?;
+        if let Err(err) = self.activate_endpoint_servers(&endpoint_service_ids, true) {
+            self.unregister_endpoint_servers(&endpoint_service_ids);
+            return Err(err);
+        }
+        Ok(())
+    }
+
+    /// Register several endpoint servers with this `Context`. Registered endpoint servers lie dormant, holding just their keys and no onion-service, until they are activated with [`Context::endpoint_servers_activate()`], so applications with many contacts may register an endpoint server for each of them and only publish those currently in use. Endpoint servers whose [`EndpointServerConfig::active`] is set are activated straight away as with [`Context::endpoint_servers_activate()`], so the endpoint servers returned by [`Context::endpoint_server_configs()`] before a restart are restored with the same priorities and only those which were active are published again. If any endpoint server cannot be registered or activated, none are registered.
+    ///
+    /// # Parameters
+    /// - `endpoint_servers`: the endpoint servers to register
+    pub fn endpoint_servers_register(
+        &mut self,
+        endpoint_servers: Vec<EndpointServerConfig>,
+    ) -> Result<(), Error> {
+        let active: Vec<bool> = endpoint_servers
+            .iter()
+            .map(|endpoint_server| endpoint_server.active)
+            .collect();
+        let endpoint_service_ids = self.register_endpoint_servers(endpoint_servers)?;
+        let active_endpoint_service_ids: Vec<V3OnionServiceId> = endpoint_service_ids
+            .iter()
+            .zip(active)
+            .filter_map(|(endpoint_service_id, active)| active.then(|| endpoint_service_id.clone()))
+            .collect();
+        if let Err(err) = self.activate_endpoint_servers(&active_endpoint_service_ids, false) {
+            self.unregister_endpoint_servers(&endpoint_service_ids);
+            return Err(err);
         }
+        Ok(())
+    }
 
-        let endpoint_public_key = Ed25519PublicKey::from_private_key(&endpoint_private_key);
-        let endpoint_service_id = V3OnionServiceId::from_public_key(&endpoint_public_key);
+    // forget endpoint servers which were just registered
+    fn unregister_endpoint_servers(&mut self, endpoint_service_ids: &[V3OnionServiceId]) {
+        for endpoint_service_id in endpoint_service_ids {
+            self.endpoint_registry.remove(endpoint_service_id);
+        }
+    }
 
-        if endpoint_service_id == self.identity_service_id {
-            return Err(Error::InvalidArgument(
-                "endpoint server must be different from identity server".to_string(),
-            ));
+    // register endpoint servers, returning their service ids
+    fn register_endpoint_servers(
+        &mut self,
+        endpoint_servers: Vec<EndpointServerConfig>,
+    ) -> Result<Vec<V3OnionServiceId>, Error> {
+        let mut endpoint_service_ids: Vec<V3OnionServiceId> =
+            Vec::with_capacity(endpoint_servers.len());
+        let mut unique_service_ids: HashSet<V3OnionServiceId> =
+            HashSet::with_capacity(endpoint_servers.len());
+        for endpoint_server in endpoint_servers.iter() {
+            let endpoint_service_id =
+                V3OnionServiceId::from_private_key(&endpoint_server.endpoint_private_key);
+
+            if endpoint_service_id == self.identity_service_id {
+                return Err(Error::InvalidArgument(
+                    "endpoint server must be different from identity server".to_string(),
+                ));
+            }
+
+            if self.endpoint_registry.contains(&endpoint_service_id)
+                || !unique_service_ids.insert(endpoint_service_id.clone())
+            {
+                return Err(Error::IncorrectUsage(
+                    "endpoint server already registered".to_string(),
+                ));
+            }
+            endpoint_service_ids.push(endpoint_service_id);
         }
 
-        if self.endpoint_listeners.contains_key(&endpoint_service_id) {
-            return Err(Error::IncorrectUsage(
-                "endpoint server already started".to_string(),
+        let now = Instant::now();
+        for (endpoint_server, endpoint_service_id) in endpoint_servers
+            .into_iter()
+            .zip(endpoint_service_ids.iter())
+        {
+            self.endpoint_registry.insert(
+                endpoint_service_id.clone(),
+                endpoint_server.endpoint_private_key,
+                endpoint_server.endpoint_name,
+                endpoint_server.client_identity,
+                endpoint_server.client_auth,
+                endpoint_server.priority,
+                now,
+            );
+        }
+        Ok(endpoint_service_ids)
+    }
+
+    /// Activate several of this `Context`'s registered endpoint servers. Their onion-services are published during the next call to [`Context::update()`], together with those of every other endpoint server activated in the meantime, as a single batch (see [`TorProvider::listener_batch()`]); any failure to do so is returned from [`Context::update()`] and leaves the endpoint servers dormant. Publish status is communicated through [`ContextEvent`]s returned from the [`Context::update()`] method: an endpoint server returns a [`ContextEvent::EndpointServerPublished`] event every time it is activated. Endpoint servers which are already active are left as they are, but count as recently active.
+    ///
+    /// Should activating the endpoint servers exceed the maximum set with [`Context::set_max_published_endpoint_servers()`], other active endpoint servers are deactivated to make room.
+    ///
+    /// If called before the [`ContextEvent::TorBootstrapCompleted`] event, the endpoint servers are published once bootstrap completes as described in [`Context::endpoint_servers_start()`].
+    ///
+    /// # Parameters
+    /// - `endpoint_service_ids`: the onion-service service-ids of the endpoint servers to activate
+    pub fn endpoint_servers_activate(
+        &mut self,
+        endpoint_service_ids: &[V3OnionServiceId],
+    ) -> Result<(), Error> {
+        self.activate_endpoint_servers(endpoint_service_ids, false)
+    }
+
+    // activate endpoint servers, starting their onion-services straight away if
+    // start_now or queueing them for the next update() otherwise
+    fn activate_endpoint_servers(
+        &mut self,
+        endpoint_service_ids: &[V3OnionServiceId],
+        start_now: bool,
+    ) -> Result<(), Error> {
+        let endpoint_service_ids = self.registered_endpoint_servers(endpoint_service_ids)?;
+        if endpoint_service_ids.len() > self.max_published_endpoint_servers {
+            return Err(Error::InvalidArgument(format!(
+                "cannot activate more than {} endpoint servers",
+                self.max_published_endpoint_servers
+            )));
+        }
+
+        let now = Instant::now();
+        let mut start_endpoint_servers: Vec<V3OnionServiceId> = Default::default();
+        let mut queue_endpoint_servers: Vec<V3OnionServiceId> = Default::default();
+        for endpoint_service_id in endpoint_service_ids.iter().copied() {
+            let active = self
+                .endpoint_registry
+                .get(endpoint_service_id)
+                .map_or(false, |endpoint| endpoint.active);
+            if active {
+                self.endpoint_registry.touch(endpoint_service_id, now);
+            } else if start_now
+                && self.bootstrap_complete
+                && !self.removed_endpoint_servers.contains(endpoint_service_id)
+            {
+                start_endpoint_servers.push(endpoint_service_id.clone());
+            } else {
+                queue_endpoint_servers.push(endpoint_service_id.clone());
+            }
+        }
+
+        // make room by deactivating endpoint servers we are not activating
+        let excess = (self.endpoint_registry.active_count()
+            + start_endpoint_servers.len()
+            + queue_endpoint_servers.len())
+        .saturating_sub(self.max_published_endpoint_servers);
+        let evicted_endpoint_servers = self
+            .endpoint_registry
+            .eviction_candidates(excess, |endpoint_service_id| {
+                endpoint_service_ids.contains(endpoint_service_id)
+            });
+
+        self.start_servers(false, &start_endpoint_servers)?;
+
+        for endpoint_service_id in start_endpoint_servers
+            .iter()
+            .chain(queue_endpoint_servers.iter())
+        {
+            self.endpoint_registry
+                .set_active(endpoint_service_id, true, now);
+        }
+        if self.bootstrap_complete && !queue_endpoint_servers.is_empty() {
+            self.update_pending = true;
+        }
+        self.queued_endpoint_servers.extend(queue_endpoint_servers);
+        self.deactivate_endpoint_servers(&evicted_endpoint_servers);
+        Ok(())
+    }
+
+    /// Deactivate several of this `Context`'s endpoint servers, leaving them registered but dormant until they are activated again. Their onion-services are torn down with a single batch during the next call to [`Context::update()`]; any in-progress incoming endpoint handshakes are unaffected.
+    ///
+    /// # Parameters
+    /// - `endpoint_service_ids`: the onion-service service-ids of the endpoint servers to deactivate
+    pub fn endpoint_servers_deactivate(
+        &mut self,
+        endpoint_service_ids: &[V3OnionServiceId],
+    ) -> Result<(), Error> {
+        self.registered_endpoint_servers(endpoint_service_ids)?;
+        self.deactivate_endpoint_servers(endpoint_service_ids);
+        Ok(())
+    }
+
+    /// Set the priority of one of this `Context`'s endpoint servers. When active endpoint servers must be deactivated to respect the maximum set with [`Context::set_max_published_endpoint_servers()`], those with the lowest priority are deactivated first. Endpoint servers are registered with priority `0`.
+    ///
+    /// # Parameters
+    /// - `endpoint_service_id`: the onion-service service-id of the endpoint server
+    /// - `priority`: the endpoint server's new priority
+    pub fn endpoint_server_set_priority(
+        &mut self,
+        endpoint_service_id: &V3OnionServiceId,
+        priority: u32,
+    ) -> Result<(), Error> {
+        if self
+            .endpoint_registry
+            .set_priority(endpoint_service_id, priority)
+        {
+            Ok(())
+        } else {
+            Err(Error::InvalidArgument(format!(
+                "endpoint server with service id {} not found",
+                endpoint_service_id
+            )))
+        }
+    }
+
+    /// Returns whether one of this `Context`'s endpoint servers is active, i.e. published or about to be.
+    ///
+    /// # Parameters
+    /// - `endpoint_service_id`: the onion-service service-id of the endpoint server
+    pub fn endpoint_server_is_active(
+        &self,
+        endpoint_service_id: &V3OnionServiceId,
+    ) -> Result<bool, Error> {
+        match self.endpoint_registry.get(endpoint_service_id) {
+            Some(endpoint) => Ok(endpoint.active),
+            None => Err(Error::InvalidArgument(format!(
+                "endpoint server with service id {} not found",
+                endpoint_service_id
+            ))),
+        }
+    }
+
+    /// Returns the configurations of this `Context`'s registered endpoint servers, both active and dormant, which may be persisted by the application and restored after a restart with [`Context::endpoint_servers_register()`].
+    pub fn endpoint_server_configs(&self) -> Vec<EndpointServerConfig> {
+        self.endpoint_registry
+            .values()
+            .map(|endpoint| EndpointServerConfig {
+                endpoint_private_key: endpoint.endpoint_private_key.clone(),
+                endpoint_name: endpoint.endpoint_name.to_string(),
+                client_identity: endpoint.client_identity.clone(),
+                client_auth: endpoint.client_auth.clone(),
+                priority: endpoint.priority,
+                active: endpoint.active,
+            })
+            .collect()
+    }
+
+    // dedupe the given endpoint servers, failing if any is not registered
+    fn registered_endpoint_servers<'a>(
+        &self,
+        endpoint_service_ids: &'a [V3OnionServiceId],
+    ) -> Result<HashSet<&'a V3OnionServiceId>, Error> {
+        let mut registered: HashSet<&V3OnionServiceId> =
+            HashSet::with_capacity(endpoint_service_ids.len());
+        for endpoint_service_id in endpoint_service_ids {
+            if !self.endpoint_registry.contains(endpoint_service_id) {
+                return Err(Error::InvalidArgument(format!(
+                    "endpoint server with service id {} not found",
+                    endpoint_service_id
+                )));
+            }
+            registered.insert(endpoint_service_id);
+        }
+        Ok(registered)
+    }
+
+    // make active endpoint servers dormant; the TorProvider tears down their
+    // onion-services in the next update()
+    fn deactivate_endpoint_servers(&mut self, endpoint_service_ids: &[V3OnionServiceId]) {
+        self.poller_disarm();
+        let now = Instant::now();
+        let mut dequeue = false;
+        for endpoint_service_id in endpoint_service_ids {
+            self.endpoint_registry
+                .set_active(endpoint_service_id, false, now);
+            if let Some(_listener) = self.endpoint_listeners.remove(endpoint_service_id) {
+                self.removed_endpoint_servers
+                    .insert(endpoint_service_id.clone());
+                self.update_pending = true;
+            } else {
+                dequeue = true;
+            }
+        }
+        if dequeue {
+            let endpoint_registry = &self.endpoint_registry;
+            self.queued_endpoint_servers.retain(|endpoint_service_id| {
+                endpoint_registry
+                    .get(endpoint_service_id)
+                    .map_or(false, |endpoint| endpoint.active)
+            });
+        }
+    }
+
+    // start the identity server and/or endpoint servers' onion-services with a single batch
+    fn start_servers(
+        &mut self,
+        identity_server: bool,
+        endpoint_service_ids: &[V3OnionServiceId],
+    ) -> Result<(), Error> {
+        if !identity_server && endpoint_service_ids.is_empty() {
+            return Ok(());
+        }
+        // the new listeners may replace registered ones
+        self.poller_disarm();
+
+        let endpoint_servers: Vec<_> = endpoint_service_ids
+            .iter()
+            .filter_map(|endpoint_service_id| {
+                self.endpoint_registry
+                    .get(endpoint_service_id)
+                    .map(|endpoint| (endpoint_service_id, endpoint))
+            })
+            .collect();
+        let client_auths: Vec<[X25519PublicKey; 1]> = endpoint_servers
+            .iter()
+            .map(|(_, endpoint)| [endpoint.client_auth.clone()])
+            .collect();
+        let mut listeners: Vec<(&Ed25519PrivateKey, u16, Option<&[X25519PublicKey]>)> =
+            Vec::with_capacity(endpoint_servers.len() + 1);
+        if identity_server {
+            listeners.push((&self.identity_private_key, self.identity_port, None));
+        }
+        for ((_, endpoint), client_auth) in endpoint_servers.iter().zip(client_auths.iter()) {
+            listeners.push((
+                &endpoint.endpoint_private_key,
+                self.endpoint_port,
+                Some(&client_auth[..]),
             ));
         }
 
-        let endpoint_listener = self.tor_provider.listener(
-            &endpoint_private_key,
-            self.endpoint_port,
-            Some(&[client_auth]),
-        )?;
-        endpoint_listener.set_nonblocking(true)?;
+        let mut listeners = self.tor_provider.listener_batch(&listeners)?.into_iter();
+        for listener in listeners.as_slice() {
+            listener.set_nonblocking(true)?;
+        }
 
-        self.endpoint_listeners.insert(
-            endpoint_service_id,
-            (endpoint_name, client_identity, endpoint_listener, false),
-        );
+        if identity_server {
+            self.identity_listener = listeners.next();
+        }
+        for ((endpoint_service_id, _), listener) in endpoint_servers.into_iter().zip(listeners) {
+            self.endpoint_listeners.insert(
+                endpoint_service_id.clone(),
+                EndpointListener {
+                    listener,
+                    published: false,
+                },
+            );
+        }
+        self.update_pending = true;
         Ok(())
     }
 
@@ -697,13 +1494,16 @@ impl Context {
         channel_supported: bool,
     ) -> Result<(), Error> {
         if let Some(endpoint_server) = self.endpoint_servers.get_mut(&handle) {
-            Ok(endpoint_server.handle_channel_request_received(channel_supported)?)
+            endpoint_server.handle_channel_request_received(channel_supported)?;
+            self.metrics.endpoint_server.application_wait_ended(handle);
+            self.update_pending = true;
+            Ok(())
         } else {
             Err(Error::HandshakeHandleNotFound(handle))
         }
     }
 
-    /// Stop one of this `Context`'s endpoint servers and ends any of its in-progress incoming endpoint handshakes.
+    /// Stop one of this `Context`'s endpoint servers and ends any of its in-progress incoming endpoint handshakes. Unlike [`Context::endpoint_servers_deactivate()`], the endpoint server is also unregistered.
     ///
     /// # Parameters
     /// - `endpoint_identity`: the onion-service service-id of the enpdoint server to stop
@@ -711,11 +1511,9 @@ impl Context {
         &mut self,
         endpoint_identity: V3OnionServiceId,
     ) -> Result<(), Error> {
-        if !self.bootstrap_complete {
-            return Err(Error::TorNotConnected());
-        }
-
-        if let Some(_listener) = self.endpoint_listeners.remove(&endpoint_identity) {
+        if self.endpoint_registry.contains(&endpoint_identity) {
+            self.deactivate_endpoint_servers(std::slice::from_ref(&endpoint_identity));
+            self.endpoint_registry.remove(&endpoint_identity);
             Ok(())
         } else {
             Err(Error::InvalidArgument(format!(
@@ -725,11 +1523,146 @@ impl Context {
         }
     }
 
+    // remove the in-flight connect associated with an outgoing handshake
+    fn remove_pending_connect(&mut self, handle: HandshakeHandle) -> Option<PendingConnect> {
+        let connect_handle = self
+            .pending_connects
+            .iter()
+            .find(|(_connect_handle, pending_connect)| pending_connect.handle() == handle)
+            .map(|(connect_handle, _pending_connect)| *connect_handle)?;
+        self.pending_connects.remove(&connect_handle)
+    }
+
+    // start the outgoing handshake waiting on a newly established connection
+    fn pending_connect_handle_complete(
+        &mut self,
+        pending_connect: PendingConnect,
+        stream: OnionStream,
+        now: Instant,
+    ) -> Option<ContextEvent> {
+        let stream: TcpStream = stream.into();
+        match pending_connect {
+            PendingConnect::IdentityClient {
+                handle,
+                identity_server_id,
+                endpoint,
+            } => match self.identity_client_handle_connect(stream, identity_server_id, endpoint) {
+                Ok(identity_client) => {
+                    self.identity_clients.insert(handle, identity_client);
+                    self.handshake_timers
+                        .arm(handle, now + self.identity_timeout);
+                    self.metrics.identity_client.connected(handle);
+                    None
+                }
+                Err(reason) => {
+                    self.handshake_timers.cancel(handle);
+                    self.metrics
+                        .identity_client
+                        .finish(handle, HandshakeOutcome::Failed);
+                    Some(ContextEvent::IdentityClientHandshakeFailed { handle, reason })
+                }
+            },
+            PendingConnect::EndpointClient {
+                handle,
+                endpoint_server_id,
+                channel,
+            } => match self.endpoint_client_handle_connect(stream, endpoint_server_id, channel) {
+                Ok(endpoint_client) => {
+                    self.endpoint_clients.insert(handle, endpoint_client);
+                    self.handshake_timers
+                        .arm(handle, now + self.endpoint_timeout);
+                    self.metrics.endpoint_client.connected(handle);
+                    None
+                }
+                Err(reason) => {
+                    self.handshake_timers.cancel(handle);
+                    self.metrics
+                        .endpoint_client
+                        .finish(handle, HandshakeOutcome::Failed);
+                    Some(ContextEvent::EndpointClientHandshakeFailed { handle, reason })
+                }
+            },
+        }
+    }
+
+    // signal the failure of the outgoing handshake waiting on a failed (or timed
+    // out) connection
+    fn pending_connect_handle_failed(
+        pending_connect: PendingConnect,
+        error: tor_interface::tor_provider::Error,
+        outcome: HandshakeOutcome,
+        metrics: &mut Metrics,
+    ) -> ContextEvent {
+        match pending_connect {
+            PendingConnect::IdentityClient { handle, .. } => {
+                metrics.identity_client.finish(handle, outcome);
+                ContextEvent::IdentityClientHandshakeFailed {
+                    handle,
+                    reason: error.into(),
+                }
+            }
+            PendingConnect::EndpointClient { handle, .. } => {
+                metrics.endpoint_client.finish(handle, outcome);
+                ContextEvent::EndpointClientHandshakeFailed {
+                    handle,
+                    reason: error.into(),
+                }
+            }
+        }
+    }
+
+    fn identity_client_handle_connect(
+        &mut self,
+        stream: TcpStream,
+        identity_server_id: V3OnionServiceId,
+        endpoint: AsciiString,
+    ) -> Result<IdentityClient, Error> {
+        stream.set_nonblocking(true)?;
+        let mut client_rpc = Session::with_buffers(stream, self.session_pool.take());
+        client_rpc.set_max_wait_time(self.identity_timeout);
+        client_rpc.set_external_read_timeout(true);
+        client_rpc.set_max_message_size(self.identity_max_message_size)?;
+
+        Ok(IdentityClient::new(
+            client_rpc,
+            identity_server_id,
+            endpoint,
+            self.identity_private_key.clone(),
+            match &self.key_pool {
+                Some(key_pool) => key_pool.take_x25519_private_key(),
+                None => X25519PrivateKey::generate(),
+            },
+        )?)
+    }
+
+    fn endpoint_client_handle_connect(
+        &mut self,
+        stream: TcpStream,
+        endpoint_server_id: V3OnionServiceId,
+        channel: AsciiString,
+    ) -> Result<EndpointClient, Error> {
+        stream.set_nonblocking(true)?;
+        let mut session = Session::with_buffers(stream, self.session_pool.take());
+        session.set_max_wait_time(self.endpoint_timeout);
+        session.set_external_read_timeout(true);
+        session.set_max_message_size(DEFAULT_ENDPOINT_MAX_MESSAGE_SIZE)?;
+
+        Ok(EndpointClient::new(
+            session,
+            endpoint_server_id,
+            channel,
+            self.identity_private_key.clone(),
+        ))
+    }
+
     fn identity_server_handle_accept(
         identity_listener: &OnionListener,
         identity_timeout: Duration,
         identity_max_message_size: i32,
         identity_private_key: &Ed25519PrivateKey,
+        key_pool: Option<&Arc<KeyPool>>,
+        early_rejection: bool,
+        session_pool: &mut SessionPool,
     ) -> Result<Option<IdentityServer>, Error> {
         if let Some(stream) = identity_listener.accept()? {
             let stream: TcpStream = stream.into();
@@ -737,11 +1670,14 @@ impl Context {
                 return Ok(None);
             }
 
-            let mut server_rpc = Session::new(stream);
+            let mut server_rpc = Session::with_buffers(stream, session_pool.take());
             server_rpc.set_max_wait_time(identity_timeout);
+            server_rpc.set_external_read_timeout(true);
             server_rpc.set_max_message_size(identity_max_message_size)?;
             let service_id = V3OnionServiceId::from_private_key(identity_private_key);
-            let identity_server = IdentityServer::new(server_rpc, service_id);
+            let mut identity_server = IdentityServer::new(server_rpc, service_id);
+            identity_server.set_key_pool(key_pool.cloned());
+            identity_server.set_early_rejection(early_rejection);
 
             Ok(Some(identity_server))
         } else {
@@ -754,6 +1690,7 @@ impl Context {
         endpoint_timeout: Duration,
         client_service_id: &V3OnionServiceId,
         endpoint_service_id: &V3OnionServiceId,
+        session_pool: &mut SessionPool,
     ) -> Result<Option<EndpointServer>, Error> {
         if let Some(stream) = endpoint_listener.accept()? {
             let stream: TcpStream = stream.into();
@@ -761,8 +1698,9 @@ impl Context {
                 return Ok(None);
             }
 
-            let mut server_rpc = Session::new(stream);
+            let mut server_rpc = Session::with_buffers(stream, session_pool.take());
             server_rpc.set_max_wait_time(endpoint_timeout);
+            server_rpc.set_external_read_timeout(true);
             server_rpc.set_max_message_size(DEFAULT_ENDPOINT_MAX_MESSAGE_SIZE)?;
 
             let endpoint_server = EndpointServer::new(
@@ -796,55 +1734,57 @@ impl Context {
         self.tor_provider.release_token(circuit_token)
     }
 
-    /// This function updates the `Context`'s underlying [`TorProvider`], handles new handshakes requests, and updates in-progress handshakes. This function needs to be regularly called to process the returned [`ContextEvent`]s.
+    /// This function updates the `Context`'s underlying [`TorProvider`], handles new handshakes requests, and updates in-progress handshakes. This function needs to be regularly called to process the returned [`ContextEvent`]s; use [`Context::wait_events()`] to block between calls until there is something to process.
     pub fn update(&mut self) -> Result<VecDeque<ContextEvent>, Error> {
+        trace_scope!("gosling::Context::update");
+        let update_stopwatch = Stopwatch::start();
+        self.update_pending = false;
+        self.poller_disarm();
+
+        // every deadline in this update is measured against the same instant
+        let now = Instant::now();
+
+        // start the servers queued before bootstrap completed during a previous update; the
+        // update returning ContextEvent::TorBootstrapCompleted always schedules another, and
+        // doing so here means a failure cannot swallow that update's events
+        if self.bootstrap_complete {
+            let identity_server = std::mem::take(&mut self.queued_identity_server);
+            // endpoint servers whose previous onion-service is still being torn down wait
+            // for the TorProvider::update() below
+            let (endpoint_servers, queued_endpoint_servers): (Vec<_>, Vec<_>) =
+                std::mem::take(&mut self.queued_endpoint_servers)
+                    .into_iter()
+                    .partition(|endpoint_service_id| {
+                        !self.removed_endpoint_servers.contains(endpoint_service_id)
+                    });
+            self.queued_endpoint_servers = queued_endpoint_servers;
+            if let Err(err) = self.start_servers(identity_server, &endpoint_servers) {
+                for endpoint_service_id in endpoint_servers.iter() {
+                    self.endpoint_registry
+                        .set_active(endpoint_service_id, false, now);
+                }
+                return Err(err);
+            }
+        }
+
         // events to return
         let mut events: VecDeque<ContextEvent> = Default::default();
 
-        // first handle new identity connections
-        if let Some(identity_listener) = &self.identity_listener {
-            match Self::identity_server_handle_accept(
-                identity_listener,
-                self.identity_timeout,
-                self.identity_max_message_size,
-                &self.identity_private_key,
-            ) {
-                Ok(Some(identity_server)) => {
-                    let handle = self.next_handshake_handle;
-                    self.next_handshake_handle += 1;
-                    self.identity_servers.insert(handle, identity_server);
-                    events.push_back(ContextEvent::IdentityServerHandshakeStarted { handle });
-                }
-                Ok(None) => {}
-                // identity listener failed, remove it
-                // TODO: signal caller identity listener is down
-                Err(_) => self.identity_listener = None,
-            }
+        // first handle new identity and endpoint connections
+        let accept_stopwatch = Stopwatch::start();
+        let accept_budget_spent = self.accept_connections(&mut events, now);
+        accept_stopwatch.record(&self.metrics.accept);
+        if accept_budget_spent {
+            self.metrics.accept_budget_exhausted.increment();
         }
 
-        // next handle new endpoint connections
-        self.endpoint_listeners.retain(
-            |endpoint_service_id, (_endpoint_name, allowed_client, listener, _published)| -> bool {
-                match Self::endpoint_server_handle_accept(
-                    listener,
-                    self.endpoint_timeout,
-                    allowed_client,
-                    endpoint_service_id,
-                ) {
-                    Ok(Some(endpoint_server)) => {
-                        let handle = self.next_handshake_handle;
-                        self.next_handshake_handle += 1;
-                        self.endpoint_servers.insert(handle, endpoint_server);
-                        events.push_back(ContextEvent::EndpointServerHandshakeStarted { handle });
-                        true
-                    }
-                    Ok(None) => true,
-                    // endpoint listener failed, remove it
-                    // TODO: signal caller endpoint listener is down
-                    Err(_) => false,
-                }
-            },
-        );
+        // unpublish endpoint servers which have not accepted a connection for too long
+        if let Some(idle_timeout) = self.endpoint_server_idle_timeout {
+            let idle_endpoint_servers =
+                self.endpoint_registry
+                    .idle(self.endpoint_listeners.keys(), now, idle_timeout);
+            self.deactivate_endpoint_servers(&idle_endpoint_servers);
+        }
 
         // consume tor events
         // TODO: so curently the only failure mode of this function is a result of the
@@ -855,7 +1795,17 @@ impl Context {
         // the response) and a failure to read async events which is either again a parsing
         // bug on our end or a malformed/buggy tor daemon which we also cannot recover
         // from.
-        for event in self.tor_provider.update()?.drain(..) {
+        let mut tor_events = {
+            trace_scope!("gosling::TorProvider::update");
+            let stopwatch = Stopwatch::start();
+            let tor_events = self.tor_provider.update()?;
+            stopwatch.record(&self.metrics.tor_provider_update);
+            tor_events
+        };
+        // the onion-services of deactivated endpoint servers are now torn down, so any
+        // activated again in the meantime may be started by the next update
+        self.removed_endpoint_servers.clear();
+        for event in tor_events.drain(..) {
             match event {
                 TorEvent::BootstrapStatus {
                     progress,
@@ -881,32 +1831,73 @@ impl Context {
                             events.push_back(ContextEvent::IdentityServerPublished);
                             self.identity_server_published = true;
                         }
-                    } else if let Some((endpoint_name, _, _, published)) =
-                        self.endpoint_listeners.get_mut(&service_id)
-                    {
+                    } else if let (Some(endpoint_listener), Some(endpoint)) = (
+                        self.endpoint_listeners.get_mut(&service_id),
+                        self.endpoint_registry.get(&service_id),
+                    ) {
                         // ingore duplicate publish events
-                        if !*published {
+                        if !endpoint_listener.published {
                             events.push_back(ContextEvent::EndpointServerPublished {
                                 endpoint_service_id: service_id,
-                                endpoint_name: endpoint_name.clone(),
+                                endpoint_name: endpoint.endpoint_name.to_string(),
                             });
-                            *published = true;
+                            endpoint_listener.published = true;
+                        }
+                    }
+                }
+                TorEvent::ConnectComplete { handle, stream } => {
+                    // connects for aborted handshakes are simply dropped
+                    if let Some(pending_connect) = self.pending_connects.remove(&handle) {
+                        if let Some(event) =
+                            self.pending_connect_handle_complete(pending_connect, stream, now)
+                        {
+                            events.push_back(event);
                         }
                     }
                 }
+                TorEvent::ConnectFailed { handle, error } => {
+                    if let Some(pending_connect) = self.pending_connects.remove(&handle) {
+                        self.handshake_timers.cancel(pending_connect.handle());
+                        events.push_back(Self::pending_connect_handle_failed(
+                            pending_connect,
+                            error,
+                            HandshakeOutcome::Failed,
+                            &mut self.metrics,
+                        ));
+                    }
+                }
             }
         }
 
         // update the ident client handshakes
+        let mut identity_client_updates = Self::update_handshakes(
+            self.identity_clients.values_mut(),
+            &self.handshake_workers,
+            |identity_client| {
+                self.metrics.identity_client.step(
+                    identity_client,
+                    IdentityClient::get_session,
+                    IdentityClient::update,
+                )
+            },
+        )
+        .into_iter();
         self.identity_clients
             .retain(|handle, identity_client| -> bool {
                 let handle = *handle;
-                match identity_client.update() {
+                let result = match identity_client_updates.next() {
+                    Some(result) => result,
+                    None => unreachable!(),
+                };
+                let retain = match result {
                     Ok(Some(IdentityClientEvent::ChallengeReceived { endpoint_challenge })) => {
                         events.push_back(ContextEvent::IdentityClientChallengeReceived {
                             handle,
                             endpoint_challenge,
                         });
+                        self.metrics
+                            .identity_client
+                            .application_wait_started(handle);
                         true
                     }
                     Ok(Some(IdentityClientEvent::HandshakeCompleted {
@@ -922,6 +1913,9 @@ impl Context {
                             endpoint_name,
                             client_auth_private_key,
                         });
+                        self.metrics
+                            .identity_client
+                            .finish(handle, HandshakeOutcome::Completed);
                         false
                     }
                     Err(err) => {
@@ -929,27 +1923,145 @@ impl Context {
                             handle,
                             reason: err.into(),
                         });
+                        self.metrics
+                            .identity_client
+                            .finish(handle, HandshakeOutcome::Failed);
                         false
                     }
                     Ok(None) => true,
+                };
+                if !retain {
+                    self.session_pool
+                        .recycle(identity_client.take_session_buffers());
                 }
+                Self::handshake_timer_update(
+                    &mut self.handshake_timers,
+                    handle,
+                    retain,
+                    identity_client.get_session_mut(),
+                    now + self.identity_timeout,
+                )
             });
 
-        // update the ident server handshakes
+        // update the ident server handshakes' sessions
+        let identity_server_sessions = Self::update_handshakes(
+            self.identity_servers.values_mut(),
+            &self.handshake_workers,
+            |identity_server| {
+                self.metrics.identity_server.step(
+                    identity_server,
+                    IdentityServer::get_session,
+                    IdentityServer::update_session,
+                )
+            },
+        );
+
+        // verify the signatures of every challenge response received above in a
+        // single batch; if the batch fails, each handshake verifies its own
+        // signatures so we can still tell which handshake they belonged to
+        let signatures_valid = {
+            trace_scope!("gosling::Context::verify_signatures");
+            let pending_signatures: Vec<_> = self
+                .identity_servers
+                .values()
+                .zip(identity_server_sessions.iter())
+                .filter(|(_identity_server, session)| session.is_ok())
+                .flat_map(|(identity_server, _session)| identity_server.pending_signatures())
+                .collect();
+            if pending_signatures.is_empty() {
+                false
+            } else {
+                // split the batch between the worker threads
+                let threads = self
+                    .handshake_workers
+                    .threads()
+                    .min(pending_signatures.len() / MIN_SIGNATURES_PER_WORKER_THREAD)
+                    .max(1);
+                let stopwatch = Stopwatch::start();
+                let signatures_valid = self
+                    .handshake_workers
+                    .map(
+                        pending_signatures
+                            .chunks((pending_signatures.len() + threads - 1) / threads)
+                            .collect(),
+                        threads,
+                        Ed25519Signature::verify_batch,
+                    )
+                    .into_iter()
+                    .all(|signatures_valid| signatures_valid);
+                stopwatch.record(&self.metrics.signature_verification);
+                signatures_valid
+            }
+        };
+        if signatures_valid {
+            for (identity_server, session) in self
+                .identity_servers
+                .values_mut()
+                .zip(identity_server_sessions.iter())
+            {
+                if session.is_ok() {
+                    identity_server.pending_signatures_verified();
+                }
+            }
+        }
+
+        // advance the ident server handshakes whose sessions are still healthy
+        let mut identity_server_updates = Self::update_handshakes(
+            self.identity_servers
+                .values_mut()
+                .zip(identity_server_sessions.iter())
+                .filter_map(|(identity_server, session)| {
+                    session.is_ok().then_some(identity_server)
+                }),
+            &self.handshake_workers,
+            |identity_server| identity_server.next_event(),
+        )
+        .into_iter();
+        let mut identity_server_sessions = identity_server_sessions.into_iter();
         self.identity_servers
             .retain(|handle, identity_server| -> bool {
                 let handle = *handle;
-                match identity_server.update() {
+                let result = match identity_server_sessions.next() {
+                    Some(Ok(())) => match identity_server_updates.next() {
+                        Some(result) => result,
+                        None => unreachable!(),
+                    },
+                    Some(Err(err)) => Err(err),
+                    None => unreachable!(),
+                };
+                let retain = match result {
                     Ok(Some(IdentityServerEvent::EndpointRequestReceived {
                         client_service_id,
                         requested_endpoint,
                     })) => {
-                        events.push_back(ContextEvent::IdentityServerEndpointRequestReceived {
-                            handle,
-                            client_service_id,
-                            requested_endpoint: requested_endpoint.to_string(),
-                        });
-                        true
+                        let rate_limited = match &mut self.identity_client_rate_limiter {
+                            Some(rate_limiter) => {
+                                !rate_limiter.try_acquire(&client_service_id, now)
+                            }
+                            None => false,
+                        };
+                        if rate_limited {
+                            self.admission_stats.handshakes_rate_limited += 1;
+                            events.push_back(ContextEvent::IdentityServerHandshakeFailed {
+                                handle,
+                                reason: Error::ClientRateLimited(client_service_id),
+                            });
+                            self.metrics
+                                .identity_server
+                                .finish(handle, HandshakeOutcome::Failed);
+                            false
+                        } else {
+                            events.push_back(ContextEvent::IdentityServerEndpointRequestReceived {
+                                handle,
+                                client_service_id,
+                                requested_endpoint: requested_endpoint.to_string(),
+                                early_rejection: identity_server.get_early_rejection(),
+                            });
+                            self.metrics
+                                .identity_server
+                                .application_wait_started(handle);
+                            true
+                        }
                     }
                     Ok(Some(IdentityServerEvent::ChallengeResponseReceived {
                         challenge_response,
@@ -958,6 +2070,9 @@ impl Context {
                             handle,
                             challenge_response,
                         });
+                        self.metrics
+                            .identity_server
+                            .application_wait_started(handle);
                         true
                     }
                     Ok(Some(IdentityServerEvent::HandshakeCompleted {
@@ -973,6 +2088,9 @@ impl Context {
                             client_service_id,
                             client_auth_public_key,
                         });
+                        self.metrics
+                            .identity_server
+                            .finish(handle, HandshakeOutcome::Completed);
                         false
                     }
                     Ok(Some(IdentityServerEvent::HandshakeRejected {
@@ -990,6 +2108,9 @@ impl Context {
                             client_auth_signature_valid,
                             challenge_response_valid,
                         });
+                        self.metrics
+                            .identity_server
+                            .finish(handle, HandshakeOutcome::Rejected);
                         false
                     }
                     Err(err) => {
@@ -997,17 +2118,47 @@ impl Context {
                             handle,
                             reason: err.into(),
                         });
+                        self.metrics
+                            .identity_server
+                            .finish(handle, HandshakeOutcome::Failed);
                         false
                     }
                     Ok(None) => true,
+                };
+                if !retain {
+                    self.session_pool
+                        .recycle(identity_server.take_session_buffers());
                 }
+                Self::handshake_timer_update(
+                    &mut self.handshake_timers,
+                    handle,
+                    retain,
+                    identity_server.get_session_mut(),
+                    now + self.identity_timeout,
+                )
             });
 
         // update the endpoint client handshakes
+        let mut endpoint_client_updates = Self::update_handshakes(
+            self.endpoint_clients.values_mut(),
+            &self.handshake_workers,
+            |endpoint_client| {
+                self.metrics.endpoint_client.step(
+                    endpoint_client,
+                    EndpointClient::get_session,
+                    EndpointClient::update,
+                )
+            },
+        )
+        .into_iter();
         self.endpoint_clients
             .retain(|handle, endpoint_client| -> bool {
                 let handle = *handle;
-                match endpoint_client.update() {
+                let result = match endpoint_client_updates.next() {
+                    Some(result) => result,
+                    None => unreachable!(),
+                };
+                let retain = match result {
                     Ok(Some(EndpointClientEvent::HandshakeCompleted { stream })) => {
                         events.push_back(ContextEvent::EndpointClientHandshakeCompleted {
                             handle,
@@ -1015,6 +2166,9 @@ impl Context {
                             channel_name: endpoint_client.requested_channel.to_string(),
                             stream,
                         });
+                        self.metrics
+                            .endpoint_client
+                            .finish(handle, HandshakeOutcome::Completed);
                         false
                     }
                     Err(err) => {
@@ -1022,17 +2176,47 @@ impl Context {
                             handle,
                             reason: err.into(),
                         });
+                        self.metrics
+                            .endpoint_client
+                            .finish(handle, HandshakeOutcome::Failed);
                         false
                     }
                     Ok(None) => true,
+                };
+                if !retain {
+                    self.session_pool
+                        .recycle(endpoint_client.take_session_buffers());
                 }
+                Self::handshake_timer_update(
+                    &mut self.handshake_timers,
+                    handle,
+                    retain,
+                    endpoint_client.get_session_mut(),
+                    now + self.endpoint_timeout,
+                )
             });
 
         // update the endpoint server handshakes
+        let mut endpoint_server_updates = Self::update_handshakes(
+            self.endpoint_servers.values_mut(),
+            &self.handshake_workers,
+            |endpoint_server| {
+                self.metrics.endpoint_server.step(
+                    endpoint_server,
+                    EndpointServer::get_session,
+                    EndpointServer::update,
+                )
+            },
+        )
+        .into_iter();
         self.endpoint_servers
             .retain(|handle, endpoint_server| -> bool {
                 let handle = *handle;
-                match endpoint_server.update() {
+                let result = match endpoint_server_updates.next() {
+                    Some(result) => result,
+                    None => unreachable!(),
+                };
+                let retain = match result {
                     Ok(Some(EndpointServerEvent::ChannelRequestReceived {
                         requested_channel,
                         client_service_id,
@@ -1042,6 +2226,9 @@ impl Context {
                             client_service_id,
                             requested_channel: requested_channel.to_string(),
                         });
+                        self.metrics
+                            .endpoint_server
+                            .application_wait_started(handle);
                         true
                     }
                     Ok(Some(EndpointServerEvent::HandshakeCompleted {
@@ -1056,6 +2243,9 @@ impl Context {
                             channel_name: channel_name.to_string(),
                             stream,
                         });
+                        self.metrics
+                            .endpoint_server
+                            .finish(handle, HandshakeOutcome::Completed);
                         false
                     }
                     Ok(Some(EndpointServerEvent::HandshakeRejected {
@@ -1069,6 +2259,9 @@ impl Context {
                             client_requested_channel_valid,
                             client_proof_signature_valid,
                         });
+                        self.metrics
+                            .endpoint_server
+                            .finish(handle, HandshakeOutcome::Rejected);
                         false
                     }
                     Err(err) => {
@@ -1076,12 +2269,435 @@ impl Context {
                             handle,
                             reason: err.into(),
                         });
+                        self.metrics
+                            .endpoint_server
+                            .finish(handle, HandshakeOutcome::Failed);
                         false
                     }
                     Ok(None) => true,
+                };
+                if !retain {
+                    self.session_pool
+                        .recycle(endpoint_server.take_session_buffers());
                 }
+                Self::handshake_timer_update(
+                    &mut self.handshake_timers,
+                    handle,
+                    retain,
+                    endpoint_server.get_session_mut(),
+                    now + self.endpoint_timeout,
+                )
             });
 
+        // fail the handshakes whose peers have gone quiet for too long
+        for handle in self.handshake_timers.expire(now) {
+            if let Some(mut identity_client) = self.identity_clients.remove(&handle) {
+                self.session_pool
+                    .recycle(identity_client.take_session_buffers());
+                let timed_out =
+                    honk_rpc::honk_rpc::Error::MessageReadTimedOut(self.identity_timeout);
+                events.push_back(ContextEvent::IdentityClientHandshakeFailed {
+                    handle,
+                    reason: identity_client::Error::from(timed_out).into(),
+                });
+                self.metrics
+                    .identity_client
+                    .finish(handle, HandshakeOutcome::TimedOut);
+            } else if let Some(mut identity_server) = self.identity_servers.remove(&handle) {
+                self.session_pool
+                    .recycle(identity_server.take_session_buffers());
+                let timed_out =
+                    honk_rpc::honk_rpc::Error::MessageReadTimedOut(self.identity_timeout);
+                events.push_back(ContextEvent::IdentityServerHandshakeFailed {
+                    handle,
+                    reason: identity_server::Error::from(timed_out).into(),
+                });
+                self.metrics
+                    .identity_server
+                    .finish(handle, HandshakeOutcome::TimedOut);
+            } else if let Some(mut endpoint_client) = self.endpoint_clients.remove(&handle) {
+                self.session_pool
+                    .recycle(endpoint_client.take_session_buffers());
+                let timed_out =
+                    honk_rpc::honk_rpc::Error::MessageReadTimedOut(self.endpoint_timeout);
+                events.push_back(ContextEvent::EndpointClientHandshakeFailed {
+                    handle,
+                    reason: endpoint_client::Error::from(timed_out).into(),
+                });
+                self.metrics
+                    .endpoint_client
+                    .finish(handle, HandshakeOutcome::TimedOut);
+            } else if let Some(mut endpoint_server) = self.endpoint_servers.remove(&handle) {
+                self.session_pool
+                    .recycle(endpoint_server.take_session_buffers());
+                let timed_out =
+                    honk_rpc::honk_rpc::Error::MessageReadTimedOut(self.endpoint_timeout);
+                events.push_back(ContextEvent::EndpointServerHandshakeFailed {
+                    handle,
+                    reason: endpoint_server::Error::from(timed_out).into(),
+                });
+                self.metrics
+                    .endpoint_server
+                    .finish(handle, HandshakeOutcome::TimedOut);
+            } else if let Some(pending_connect) = self.remove_pending_connect(handle) {
+                // a late ConnectComplete for this handshake is dropped
+                let timeout = match pending_connect {
+                    PendingConnect::IdentityClient { .. } => self.identity_timeout,
+                    PendingConnect::EndpointClient { .. } => self.endpoint_timeout,
+                };
+                let timed_out = tor_interface::tor_provider::Error::Generic(format!(
+                    "connect timed out after {:?}",
+                    timeout
+                ));
+                events.push_back(Self::pending_connect_handle_failed(
+                    pending_connect,
+                    timed_out,
+                    HandshakeOutcome::TimedOut,
+                    &mut self.metrics,
+                ));
+            }
+        }
+
+        // handshakes advance at most one step per update() and listeners accept
+        // a limited number of connections per update(), so if anything happened
+        // we may have more work to do; likewise for sessions with sections left
+        // to handle and endpoint servers queued behind the teardown of their
+        // previous onion-service, which the next update() may now start
+        self.update_pending = !events.is_empty()
+            || accept_budget_spent
+            || (self.bootstrap_complete && !self.queued_endpoint_servers.is_empty())
+            || self
+                .sessions()
+                .any(|session| session.has_pending_sections());
+
+        self.metrics.events_returned.add(events.len() as u64);
+        update_stopwatch.record(&self.metrics.update);
         Ok(events)
     }
+
+    // accept new connections from our listeners, which take turns accepting one
+    // connection at a time; without a budget each listener takes a single turn,
+    // otherwise turns continue until every listener would block or the budget is
+    // spent. Turns start where the previous update() stopped, so listeners which
+    // sort first cannot take every accept. Returns true if listeners may still
+    // have connections waiting
+    fn accept_connections(&mut self, events: &mut VecDeque<ContextEvent>, now: Instant) -> bool {
+        trace_scope!("gosling::Context::accept_connections");
+        let (mut accepts_remaining, mut turns_remaining) = match self.max_accepts_per_update {
+            Some(max_accepts) => (max_accepts, usize::MAX),
+            None => (usize::MAX, 1 + self.endpoint_listeners.len()),
+        };
+        // connections shed by the identity listener do not count against the
+        // budget, so they get an allowance of their own
+        let mut sheds_remaining = self.max_accepts_per_update.unwrap_or(1);
+
+        // every listener's turn, starting with the one after the previous update()'s last
+        let mut turns: VecDeque<AcceptTurn> = Default::default();
+        if self.identity_listener.is_some() {
+            turns.push_back(AcceptTurn::IdentityListener);
+        }
+        turns.extend(
+            self.endpoint_listeners.keys().map(|endpoint_service_id| {
+                AcceptTurn::EndpointListener(endpoint_service_id.clone())
+            }),
+        );
+        let first_turn = turns
+            .iter()
+            .position(|turn| *turn >= self.next_accept_turn)
+            .unwrap_or(0);
+        turns.rotate_left(first_turn);
+
+        while let Some(turn) = turns.pop_front() {
+            if accepts_remaining == 0 || turns_remaining == 0 {
+                self.next_accept_turn = turn;
+                return true;
+            }
+            turns_remaining -= 1;
+
+            let accept = match &turn {
+                AcceptTurn::IdentityListener => {
+                    self.identity_listener_accept(events, now, sheds_remaining > 0)
+                }
+                AcceptTurn::EndpointListener(endpoint_service_id) => {
+                    self.endpoint_listener_accept(endpoint_service_id, events, now)
+                }
+            };
+            match accept {
+                Accept::Handshake => {
+                    accepts_remaining -= 1;
+                    turns.push_back(turn);
+                }
+                Accept::Shed => {
+                    sheds_remaining -= 1;
+                    turns.push_back(turn);
+                }
+                Accept::WouldBlock => {}
+            }
+        }
+        // every listener would block
+        false
+    }
+
+    // accept one connection from the identity listener, shedding it if we are
+    // already driving as many identity server handshakes as allowed; the identity
+    // listener would block once it may no longer shed
+    fn identity_listener_accept(
+        &mut self,
+        events: &mut VecDeque<ContextEvent>,
+        now: Instant,
+        may_shed: bool,
+    ) -> Accept {
+        let identity_listener = match &self.identity_listener {
+            Some(identity_listener) => identity_listener,
+            None => return Accept::WouldBlock,
+        };
+        if self.identity_servers.len() >= self.max_identity_server_handshakes {
+            if !may_shed {
+                return Accept::WouldBlock;
+            }
+            // shed connections over our limit before spending a session on them
+            match identity_listener.accept() {
+                Ok(Some(_stream)) => {
+                    self.admission_stats.connections_shed += 1;
+                    self.metrics.connections_accepted.increment();
+                    Accept::Shed
+                }
+                Ok(None) => Accept::WouldBlock,
+                Err(_) => {
+                    self.identity_listener = None;
+                    Accept::WouldBlock
+                }
+            }
+        } else {
+            match Self::identity_server_handle_accept(
+                identity_listener,
+                self.identity_timeout,
+                self.identity_max_message_size,
+                &self.identity_private_key,
+                self.key_pool.as_ref(),
+                self.identity_server_early_rejection,
+                &mut self.session_pool,
+            ) {
+                Ok(Some(identity_server)) => {
+                    let handle = self.next_handshake_handle;
+                    self.next_handshake_handle += 1;
+                    self.identity_servers.insert(handle, identity_server);
+                    self.handshake_timers
+                        .arm(handle, now + self.identity_timeout);
+                    self.metrics.connections_accepted.increment();
+                    self.metrics.identity_server.start(handle);
+                    events.push_back(ContextEvent::IdentityServerHandshakeStarted { handle });
+                    Accept::Handshake
+                }
+                Ok(None) => Accept::WouldBlock,
+                // identity listener failed, remove it
+                // TODO: signal caller identity listener is down
+                Err(_) => {
+                    self.identity_listener = None;
+                    Accept::WouldBlock
+                }
+            }
+        }
+    }
+
+    // accept one connection from an active endpoint server's listener
+    fn endpoint_listener_accept(
+        &mut self,
+        endpoint_service_id: &V3OnionServiceId,
+        events: &mut VecDeque<ContextEvent>,
+        now: Instant,
+    ) -> Accept {
+        let (endpoint_listener, endpoint) = match (
+            self.endpoint_listeners.get(endpoint_service_id),
+            self.endpoint_registry.get(endpoint_service_id),
+        ) {
+            (Some(endpoint_listener), Some(endpoint)) => (endpoint_listener, endpoint),
+            (Some(_), None) => {
+                self.endpoint_listeners.remove(endpoint_service_id);
+                return Accept::WouldBlock;
+            }
+            (None, _) => return Accept::WouldBlock,
+        };
+        match Self::endpoint_server_handle_accept(
+            &endpoint_listener.listener,
+            self.endpoint_timeout,
+            &endpoint.client_identity,
+            endpoint_service_id,
+            &mut self.session_pool,
+        ) {
+            Ok(Some(endpoint_server)) => {
+                self.endpoint_registry.touch(endpoint_service_id, now);
+                let handle = self.next_handshake_handle;
+                self.next_handshake_handle += 1;
+                self.endpoint_servers.insert(handle, endpoint_server);
+                self.handshake_timers
+                    .arm(handle, now + self.endpoint_timeout);
+                self.metrics.connections_accepted.increment();
+                self.metrics.endpoint_server.start(handle);
+                events.push_back(ContextEvent::EndpointServerHandshakeStarted { handle });
+                Accept::Handshake
+            }
+            Ok(None) => Accept::WouldBlock,
+            // endpoint listener failed, remove it
+            // TODO: signal caller endpoint listener is down
+            Err(_) => {
+                self.endpoint_listeners.remove(endpoint_service_id);
+                self.endpoint_registry
+                    .set_active(endpoint_service_id, false, now);
+                self.removed_endpoint_servers
+                    .insert(endpoint_service_id.clone());
+                Accept::WouldBlock
+            }
+        }
+    }
+
+    // advance every handshake in handshakes by one step and return the results in
+    // iteration order; with enough handshakes to keep them busy, the handshakes
+    // are spread across our parked worker threads
+    fn update_handshakes<'a, H: Send + 'a, R: Send>(
+        handshakes: impl Iterator<Item = &'a mut H>,
+        workers: &WorkerPool,
+        update: impl Fn(&mut H) -> R + Sync,
+    ) -> Vec<R> {
+        let handshakes: Vec<&mut H> = handshakes.collect();
+        let threads = handshakes.len() / MIN_HANDSHAKES_PER_WORKER_THREAD;
+        workers.map(handshakes, threads, |handshake| update(handshake))
+    }
+
+    // cancel the read timeout of a handshake which is finished, or push it back if
+    // the handshake's peer has sent anything since the last update(); returns retain
+    fn handshake_timer_update(
+        handshake_timers: &mut TimerWheel<HandshakeHandle>,
+        handle: HandshakeHandle,
+        retain: bool,
+        session: Option<&mut Session<TcpStream>>,
+        deadline: Instant,
+    ) -> bool {
+        if !retain {
+            handshake_timers.cancel(handle);
+        } else if session.map_or(false, |session| session.take_read_progress()) {
+            handshake_timers.arm(handle, deadline);
+        }
+        retain
+    }
+
+    // every honk-rpc session of our in-progress handshakes
+    fn sessions(&self) -> impl Iterator<Item = &Session<TcpStream>> {
+        self.identity_clients
+            .values()
+            .filter_map(|identity_client| identity_client.get_session())
+            .chain(
+                self.identity_servers
+                    .values()
+                    .filter_map(|identity_server| identity_server.get_session()),
+            )
+            .chain(
+                self.endpoint_clients
+                    .values()
+                    .filter_map(|endpoint_client| endpoint_client.get_session()),
+            )
+            .chain(
+                self.endpoint_servers
+                    .values()
+                    .filter_map(|endpoint_server| endpoint_server.get_session()),
+            )
+    }
+
+    /// Prepare to block until this `Context` has work for [`Context::update()`] and return a [`ContextWaiter`] to do so. Sockets stay registered until the next call to [`Context::update()`], which callers must make between waits.
+    ///
+    /// # Parameters
+    /// - `timeout`: the maximum amount of time to wait; `None` waits indefinitely. The wait may end sooner to time out quiet handshakes, to deactivate idle endpoint servers (see [`Context::set_endpoint_server_idle_timeout()`]), or to periodically update a [`TorProvider`] which cannot signal new events itself.
+    pub fn event_waiter(&self, timeout: Option<Duration>) -> Result<ContextWaiter, Error> {
+        // the TorProvider may hold events none of our sockets or its waker will signal
+        if self.update_pending || self.tor_provider.has_pending_events() {
+            return Ok(ContextWaiter {
+                poller: None,
+                timeout,
+            });
+        }
+
+        let mut timeout = timeout;
+        let readable = Event::readable(POLLER_KEY);
+        self.poller_armed.store(true, Ordering::Relaxed);
+
+        // listeners are readable when a new connection is waiting
+        if let Some(identity_listener) = &self.identity_listener {
+            poller_arm(&self.poller, identity_listener, readable)?;
+        }
+        for endpoint_listener in self.endpoint_listeners.values() {
+            poller_arm(&self.poller, &endpoint_listener.listener, readable)?;
+        }
+
+        // the TorProvider either wakes us itself or must be polled
+        for source in self.tor_provider.event_sources() {
+            poller_arm(&self.poller, source, readable)?;
+        }
+        if !self.tor_provider_has_waker {
+            timeout = min_timeout(timeout, TOR_PROVIDER_UPDATE_INTERVAL);
+        }
+
+        // in-progress handshakes wait on their peer, or on a full send buffer
+        for session in self.sessions() {
+            let interest = if session.has_pending_writes() {
+                Event::all(POLLER_KEY)
+            } else {
+                readable
+            };
+            poller_arm(&self.poller, session.get_stream(), interest)?;
+        }
+
+        // wake up just after the earliest handshake timeout so update() can fail it
+        if let Some(deadline) = self.handshake_timers.next_deadline() {
+            let deadline = deadline.saturating_duration_since(Instant::now());
+            timeout = min_timeout(timeout, deadline + Duration::from_millis(1));
+        }
+
+        // and just after the first endpoint server goes idle so update() can deactivate it
+        if let Some(deadline) = self.endpoint_server_idle_timeout.and_then(|idle_timeout| {
+            self.endpoint_registry
+                .next_idle_deadline(self.endpoint_listeners.keys(), idle_timeout)
+        }) {
+            let deadline = deadline.saturating_duration_since(Instant::now());
+            timeout = min_timeout(timeout, deadline + Duration::from_millis(1));
+        }
+
+        Ok(ContextWaiter {
+            poller: Some(Arc::clone(&self.poller)),
+            timeout,
+        })
+    }
+
+    // delete every registration made by event_waiter(), see poller_arm(); sockets
+    // which were never registered only fail with NotFound
+    fn poller_disarm(&self) {
+        if !self.poller_armed.swap(false, Ordering::Relaxed) {
+            return;
+        }
+        if let Some(identity_listener) = &self.identity_listener {
+            let _ = self.poller.delete(identity_listener);
+        }
+        for endpoint_listener in self.endpoint_listeners.values() {
+            let _ = self.poller.delete(&endpoint_listener.listener);
+        }
+        for source in self.tor_provider.event_sources() {
+            let _ = self.poller.delete(source);
+        }
+        for session in self.sessions() {
+            let _ = self.poller.delete(session.get_stream());
+        }
+    }
+
+    /// Block the calling thread until this `Context` has work for [`Context::update()`]: a listener or handshake socket is ready, the [`TorProvider`] has new events, an earlier call left work unfinished, or `timeout` elapses. Idle `Context`s therefore sleep in the kernel rather than needing to be busy-polled.
+    ///
+    /// Equivalent to `context.event_waiter(timeout)?.wait()`.
+    pub fn wait_events(&self, timeout: Option<Duration>) -> Result<(), Error> {
+        self.event_waiter(timeout)?.wait()
+    }
+}
+
+impl Drop for Context {
+    fn drop(&mut self) {
+        // a ContextWaiter may keep the poller alive after our sockets are gone
+        self.poller_disarm();
+    }
 }
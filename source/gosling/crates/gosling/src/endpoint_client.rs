@@ -7,7 +7,7 @@ use std::net::TcpStream;
 use bson::doc;
 use bson::spec::BinarySubtype;
 use bson::{Binary, Bson};
-use honk_rpc::honk_rpc::{RequestCookie, Response, Session};
+use honk_rpc::honk_rpc::{RequestCookie, Response, Session, SessionBuffers};
 use rand::rngs::OsRng;
 use rand::RngCore;
 use tor_interface::tor_crypto::*;
@@ -50,6 +50,8 @@ enum EndpointClientState {
 pub(crate) struct EndpointClient {
     // session data
     rpc: Option<Session<TcpStream>>,
+    // the completed session's buffers, once rpc has been converted into a stream
+    session_buffers: Option<SessionBuffers>,
     pub server_service_id: V3OnionServiceId,
     pub requested_channel: AsciiString,
     client_service_id: V3OnionServiceId,
@@ -74,6 +76,7 @@ impl EndpointClient {
     ) -> Self {
         Self {
             rpc: Some(rpc),
+            session_buffers: None,
             server_service_id,
             requested_channel,
             client_service_id: V3OnionServiceId::from_private_key(&client_ed25519_private),
@@ -85,6 +88,23 @@ impl EndpointClient {
         }
     }
 
+    // the session driving this handshake, or None once it has completed
+    pub fn get_session(&self) -> Option<&Session<TcpStream>> {
+        self.rpc.as_ref()
+    }
+
+    pub fn get_session_mut(&mut self) -> Option<&mut Session<TcpStream>> {
+        self.rpc.as_mut()
+    }
+
+    // the session's buffers, for re-use by future handshakes once this one is finished
+    pub fn take_session_buffers(&mut self) -> Option<SessionBuffers> {
+        match self.rpc.as_mut() {
+            Some(rpc) => Some(rpc.take_buffers()),
+            None => self.session_buffers.take(),
+        }
+    }
+
     pub fn update(&mut self) -> Result<Option<EndpointClientEvent>, Error> {
         if self.state == EndpointClientState::HandshakeComplete {
             return Err(Error::IncorrectUsage("update() may not be called after HandshakeComplete has been returned from previous update() call".to_string()));
@@ -258,7 +278,9 @@ impl EndpointClient {
                         if let Some(Bson::Document(result)) = result {
                             if result.is_empty() {
                                 self.state = EndpointClientState::HandshakeComplete;
-                                let stream = std::mem::take(&mut self.rpc).unwrap().into_stream();
+                                let mut rpc = std::mem::take(&mut self.rpc).unwrap();
+                                self.session_buffers = Some(rpc.take_buffers());
+                                let stream = rpc.into_stream();
                                 return Ok(Some(EndpointClientEvent::HandshakeCompleted {
                                     stream,
                                 }));
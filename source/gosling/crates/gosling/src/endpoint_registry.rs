@@ -0,0 +1,304 @@
+// standard
+use std::collections::{HashMap, HashSet};
+use std::sync::Arc;
+use std::time::{Duration, Instant};
+
+// extern crates
+use tor_interface::tor_crypto::*;
+
+//
+// Endpoint Registry
+//
+
+// An endpoint server registered with a Context. Only active endpoint servers have an
+// onion-service; dormant ones are just their keys until they are activated again.
+pub(crate) struct RegisteredEndpoint {
+    pub endpoint_private_key: Ed25519PrivateKey,
+    // shared with every other endpoint server of the same name
+    pub endpoint_name: Arc<str>,
+    pub client_identity: V3OnionServiceId,
+    pub client_auth: X25519PublicKey,
+    // endpoint servers with a lower priority are deactivated first to make room
+    pub priority: u32,
+    // when this endpoint server was last activated or accepted a connection
+    pub last_active: Instant,
+    pub active: bool,
+}
+
+// Every endpoint server registered with a Context, keyed by service id.
+//
+// Applications typically offer a handful of endpoint names to a great many clients,
+// so names are interned: each distinct name is allocated once and shared by all of
+// the endpoint servers using it.
+pub(crate) struct EndpointRegistry {
+    endpoints: HashMap<V3OnionServiceId, RegisteredEndpoint>,
+    endpoint_names: HashSet<Arc<str>>,
+    active_count: usize,
+}
+
+impl EndpointRegistry {
+    pub fn new() -> Self {
+        Self {
+            endpoints: Default::default(),
+            endpoint_names: Default::default(),
+            active_count: 0,
+        }
+    }
+
+    // the number of endpoint servers which are active
+    pub fn active_count(&self) -> usize {
+        self.active_count
+    }
+
+    pub fn contains(&self, service_id: &V3OnionServiceId) -> bool {
+        self.endpoints.contains_key(service_id)
+    }
+
+    pub fn get(&self, service_id: &V3OnionServiceId) -> Option<&RegisteredEndpoint> {
+        self.endpoints.get(service_id)
+    }
+
+    pub fn values(&self) -> impl Iterator<Item = &RegisteredEndpoint> {
+        self.endpoints.values()
+    }
+
+    // register a new, dormant endpoint server
+    pub fn insert(
+        &mut self,
+        service_id: V3OnionServiceId,
+        endpoint_private_key: Ed25519PrivateKey,
+        endpoint_name: String,
+        client_identity: V3OnionServiceId,
+        client_auth: X25519PublicKey,
+        priority: u32,
+        now: Instant,
+    ) {
+        let endpoint_name = match self.endpoint_names.get(endpoint_name.as_str()) {
+            Some(endpoint_name) => Arc::clone(endpoint_name),
+            None => {
+                let endpoint_name: Arc<str> = Arc::from(endpoint_name);
+                self.endpoint_names.insert(Arc::clone(&endpoint_name));
+                endpoint_name
+            }
+        };
+        let endpoint = RegisteredEndpoint {
+            endpoint_private_key,
+            endpoint_name,
+            client_identity,
+            client_auth,
+            priority,
+            last_active: now,
+            active: false,
+        };
+        if let Some(endpoint) = self.endpoints.insert(service_id, endpoint) {
+            self.release(endpoint);
+        }
+    }
+
+    pub fn remove(&mut self, service_id: &V3OnionServiceId) -> Option<RegisteredEndpoint> {
+        let endpoint = self.endpoints.remove(service_id)?;
+        Some(self.release(endpoint))
+    }
+
+    // forget a removed endpoint server's name and activity once nothing else uses them
+    fn release(&mut self, endpoint: RegisteredEndpoint) -> RegisteredEndpoint {
+        if endpoint.active {
+            self.active_count -= 1;
+        }
+        // the only other reference is our own
+        if Arc::strong_count(&endpoint.endpoint_name) == 2 {
+            self.endpoint_names.remove(&endpoint.endpoint_name);
+        }
+        endpoint
+    }
+
+    // mark an endpoint server active or dormant, returns whether it changed
+    pub fn set_active(
+        &mut self,
+        service_id: &V3OnionServiceId,
+        active: bool,
+        now: Instant,
+    ) -> bool {
+        match self.endpoints.get_mut(service_id) {
+            Some(endpoint) if endpoint.active != active => {
+                endpoint.active = active;
+                if active {
+                    endpoint.last_active = now;
+                    self.active_count += 1;
+                } else {
+                    self.active_count -= 1;
+                }
+                true
+            }
+            _ => false,
+        }
+    }
+
+    // record activity on an endpoint server
+    pub fn touch(&mut self, service_id: &V3OnionServiceId, now: Instant) {
+        if let Some(endpoint) = self.endpoints.get_mut(service_id) {
+            endpoint.last_active = now;
+        }
+    }
+
+    pub fn set_priority(&mut self, service_id: &V3OnionServiceId, priority: u32) -> bool {
+        match self.endpoints.get_mut(service_id) {
+            Some(endpoint) => {
+                endpoint.priority = priority;
+                true
+            }
+            None => false,
+        }
+    }
+
+    // up to count active endpoint servers for which keep() is false, in the order they
+    // should be deactivated: lowest priority first, then least recently active
+    pub fn eviction_candidates(
+        &self,
+        count: usize,
+        keep: impl Fn(&V3OnionServiceId) -> bool,
+    ) -> Vec<V3OnionServiceId> {
+        if count == 0 {
+            return Default::default();
+        }
+        let mut candidates: Vec<(&V3OnionServiceId, &RegisteredEndpoint)> = self
+            .endpoints
+            .iter()
+            .filter(|(service_id, endpoint)| endpoint.active && !keep(*service_id))
+            .collect();
+        candidates.sort_unstable_by_key(|(_, endpoint)| (endpoint.priority, endpoint.last_active));
+        candidates
+            .into_iter()
+            .take(count)
+            .map(|(service_id, _)| service_id.clone())
+            .collect()
+    }
+
+    // those of the given endpoint servers which are active and have seen no activity
+    // for idle_timeout
+    pub fn idle<'a>(
+        &self,
+        service_ids: impl Iterator<Item = &'a V3OnionServiceId>,
+        now: Instant,
+        idle_timeout: Duration,
+    ) -> Vec<V3OnionServiceId> {
+        service_ids
+            .filter(|service_id| {
+                self.endpoints.get(*service_id).map_or(false, |endpoint| {
+                    endpoint.active
+                        && now.saturating_duration_since(endpoint.last_active) >= idle_timeout
+                })
+            })
+            .cloned()
+            .collect()
+    }
+
+    // when the first of the given endpoint servers which are active will have seen no
+    // activity for idle_timeout
+    pub fn next_idle_deadline<'a>(
+        &self,
+        service_ids: impl Iterator<Item = &'a V3OnionServiceId>,
+        idle_timeout: Duration,
+    ) -> Option<Instant> {
+        service_ids
+            .filter_map(|service_id| self.endpoints.get(service_id))
+            .filter(|endpoint| endpoint.active)
+            .map(|endpoint| endpoint.last_active + idle_timeout)
+            .min()
+    }
+}
+
+#[test]
+fn test_endpoint_registry() {
+    let start = Instant::now();
+    let at = |secs: u64| start + Duration::from_secs(secs);
+    let mut endpoint_registry = EndpointRegistry::new();
+
+    let client_identity = V3OnionServiceId::from_private_key(&Ed25519PrivateKey::generate());
+    let client_auth = X25519PublicKey::from_private_key(&X25519PrivateKey::generate());
+    let mut register = |endpoint_name: &str| -> V3OnionServiceId {
+        let endpoint_private_key = Ed25519PrivateKey::generate();
+        let service_id = V3OnionServiceId::from_private_key(&endpoint_private_key);
+        endpoint_registry.insert(
+            service_id.clone(),
+            endpoint_private_key,
+            endpoint_name.to_string(),
+            client_identity.clone(),
+            client_auth.clone(),
+            0,
+            start,
+        );
+        service_id
+    };
+    let endpoints: Vec<V3OnionServiceId> = (0..4)
+        .map(|i| register(if i < 3 { "chat" } else { "files" }))
+        .collect();
+    assert_eq!(endpoint_registry.endpoints.len(), 4);
+
+    // endpoint servers of the same name share one allocation
+    let name = |service_id: &V3OnionServiceId| {
+        Arc::clone(&endpoint_registry.get(service_id).unwrap().endpoint_name)
+    };
+    assert!(Arc::ptr_eq(&name(&endpoints[0]), &name(&endpoints[2])));
+    assert!(!Arc::ptr_eq(&name(&endpoints[0]), &name(&endpoints[3])));
+    assert_eq!(endpoint_registry.endpoint_names.len(), 2);
+
+    // endpoint servers are registered dormant
+    assert_eq!(endpoint_registry.active_count(), 0);
+    assert!(endpoint_registry
+        .eviction_candidates(4, |_| false)
+        .is_empty());
+    for (i, service_id) in endpoints.iter().enumerate() {
+        assert!(endpoint_registry.set_active(service_id, true, at(i as u64)));
+    }
+    assert!(!endpoint_registry.set_active(&endpoints[0], true, at(10)));
+    assert_eq!(endpoint_registry.active_count(), 4);
+
+    // the least recently active endpoint servers are evicted first, unless kept
+    endpoint_registry.touch(&endpoints[0], at(10));
+    assert_eq!(
+        endpoint_registry.eviction_candidates(2, |_| false),
+        vec![endpoints[1].clone(), endpoints[2].clone()]
+    );
+    assert_eq!(
+        endpoint_registry.eviction_candidates(2, |service_id| *service_id == endpoints[1]),
+        vec![endpoints[2].clone(), endpoints[3].clone()]
+    );
+    // and priority trumps activity
+    assert!(endpoint_registry.set_priority(&endpoints[1], 1));
+    assert!(endpoint_registry.set_priority(&endpoints[2], 2));
+    assert_eq!(
+        endpoint_registry.eviction_candidates(1, |_| false),
+        vec![endpoints[3].clone()]
+    );
+    assert_eq!(endpoint_registry.eviction_candidates(8, |_| false).len(), 4);
+
+    assert_eq!(
+        endpoint_registry.idle(endpoints.iter(), at(11), Duration::from_secs(8)),
+        endpoints[1..].to_vec()
+    );
+    assert_eq!(
+        endpoint_registry.next_idle_deadline(endpoints.iter(), Duration::from_secs(8)),
+        Some(at(9))
+    );
+
+    // dormant endpoint servers are never evicted or idle
+    assert!(endpoint_registry.set_active(&endpoints[3], false, at(11)));
+    assert_eq!(endpoint_registry.active_count(), 3);
+    assert_eq!(endpoint_registry.eviction_candidates(8, |_| false).len(), 3);
+    assert_eq!(
+        endpoint_registry
+            .idle(endpoints.iter(), at(11), Duration::ZERO)
+            .len(),
+        3
+    );
+
+    // removing the last endpoint server of a name forgets the name
+    assert!(endpoint_registry.remove(&endpoints[3]).is_some());
+    assert_eq!(endpoint_registry.endpoint_names.len(), 1);
+    assert!(endpoint_registry.remove(&endpoints[0]).is_some());
+    assert_eq!(endpoint_registry.active_count(), 2);
+    assert_eq!(endpoint_registry.endpoint_names.len(), 1);
+    assert!(endpoint_registry.remove(&endpoints[0]).is_none());
+    assert!(!endpoint_registry.contains(&endpoints[0]));
+}
@@ -7,7 +7,7 @@ use std::net::TcpStream;
 use bson::doc;
 use bson::spec::BinarySubtype;
 use bson::{Binary, Bson};
-use honk_rpc::honk_rpc::{ApiSet, ErrorCode, RequestCookie, Session};
+use honk_rpc::honk_rpc::{ApiSet, ErrorCode, RequestCookie, Session, SessionBuffers};
 use rand::rngs::OsRng;
 use rand::RngCore;
 use tor_interface::tor_crypto::*;
@@ -70,6 +70,8 @@ enum EndpointServerState {
 pub(crate) struct EndpointServer {
     // Session Data
     rpc: Option<Session<TcpStream>>,
+    // the completed session's buffers, once rpc has been converted into a stream
+    session_buffers: Option<SessionBuffers>,
     pub server_identity: V3OnionServiceId,
     allowed_client_identity: V3OnionServiceId,
 
@@ -107,6 +109,7 @@ impl EndpointServer {
 
         EndpointServer {
             rpc: Some(rpc),
+            session_buffers: None,
             server_identity,
             allowed_client_identity: client_identity,
             state: EndpointServerState::WaitingForBeginHandshake,
@@ -122,6 +125,23 @@ impl EndpointServer {
         }
     }
 
+    // the session driving this handshake, or None once it has completed
+    pub fn get_session(&self) -> Option<&Session<TcpStream>> {
+        self.rpc.as_ref()
+    }
+
+    pub fn get_session_mut(&mut self) -> Option<&mut Session<TcpStream>> {
+        self.rpc.as_mut()
+    }
+
+    // the session's buffers, for re-use by future handshakes once this one is finished
+    pub fn take_session_buffers(&mut self) -> Option<SessionBuffers> {
+        match self.rpc.as_mut() {
+            Some(rpc) => Some(rpc.take_buffers()),
+            None => self.session_buffers.take(),
+        }
+    }
+
     pub fn update(&mut self) -> Result<Option<EndpointServerEvent>, Error> {
         if let Some(mut rpc) = std::mem::take(&mut self.rpc) {
             match rpc.update(Some(&mut [self])) {
@@ -194,7 +214,9 @@ impl EndpointServer {
             => {
                 self.state = EndpointServerState::HandshakeComplete;
                 if handshake_succeeded {
-                    let stream = std::mem::take(&mut self.rpc).unwrap().into_stream();
+                    let mut rpc = std::mem::take(&mut self.rpc).unwrap();
+                    self.session_buffers = Some(rpc.take_buffers());
+                    let stream = rpc.into_stream();
                     return Ok(Some(EndpointServerEvent::HandshakeCompleted{
                         client_service_id: client_identity.clone(),
                         channel_name: requested_channel.clone(),
@@ -9,6 +9,7 @@ use bson::spec::BinarySubtype;
 use bson::{Binary, Bson};
 use honk_rpc::honk_rpc::{
     get_message_overhead, get_request_section_size, RequestCookie, Response, Session,
+    SessionBuffers,
 };
 use rand::rngs::OsRng;
 use rand::RngCore;
@@ -118,6 +119,20 @@ impl IdentityClient {
         })
     }
 
+    // the session driving this handshake
+    pub fn get_session(&self) -> Option<&Session<TcpStream>> {
+        Some(&self.rpc)
+    }
+
+    pub fn get_session_mut(&mut self) -> Option<&mut Session<TcpStream>> {
+        Some(&mut self.rpc)
+    }
+
+    // the session's buffers, for re-use by future handshakes once this one is finished
+    pub fn take_session_buffers(&mut self) -> Option<SessionBuffers> {
+        Some(self.rpc.take_buffers())
+    }
+
     pub fn update(&mut self) -> Result<Option<IdentityClientEvent>, Error> {
         if self.state == IdentityClientState::HandshakeComplete {
             return Err(Error::IncorrectUsage("update() may not be called after HandshakeComplete has been returned from previous update() call".to_string()));
@@ -2,13 +2,15 @@
 use std::clone::Clone;
 use std::convert::TryInto;
 use std::net::TcpStream;
+use std::sync::Arc;
 
 // extern crates
 use bson::doc;
 use bson::spec::BinarySubtype;
 use bson::{Binary, Bson};
 use honk_rpc::honk_rpc::{
-    get_message_overhead, get_response_section_size, ApiSet, ErrorCode, RequestCookie, Session,
+    get_embedded_document_size, get_message_overhead, get_response_section_size, ApiSet, ErrorCode,
+    RequestCookie, Session, SessionBuffers,
 };
 use rand::rngs::OsRng;
 use rand::RngCore;
@@ -17,6 +19,7 @@ use tor_interface::tor_crypto::*;
 // internal crates
 use crate::ascii_string::*;
 use crate::gosling::*;
+use crate::key_pool::KeyPool;
 
 //
 // Identity Server
@@ -71,6 +74,21 @@ pub(crate) enum IdentityServerEvent {
     },
 }
 
+// the client signatures received with send_response, to be verified before the
+// challenge response is handed off
+struct ClientSignatures {
+    // the client proof and the key it must be signed with, if the client's identity
+    // could be converted to one
+    client_proof: ClientProof,
+    client_identity_proof_signature: Ed25519Signature,
+    client_identity_key: Option<Ed25519PublicKey>,
+    // the client's identity and the ed25519 key derived from the client's
+    // authorization key, if it could be
+    client_identity: V3OnionServiceId,
+    client_authorization_signature: Ed25519Signature,
+    client_authorization_key: Option<Ed25519PublicKey>,
+}
+
 #[derive(Debug, PartialEq)]
 enum IdentityServerState {
     // valid/expected states
@@ -81,6 +99,9 @@ enum IdentityServerState {
     GettingChallengeVerification,
     ChallengeVerificationReady,
     ChallengeVerificationResponseSent,
+    // early rejection states
+    BeginHandshakeRejectionReady,
+    BeginHandshakeRejectionSent,
     HandshakeComplete,
     // failure state
     HandshakeFailed,
@@ -90,6 +111,10 @@ pub(crate) struct IdentityServer {
     // Session Data
     rpc: Option<Session<TcpStream>>,
     server_identity: V3OnionServiceId,
+    // source of pre-generated endpoint private keys
+    key_pool: Option<Arc<KeyPool>>,
+    // reject disallowed clients and unknown endpoints in reply to begin_handshake
+    early_rejection: bool,
 
     // State Machine Data
     state: IdentityServerState,
@@ -102,6 +127,7 @@ pub(crate) struct IdentityServer {
     client_auth_key: Option<X25519PublicKey>,
     challenge_response: Option<bson::document::Document>,
     endpoint_private_key: Option<Ed25519PrivateKey>,
+    client_signatures: Option<ClientSignatures>,
 
     // Verification flags
 
@@ -127,6 +153,8 @@ impl IdentityServer {
             // Session Data
             rpc: Some(rpc),
             server_identity,
+            key_pool: None,
+            early_rejection: false,
 
             // State Machine Data
             state: IdentityServerState::WaitingForBeginHandshake,
@@ -139,6 +167,7 @@ impl IdentityServer {
             client_auth_key: None,
             challenge_response: None,
             endpoint_private_key: None,
+            client_signatures: None,
 
             // Verification Flags
             client_allowed: false,
@@ -149,7 +178,43 @@ impl IdentityServer {
         }
     }
 
+    // take endpoint private keys from key_pool rather than generating them inline
+    pub fn set_key_pool(&mut self, key_pool: Option<Arc<KeyPool>>) {
+        self.key_pool = key_pool;
+    }
+
+    // reject disallowed clients and unknown endpoints without sending a challenge
+    // or verifying any signatures, rather than only once the handshake is over
+    pub fn set_early_rejection(&mut self, early_rejection: bool) {
+        self.early_rejection = early_rejection;
+    }
+
+    pub fn get_early_rejection(&self) -> bool {
+        self.early_rejection
+    }
+
+    // the session driving this handshake, or None once it has completed
+    pub fn get_session(&self) -> Option<&Session<TcpStream>> {
+        self.rpc.as_ref()
+    }
+
+    pub fn get_session_mut(&mut self) -> Option<&mut Session<TcpStream>> {
+        self.rpc.as_mut()
+    }
+
+    // the session's buffers, for re-use by future handshakes once this one is finished
+    pub fn take_session_buffers(&mut self) -> Option<SessionBuffers> {
+        self.rpc.as_mut().map(Session::take_buffers)
+    }
+
     pub fn update(&mut self) -> Result<Option<IdentityServerEvent>, Error> {
+        self.update_session()?;
+        self.next_event()
+    }
+
+    // update our rpc session; any signatures received are left unverified
+    // until next_event() unless first verified in a batch by the caller
+    pub fn update_session(&mut self) -> Result<(), Error> {
         // need to remove ownership of the HonkRPC session from Self
         // before being able to pass self into the session update method
         if let Some(mut rpc) = std::mem::take(&mut self.rpc) {
@@ -163,6 +228,70 @@ impl IdentityServer {
                 }
             }
         }
+        Ok(())
+    }
+
+    // the (message, signature, public key) triples received from the client which
+    // still need verifying
+    pub fn pending_signatures(
+        &self,
+    ) -> impl Iterator<Item = (&[u8], &Ed25519Signature, &Ed25519PublicKey)> {
+        self.client_signatures
+            .iter()
+            .flat_map(|client_signatures| {
+                [
+                    client_signatures.client_identity_key.as_ref().map(|key| {
+                        (
+                            client_signatures.client_proof.as_slice(),
+                            &client_signatures.client_identity_proof_signature,
+                            key,
+                        )
+                    }),
+                    client_signatures
+                        .client_authorization_key
+                        .as_ref()
+                        .map(|key| {
+                            (
+                                client_signatures.client_identity.as_bytes().as_slice(),
+                                &client_signatures.client_authorization_signature,
+                                key,
+                            )
+                        }),
+                ]
+            })
+            .flatten()
+    }
+
+    // mark every signature returned by pending_signatures() as valid after the
+    // caller has verified them
+    pub fn pending_signatures_verified(&mut self) {
+        if let Some(client_signatures) = std::mem::take(&mut self.client_signatures) {
+            self.client_proof_signature_valid = client_signatures.client_identity_key.is_some();
+            self.client_auth_signature_valid = client_signatures.client_authorization_key.is_some();
+        }
+    }
+
+    // verify any pending signatures one at a time
+    fn verify_pending_signatures(&mut self) {
+        if let Some(client_signatures) = std::mem::take(&mut self.client_signatures) {
+            if let Some(client_identity_key) = client_signatures.client_identity_key {
+                self.client_proof_signature_valid = client_signatures
+                    .client_identity_proof_signature
+                    .verify(&client_signatures.client_proof, &client_identity_key);
+            }
+            if let Some(client_authorization_key) = client_signatures.client_authorization_key {
+                self.client_auth_signature_valid =
+                    client_signatures.client_authorization_signature.verify(
+                        client_signatures.client_identity.as_bytes(),
+                        &client_authorization_key,
+                    );
+            }
+        }
+    }
+
+    // advance the handshake state machine following an update_session()
+    pub fn next_event(&mut self) -> Result<Option<IdentityServerEvent>, Error> {
+        self.verify_pending_signatures();
 
         match(&self.state,
               self.begin_handshake_request_cookie,
@@ -268,6 +397,26 @@ impl IdentityServer {
                     client_auth_signature_valid: self.client_auth_signature_valid,
                     challenge_response_valid: self.challenge_response_valid,
                 }));
+            },
+            (&IdentityServerState::BeginHandshakeRejectionSent,
+             Some(_begin_handshake_request_cookie),
+             Some(_client_identity),
+             Some(_requested_endpoint),
+             None, // server_cookie
+             None, // endpoint_challenge
+             None, // send_response_request_cookie
+             None, // client_auth_key
+             None, // challenge_response
+             None) // endpoint_private_key
+            => {
+                self.state = IdentityServerState::HandshakeComplete;
+                return Ok(Some(IdentityServerEvent::HandshakeRejected{
+                    client_allowed: self.client_allowed,
+                    client_requested_endpoint_valid: self.client_requested_endpoint_valid,
+                    client_proof_signature_valid: false,
+                    client_auth_signature_valid: false,
+                    challenge_response_valid: false,
+                }));
             },
              _ => {
                 if self.state == IdentityServerState::HandshakeFailed {
@@ -311,16 +460,24 @@ impl IdentityServer {
                 None, // challenge_response
                 None, // endpoint_private_key
             ) => {
+                if self.early_rejection && !(client_allowed && endpoint_valid) {
+                    self.client_allowed = client_allowed;
+                    self.client_requested_endpoint_valid = endpoint_valid;
+                    self.state = IdentityServerState::BeginHandshakeRejectionReady;
+                    return Ok(());
+                }
+
                 let mut server_cookie: ServerCookie = Default::default();
                 OsRng.fill_bytes(&mut server_cookie);
 
                 // calculate required size of response message and ensure if fits our
-                // specified message size budget
+                // specified message size budget; the endpoint challenge is measured in
+                // place rather than cloned into a throwaway result document
                 let result = doc!{
                     "server_cookie" : Bson::Binary(Binary{subtype: BinarySubtype::Generic, bytes: server_cookie.to_vec()}),
-                    "endpoint_challenge" : endpoint_challenge.clone(),
                 };
-                let response_section_size = get_response_section_size(Some(Bson::Document(result)))?;
+                let response_section_size = get_response_section_size(Some(Bson::Document(result)))?
+                    + get_embedded_document_size("endpoint_challenge", &endpoint_challenge)?;
                 let message_size = get_message_overhead()? + response_section_size;
                 let max_message_size = rpc.get_max_message_size();
                 if message_size > max_message_size {
@@ -575,30 +732,37 @@ impl ApiSet for IdentityServer {
                     // save  cookie
                     self.send_response_request_cookie = Some(request_cookie);
 
-                    // convert client_identity to client's public ed25519 key
-                    if let Ok(client_identity_key) =
-                        Ed25519PublicKey::from_service_id(client_identity)
-                    {
-                        // construct + verify client proof
-                        let client_proof = build_client_proof(
-                            DomainSeparator::GoslingIdentity,
-                            requested_endpoint,
-                            client_identity,
-                            &self.server_identity,
-                            &client_cookie,
-                            server_cookie,
-                        );
-                        self.client_proof_signature_valid = client_identity_proof_signature
-                            .verify(&client_proof, &client_identity_key);
-                    }
-
-                    // evaluate the client authorization signature
-                    self.client_auth_signature_valid = client_authorization_signature
-                        .verify_x25519(
-                            client_identity.as_bytes(),
-                            &client_authorization_key,
-                            client_authorization_key_signbit,
-                        );
+                    // construct client proof and convert client_identity to client's
+                    // public ed25519 key
+                    let client_proof = build_client_proof(
+                        DomainSeparator::GoslingIdentity,
+                        requested_endpoint,
+                        client_identity,
+                        &self.server_identity,
+                        &client_cookie,
+                        server_cookie,
+                    );
+                    let client_identity_key =
+                        Ed25519PublicKey::from_service_id(client_identity).ok();
+
+                    // the client authorization signature is verified with the ed25519 key
+                    // derived from the client authorization key
+                    let client_authorization_ed25519_key = Ed25519PublicKey::from_public_x25519(
+                        &client_authorization_key,
+                        client_authorization_key_signbit,
+                    )
+                    .ok();
+
+                    // defer signature verification so it may be batched with other
+                    // handshakes' signatures
+                    self.client_signatures = Some(ClientSignatures {
+                        client_proof,
+                        client_identity_proof_signature,
+                        client_identity_key,
+                        client_identity: client_identity.clone(),
+                        client_authorization_signature,
+                        client_authorization_key: client_authorization_ed25519_key,
+                    });
 
                     // save off client auth key for future endpoint generation
                     self.client_auth_key = Some(client_authorization_key);
@@ -655,6 +819,24 @@ impl ApiSet for IdentityServer {
                 ))
             }
             (&IdentityServerState::ChallengeReady, _, _, _, _, _, _, _, _) => unreachable!(),
+            // fail begin_handshake without sending a challenge
+            (
+                &IdentityServerState::BeginHandshakeRejectionReady,
+                Some(begin_handshake_request_cookie),
+                Some(_client_identity),
+                Some(_requested_endpoint),
+                None, // server_cookie
+                None, // endpoint_challenge
+                None, // send_response_request_cookie
+                None, // client_auth_key
+                None, // challenge_response
+            ) => {
+                self.state = IdentityServerState::BeginHandshakeRejectionSent;
+                Some((
+                    begin_handshake_request_cookie,
+                    Err(ErrorCode::Runtime(RpcError::Failure as i32)),
+                ))
+            }
             (
                 &IdentityServerState::ChallengeVerificationReady,
                 Some(_begin_handshake_request_cookie),
@@ -675,7 +857,10 @@ impl ApiSet for IdentityServer {
 
                 self.state = IdentityServerState::ChallengeVerificationResponseSent;
                 if success {
-                    let endpoint_private_key = Ed25519PrivateKey::generate();
+                    let endpoint_private_key = match &self.key_pool {
+                        Some(key_pool) => key_pool.take_ed25519_private_key(),
+                        None => Ed25519PrivateKey::generate(),
+                    };
                     let endpoint_service_id =
                         V3OnionServiceId::from_private_key(&endpoint_private_key);
                     self.endpoint_private_key = Some(endpoint_private_key);
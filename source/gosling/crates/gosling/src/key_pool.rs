@@ -0,0 +1,215 @@
+// standard
+use std::collections::VecDeque;
+use std::sync::{Arc, Condvar, Mutex, MutexGuard};
+use std::thread::JoinHandle;
+
+// extern crates
+use tor_interface::tor_crypto::*;
+
+//
+// Key Pool
+//
+
+struct KeyPoolState {
+    capacity: usize,
+    ed25519_private_keys: VecDeque<Ed25519PrivateKey>,
+    x25519_private_keys: VecDeque<X25519PrivateKey>,
+    shutdown: bool,
+}
+
+impl KeyPoolState {
+    fn is_full(&self) -> bool {
+        self.ed25519_private_keys.len() >= self.capacity
+            && self.x25519_private_keys.len() >= self.capacity
+    }
+}
+
+struct KeyPoolShared {
+    state: Mutex<KeyPoolState>,
+    // signalled when keys are taken or the pool is shutting down
+    refill: Condvar,
+}
+
+impl KeyPoolShared {
+    fn lock(&self) -> MutexGuard<'_, KeyPoolState> {
+        match self.state.lock() {
+            Ok(state) => state,
+            Err(_) => unreachable!("another thread panicked while holding the key pool's lock"),
+        }
+    }
+}
+
+// A pool of pre-generated endpoint (ed25519) and client-auth (x25519) private keys
+// kept topped up by a background thread, so completing a handshake only has to
+// dequeue a key rather than generate one. Should a burst of handshakes drain the
+// pool, keys are generated inline until the refill thread catches up.
+//
+// In-progress handshakes hold their own references to the pool, so its owner stops
+// the refill thread with shutdown() rather than by dropping its reference; the keys
+// left over are still handed out before falling back to inline generation.
+pub(crate) struct KeyPool {
+    shared: Arc<KeyPoolShared>,
+    refill_thread: Mutex<Option<JoinHandle<()>>>,
+}
+
+impl KeyPool {
+    // construct a pool holding up to capacity keys of each type
+    pub fn new(capacity: usize) -> Result<Self, std::io::Error> {
+        let shared = Arc::new(KeyPoolShared {
+            state: Mutex::new(KeyPoolState {
+                capacity,
+                ed25519_private_keys: VecDeque::with_capacity(capacity),
+                x25519_private_keys: VecDeque::with_capacity(capacity),
+                shutdown: false,
+            }),
+            refill: Condvar::new(),
+        });
+
+        let refill_thread = {
+            let shared = Arc::clone(&shared);
+            std::thread::Builder::new()
+                .name("gosling-key-pool".to_string())
+                .spawn(move || Self::refill(&shared))?
+        };
+
+        Ok(Self {
+            shared,
+            refill_thread: Mutex::new(Some(refill_thread)),
+        })
+    }
+
+    // take a pre-generated ed25519 private key
+    pub fn take_ed25519_private_key(&self) -> Ed25519PrivateKey {
+        let private_key = self.shared.lock().ed25519_private_keys.pop_front();
+        self.shared.refill.notify_one();
+        private_key.unwrap_or_else(Self::generate_ed25519_private_key)
+    }
+
+    // take a pre-generated x25519 private key
+    pub fn take_x25519_private_key(&self) -> X25519PrivateKey {
+        let private_key = self.shared.lock().x25519_private_keys.pop_front();
+        self.shared.refill.notify_one();
+        private_key.unwrap_or_else(Self::generate_x25519_private_key)
+    }
+
+    // stop and join the refill thread
+    pub fn shutdown(&self) {
+        self.shared.lock().shutdown = true;
+        self.shared.refill.notify_one();
+        let refill_thread = match self.refill_thread.lock() {
+            Ok(mut refill_thread) => refill_thread.take(),
+            Err(_) => unreachable!("another thread panicked while holding the key pool's lock"),
+        };
+        if let Some(refill_thread) = refill_thread {
+            let _ = refill_thread.join();
+        }
+    }
+
+    // the number of ready (ed25519, x25519) private keys
+    #[cfg(test)]
+    fn len(&self) -> (usize, usize) {
+        let state = self.shared.lock();
+        (
+            state.ed25519_private_keys.len(),
+            state.x25519_private_keys.len(),
+        )
+    }
+
+    // the values derived from private keys are cached on first use, so also derive
+    // the public parts handshakes will need while we are off the critical path
+    fn generate_ed25519_private_key() -> Ed25519PrivateKey {
+        let private_key = Ed25519PrivateKey::generate();
+        let _ = V3OnionServiceId::from_private_key(&private_key);
+        private_key
+    }
+
+    fn generate_x25519_private_key() -> X25519PrivateKey {
+        let private_key = X25519PrivateKey::generate();
+        let _ = X25519PublicKey::from_private_key(&private_key);
+        private_key
+    }
+
+    // the refill thread's body; keys are generated one at a time without holding
+    // the lock so takers never wait on key generation
+    fn refill(shared: &KeyPoolShared) {
+        loop {
+            let (need_ed25519, need_x25519) = {
+                let mut state = shared.lock();
+                while !state.shutdown && state.is_full() {
+                    state = match shared.refill.wait(state) {
+                        Ok(state) => state,
+                        Err(_) => unreachable!(
+                            "another thread panicked while holding the key pool's lock"
+                        ),
+                    };
+                }
+                if state.shutdown {
+                    return;
+                }
+                (
+                    state.ed25519_private_keys.len() < state.capacity,
+                    state.x25519_private_keys.len() < state.capacity,
+                )
+            };
+
+            let ed25519_private_key = need_ed25519.then(Self::generate_ed25519_private_key);
+            let x25519_private_key = need_x25519.then(Self::generate_x25519_private_key);
+
+            let mut state = shared.lock();
+            if let Some(private_key) = ed25519_private_key {
+                state.ed25519_private_keys.push_back(private_key);
+            }
+            if let Some(private_key) = x25519_private_key {
+                state.x25519_private_keys.push_back(private_key);
+            }
+        }
+    }
+}
+
+impl Drop for KeyPool {
+    fn drop(&mut self) {
+        self.shutdown();
+    }
+}
+
+#[test]
+fn test_key_pool() -> Result<(), std::io::Error> {
+    use std::collections::BTreeSet;
+    use std::time::{Duration, Instant};
+
+    const CAPACITY: usize = 4;
+
+    let wait_until_full = |key_pool: &KeyPool| {
+        let start = Instant::now();
+        while key_pool.len() != (CAPACITY, CAPACITY) {
+            assert!(start.elapsed() < Duration::from_secs(30));
+            std::thread::sleep(Duration::from_millis(1));
+        }
+    };
+
+    let key_pool = KeyPool::new(CAPACITY)?;
+    wait_until_full(&key_pool);
+
+    // draining the pool past its capacity still yields unique keys
+    let mut service_ids: BTreeSet<String> = Default::default();
+    let mut public_keys: BTreeSet<String> = Default::default();
+    for _ in 0..3 * CAPACITY {
+        let private_key = key_pool.take_ed25519_private_key();
+        assert!(service_ids.insert(V3OnionServiceId::from_private_key(&private_key).to_string()));
+        let private_key = key_pool.take_x25519_private_key();
+        assert!(public_keys.insert(X25519PublicKey::from_private_key(&private_key).to_base32()));
+    }
+
+    // and the pool is refilled afterwards
+    wait_until_full(&key_pool);
+
+    // a shut down pool hands out its leftover keys, then generates them inline
+    key_pool.shutdown();
+    for _ in 0..2 * CAPACITY {
+        let private_key = key_pool.take_ed25519_private_key();
+        assert!(service_ids.insert(V3OnionServiceId::from_private_key(&private_key).to_string()));
+    }
+    assert_eq!(key_pool.len(), (0, CAPACITY));
+
+    Ok(())
+}
@@ -10,6 +10,7 @@ pub mod context;
 pub mod endpoint_client;
 #[cfg(not(fuzzing))]
 mod endpoint_client;
+mod endpoint_registry;
 #[cfg(fuzzing)]
 pub mod endpoint_server;
 #[cfg(not(fuzzing))]
@@ -23,3 +24,10 @@ mod identity_client;
 pub mod identity_server;
 #[cfg(not(fuzzing))]
 mod identity_server;
+mod key_pool;
+/// Counters and latency histograms describing a [`Context`](context::Context)'s activity
+pub mod metrics;
+mod rate_limiter;
+mod session_pool;
+mod timer_wheel;
+mod worker_pool;
@@ -0,0 +1,492 @@
+// standard
+#[cfg(feature = "metrics")]
+use std::collections::HashMap;
+use std::net::TcpStream;
+#[cfg(feature = "metrics")]
+use std::sync::atomic::{AtomicU64, Ordering};
+use std::time::Duration;
+#[cfg(feature = "metrics")]
+use std::time::Instant;
+
+// extern crates
+use honk_rpc::honk_rpc::Session;
+
+// internal crates
+use crate::context::HandshakeHandle;
+
+//
+// Metrics Snapshots
+//
+
+/// The number of buckets in a [`HistogramSnapshot`]
+pub const HISTOGRAM_BUCKETS: usize = 26;
+
+/// A latency histogram with exponentially sized buckets.
+///
+/// Bucket `0` counts samples shorter than 1 microsecond, bucket `i` for `0 < i < HISTOGRAM_BUCKETS - 1` counts samples of at least `2^(i-1)` and less than `2^i` microseconds, and the last bucket counts every sample of `2^(HISTOGRAM_BUCKETS - 2)` microseconds (about 16.8 seconds) or longer.
+#[derive(Clone, Copy, Debug, Default, PartialEq, Eq)]
+pub struct HistogramSnapshot {
+    /// The number of samples in each bucket
+    pub buckets: [u64; HISTOGRAM_BUCKETS],
+    /// The sum of every sample in microseconds
+    pub sum_micros: u64,
+}
+
+impl HistogramSnapshot {
+    /// The number of samples in the histogram.
+    pub fn count(&self) -> u64 {
+        self.buckets.iter().sum()
+    }
+
+    /// The mean of the histogram's samples, or `None` if it is empty.
+    pub fn mean(&self) -> Option<Duration> {
+        match self.count() {
+            0 => None,
+            count => Some(Duration::from_micros(self.sum_micros / count)),
+        }
+    }
+
+    /// An upper bound for the `quantile` (between `0.0` and `1.0`) of the histogram's samples, or `None` if it is empty. The bound is the upper bound of the bucket containing the quantile; samples in the last bucket are reported as its lower bound.
+    pub fn quantile(&self, quantile: f64) -> Option<Duration> {
+        let count = self.count();
+        if count == 0 {
+            return None;
+        }
+        // the rank of the sample at the quantile, counting from 1
+        let rank = ((quantile.clamp(0.0, 1.0) * count as f64).ceil() as u64).max(1);
+        let mut seen = 0u64;
+        for (index, bucket) in self.buckets.iter().enumerate() {
+            seen += bucket;
+            if seen >= rank {
+                return Some(Self::bucket_bound(index));
+            }
+        }
+        Some(Self::bucket_bound(HISTOGRAM_BUCKETS - 1))
+    }
+
+    // the exclusive upper bound of a bucket (or the lower bound of the last bucket)
+    fn bucket_bound(index: usize) -> Duration {
+        Duration::from_micros(1u64 << index.min(HISTOGRAM_BUCKETS - 2))
+    }
+}
+
+/// Counters and timings of one kind of handshake (e.g. incoming identity handshakes) driven by a [`Context`](crate::context::Context)
+#[derive(Clone, Copy, Debug, Default, PartialEq, Eq)]
+pub struct HandshakeMetrics {
+    /// Handshakes begun; for outgoing handshakes this includes those still waiting on their connection
+    pub started: u64,
+    /// Handshakes which completed successfully
+    pub completed: u64,
+    /// Handshakes rejected by either side
+    pub rejected: u64,
+    /// Handshakes which failed, including those which timed out
+    pub failed: u64,
+    /// Handshakes which failed because their peer fell silent for too long
+    pub timed_out: u64,
+    /// Handshakes aborted by the application
+    pub aborted: u64,
+    /// Handshakes currently in progress (including outgoing handshakes still waiting on their connection)
+    pub in_progress: u64,
+    /// Bytes read by the handshakes' honk-rpc sessions; bytes read by the final step of a handshake whose session is consumed by that step are not counted
+    pub bytes_read: u64,
+    /// Bytes written by the handshakes' honk-rpc sessions; bytes written by the final step of a handshake whose session is consumed by that step are not counted
+    pub bytes_written: u64,
+    /// Time from a handshake beginning to it completing, being rejected or failing
+    pub duration: HistogramSnapshot,
+    /// Time taken to establish outgoing handshakes' connections through the Tor Network
+    pub connect: HistogramSnapshot,
+    /// Time spent advancing a handshake by one step, including any cryptography
+    pub step: HistogramSnapshot,
+    /// Time handshakes spent waiting on the application, from a [`ContextEvent`](crate::context::ContextEvent) which must be answered being returned to the handshake's corresponding `Context` method being called
+    pub application_wait: HistogramSnapshot,
+}
+
+/// A point-in-time copy of a [`Context`](crate::context::Context)'s metrics, see [`Context::metrics()`](crate::context::Context::metrics)
+#[derive(Clone, Copy, Debug, Default, PartialEq, Eq)]
+pub struct MetricsSnapshot {
+    /// Whether gosling was built with the `metrics` feature; if not, every counter and histogram is always zero
+    pub enabled: bool,
+    /// Outgoing identity handshakes
+    pub identity_client: HandshakeMetrics,
+    /// Incoming identity handshakes
+    pub identity_server: HandshakeMetrics,
+    /// Outgoing endpoint handshakes
+    pub endpoint_client: HandshakeMetrics,
+    /// Incoming endpoint handshakes
+    pub endpoint_server: HandshakeMetrics,
+    /// Time spent in [`Context::update()`](crate::context::Context::update)
+    pub update: HistogramSnapshot,
+    /// Time spent in the [`TorProvider`](tor_interface::tor_provider::TorProvider)'s `update()` method
+    pub tor_provider_update: HistogramSnapshot,
+    /// Time spent verifying the batched signatures of incoming identity handshakes
+    pub signature_verification: HistogramSnapshot,
+    /// Time spent accepting incoming connections
+    pub accept: HistogramSnapshot,
+    /// Incoming connections accepted, including those shed by admission control
+    pub connections_accepted: u64,
+    /// Calls to [`Context::update()`](crate::context::Context::update) which ran out of accept budget or turns with connections possibly still waiting, see [`Context::set_max_accepts_per_update()`](crate::context::Context::set_max_accepts_per_update)
+    pub accept_budget_exhausted: u64,
+    /// Outgoing handshakes currently waiting on their connection
+    pub pending_connects: u64,
+    /// [`ContextEvent`](crate::context::ContextEvent)s returned by [`Context::update()`](crate::context::Context::update)
+    pub events_returned: u64,
+}
+
+//
+// Recorders
+//
+// The recorders below only do anything when the metrics feature is enabled; otherwise
+// they are zero-sized and never read the clock. Counters and histograms are relaxed
+// atomics so they may be shared with the handshake worker threads.
+//
+
+// a monotonic counter
+#[derive(Default)]
+pub(crate) struct Counter {
+    #[cfg(feature = "metrics")]
+    value: AtomicU64,
+}
+
+#[cfg_attr(not(feature = "metrics"), allow(unused_variables))]
+impl Counter {
+    #[inline]
+    pub fn add(&self, count: u64) {
+        #[cfg(feature = "metrics")]
+        self.value.fetch_add(count, Ordering::Relaxed);
+    }
+
+    #[inline]
+    pub fn increment(&self) {
+        self.add(1u64);
+    }
+
+    #[cfg(feature = "metrics")]
+    pub fn get(&self) -> u64 {
+        self.value.load(Ordering::Relaxed)
+    }
+
+    #[cfg(not(feature = "metrics"))]
+    pub fn get(&self) -> u64 {
+        0u64
+    }
+}
+
+// a latency histogram, see HistogramSnapshot
+#[derive(Default)]
+pub(crate) struct Histogram {
+    #[cfg(feature = "metrics")]
+    buckets: [AtomicU64; HISTOGRAM_BUCKETS],
+    #[cfg(feature = "metrics")]
+    sum_micros: AtomicU64,
+}
+
+#[cfg_attr(not(feature = "metrics"), allow(unused_variables))]
+impl Histogram {
+    #[inline]
+    pub fn record(&self, duration: Duration) {
+        #[cfg(feature = "metrics")]
+        {
+            let micros = u64::try_from(duration.as_micros()).unwrap_or(u64::MAX);
+            let index = (u64::BITS - micros.leading_zeros()) as usize;
+            self.buckets[index.min(HISTOGRAM_BUCKETS - 1)].fetch_add(1u64, Ordering::Relaxed);
+            self.sum_micros.fetch_add(micros, Ordering::Relaxed);
+        }
+    }
+
+    pub fn snapshot(&self) -> HistogramSnapshot {
+        #[cfg_attr(not(feature = "metrics"), allow(unused_mut))]
+        let mut snapshot = HistogramSnapshot::default();
+        #[cfg(feature = "metrics")]
+        {
+            for (count, bucket) in snapshot.buckets.iter_mut().zip(self.buckets.iter()) {
+                *count = bucket.load(Ordering::Relaxed);
+            }
+            snapshot.sum_micros = self.sum_micros.load(Ordering::Relaxed);
+        }
+        snapshot
+    }
+}
+
+// measures the time from its construction to record()
+pub(crate) struct Stopwatch {
+    #[cfg(feature = "metrics")]
+    start: Instant,
+}
+
+#[cfg_attr(not(feature = "metrics"), allow(unused_variables))]
+impl Stopwatch {
+    #[inline]
+    pub fn start() -> Self {
+        Self {
+            #[cfg(feature = "metrics")]
+            start: Instant::now(),
+        }
+    }
+
+    #[inline]
+    pub fn record(self, histogram: &Histogram) {
+        #[cfg(feature = "metrics")]
+        histogram.record(self.start.elapsed());
+    }
+}
+
+// how a handshake ended
+#[derive(Clone, Copy)]
+pub(crate) enum HandshakeOutcome {
+    Completed,
+    Rejected,
+    Failed,
+    TimedOut,
+    Aborted,
+}
+
+#[cfg(feature = "metrics")]
+struct HandshakeTimestamps {
+    started: Instant,
+    // set while the handshake waits on the application
+    application_wait_started: Option<Instant>,
+}
+
+// the metrics of one kind of handshake
+#[derive(Default)]
+pub(crate) struct HandshakeRecorder {
+    started: Counter,
+    completed: Counter,
+    rejected: Counter,
+    failed: Counter,
+    timed_out: Counter,
+    aborted: Counter,
+    bytes_read: Counter,
+    bytes_written: Counter,
+    duration: Histogram,
+    connect: Histogram,
+    step: Histogram,
+    application_wait: Histogram,
+    #[cfg(feature = "metrics")]
+    timestamps: HashMap<HandshakeHandle, HandshakeTimestamps>,
+}
+
+#[cfg_attr(not(feature = "metrics"), allow(unused_variables))]
+impl HandshakeRecorder {
+    // a handshake has begun
+    pub fn start(&mut self, handle: HandshakeHandle) {
+        self.started.increment();
+        #[cfg(feature = "metrics")]
+        self.timestamps.insert(
+            handle,
+            HandshakeTimestamps {
+                started: Instant::now(),
+                application_wait_started: None,
+            },
+        );
+    }
+
+    // an outgoing handshake's connection has been established
+    pub fn connected(&mut self, handle: HandshakeHandle) {
+        #[cfg(feature = "metrics")]
+        if let Some(timestamps) = self.timestamps.get(&handle) {
+            self.connect.record(timestamps.started.elapsed());
+        }
+    }
+
+    // a handshake has returned an event the application must answer
+    pub fn application_wait_started(&mut self, handle: HandshakeHandle) {
+        #[cfg(feature = "metrics")]
+        if let Some(timestamps) = self.timestamps.get_mut(&handle) {
+            timestamps.application_wait_started = Some(Instant::now());
+        }
+    }
+
+    // the application has answered a handshake's event
+    pub fn application_wait_ended(&mut self, handle: HandshakeHandle) {
+        #[cfg(feature = "metrics")]
+        if let Some(timestamps) = self.timestamps.get_mut(&handle) {
+            if let Some(application_wait_started) = timestamps.application_wait_started.take() {
+                self.application_wait
+                    .record(application_wait_started.elapsed());
+            }
+        }
+    }
+
+    // a handshake has ended
+    pub fn finish(&mut self, handle: HandshakeHandle, outcome: HandshakeOutcome) {
+        match outcome {
+            HandshakeOutcome::Completed => self.completed.increment(),
+            HandshakeOutcome::Rejected => self.rejected.increment(),
+            HandshakeOutcome::Failed => self.failed.increment(),
+            HandshakeOutcome::TimedOut => {
+                self.failed.increment();
+                self.timed_out.increment();
+            }
+            HandshakeOutcome::Aborted => self.aborted.increment(),
+        }
+        #[cfg(feature = "metrics")]
+        if let Some(timestamps) = self.timestamps.remove(&handle) {
+            if !matches!(outcome, HandshakeOutcome::Aborted) {
+                self.duration.record(timestamps.started.elapsed());
+            }
+        }
+    }
+
+    // advance a handshake by one step with update(), timing the step and counting
+    // the bytes its session moves; may be called from the handshake worker threads
+    #[cfg(feature = "metrics")]
+    pub fn step<H, R>(
+        &self,
+        handshake: &mut H,
+        session: impl Fn(&H) -> Option<&Session<TcpStream>>,
+        update: impl FnOnce(&mut H) -> R,
+    ) -> R {
+        let bytes = |handshake: &H| {
+            session(handshake)
+                .map(|session| (session.get_bytes_read(), session.get_bytes_written()))
+        };
+        let before = bytes(handshake);
+        let stopwatch = Stopwatch::start();
+        let result = update(handshake);
+        stopwatch.record(&self.step);
+        if let (Some((read_before, written_before)), Some((read, written))) =
+            (before, bytes(handshake))
+        {
+            self.bytes_read.add(read - read_before);
+            self.bytes_written.add(written - written_before);
+        }
+        result
+    }
+
+    #[cfg(not(feature = "metrics"))]
+    #[inline]
+    pub fn step<H, R>(
+        &self,
+        handshake: &mut H,
+        session: impl Fn(&H) -> Option<&Session<TcpStream>>,
+        update: impl FnOnce(&mut H) -> R,
+    ) -> R {
+        update(handshake)
+    }
+
+    pub fn snapshot(&self, in_progress: usize) -> HandshakeMetrics {
+        HandshakeMetrics {
+            started: self.started.get(),
+            completed: self.completed.get(),
+            rejected: self.rejected.get(),
+            failed: self.failed.get(),
+            timed_out: self.timed_out.get(),
+            aborted: self.aborted.get(),
+            in_progress: in_progress as u64,
+            bytes_read: self.bytes_read.get(),
+            bytes_written: self.bytes_written.get(),
+            duration: self.duration.snapshot(),
+            connect: self.connect.snapshot(),
+            step: self.step.snapshot(),
+            application_wait: self.application_wait.snapshot(),
+        }
+    }
+}
+
+// every metric recorded by a Context
+#[derive(Default)]
+pub(crate) struct Metrics {
+    pub identity_client: HandshakeRecorder,
+    pub identity_server: HandshakeRecorder,
+    pub endpoint_client: HandshakeRecorder,
+    pub endpoint_server: HandshakeRecorder,
+    pub update: Histogram,
+    pub tor_provider_update: Histogram,
+    pub signature_verification: Histogram,
+    pub accept: Histogram,
+    pub connections_accepted: Counter,
+    pub accept_budget_exhausted: Counter,
+    pub events_returned: Counter,
+}
+
+impl Metrics {
+    // the gauges are owned by the Context, so it passes them in
+    pub fn snapshot(
+        &self,
+        identity_clients: usize,
+        identity_servers: usize,
+        endpoint_clients: usize,
+        endpoint_servers: usize,
+        pending_connects: usize,
+    ) -> MetricsSnapshot {
+        MetricsSnapshot {
+            enabled: cfg!(feature = "metrics"),
+            identity_client: self.identity_client.snapshot(identity_clients),
+            identity_server: self.identity_server.snapshot(identity_servers),
+            endpoint_client: self.endpoint_client.snapshot(endpoint_clients),
+            endpoint_server: self.endpoint_server.snapshot(endpoint_servers),
+            update: self.update.snapshot(),
+            tor_provider_update: self.tor_provider_update.snapshot(),
+            signature_verification: self.signature_verification.snapshot(),
+            accept: self.accept.snapshot(),
+            connections_accepted: self.connections_accepted.get(),
+            accept_budget_exhausted: self.accept_budget_exhausted.get(),
+            pending_connects: pending_connects as u64,
+            events_returned: self.events_returned.get(),
+        }
+    }
+}
+
+//
+// Tracing
+//
+
+// enter a trace-level span named $name for the rest of the enclosing block when the
+// tracing feature is enabled
+macro_rules! trace_scope {
+    ($name:literal) => {
+        #[cfg(feature = "tracing")]
+        let _span = tracing::trace_span!($name).entered();
+    };
+}
+pub(crate) use trace_scope;
+
+#[test]
+fn test_histogram_snapshot() {
+    let mut histogram = HistogramSnapshot::default();
+    assert_eq!(histogram.count(), 0);
+    assert!(histogram.mean().is_none());
+    assert!(histogram.quantile(0.5).is_none());
+
+    // 90 samples in [1ms, 2ms) and 10 in [8ms, 16ms)
+    histogram.buckets[11] = 90;
+    histogram.buckets[14] = 10;
+    histogram.sum_micros = 90 * 1_500 + 10 * 10_000;
+    assert_eq!(histogram.count(), 100);
+    assert_eq!(histogram.mean(), Some(Duration::from_micros(2_350)));
+    assert_eq!(histogram.quantile(0.0), Some(Duration::from_micros(2_048)));
+    assert_eq!(histogram.quantile(0.9), Some(Duration::from_micros(2_048)));
+    assert_eq!(
+        histogram.quantile(0.91),
+        Some(Duration::from_micros(16_384))
+    );
+    assert_eq!(histogram.quantile(1.0), Some(Duration::from_micros(16_384)));
+
+    // the overflow bucket is reported as its lower bound
+    histogram.buckets[HISTOGRAM_BUCKETS - 1] = 1_000;
+    assert_eq!(
+        histogram.quantile(1.0),
+        Some(Duration::from_micros(1u64 << (HISTOGRAM_BUCKETS - 2)))
+    );
+}
+
+#[cfg(feature = "metrics")]
+#[test]
+fn test_histogram() {
+    let histogram = Histogram::default();
+    histogram.record(Duration::from_nanos(500));
+    histogram.record(Duration::from_micros(1));
+    histogram.record(Duration::from_micros(3));
+    histogram.record(Duration::from_micros(4));
+    histogram.record(Duration::from_secs(3_600));
+
+    let snapshot = histogram.snapshot();
+    assert_eq!(snapshot.count(), 5);
+    assert_eq!(snapshot.buckets[0], 1);
+    assert_eq!(snapshot.buckets[1], 1);
+    assert_eq!(snapshot.buckets[2], 1);
+    assert_eq!(snapshot.buckets[3], 1);
+    assert_eq!(snapshot.buckets[HISTOGRAM_BUCKETS - 1], 1);
+    assert_eq!(snapshot.sum_micros, 8 + 3_600_000_000);
+}
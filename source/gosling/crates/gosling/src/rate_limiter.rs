@@ -0,0 +1,150 @@
+// standard
+use std::collections::HashMap;
+use std::hash::Hash;
+use std::time::{Duration, Instant};
+
+//
+// Rate Limiter
+//
+
+struct TokenBucket {
+    tokens: u32,
+    // the instant the next token is due to be added is last_refill + refill_interval
+    last_refill: Instant,
+}
+
+// Per-key token buckets; each key may acquire up to burst tokens at once and
+// regains one token every refill_interval.
+//
+// Buckets which have refilled completely are indistinguishable from new ones, so they
+// are pruned whenever the number of buckets doubles, keeping memory proportional to
+// the number of recently seen keys.
+pub(crate) struct RateLimiter<K> {
+    burst: u32,
+    refill_interval: Duration,
+    buckets: HashMap<K, TokenBucket>,
+    // prune once there are more than this many buckets
+    prune_threshold: usize,
+}
+
+const MIN_PRUNE_THRESHOLD: usize = 64;
+
+impl<K: Clone + Eq + Hash> RateLimiter<K> {
+    pub fn new(burst: u32, refill_interval: Duration) -> Self {
+        Self {
+            burst,
+            refill_interval,
+            buckets: Default::default(),
+            prune_threshold: MIN_PRUNE_THRESHOLD,
+        }
+    }
+
+    // take one of key's tokens; returns false if key has none left
+    pub fn try_acquire(&mut self, key: &K, now: Instant) -> bool {
+        if self.burst == 0 {
+            return false;
+        }
+
+        if self.buckets.len() > self.prune_threshold {
+            self.prune(now);
+        }
+
+        let burst = self.burst;
+        let refill_interval = self.refill_interval;
+        let bucket = match self.buckets.get_mut(key) {
+            Some(bucket) => {
+                Self::refill(bucket, burst, refill_interval, now);
+                bucket
+            }
+            None => self.buckets.entry(key.clone()).or_insert(TokenBucket {
+                tokens: burst,
+                last_refill: now,
+            }),
+        };
+
+        if bucket.tokens == 0 {
+            false
+        } else {
+            bucket.tokens -= 1;
+            true
+        }
+    }
+
+    // add the tokens bucket has earned since its last refill
+    fn refill(bucket: &mut TokenBucket, burst: u32, refill_interval: Duration, now: Instant) {
+        if bucket.tokens >= burst {
+            bucket.last_refill = now;
+            return;
+        }
+        let elapsed = now.saturating_duration_since(bucket.last_refill);
+        let earned = match refill_interval.as_nanos() {
+            0 => u128::from(burst),
+            interval => elapsed.as_nanos() / interval,
+        };
+        if earned == 0 {
+            return;
+        }
+        let missing = burst - bucket.tokens;
+        if earned >= u128::from(missing) {
+            bucket.tokens = burst;
+            bucket.last_refill = now;
+        } else {
+            // earned < missing <= u32::MAX
+            let earned = earned as u32;
+            bucket.tokens += earned;
+            bucket.last_refill += refill_interval * earned;
+        }
+    }
+
+    // drop every bucket which has refilled completely
+    fn prune(&mut self, now: Instant) {
+        let burst = self.burst;
+        let refill_interval = self.refill_interval;
+        self.buckets.retain(|_key, bucket| {
+            Self::refill(bucket, burst, refill_interval, now);
+            bucket.tokens < burst
+        });
+        self.prune_threshold = (self.buckets.len() * 2).max(MIN_PRUNE_THRESHOLD);
+    }
+}
+
+#[test]
+fn test_rate_limiter() {
+    let start = Instant::now();
+    let at = |millis: u64| start + Duration::from_millis(millis);
+    let mut rate_limiter: RateLimiter<usize> = RateLimiter::new(3, Duration::from_millis(100));
+
+    // a key may use its whole burst at once
+    for _ in 0..3 {
+        assert!(rate_limiter.try_acquire(&0, at(0)));
+    }
+    assert!(!rate_limiter.try_acquire(&0, at(0)));
+    // without affecting other keys
+    assert!(rate_limiter.try_acquire(&1, at(0)));
+
+    // and regains one token per refill interval
+    assert!(!rate_limiter.try_acquire(&0, at(99)));
+    assert!(rate_limiter.try_acquire(&0, at(100)));
+    assert!(!rate_limiter.try_acquire(&0, at(199)));
+    assert!(rate_limiter.try_acquire(&0, at(250)));
+    // partial intervals carry over
+    assert!(rate_limiter.try_acquire(&0, at(300)));
+    assert!(!rate_limiter.try_acquire(&0, at(300)));
+
+    // but never more than its burst
+    for _ in 0..3 {
+        assert!(rate_limiter.try_acquire(&0, at(10_000)));
+    }
+    assert!(!rate_limiter.try_acquire(&0, at(10_000)));
+
+    // refilled buckets are pruned once there are many keys
+    for key in 1_000..2_000 {
+        assert!(rate_limiter.try_acquire(&key, at(20_000)));
+    }
+    for key in 3_000..4_000 {
+        assert!(rate_limiter.try_acquire(&key, at(30_000)));
+    }
+    assert!(rate_limiter.buckets.len() < 1_500);
+    assert!(!rate_limiter.buckets.contains_key(&1_000));
+    assert!(rate_limiter.buckets.contains_key(&3_999));
+}
@@ -0,0 +1,96 @@
+// extern crates
+use honk_rpc::honk_rpc::SessionBuffers;
+
+//
+// Session Pool
+//
+
+// Message buffers recycled from finished handshakes' honk-rpc sessions, handed
+// to new sessions so that a steady stream of short handshakes re-uses the same
+// allocations rather than growing fresh ones for every connection.
+//
+// Each entry holds at most (1 + 4) read buffers and 16 write buffers, none larger
+// than the maximum message size of the session which grew them. Identity and
+// endpoint sessions share one pool, so that is the larger of their limits, and the
+// pool's memory is bounded by capacity times that.
+pub(crate) struct SessionPool {
+    capacity: usize,
+    buffers: Vec<SessionBuffers>,
+}
+
+impl SessionPool {
+    pub fn new(capacity: usize) -> Self {
+        Self {
+            capacity,
+            buffers: Default::default(),
+        }
+    }
+
+    // change the number of buffers kept, dropping any over the new capacity
+    pub fn set_capacity(&mut self, capacity: usize) {
+        self.capacity = capacity;
+        self.buffers.truncate(capacity);
+        self.buffers.shrink_to(capacity);
+    }
+
+    // buffers for a new session, empty if the pool has none to spare
+    pub fn take(&mut self) -> SessionBuffers {
+        self.buffers.pop().unwrap_or_default()
+    }
+
+    // return a finished session's buffers for re-use by future sessions
+    pub fn recycle(&mut self, buffers: Option<SessionBuffers>) {
+        if let Some(buffers) = buffers {
+            // buffers which never allocated are not worth keeping
+            if self.buffers.len() < self.capacity && buffers.capacity() > 0 {
+                self.buffers.push(buffers);
+            }
+        }
+    }
+}
+
+#[test]
+fn test_session_pool() -> anyhow::Result<()> {
+    use std::net::{SocketAddr, TcpListener, TcpStream};
+
+    use honk_rpc::honk_rpc::Session;
+
+    let listener = TcpListener::bind(SocketAddr::from(([127, 0, 0, 1], 0u16)))?;
+    let socket_addr = listener.local_addr()?;
+    let mut session_pool = SessionPool::new(2);
+
+    // a session which never allocated has nothing worth pooling
+    let mut session = Session::new(TcpStream::connect(socket_addr)?);
+    session_pool.recycle(Some(session.take_buffers()));
+    assert!(session_pool.buffers.is_empty());
+
+    // but one which queued a request does
+    for _ in 0..3 {
+        let mut session =
+            Session::with_buffers(TcpStream::connect(socket_addr)?, session_pool.take());
+        session.client_call("namespace", "function", 0, bson::doc! {})?;
+        session_pool.recycle(Some(session.take_buffers()));
+        assert_eq!(session_pool.buffers.len(), 1);
+    }
+    let capacity = session_pool.buffers[0].capacity();
+    assert!(capacity > 0);
+
+    // new sessions are handed the pooled buffers and the pool never grows past its capacity
+    let first = session_pool.take();
+    assert_eq!(first.capacity(), capacity);
+    assert!(session_pool.take().capacity() == 0);
+    for _ in 0..3 {
+        let mut session = Session::new(TcpStream::connect(socket_addr)?);
+        session.client_call("namespace", "function", 0, bson::doc! {})?;
+        session_pool.recycle(Some(session.take_buffers()));
+    }
+    assert_eq!(session_pool.buffers.len(), 2);
+
+    session_pool.set_capacity(1);
+    assert_eq!(session_pool.buffers.len(), 1);
+    session_pool.set_capacity(0);
+    session_pool.recycle(Some(first));
+    assert!(session_pool.buffers.is_empty());
+
+    Ok(())
+}
@@ -0,0 +1,251 @@
+// standard
+use std::collections::HashMap;
+use std::hash::Hash;
+use std::time::{Duration, Instant};
+
+//
+// Timer Wheel
+//
+
+// each wheel level has 2^SLOT_BITS slots, and each slot of a level spans as many
+// ticks as the entire level below it; a tick is one millisecond
+const SLOT_BITS: u32 = 6;
+const SLOTS: usize = 1usize << SLOT_BITS;
+const LEVELS: usize = 6;
+const TICK_NANOS: u128 = 1_000_000u128;
+// the furthest ahead of the current tick an entry is filed; later deadlines are filed
+// this far out and re-filed once reached. Staying a full top-level slot short of the
+// wheel's span keeps every entry ahead of the current slot of its level
+const MAX_FILED_TICKS: u64 =
+    (1u64 << (SLOT_BITS * LEVELS as u32)) - (1u64 << (SLOT_BITS * (LEVELS as u32 - 1))) - 1;
+
+struct Timer {
+    // tick at (or after) which the timer expires
+    deadline: u64,
+    // distinguishes the timer's current slot entry from stale entries left behind
+    // by cancelled timers or earlier deadlines
+    generation: u64,
+}
+
+// A hierarchical timer wheel mapping keys to deadlines with millisecond precision.
+//
+// Arming, extending and cancelling a timer are O(1): cancelled timers leave stale
+// entries in their slots which are discarded when the slot is reached, and pushing a
+// deadline back only updates the timer in place, as the slot entry it already has is
+// re-filed further out when reached. Timers in the coarser levels cascade down into
+// finer levels as their slots are reached, so advancing the wheel only visits
+// occupied slots regardless of how much time has passed.
+pub(crate) struct TimerWheel<K> {
+    // the instant corresponding to tick 0
+    start: Instant,
+    // the wheel has processed all ticks before this one
+    elapsed: u64,
+    // LEVELS * SLOTS slots of (key, generation) entries
+    slots: Vec<Vec<(K, u64)>>,
+    // per-level bitmap of non-empty slots
+    occupied: [u64; LEVELS],
+    // the live timers
+    timers: HashMap<K, Timer>,
+    next_generation: u64,
+}
+
+impl<K: Copy + Eq + Hash> TimerWheel<K> {
+    pub fn new(start: Instant) -> Self {
+        Self {
+            start,
+            elapsed: 0u64,
+            slots: (0..LEVELS * SLOTS).map(|_| Default::default()).collect(),
+            occupied: [0u64; LEVELS],
+            timers: Default::default(),
+            next_generation: 0u64,
+        }
+    }
+
+    // arm the timer for key to expire at deadline, replacing any existing deadline
+    pub fn arm(&mut self, key: K, deadline: Instant) {
+        let deadline = self.instant_to_tick(deadline, true);
+        if let Some(timer) = self.timers.get_mut(&key) {
+            if deadline >= timer.deadline {
+                // the timer's slot entry is reached no later than the new deadline,
+                // at which point it is re-filed
+                timer.deadline = deadline;
+                return;
+            }
+        }
+
+        let generation = self.next_generation;
+        self.next_generation += 1;
+        self.timers.insert(
+            key,
+            Timer {
+                deadline,
+                generation,
+            },
+        );
+        self.file_entry(key, deadline, generation);
+    }
+
+    // cancel the timer for key; returns false if no timer was armed
+    pub fn cancel(&mut self, key: K) -> bool {
+        self.timers.remove(&key).is_some()
+    }
+
+    // advance the wheel to now and return the keys of every timer which expired
+    pub fn expire(&mut self, now: Instant) -> Vec<K> {
+        let now = self.instant_to_tick(now, false);
+        let mut expired: Vec<K> = Default::default();
+
+        while let Some((level, slot, slot_start)) = self.next_slot() {
+            if slot_start > now {
+                break;
+            }
+            self.elapsed = slot_start;
+
+            // entries are never re-filed into the slot being drained, so its
+            // allocation can be handed back afterwards
+            let index = level * SLOTS + slot;
+            let mut entries = std::mem::take(&mut self.slots[index]);
+            self.occupied[level] &= !(1u64 << slot);
+
+            for (key, generation) in entries.drain(..) {
+                let deadline = match self.timers.get(&key) {
+                    Some(timer) if timer.generation == generation => timer.deadline,
+                    // cancelled or re-armed earlier
+                    _ => continue,
+                };
+                if deadline <= self.elapsed {
+                    self.timers.remove(&key);
+                    expired.push(key);
+                } else {
+                    // cascade into a finer level, or re-file an extended deadline
+                    self.file_entry(key, deadline, generation);
+                }
+            }
+            self.slots[index] = entries;
+        }
+        self.elapsed = self.elapsed.max(now);
+
+        expired
+    }
+
+    // the earliest instant at which a timer may expire; this is a lower bound, as
+    // timers in the coarser levels are only located precisely once they cascade and
+    // cancelled timers are only discarded once their slot is reached
+    pub fn next_deadline(&self) -> Option<Instant> {
+        self.next_slot()
+            .map(|(_level, _slot, slot_start)| self.start + Duration::from_millis(slot_start))
+    }
+
+    // the number of armed timers
+    pub fn len(&self) -> usize {
+        self.timers.len()
+    }
+
+    // the earliest non-empty slot as (level, slot, first tick covered by the slot)
+    fn next_slot(&self) -> Option<(usize, usize, u64)> {
+        let mut next: Option<(usize, usize, u64)> = None;
+        for level in 0..LEVELS {
+            let occupied = self.occupied[level];
+            if occupied == 0 {
+                continue;
+            }
+            let slot_shift = SLOT_BITS * level as u32;
+            let current_slot = ((self.elapsed >> slot_shift) as usize) & (SLOTS - 1);
+            // slots behind the current one belong to the level's next rotation
+            let distance = occupied.rotate_right(current_slot as u32).trailing_zeros() as usize;
+            let slot = (current_slot + distance) & (SLOTS - 1);
+            let level_start = self.elapsed & !((1u64 << (slot_shift + SLOT_BITS)) - 1);
+            let slot_start = level_start + (((current_slot + distance) as u64) << slot_shift);
+            let slot_start = slot_start.max(self.elapsed);
+            match next {
+                Some((_, _, next_start)) if next_start <= slot_start => (),
+                _ => next = Some((level, slot, slot_start)),
+            }
+        }
+        next
+    }
+
+    // file an entry in the finest level whose current rotation reaches deadline
+    fn file_entry(&mut self, key: K, deadline: u64, generation: u64) {
+        let deadline = deadline
+            .max(self.elapsed)
+            .min(self.elapsed + MAX_FILED_TICKS);
+        // the level is determined by the most significant slot index in which the
+        // deadline differs from the current tick
+        let significant = (deadline ^ self.elapsed) | (SLOTS as u64 - 1);
+        let level = ((63 - significant.leading_zeros()) / SLOT_BITS) as usize;
+        let level = level.min(LEVELS - 1);
+        let slot = ((deadline >> (SLOT_BITS * level as u32)) as usize) & (SLOTS - 1);
+
+        self.slots[level * SLOTS + slot].push((key, generation));
+        self.occupied[level] |= 1u64 << slot;
+    }
+
+    // deadlines round up and the current time rounds down so timers never expire early
+    fn instant_to_tick(&self, instant: Instant, round_up: bool) -> u64 {
+        let nanos = instant.saturating_duration_since(self.start).as_nanos();
+        let ticks = if round_up {
+            (nanos + TICK_NANOS - 1) / TICK_NANOS
+        } else {
+            nanos / TICK_NANOS
+        };
+        ticks.min(u64::MAX as u128 / 2) as u64
+    }
+}
+
+#[test]
+fn test_timer_wheel() {
+    let start = Instant::now();
+    let mut wheel: TimerWheel<usize> = TimerWheel::new(start);
+    let at = |millis: u64| start + Duration::from_millis(millis);
+
+    // timers spread across several levels expire in order and never early
+    let deadlines: [u64; 7] = [0, 1, 63, 64, 4_095, 60_000, 3_600_000];
+    for (key, deadline) in deadlines.iter().enumerate() {
+        wheel.arm(key, at(*deadline));
+    }
+    assert_eq!(wheel.len(), deadlines.len());
+    assert_eq!(wheel.expire(at(0)), vec![0]);
+    for (key, deadline) in deadlines.iter().enumerate().skip(1) {
+        assert!(wheel.next_deadline().unwrap() <= at(*deadline));
+        assert!(wheel.expire(at(deadline - 1)).is_empty());
+        assert_eq!(wheel.expire(at(*deadline)), vec![key]);
+    }
+    assert_eq!(wheel.len(), 0);
+    assert!(wheel.next_deadline().is_none());
+
+    // cancelled timers never expire
+    wheel.arm(0, at(3_600_100));
+    wheel.arm(1, at(3_600_200));
+    assert!(wheel.cancel(0));
+    assert!(!wheel.cancel(0));
+    assert_eq!(wheel.expire(at(3_700_000)), vec![1]);
+
+    // extended timers expire at their new deadline, shortened ones at theirs
+    wheel.arm(0, at(3_800_000));
+    wheel.arm(0, at(3_900_000));
+    wheel.arm(1, at(3_900_000));
+    wheel.arm(1, at(3_750_000));
+    assert_eq!(wheel.expire(at(3_799_999)), vec![1]);
+    assert!(wheel.expire(at(3_899_999)).is_empty());
+    assert_eq!(wheel.expire(at(3_900_000)), vec![0]);
+
+    // deadlines in the past expire on the next advance
+    wheel.arm(2, at(1));
+    assert_eq!(wheel.expire(at(3_900_000)), vec![2]);
+
+    // deadlines beyond the wheel's span are re-filed until they are reached
+    let far = 3_900_000u64 + 3 * MAX_FILED_TICKS;
+    wheel.arm(3, at(far));
+    assert!(wheel.expire(at(far - 1)).is_empty());
+    assert_eq!(wheel.expire(at(far)), vec![3]);
+
+    // many timers sharing a slot expire together
+    let now = far + 10;
+    for key in 0..100 {
+        wheel.arm(key, at(now + 1_000));
+    }
+    let mut expired = wheel.expire(at(now + 1_000));
+    expired.sort();
+    assert_eq!(expired, (0..100).collect::<Vec<usize>>());
+}
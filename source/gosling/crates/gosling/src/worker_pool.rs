@@ -0,0 +1,259 @@
+// standard
+use std::sync::atomic::{AtomicUsize, Ordering};
+use std::sync::{Arc, Condvar, Mutex, MutexGuard};
+use std::thread::JoinHandle;
+
+//
+// Worker Pool
+//
+
+// a job run by the calling thread and any workers which join it
+type Job<'a> = &'a (dyn Fn() + Sync);
+
+struct WorkerPoolState {
+    // the job being run, if any; its lifetime is erased, see WorkerPool::run()
+    job: Option<Job<'static>>,
+    // the number of workers which may still join the job
+    vacancies: usize,
+    // the number of workers currently running the job
+    running: usize,
+    // whether a worker panicked while running the job
+    panicked: bool,
+    shutdown: bool,
+}
+
+struct WorkerPoolShared {
+    state: Mutex<WorkerPoolState>,
+    // signalled when a job is posted or the pool is shutting down
+    job_posted: Condvar,
+    // signalled when the last running worker finishes the job
+    job_finished: Condvar,
+}
+
+impl WorkerPoolShared {
+    fn lock(&self) -> MutexGuard<'_, WorkerPoolState> {
+        match self.state.lock() {
+            Ok(state) => state,
+            Err(_) => unreachable!("another thread panicked while holding the worker pool's lock"),
+        }
+    }
+
+    fn wait<'a>(
+        condvar: &Condvar,
+        state: MutexGuard<'a, WorkerPoolState>,
+    ) -> MutexGuard<'a, WorkerPoolState> {
+        match condvar.wait(state) {
+            Ok(state) => state,
+            Err(_) => unreachable!("another thread panicked while holding the worker pool's lock"),
+        }
+    }
+}
+
+// A pool of worker threads which help the calling thread work through a list of
+// items. The workers are spawned once and park between jobs, so a Context spreads
+// every update()'s handshake steps (and signature verification) across them
+// without spawning and joining threads each time.
+//
+// Jobs borrow from the calling thread's stack: run() does not return until every
+// worker which joined the job has finished it, so the borrows outlive their use.
+pub(crate) struct WorkerPool {
+    shared: Arc<WorkerPoolShared>,
+    worker_threads: Vec<JoinHandle<()>>,
+}
+
+impl WorkerPool {
+    // construct a pool whose jobs run on up to threads threads, including the
+    // calling thread; a pool of one thread spawns no workers
+    pub fn new(threads: usize) -> Result<Self, std::io::Error> {
+        let shared = Arc::new(WorkerPoolShared {
+            state: Mutex::new(WorkerPoolState {
+                job: None,
+                vacancies: 0,
+                running: 0,
+                panicked: false,
+                shutdown: false,
+            }),
+            job_posted: Condvar::new(),
+            job_finished: Condvar::new(),
+        });
+
+        let mut pool = Self {
+            shared,
+            worker_threads: Vec::with_capacity(threads.saturating_sub(1)),
+        };
+        for index in 1..threads {
+            let shared = Arc::clone(&pool.shared);
+            // on failure dropping pool stops the workers spawned so far
+            pool.worker_threads.push(
+                std::thread::Builder::new()
+                    .name(format!("gosling-worker-{}", index))
+                    .spawn(move || Self::work(&shared))?,
+            );
+        }
+        Ok(pool)
+    }
+
+    // the number of threads which may run a job, including the calling thread
+    pub fn threads(&self) -> usize {
+        1 + self.worker_threads.len()
+    }
+
+    // call f on every item on up to threads threads (including the calling thread)
+    // and return the results in item order; each thread claims one item at a time,
+    // so a few slow items cannot stall everything queued behind them
+    pub fn map<T: Send, R: Send>(
+        &self,
+        items: Vec<T>,
+        threads: usize,
+        f: impl Fn(T) -> R + Sync,
+    ) -> Vec<R> {
+        let threads = threads.min(self.threads()).min(items.len());
+        if threads <= 1 {
+            return items.into_iter().map(f).collect();
+        }
+
+        let tasks: Vec<Mutex<(Option<T>, Option<R>)>> = items
+            .into_iter()
+            .map(|item| Mutex::new((Some(item), None)))
+            .collect();
+        let next_task = AtomicUsize::new(0);
+        self.run(threads - 1, &|| {
+            while let Some(task) = tasks.get(next_task.fetch_add(1, Ordering::Relaxed)) {
+                let mut task = match task.lock() {
+                    Ok(task) => task,
+                    Err(_) => unreachable!("another thread panicked while holding a task's lock"),
+                };
+                if let Some(item) = task.0.take() {
+                    task.1 = Some(f(item));
+                }
+            }
+        });
+
+        tasks
+            .into_iter()
+            .map(|task| match task.into_inner() {
+                Ok((None, Some(result))) => result,
+                _ => unreachable!(),
+            })
+            .collect()
+    }
+
+    // run job on the calling thread and on up to helpers parked workers, returning
+    // once every one of them has finished it
+    fn run(&self, helpers: usize, job: Job<'_>) {
+        // waits for the workers even should job panic on the calling thread
+        struct JobGuard<'a>(&'a WorkerPoolShared);
+        impl Drop for JobGuard<'_> {
+            fn drop(&mut self) {
+                let mut state = self.0.lock();
+                state.job = None;
+                state.vacancies = 0;
+                while state.running > 0 {
+                    state = WorkerPoolShared::wait(&self.0.job_finished, state);
+                }
+            }
+        }
+
+        let helpers = helpers.min(self.worker_threads.len());
+        {
+            let mut state = self.shared.lock();
+            // SAFETY: workers only call the job between taking it from the state and
+            // decrementing running, and JobGuard clears it and waits for running to
+            // reach zero before this function returns
+            state.job = Some(unsafe { std::mem::transmute::<Job<'_>, Job<'static>>(job) });
+            state.vacancies = helpers;
+            state.panicked = false;
+        }
+        for _ in 0..helpers {
+            self.shared.job_posted.notify_one();
+        }
+
+        let guard = JobGuard(&self.shared);
+        job();
+        drop(guard);
+
+        if self.shared.lock().panicked {
+            panic!("a gosling worker thread panicked");
+        }
+    }
+
+    // the worker threads' body
+    fn work(shared: &WorkerPoolShared) {
+        loop {
+            let job = {
+                let mut state = shared.lock();
+                while !state.shutdown && (state.job.is_none() || state.vacancies == 0) {
+                    state = WorkerPoolShared::wait(&shared.job_posted, state);
+                }
+                if state.shutdown {
+                    return;
+                }
+                state.vacancies -= 1;
+                state.running += 1;
+                match state.job {
+                    Some(job) => job,
+                    None => unreachable!(),
+                }
+            };
+
+            let result = std::panic::catch_unwind(std::panic::AssertUnwindSafe(job));
+
+            let mut state = shared.lock();
+            state.panicked |= result.is_err();
+            state.running -= 1;
+            if state.running == 0 {
+                shared.job_finished.notify_one();
+            }
+        }
+    }
+}
+
+impl Drop for WorkerPool {
+    fn drop(&mut self) {
+        self.shared.lock().shutdown = true;
+        self.shared.job_posted.notify_all();
+        for worker_thread in self.worker_threads.drain(..) {
+            let _ = worker_thread.join();
+        }
+    }
+}
+
+#[test]
+fn test_worker_pool() -> Result<(), std::io::Error> {
+    use std::collections::BTreeSet;
+    use std::thread::ThreadId;
+
+    const ITEM_COUNT: usize = 64;
+
+    // a single-threaded pool runs everything on the calling thread
+    let worker_pool = WorkerPool::new(1)?;
+    assert_eq!(worker_pool.threads(), 1);
+    let thread_ids = worker_pool.map((0..ITEM_COUNT).collect(), 4, |_| {
+        std::thread::current().id()
+    });
+    assert!(thread_ids
+        .iter()
+        .all(|thread_id| *thread_id == std::thread::current().id()));
+
+    // results come back in item order however the items are spread, and the same
+    // parked workers run every job
+    let worker_pool = WorkerPool::new(4)?;
+    assert_eq!(worker_pool.threads(), 4);
+    let mut all_thread_ids: BTreeSet<ThreadId> = Default::default();
+    for _ in 0..16 {
+        let mut items: Vec<usize> = (0..ITEM_COUNT).collect();
+        let results = worker_pool.map(items.iter_mut().collect(), 4, |item: &mut usize| {
+            *item *= 2;
+            std::thread::sleep(std::time::Duration::from_micros(100));
+            (*item, std::thread::current().id())
+        });
+        for (index, (item, thread_id)) in results.into_iter().enumerate() {
+            assert_eq!(item, 2 * index);
+            assert_eq!(items[index], 2 * index);
+            all_thread_ids.insert(thread_id);
+        }
+    }
+    assert!(all_thread_ids.len() <= worker_pool.threads());
+
+    Ok(())
+}
@@ -18,6 +18,58 @@ use gosling::context::*;
 
 const INVALID_HANDSHAKE_HANDLE: HandshakeHandle = !0usize;
 
+// a Context using the mock tor provider
+#[cfg(feature = "tor-interface/mock-tor-provider")]
+fn new_mock_context(private_key: Ed25519PrivateKey) -> anyhow::Result<Context> {
+    Ok(Context::new(
+        Box::new(MockTorClient::new()),
+        420,
+        420,
+        std::time::Duration::from_secs(60),
+        4096,
+        None,
+        private_key,
+    )?)
+}
+
+// bootstrap a Context and update it until bootstrap completes
+#[cfg(feature = "tor-interface/mock-tor-provider")]
+fn bootstrap_context(context: &mut Context) -> anyhow::Result<()> {
+    context.bootstrap()?;
+    let mut bootstrap_complete = false;
+    while !bootstrap_complete {
+        for event in context.update()?.drain(..) {
+            if let ContextEvent::TorBootstrapCompleted = event {
+                bootstrap_complete = true;
+            }
+        }
+    }
+    Ok(())
+}
+
+// a Context using the mock tor provider which has completed bootstrapping
+#[cfg(feature = "tor-interface/mock-tor-provider")]
+fn new_bootstrapped_mock_context(private_key: Ed25519PrivateKey) -> anyhow::Result<Context> {
+    let mut context = new_mock_context(private_key)?;
+    bootstrap_context(&mut context)?;
+    Ok(context)
+}
+
+// start a Context's identity server and update it until the server is published
+#[cfg(feature = "tor-interface/mock-tor-provider")]
+fn start_identity_server_and_wait(context: &mut Context) -> anyhow::Result<()> {
+    context.identity_server_start()?;
+    let mut identity_server_published = false;
+    while !identity_server_published {
+        for event in context.update()?.drain(..) {
+            if let ContextEvent::IdentityServerPublished = event {
+                identity_server_published = true;
+            }
+        }
+    }
+    Ok(())
+}
+
 #[test]
 #[cfg(feature = "tor-interface/mock-tor-provider")]
 fn test_mock_client_gosling_context() -> anyhow::Result<()> {
@@ -26,6 +78,975 @@ fn test_mock_client_gosling_context() -> anyhow::Result<()> {
     gosling_context_test(alice_tor_client, pat_tor_client)
 }
 
+#[test]
+#[cfg(feature = "tor-interface/mock-tor-provider")]
+fn test_mock_client_gosling_context_connect_failure() -> anyhow::Result<()> {
+    let pat_private_key = Ed25519PrivateKey::generate();
+    let mut pat = new_bootstrapped_mock_context(pat_private_key)?;
+
+    // nobody is listening on these onion services, so both handshakes must
+    // return a handle right away and then fail in a later update()
+    let missing_identity_service_id =
+        V3OnionServiceId::from_private_key(&Ed25519PrivateKey::generate());
+    let identity_handle = pat.identity_client_begin_handshake(
+        missing_identity_service_id,
+        "test_endpoint".to_string(),
+    )?;
+
+    let missing_endpoint_service_id =
+        V3OnionServiceId::from_private_key(&Ed25519PrivateKey::generate());
+    let endpoint_handle = pat.endpoint_client_begin_handshake(
+        missing_endpoint_service_id,
+        X25519PrivateKey::generate(),
+        "test_channel".to_string(),
+    )?;
+    assert_ne!(identity_handle, endpoint_handle);
+
+    let mut identity_handshake_failed = false;
+    let mut endpoint_handshake_failed = false;
+    while !identity_handshake_failed || !endpoint_handshake_failed {
+        for event in pat.update()?.drain(..) {
+            match event {
+                ContextEvent::IdentityClientHandshakeFailed { handle, reason } => {
+                    assert_eq!(handle, identity_handle);
+                    println!("Pat identity handshake failed with: {:?}", reason);
+                    identity_handshake_failed = true;
+                }
+                ContextEvent::EndpointClientHandshakeFailed { handle, reason } => {
+                    assert_eq!(handle, endpoint_handle);
+                    println!("Pat endpoint handshake failed with: {:?}", reason);
+                    endpoint_handshake_failed = true;
+                }
+                ContextEvent::TorLogReceived { line: _ } => (),
+                evt => bail!("pat.update() returned unexpected event: {:?}", evt),
+            }
+        }
+    }
+
+    // failed handshakes are no longer tracked by the context
+    assert!(pat
+        .identity_client_abort_handshake(identity_handle)
+        .is_err());
+    assert!(pat
+        .endpoint_client_abort_handshake(endpoint_handle)
+        .is_err());
+
+    Ok(())
+}
+
+#[test]
+#[cfg(feature = "tor-interface/mock-tor-provider")]
+fn test_mock_client_gosling_context_wait_events() -> anyhow::Result<()> {
+    use std::time::{Duration, Instant};
+
+    let alice_private_key = Ed25519PrivateKey::generate();
+    let alice_service_id = V3OnionServiceId::from_private_key(&alice_private_key);
+    let mut alice = new_bootstrapped_mock_context(alice_private_key)?;
+    start_identity_server_and_wait(&mut alice)?;
+
+    // once idle, waits sleep until they time out
+    while !alice.update()?.is_empty() {}
+    const SHORT_TIMEOUT: Duration = Duration::from_millis(200);
+    let start = Instant::now();
+    alice.wait_events(Some(SHORT_TIMEOUT))?;
+    assert!(start.elapsed() >= SHORT_TIMEOUT / 2);
+
+    // but end immediately while there is work to do
+    const LONG_TIMEOUT: Duration = Duration::from_secs(30);
+    let mut pat = new_mock_context(Ed25519PrivateKey::generate())?;
+    pat.bootstrap()?;
+    let mut pat_bootstrap_complete = false;
+    while !pat_bootstrap_complete {
+        let start = Instant::now();
+        pat.wait_events(Some(LONG_TIMEOUT))?;
+        assert!(start.elapsed() < LONG_TIMEOUT);
+        for event in pat.update()?.drain(..) {
+            if let ContextEvent::TorBootstrapCompleted = event {
+                pat_bootstrap_complete = true;
+            }
+        }
+    }
+
+    // and wake up as soon as a client connects to the identity server
+    pat.identity_client_begin_handshake(alice_service_id, "test_endpoint".to_string())?;
+
+    let start = Instant::now();
+    let mut alice_handshake_started = false;
+    while !alice_handshake_started {
+        alice.wait_events(Some(LONG_TIMEOUT))?;
+        assert!(start.elapsed() < LONG_TIMEOUT);
+        for event in alice.update()?.drain(..) {
+            if let ContextEvent::IdentityServerHandshakeStarted { handle: _ } = event {
+                alice_handshake_started = true;
+            }
+        }
+    }
+
+    Ok(())
+}
+
+#[test]
+#[cfg(all(
+    feature = "tor-interface/mock-tor-provider",
+    any(target_os = "linux", target_os = "macos")
+))]
+fn test_mock_client_gosling_context_event_waiter_fd() -> anyhow::Result<()> {
+    use std::time::{Duration, Instant};
+
+    use polling::{Event, Events, Poller};
+
+    let alice_private_key = Ed25519PrivateKey::generate();
+    let alice_service_id = V3OnionServiceId::from_private_key(&alice_private_key);
+    let mut alice = new_bootstrapped_mock_context(alice_private_key)?;
+    start_identity_server_and_wait(&mut alice)?;
+    let mut pat = new_bootstrapped_mock_context(Ed25519PrivateKey::generate())?;
+
+    const LONG_TIMEOUT: Duration = Duration::from_secs(30);
+    while !alice.update()?.is_empty() {}
+
+    // an external event loop waits on the waiter's descriptor, which an idle context leaves unreadable
+    let waiter = alice.event_waiter(None)?;
+    assert_eq!(waiter.timeout(), None);
+    let fd = match waiter.as_raw_fd() {
+        Some(fd) => fd,
+        None => bail!("idle context has no descriptor to wait on"),
+    };
+    let poller = Poller::new()?;
+    unsafe { poller.add(fd, Event::readable(0))? };
+    let mut events = Events::new();
+    assert_eq!(
+        poller.wait(&mut events, Some(Duration::from_millis(200)))?,
+        0
+    );
+
+    // until a client connects to the identity server
+    pat.identity_client_begin_handshake(alice_service_id, "test_endpoint".to_string())?;
+    let start = Instant::now();
+    while poller.wait(&mut events, Some(Duration::from_millis(10)))? == 0 {
+        assert!(start.elapsed() < LONG_TIMEOUT);
+        pat.update()?;
+    }
+    waiter.wait()?;
+
+    let start = Instant::now();
+    let mut alice_handshake_started = false;
+    while !alice_handshake_started {
+        assert!(start.elapsed() < LONG_TIMEOUT);
+        for event in alice.update()?.drain(..) {
+            if let ContextEvent::IdentityServerHandshakeStarted { handle: _ } = event {
+                alice_handshake_started = true;
+            }
+        }
+    }
+
+    Ok(())
+}
+
+#[test]
+#[cfg(feature = "tor-interface/mock-tor-provider")]
+fn test_mock_client_gosling_context_handshake_worker_threads() -> anyhow::Result<()> {
+    use std::collections::BTreeMap;
+
+    // enough concurrent handshakes to keep every worker thread busy
+    const CLIENT_COUNT: usize = 16;
+
+    // alice drives her incoming handshakes on several threads
+    let alice_private_key = Ed25519PrivateKey::generate();
+    let alice_service_id = V3OnionServiceId::from_private_key(&alice_private_key);
+    let mut alice = new_bootstrapped_mock_context(alice_private_key)?;
+    alice.set_handshake_worker_threads(4)?;
+    start_identity_server_and_wait(&mut alice)?;
+
+    // and many pats all request an endpoint at once
+    let mut pats: Vec<Context> = Default::default();
+    for _ in 0..CLIENT_COUNT {
+        let mut pat = new_bootstrapped_mock_context(Ed25519PrivateKey::generate())?;
+        pat.identity_client_begin_handshake(alice_service_id.clone(), "endpoint".to_string())?;
+        pats.push(pat);
+    }
+
+    // every server handshake must still report its steps in order
+    let mut server_steps: BTreeMap<HandshakeHandle, usize> = Default::default();
+    let mut servers_completed = 0usize;
+    let mut clients_completed = 0usize;
+    while servers_completed < CLIENT_COUNT || clients_completed < CLIENT_COUNT {
+        for event in alice.update()?.drain(..) {
+            match event {
+                ContextEvent::IdentityServerHandshakeStarted { handle } => {
+                    assert_eq!(server_steps.insert(handle, 1), None);
+                }
+                ContextEvent::IdentityServerEndpointRequestReceived { handle, .. } => {
+                    assert_eq!(server_steps.insert(handle, 2), Some(1));
+                    alice.identity_server_handle_endpoint_request_received(
+                        handle,
+                        true,
+                        true,
+                        doc! {},
+                    )?;
+                }
+                ContextEvent::IdentityServerChallengeResponseReceived { handle, .. } => {
+                    assert_eq!(server_steps.insert(handle, 3), Some(2));
+                    alice.identity_server_handle_challenge_response_received(handle, true)?;
+                }
+                ContextEvent::IdentityServerHandshakeCompleted { handle, .. } => {
+                    assert_eq!(server_steps.remove(&handle), Some(3));
+                    servers_completed += 1;
+                }
+                ContextEvent::TorLogReceived { line: _ } => (),
+                evt => bail!("alice.update() returned unexpected event: {:?}", evt),
+            }
+        }
+
+        for pat in pats.iter_mut() {
+            for event in pat.update()?.drain(..) {
+                match event {
+                    ContextEvent::IdentityClientChallengeReceived { handle, .. } => {
+                        pat.identity_client_handle_challenge_received(handle, doc! {})?;
+                    }
+                    ContextEvent::IdentityClientHandshakeCompleted { .. } => {
+                        clients_completed += 1;
+                    }
+                    ContextEvent::TorLogReceived { line: _ } => (),
+                    evt => bail!("pat.update() returned unexpected event: {:?}", evt),
+                }
+            }
+        }
+    }
+    assert!(server_steps.is_empty());
+
+    Ok(())
+}
+
+#[test]
+#[cfg(feature = "tor-interface/mock-tor-provider")]
+fn test_mock_client_gosling_context_max_accepts_per_update() -> anyhow::Result<()> {
+    const CLIENT_COUNT: usize = 8;
+    const MAX_ACCEPTS: usize = 3;
+
+    let handshakes_started = |context: &mut Context| -> anyhow::Result<usize> {
+        let mut handshakes_started = 0usize;
+        for event in context.update()?.drain(..) {
+            match event {
+                ContextEvent::IdentityServerHandshakeStarted { .. } => handshakes_started += 1,
+                ContextEvent::TorLogReceived { line: _ } => (),
+                evt => bail!("alice.update() returned unexpected event: {:?}", evt),
+            }
+        }
+        Ok(handshakes_started)
+    };
+
+    let alice_private_key = Ed25519PrivateKey::generate();
+    let alice_service_id = V3OnionServiceId::from_private_key(&alice_private_key);
+    let mut alice = new_bootstrapped_mock_context(alice_private_key)?;
+    alice.set_max_accepts_per_update(Some(MAX_ACCEPTS));
+    start_identity_server_and_wait(&mut alice)?;
+
+    // mock connections are made immediately, so every pat is waiting in the
+    // identity listener's backlog before alice's next update()
+    let mut pats: Vec<Context> = Default::default();
+    for _ in 0..CLIENT_COUNT {
+        let mut pat = new_bootstrapped_mock_context(Ed25519PrivateKey::generate())?;
+        pat.identity_client_begin_handshake(alice_service_id.clone(), "endpoint".to_string())?;
+        pats.push(pat);
+    }
+
+    // alice accepts at most MAX_ACCEPTS connections per update()
+    let mut accepted = 0usize;
+    while accepted < CLIENT_COUNT {
+        let started = handshakes_started(&mut alice)?;
+        assert_eq!(started, MAX_ACCEPTS.min(CLIENT_COUNT - accepted));
+        accepted += started;
+    }
+    assert_eq!(handshakes_started(&mut alice)?, 0);
+
+    // without a limit alice drains the whole backlog in one update()
+    alice.set_max_accepts_per_update(Some(0));
+    for _ in 0..CLIENT_COUNT {
+        let mut pat = new_bootstrapped_mock_context(Ed25519PrivateKey::generate())?;
+        pat.identity_client_begin_handshake(alice_service_id.clone(), "endpoint".to_string())?;
+        pats.push(pat);
+    }
+    assert_eq!(handshakes_started(&mut alice)?, CLIENT_COUNT);
+
+    Ok(())
+}
+
+#[test]
+#[cfg(feature = "tor-interface/mock-tor-provider")]
+fn test_mock_client_gosling_context_accept_turns() -> anyhow::Result<()> {
+    const IDENTITY_CLIENT_COUNT: usize = 4;
+
+    let alice_private_key = Ed25519PrivateKey::generate();
+    let alice_service_id = V3OnionServiceId::from_private_key(&alice_private_key);
+    let mut alice = new_bootstrapped_mock_context(alice_private_key)?;
+    alice.set_max_accepts_per_update(Some(1));
+    alice.set_max_identity_server_handshakes(1);
+    start_identity_server_and_wait(&mut alice)?;
+    let mut endpoint_servers: Vec<(V3OnionServiceId, X25519PrivateKey)> = Default::default();
+    for _ in 0..2 {
+        let endpoint_private_key = Ed25519PrivateKey::generate();
+        let client_auth_private_key = X25519PrivateKey::generate();
+        alice.endpoint_server_start(
+            endpoint_private_key.clone(),
+            "endpoint".to_string(),
+            V3OnionServiceId::from_private_key(&Ed25519PrivateKey::generate()),
+            X25519PublicKey::from_private_key(&client_auth_private_key),
+        )?;
+        endpoint_servers.push((
+            V3OnionServiceId::from_private_key(&endpoint_private_key),
+            client_auth_private_key,
+        ));
+    }
+    let mut endpoint_servers_published = 0usize;
+    while endpoint_servers_published < 2 {
+        for event in alice.update()?.drain(..) {
+            match event {
+                ContextEvent::EndpointServerPublished { .. } => endpoint_servers_published += 1,
+                ContextEvent::TorLogReceived { line: _ } => (),
+                evt => bail!("alice.update() returned unexpected event: {:?}", evt),
+            }
+        }
+    }
+
+    // flood the identity server, then connect once to each endpoint server
+    let mut pat = new_bootstrapped_mock_context(Ed25519PrivateKey::generate())?;
+    for _ in 0..IDENTITY_CLIENT_COUNT {
+        pat.identity_client_begin_handshake(alice_service_id.clone(), "endpoint".to_string())?;
+    }
+    for (endpoint_service_id, client_auth_private_key) in endpoint_servers {
+        pat.endpoint_client_begin_handshake(
+            endpoint_service_id,
+            client_auth_private_key,
+            "channel".to_string(),
+        )?;
+    }
+
+    // the servers take turns, so each accepts one connection in as many updates
+    // as there are servers, however many connections the identity server has waiting
+    let mut identity_handshakes_started = 0usize;
+    let mut endpoint_handshakes_started = 0usize;
+    for _ in 0..3 {
+        let mut handshakes_started = 0usize;
+        for event in alice.update()?.drain(..) {
+            match event {
+                ContextEvent::IdentityServerHandshakeStarted { .. } => {
+                    identity_handshakes_started += 1;
+                    handshakes_started += 1;
+                }
+                ContextEvent::EndpointServerHandshakeStarted { .. } => {
+                    endpoint_handshakes_started += 1;
+                    handshakes_started += 1;
+                }
+                ContextEvent::IdentityServerEndpointRequestReceived { .. } => (),
+                ContextEvent::TorLogReceived { line: _ } => (),
+                evt => bail!("alice.update() returned unexpected event: {:?}", evt),
+            }
+        }
+        assert_eq!(handshakes_started, 1);
+    }
+    assert_eq!(identity_handshakes_started, 1);
+    assert_eq!(endpoint_handshakes_started, 2);
+
+    // connections over the identity server's handshake limit are shed without
+    // spending the accept budget, at most one per update
+    assert_eq!(alice.identity_server_admission_stats().connections_shed, 0);
+    for _ in 0..IDENTITY_CLIENT_COUNT {
+        alice.update()?;
+    }
+    assert_eq!(
+        alice.identity_server_admission_stats().connections_shed,
+        (IDENTITY_CLIENT_COUNT - 1) as u64
+    );
+
+    Ok(())
+}
+
+#[test]
+#[cfg(feature = "tor-interface/mock-tor-provider")]
+fn test_mock_client_gosling_context_key_pool() -> anyhow::Result<()> {
+    use std::collections::BTreeSet;
+
+    // more clients than pooled keys so some keys must be generated inline
+    const CLIENT_COUNT: usize = 6;
+    const KEY_POOL_SIZE: usize = 2;
+
+    let new_context = |private_key: Ed25519PrivateKey| -> anyhow::Result<Context> {
+        let mut context = new_bootstrapped_mock_context(private_key)?;
+        context.set_key_pool_size(KEY_POOL_SIZE)?;
+        Ok(context)
+    };
+
+    let alice_private_key = Ed25519PrivateKey::generate();
+    let alice_service_id = V3OnionServiceId::from_private_key(&alice_private_key);
+    let mut alice = new_context(alice_private_key)?;
+    alice.set_max_accepts_per_update(Some(0));
+    start_identity_server_and_wait(&mut alice)?;
+
+    let mut pats: Vec<Context> = Default::default();
+    for _ in 0..CLIENT_COUNT {
+        let mut pat = new_context(Ed25519PrivateKey::generate())?;
+        pat.identity_client_begin_handshake(alice_service_id.clone(), "endpoint".to_string())?;
+        pats.push(pat);
+    }
+
+    // every handshake completes with a key of its own
+    let mut server_endpoint_service_ids: BTreeSet<String> = Default::default();
+    let mut client_endpoint_service_ids: BTreeSet<String> = Default::default();
+    let mut client_auth_public_keys: BTreeSet<String> = Default::default();
+    while server_endpoint_service_ids.len() < CLIENT_COUNT
+        || client_endpoint_service_ids.len() < CLIENT_COUNT
+    {
+        for event in alice.update()?.drain(..) {
+            match event {
+                ContextEvent::IdentityServerHandshakeStarted { .. } => (),
+                ContextEvent::IdentityServerEndpointRequestReceived { handle, .. } => {
+                    alice.identity_server_handle_endpoint_request_received(
+                        handle,
+                        true,
+                        true,
+                        doc! {},
+                    )?;
+                }
+                ContextEvent::IdentityServerChallengeResponseReceived { handle, .. } => {
+                    alice.identity_server_handle_challenge_response_received(handle, true)?;
+                }
+                ContextEvent::IdentityServerHandshakeCompleted {
+                    endpoint_private_key,
+                    client_auth_public_key,
+                    ..
+                } => {
+                    let endpoint_service_id =
+                        V3OnionServiceId::from_private_key(&endpoint_private_key);
+                    assert!(server_endpoint_service_ids.insert(endpoint_service_id.to_string()));
+                    assert!(client_auth_public_keys.insert(client_auth_public_key.to_base32()));
+                }
+                ContextEvent::TorLogReceived { line: _ } => (),
+                evt => bail!("alice.update() returned unexpected event: {:?}", evt),
+            }
+        }
+
+        for pat in pats.iter_mut() {
+            for event in pat.update()?.drain(..) {
+                match event {
+                    ContextEvent::IdentityClientChallengeReceived { handle, .. } => {
+                        pat.identity_client_handle_challenge_received(handle, doc! {})?;
+                    }
+                    ContextEvent::IdentityClientHandshakeCompleted {
+                        endpoint_service_id,
+                        ..
+                    } => {
+                        assert!(client_endpoint_service_ids.insert(endpoint_service_id.to_string()));
+                    }
+                    ContextEvent::TorLogReceived { line: _ } => (),
+                    evt => bail!("pat.update() returned unexpected event: {:?}", evt),
+                }
+            }
+        }
+    }
+    assert_eq!(server_endpoint_service_ids, client_endpoint_service_ids);
+
+    // disabling the pool stops its thread
+    alice.set_key_pool_size(0)?;
+
+    Ok(())
+}
+
+#[test]
+#[cfg(feature = "tor-interface/mock-tor-provider")]
+fn test_mock_client_gosling_context_admission_control() -> anyhow::Result<()> {
+    let alice_private_key = Ed25519PrivateKey::generate();
+    let alice_service_id = V3OnionServiceId::from_private_key(&alice_private_key);
+    let mut alice = new_bootstrapped_mock_context(alice_private_key)?;
+    alice.set_max_accepts_per_update(Some(0));
+    start_identity_server_and_wait(&mut alice)?;
+
+    // connections beyond the concurrent handshake limit are closed on accept
+    alice.set_max_identity_server_handshakes(1);
+    let mut pat = new_bootstrapped_mock_context(Ed25519PrivateKey::generate())?;
+    let first_handle =
+        pat.identity_client_begin_handshake(alice_service_id.clone(), "endpoint".to_string())?;
+    let second_handle =
+        pat.identity_client_begin_handshake(alice_service_id.clone(), "endpoint".to_string())?;
+    let mut alice_first_handle: Option<HandshakeHandle> = None;
+    let mut second_failed = false;
+    while alice_first_handle.is_none() || !second_failed {
+        for event in alice.update()?.drain(..) {
+            match event {
+                ContextEvent::IdentityServerHandshakeStarted { handle } => {
+                    assert!(alice_first_handle.is_none());
+                    alice_first_handle = Some(handle);
+                }
+                ContextEvent::IdentityServerEndpointRequestReceived { .. } => (),
+                ContextEvent::TorLogReceived { line: _ } => (),
+                evt => bail!("alice.update() returned unexpected event: {:?}", evt),
+            }
+        }
+        for event in pat.update()?.drain(..) {
+            match event {
+                ContextEvent::IdentityClientHandshakeFailed { handle, .. } => {
+                    assert!(handle == first_handle || handle == second_handle);
+                    second_failed = true;
+                }
+                ContextEvent::TorLogReceived { line: _ } => (),
+                evt => bail!("pat.update() returned unexpected event: {:?}", evt),
+            }
+        }
+    }
+    assert_eq!(alice.identity_server_admission_stats().connections_shed, 1);
+    pat.identity_client_abort_handshake(first_handle).ok();
+    pat.identity_client_abort_handshake(second_handle).ok();
+    alice.set_max_identity_server_handshakes(0);
+
+    // a client beyond its rate limit fails before the application hears about it
+    alice.set_identity_client_rate_limit(1, std::time::Duration::from_secs(3600));
+    // and disallowed clients are rejected without a challenge
+    alice.set_identity_server_early_rejection(true);
+    let mut pat = new_bootstrapped_mock_context(Ed25519PrivateKey::generate())?;
+    pat.identity_client_begin_handshake(alice_service_id.clone(), "endpoint".to_string())?;
+    pat.identity_client_begin_handshake(alice_service_id.clone(), "endpoint".to_string())?;
+    let mut alice_rejected = false;
+    let mut alice_rate_limited = false;
+    let mut pat_failures = 0usize;
+    while !alice_rejected || !alice_rate_limited || pat_failures < 2 {
+        for event in alice.update()?.drain(..) {
+            match event {
+                ContextEvent::IdentityServerHandshakeStarted { .. } => (),
+                ContextEvent::IdentityServerEndpointRequestReceived { handle, .. } => {
+                    alice.identity_server_handle_endpoint_request_received(
+                        handle,
+                        false,
+                        true,
+                        doc! {},
+                    )?;
+                }
+                ContextEvent::IdentityServerHandshakeRejected {
+                    client_allowed,
+                    client_requested_endpoint_valid,
+                    client_proof_signature_valid,
+                    ..
+                } => {
+                    assert!(!client_allowed);
+                    assert!(client_requested_endpoint_valid);
+                    // the client never got to prove anything
+                    assert!(!client_proof_signature_valid);
+                    alice_rejected = true;
+                }
+                ContextEvent::IdentityServerHandshakeFailed { handle, reason } => match reason {
+                    gosling::context::Error::ClientRateLimited(_) => alice_rate_limited = true,
+                    // the handshake pat aborted above
+                    _ if Some(handle) == alice_first_handle => (),
+                    reason => bail!("unexpected identity server failure: {:?}", reason),
+                },
+                ContextEvent::TorLogReceived { line: _ } => (),
+                evt => bail!("alice.update() returned unexpected event: {:?}", evt),
+            }
+        }
+        for event in pat.update()?.drain(..) {
+            match event {
+                ContextEvent::IdentityClientHandshakeFailed { .. } => pat_failures += 1,
+                ContextEvent::TorLogReceived { line: _ } => (),
+                evt => bail!("pat.update() returned unexpected event: {:?}", evt),
+            }
+        }
+    }
+
+    let admission_stats = alice.identity_server_admission_stats();
+    assert_eq!(admission_stats.handshakes_rate_limited, 1);
+    assert_eq!(admission_stats.handshakes_rejected_early, 1);
+
+    Ok(())
+}
+
+#[test]
+#[cfg(feature = "tor-interface/mock-tor-provider")]
+fn test_mock_client_gosling_context_metrics() -> anyhow::Result<()> {
+    let alice_private_key = Ed25519PrivateKey::generate();
+    let alice_service_id = V3OnionServiceId::from_private_key(&alice_private_key);
+    let mut alice = new_bootstrapped_mock_context(alice_private_key)?;
+    start_identity_server_and_wait(&mut alice)?;
+
+    let mut pat = new_bootstrapped_mock_context(Ed25519PrivateKey::generate())?;
+    // a handshake aborted while still connecting
+    let aborted_handle =
+        pat.identity_client_begin_handshake(alice_service_id.clone(), "endpoint".to_string())?;
+    assert_eq!(pat.metrics().identity_client.in_progress, 1);
+    assert_eq!(pat.metrics().pending_connects, 1);
+    pat.identity_client_abort_handshake(aborted_handle)?;
+    assert_eq!(pat.metrics().identity_client.in_progress, 0);
+
+    // and one which completes
+    pat.identity_client_begin_handshake(alice_service_id, "endpoint".to_string())?;
+    let mut alice_handshake_completed = false;
+    let mut pat_handshake_completed = false;
+    while !alice_handshake_completed || !pat_handshake_completed {
+        for event in alice.update()?.drain(..) {
+            match event {
+                ContextEvent::IdentityServerHandshakeStarted { .. } => (),
+                ContextEvent::IdentityServerEndpointRequestReceived { handle, .. } => {
+                    alice.identity_server_handle_endpoint_request_received(
+                        handle,
+                        true,
+                        true,
+                        doc! {},
+                    )?;
+                }
+                ContextEvent::IdentityServerChallengeResponseReceived { handle, .. } => {
+                    alice.identity_server_handle_challenge_response_received(handle, true)?;
+                }
+                ContextEvent::IdentityServerHandshakeCompleted { .. } => {
+                    alice_handshake_completed = true;
+                }
+                ContextEvent::TorLogReceived { line: _ } => (),
+                evt => bail!("alice.update() returned unexpected event: {:?}", evt),
+            }
+        }
+        for event in pat.update()?.drain(..) {
+            match event {
+                ContextEvent::IdentityClientChallengeReceived { handle, .. } => {
+                    pat.identity_client_handle_challenge_received(handle, doc! {})?;
+                }
+                ContextEvent::IdentityClientHandshakeCompleted { .. } => {
+                    pat_handshake_completed = true;
+                }
+                ContextEvent::TorLogReceived { line: _ } => (),
+                evt => bail!("pat.update() returned unexpected event: {:?}", evt),
+            }
+        }
+    }
+
+    let alice_metrics = alice.metrics();
+    let pat_metrics = pat.metrics();
+    assert_eq!(alice_metrics.enabled, cfg!(feature = "metrics"));
+    assert_eq!(alice_metrics.identity_server.in_progress, 0);
+    assert_eq!(pat_metrics.identity_client.in_progress, 0);
+    assert_eq!(pat_metrics.pending_connects, 0);
+    if !alice_metrics.enabled {
+        assert_eq!(alice_metrics, MetricsSnapshot::default());
+        return Ok(());
+    }
+
+    let identity_server = alice_metrics.identity_server;
+    assert_eq!(identity_server.started, 1);
+    assert_eq!(identity_server.completed, 1);
+    assert_eq!(identity_server.failed + identity_server.rejected, 0);
+    assert_eq!(identity_server.duration.count(), 1);
+    // endpoint request and challenge response
+    assert_eq!(identity_server.application_wait.count(), 2);
+    assert!(identity_server.step.count() > 0);
+    assert!(identity_server.bytes_read > 0 && identity_server.bytes_written > 0);
+    assert_eq!(alice_metrics.connections_accepted, 1);
+    assert_eq!(alice_metrics.signature_verification.count(), 1);
+
+    let identity_client = pat_metrics.identity_client;
+    assert_eq!(identity_client.started, 2);
+    assert_eq!(identity_client.completed, 1);
+    assert_eq!(identity_client.aborted, 1);
+    assert_eq!(identity_client.duration.count(), 1);
+    assert_eq!(identity_client.connect.count(), 1);
+    assert_eq!(identity_client.application_wait.count(), 1);
+    // alice reads everything pat writes, though the bytes of a handshake's final
+    // step are not counted if its session is consumed by that step
+    assert!(identity_client.bytes_written <= identity_server.bytes_read);
+
+    assert!(pat_metrics.update.count() > 0);
+    assert_eq!(
+        pat_metrics.update.count(),
+        pat_metrics.tor_provider_update.count()
+    );
+    assert!(pat_metrics.events_returned > 0);
+
+    Ok(())
+}
+
+#[test]
+#[cfg(feature = "tor-interface/mock-tor-provider")]
+fn test_mock_client_gosling_context_warm_restart() -> anyhow::Result<()> {
+    let mut alice = new_mock_context(Ed25519PrivateKey::generate())?;
+
+    // servers started before bootstrap are queued and started together once it completes
+    let endpoint_private_key = Ed25519PrivateKey::generate();
+    let endpoint_service_id = V3OnionServiceId::from_private_key(&endpoint_private_key);
+    let client_identity = V3OnionServiceId::from_private_key(&Ed25519PrivateKey::generate());
+    let client_auth = X25519PublicKey::from_private_key(&X25519PrivateKey::generate());
+    alice.identity_server_start()?;
+    alice.endpoint_server_start(
+        endpoint_private_key.clone(),
+        "endpoint".to_string(),
+        client_identity.clone(),
+        client_auth.clone(),
+    )?;
+    assert!(alice.identity_server_start().is_err());
+    assert!(alice
+        .endpoint_server_start(
+            endpoint_private_key.clone(),
+            "endpoint".to_string(),
+            client_identity.clone(),
+            client_auth.clone(),
+        )
+        .is_err());
+
+    // queued servers may be stopped and restarted
+    alice.endpoint_server_stop(endpoint_service_id.clone())?;
+    assert!(alice.endpoint_server_configs().is_empty());
+    alice.endpoint_servers_start(vec![EndpointServerConfig {
+        endpoint_private_key,
+        endpoint_name: "endpoint".to_string(),
+        client_identity,
+        client_auth,
+        priority: 0,
+        active: false,
+    }])?;
+
+    // and are part of the snapshot an application persists across restarts
+    let endpoint_server_configs = alice.endpoint_server_configs();
+    assert_eq!(endpoint_server_configs.len(), 1);
+    assert_eq!(endpoint_server_configs[0].endpoint_name, "endpoint");
+    assert!(endpoint_server_configs[0].active);
+
+    alice.bootstrap()?;
+    let mut bootstrap_complete = false;
+    let mut identity_server_published = false;
+    let mut endpoint_server_published = false;
+    while !bootstrap_complete || !identity_server_published || !endpoint_server_published {
+        for event in alice.update()?.drain(..) {
+            match event {
+                ContextEvent::TorBootstrapStatusReceived { .. } => (),
+                ContextEvent::TorBootstrapCompleted => bootstrap_complete = true,
+                ContextEvent::TorLogReceived { .. } => (),
+                ContextEvent::IdentityServerPublished => {
+                    assert!(bootstrap_complete);
+                    identity_server_published = true;
+                }
+                ContextEvent::EndpointServerPublished {
+                    endpoint_service_id: published_service_id,
+                    endpoint_name,
+                } => {
+                    assert!(bootstrap_complete);
+                    assert_eq!(published_service_id, endpoint_service_id);
+                    assert_eq!(endpoint_name, "endpoint");
+                    endpoint_server_published = true;
+                }
+                evt => bail!("alice.update() returned unexpected event: {:?}", evt),
+            }
+        }
+    }
+    assert_eq!(alice.endpoint_server_configs().len(), 1);
+
+    alice.endpoint_server_stop(endpoint_service_id)?;
+    assert!(alice.endpoint_server_configs().is_empty());
+
+    Ok(())
+}
+
+#[test]
+#[cfg(feature = "tor-interface/mock-tor-provider")]
+fn test_mock_client_gosling_context_dormant_endpoint_servers() -> anyhow::Result<()> {
+    use std::time::{Duration, Instant};
+
+    let mut alice = new_bootstrapped_mock_context(Ed25519PrivateKey::generate())?;
+
+    // update a context until exactly the given endpoint servers have been published
+    fn update_until_published(
+        context: &mut Context,
+        endpoint_service_ids: &[V3OnionServiceId],
+    ) -> anyhow::Result<()> {
+        let mut unpublished = endpoint_service_ids.to_vec();
+        while !unpublished.is_empty() {
+            for event in context.update()?.drain(..) {
+                match event {
+                    ContextEvent::TorLogReceived { .. } => (),
+                    ContextEvent::EndpointServerPublished {
+                        endpoint_service_id,
+                        endpoint_name,
+                    } => {
+                        assert_eq!(endpoint_name, "endpoint");
+                        match unpublished
+                            .iter()
+                            .position(|service_id| *service_id == endpoint_service_id)
+                        {
+                            Some(index) => unpublished.swap_remove(index),
+                            None => bail!("unexpected endpoint server published"),
+                        };
+                    }
+                    evt => bail!("context.update() returned unexpected event: {:?}", evt),
+                }
+            }
+        }
+        Ok(())
+    }
+
+    let client_identity = V3OnionServiceId::from_private_key(&Ed25519PrivateKey::generate());
+    let client_auth = X25519PublicKey::from_private_key(&X25519PrivateKey::generate());
+    let endpoint_private_keys: Vec<Ed25519PrivateKey> =
+        (0..3).map(|_| Ed25519PrivateKey::generate()).collect();
+    let endpoint_service_ids: Vec<V3OnionServiceId> = endpoint_private_keys
+        .iter()
+        .map(V3OnionServiceId::from_private_key)
+        .collect();
+    let endpoint_server_config = |endpoint_private_key: &Ed25519PrivateKey| EndpointServerConfig {
+        endpoint_private_key: endpoint_private_key.clone(),
+        endpoint_name: "endpoint".to_string(),
+        client_identity: client_identity.clone(),
+        client_auth: client_auth.clone(),
+        priority: 0,
+        active: false,
+    };
+
+    // registered endpoint servers lie dormant
+    alice.endpoint_servers_register(
+        endpoint_private_keys
+            .iter()
+            .map(endpoint_server_config)
+            .collect(),
+    )?;
+    assert!(alice
+        .endpoint_servers_register(vec![endpoint_server_config(&endpoint_private_keys[0])])
+        .is_err());
+    assert_eq!(alice.endpoint_server_configs().len(), 3);
+    for endpoint_service_id in endpoint_service_ids.iter() {
+        assert!(!alice.endpoint_server_is_active(endpoint_service_id)?);
+    }
+    let is_active = |alice: &Context| -> anyhow::Result<Vec<bool>> {
+        endpoint_service_ids
+            .iter()
+            .map(|endpoint_service_id| Ok(alice.endpoint_server_is_active(endpoint_service_id)?))
+            .collect()
+    };
+
+    // at most two endpoint servers may be published at once
+    alice.set_max_published_endpoint_servers(2);
+    assert!(alice
+        .endpoint_servers_activate(&endpoint_service_ids)
+        .is_err());
+    alice.endpoint_servers_activate(&endpoint_service_ids[..2])?;
+    update_until_published(&mut alice, &endpoint_service_ids[..2])?;
+    assert_eq!(is_active(&alice)?, vec![true, true, false]);
+
+    // so activating a third deactivates the one with the lowest priority
+    alice.endpoint_server_set_priority(&endpoint_service_ids[0], 1)?;
+    alice.endpoint_servers_activate(&endpoint_service_ids[2..])?;
+    assert_eq!(is_active(&alice)?, vec![true, false, true]);
+    update_until_published(&mut alice, &endpoint_service_ids[2..])?;
+
+    // endpoint servers may be reactivated before their onion-service is torn down and are
+    // published again
+    alice.endpoint_servers_deactivate(&endpoint_service_ids[2..])?;
+    assert_eq!(is_active(&alice)?, vec![true, false, false]);
+    alice.endpoint_servers_activate(&endpoint_service_ids[2..])?;
+    assert_eq!(is_active(&alice)?, vec![true, false, true]);
+    update_until_published(&mut alice, &endpoint_service_ids[2..])?;
+
+    // without waits sleeping through their being queued
+    const LONG_TIMEOUT: Duration = Duration::from_secs(30);
+    alice.endpoint_servers_deactivate(&endpoint_service_ids[2..])?;
+    alice.endpoint_servers_activate(&endpoint_service_ids[2..])?;
+    let start = Instant::now();
+    let mut endpoint_server_published = false;
+    while !endpoint_server_published {
+        alice.wait_events(Some(LONG_TIMEOUT))?;
+        assert!(start.elapsed() < LONG_TIMEOUT);
+        for event in alice.update()?.drain(..) {
+            match event {
+                ContextEvent::TorLogReceived { .. } => (),
+                ContextEvent::EndpointServerPublished {
+                    endpoint_service_id,
+                    ..
+                } => {
+                    assert_eq!(endpoint_service_id, endpoint_service_ids[2]);
+                    endpoint_server_published = true;
+                }
+                evt => bail!("alice.update() returned unexpected event: {:?}", evt),
+            }
+        }
+    }
+
+    // configs restore each endpoint server's priority and whether it was active
+    let mut restored = new_mock_context(Ed25519PrivateKey::generate())?;
+    restored.set_max_published_endpoint_servers(2);
+    restored.endpoint_servers_register(alice.endpoint_server_configs())?;
+    assert_eq!(is_active(&restored)?, vec![true, false, true]);
+    restored.endpoint_servers_activate(&endpoint_service_ids[1..2])?;
+    assert_eq!(is_active(&restored)?, vec![true, true, false]);
+    drop(restored);
+
+    // lowering the maximum deactivates endpoint servers straight away
+    alice.set_max_published_endpoint_servers(1);
+    assert_eq!(is_active(&alice)?, vec![true, false, false]);
+
+    // as does going without connections for too long
+    alice.set_endpoint_server_idle_timeout(Some(Duration::ZERO));
+    alice.update()?;
+    assert_eq!(is_active(&alice)?, vec![false, false, false]);
+    alice.set_endpoint_server_idle_timeout(None);
+
+    // stopped endpoint servers are unregistered
+    alice.endpoint_server_stop(endpoint_service_ids[0].clone())?;
+    assert!(alice
+        .endpoint_server_is_active(&endpoint_service_ids[0])
+        .is_err());
+    assert!(alice
+        .endpoint_servers_activate(&endpoint_service_ids[..1])
+        .is_err());
+    assert_eq!(alice.endpoint_server_configs().len(), 2);
+
+    Ok(())
+}
+
+#[test]
+#[cfg(feature = "tor-interface/mock-tor-provider")]
+fn test_mock_client_gosling_context_endpoint_client_prewarm() -> anyhow::Result<()> {
+    let mut pat = new_mock_context(Ed25519PrivateKey::generate())?;
+
+    let endpoint_servers: Vec<(V3OnionServiceId, X25519PrivateKey)> = (0..4)
+        .map(|_| {
+            (
+                V3OnionServiceId::from_private_key(&Ed25519PrivateKey::generate()),
+                X25519PrivateKey::generate(),
+            )
+        })
+        .collect();
+
+    // pre-warming requires a connection to the tor network
+    assert!(pat.endpoint_client_prewarm(&endpoint_servers).is_err());
+
+    bootstrap_context(&mut pat)?;
+
+    // the count of each endpoint server's descriptor prefetches the mock tor provider logs
+    let prefetches = |pat: &mut Context| -> anyhow::Result<Vec<usize>> {
+        let lines: Vec<String> = pat
+            .update()?
+            .drain(..)
+            .filter_map(|event| match event {
+                ContextEvent::TorLogReceived { line } => Some(line),
+                _ => None,
+            })
+            .collect();
+        Ok(endpoint_servers
+            .iter()
+            .map(|(endpoint_service_id, _)| {
+                let endpoint_service_id = endpoint_service_id.to_string();
+                lines
+                    .iter()
+                    .filter(|line| {
+                        line.contains("prefetching descriptor")
+                            && line.contains(&endpoint_service_id)
+                    })
+                    .count()
+            })
+            .collect())
+    };
+
+    pat.endpoint_client_prewarm(&[])?;
+    assert_eq!(prefetches(&mut pat)?, vec![0; 4]);
+    pat.endpoint_client_prewarm(&endpoint_servers)?;
+    assert_eq!(prefetches(&mut pat)?, vec![1; 4]);
+    // and may be repeated once descriptors have expired
+    pat.endpoint_client_prewarm(&endpoint_servers)?;
+    assert_eq!(prefetches(&mut pat)?, vec![1; 4]);
+
+    Ok(())
+}
+
 #[test]
 #[serial]
 #[cfg(feature = "tor-interface/legacy-tor-provider")]
@@ -41,6 +1062,7 @@ fn test_legacy_client_gosling_context() -> anyhow::Result<()> {
         allowed_ports: None,
         pluggable_transports: None,
         bridge_lines: None,
+        unix_domain_sockets: false,
     };
     let alice_tor_client = Box::new(LegacyTorClient::new(tor_config)?);
 
@@ -53,6 +1075,7 @@ fn test_legacy_client_gosling_context() -> anyhow::Result<()> {
         allowed_ports: None,
         pluggable_transports: None,
         bridge_lines: None,
+        unix_domain_sockets: false,
     };
     let pat_tor_client = Box::new(LegacyTorClient::new(tor_config)?);
 
@@ -172,8 +1195,8 @@ fn gosling_context_test(
     // Pat begins client handshake
     println!("Pat identity client handshake begin");
     let mut pat_identity_handshake_handle: HandshakeHandle = INVALID_HANDSHAKE_HANDLE;
+    let mut pat_identity_handshake_tries_remaining = 3;
     {
-        let mut pat_identity_handshake_tries_remaining = 3;
         while pat_identity_handshake_tries_remaining > 0
             && pat_identity_handshake_handle == INVALID_HANDSHAKE_HANDLE
         {
@@ -215,6 +1238,7 @@ fn gosling_context_test(
                         handle,
                         client_service_id,
                         requested_endpoint,
+                        ..
                     } => {
                         assert_eq!(alice_identity_handshake_handle, handle);
                         assert_eq!(pat_service_id, client_service_id);
@@ -228,6 +1252,22 @@ fn gosling_context_test(
             }
             for event in pat.update()?.drain(..) {
                 match event {
+                    // connecting happens in the background so retry on failure
+                    ContextEvent::IdentityClientHandshakeFailed { handle, reason } => {
+                        assert_eq!(handle, pat_identity_handshake_handle);
+                        println!(
+                            "Pat connecting to Alice's identity server failed with: {:?}",
+                            reason
+                        );
+                        pat_identity_handshake_tries_remaining -= 1;
+                        if pat_identity_handshake_tries_remaining == 0 {
+                            bail!("pat.identity_client_handshake() failed no more retries remain");
+                        }
+                        pat_identity_handshake_handle = pat.identity_client_begin_handshake(
+                            alice_service_id.clone(),
+                            "test_endpoint".to_string(),
+                        )?;
+                    }
                     ContextEvent::TorLogReceived { line: _ } => (),
                     evt => bail!("pat.update() returned unexpected event: {:?}", evt),
                 }
@@ -423,8 +1463,8 @@ fn gosling_context_test(
     // Pat begins client handshake
     println!("Pat endpoint client handshake begin");
     let mut pat_endpoint_handshake_handle: HandshakeHandle = INVALID_HANDSHAKE_HANDLE;
+    let mut pat_endpoint_handshake_tries_remaining = 3;
     {
-        let mut pat_endpoint_handshake_tries_remaining = 3;
         while pat_endpoint_handshake_tries_remaining > 0
             && pat_endpoint_handshake_handle == INVALID_HANDSHAKE_HANDLE
         {
@@ -480,6 +1520,23 @@ fn gosling_context_test(
             }
             for event in pat.update()?.drain(..) {
                 match event {
+                    // connecting happens in the background so retry on failure
+                    ContextEvent::EndpointClientHandshakeFailed { handle, reason } => {
+                        assert_eq!(handle, pat_endpoint_handshake_handle);
+                        println!(
+                            "Pat connecting to Alice's endpoint server failed with:\n{:?}",
+                            reason
+                        );
+                        pat_endpoint_handshake_tries_remaining -= 1;
+                        if pat_endpoint_handshake_tries_remaining == 0 {
+                            bail!("pat.endpoint_client_begin_handshake() failed no more retries remain");
+                        }
+                        pat_endpoint_handshake_handle = pat.endpoint_client_begin_handshake(
+                            alice_endpoint_service_id.clone(),
+                            pat_auth_private_key.clone(),
+                            "test_channel".to_string(),
+                        )?;
+                    }
                     ContextEvent::TorLogReceived { line: _ } => (),
                     evt => bail!("pat.update() returned unexpected event: {:?}", evt),
                 }
@@ -0,0 +1,159 @@
+// standard
+use std::net::{SocketAddr, TcpListener, TcpStream};
+
+// extern crates
+use bench_common::{report_allocations, CountingAllocator};
+use bson::doc;
+use bson::spec::BinarySubtype;
+use criterion::{black_box, criterion_group, criterion_main, BenchmarkId, Criterion, Throughput};
+
+// internal crates
+use honk_rpc::honk_rpc::*;
+
+#[global_allocator]
+static GLOBAL: CountingAllocator = CountingAllocator;
+
+// payload sizes exercised by the round-trip benchmark
+const PAYLOAD_SIZES: [usize; 5] = [0, 64, 1024, 16 * 1024, 256 * 1024];
+
+// Echoes the 'data' argument back to the caller
+struct EchoApiSet {}
+
+impl ApiSet for EchoApiSet {
+    fn namespace(&self) -> &str {
+        "bench"
+    }
+
+    fn exec_function(
+        &mut self,
+        name: &str,
+        version: i32,
+        mut args: bson::document::Document,
+        _request_cookie: Option<RequestCookie>,
+    ) -> Option<Result<Option<bson::Bson>, ErrorCode>> {
+        match (name, version) {
+            ("echo", 0) => match args.remove("data") {
+                Some(data) => Some(Ok(Some(data))),
+                None => Some(Err(ErrorCode::Runtime(1i32))),
+            },
+            _ => Some(Err(ErrorCode::RequestFunctionInvalid)),
+        }
+    }
+}
+
+fn session_pair(max_message_size: i32) -> (Session<TcpStream>, Session<TcpStream>) {
+    let socket_addr = SocketAddr::from(([127, 0, 0, 1], 0u16));
+    let listener = TcpListener::bind(socket_addr).unwrap();
+    let socket_addr = listener.local_addr().unwrap();
+
+    let stream1 = TcpStream::connect(socket_addr).unwrap();
+    stream1.set_nonblocking(true).unwrap();
+    let (stream2, _socket_addr) = listener.accept().unwrap();
+    stream2.set_nonblocking(true).unwrap();
+
+    let mut server = Session::new(stream1);
+    server.set_max_message_size(max_message_size).unwrap();
+    let mut client = Session::new(stream2);
+    client.set_max_message_size(max_message_size).unwrap();
+
+    (server, client)
+}
+
+// a single client call and its response
+fn round_trip(
+    server: &mut Session<TcpStream>,
+    client: &mut Session<TcpStream>,
+    apiset: &mut EchoApiSet,
+    args: &bson::document::Document,
+) {
+    let cookie = client
+        .client_call("bench", "echo", 0, args.clone())
+        .unwrap();
+    loop {
+        let apisets: &mut [&mut dyn ApiSet] = &mut [&mut *apiset];
+        server.update(Some(apisets)).unwrap();
+        client.update(None).unwrap();
+        match client.client_next_response() {
+            Some(Response::Success {
+                cookie: response_cookie,
+                result,
+            }) => {
+                assert_eq!(cookie, response_cookie);
+                black_box(result);
+                return;
+            }
+            Some(_) => panic!("unexpected response"),
+            None => (),
+        }
+    }
+}
+
+fn payload(size: usize) -> bson::document::Document {
+    doc! {
+        "data" : bson::Bson::Binary(bson::Binary{subtype: BinarySubtype::Generic, bytes: vec![0u8; size]}),
+    }
+}
+
+fn bench_session_round_trip(c: &mut Criterion) {
+    let mut group = c.benchmark_group("session_round_trip");
+    for size in PAYLOAD_SIZES {
+        let args = payload(size);
+        // request and response both carry the payload plus some framing
+        let max_message_size = (size + 1024) as i32;
+
+        let (mut server, mut client) = session_pair(max_message_size);
+        let mut apiset = EchoApiSet {};
+
+        report_allocations(&format!("session_round_trip/{}", size), 100, || {
+            round_trip(&mut server, &mut client, &mut apiset, &args)
+        });
+
+        group.throughput(Throughput::Bytes(2 * size as u64));
+        group.bench_with_input(BenchmarkId::from_parameter(size), &args, |b, args| {
+            b.iter(|| round_trip(&mut server, &mut client, &mut apiset, args))
+        });
+    }
+    group.finish();
+}
+
+fn bench_get_request_section_size(c: &mut Criterion) {
+    let mut group = c.benchmark_group("get_request_section_size");
+    for size in PAYLOAD_SIZES {
+        let args = payload(size);
+
+        report_allocations(&format!("get_request_section_size/{}", size), 100, || {
+            black_box(
+                get_request_section_size(
+                    Some(0),
+                    Some("bench".to_string()),
+                    "echo".to_string(),
+                    Some(0),
+                    Some(args.clone()),
+                )
+                .unwrap(),
+            );
+        });
+
+        group.throughput(Throughput::Bytes(size as u64));
+        group.bench_with_input(BenchmarkId::from_parameter(size), &args, |b, args| {
+            b.iter(|| {
+                get_request_section_size(
+                    Some(0),
+                    Some("bench".to_string()),
+                    "echo".to_string(),
+                    Some(0),
+                    Some(args.clone()),
+                )
+                .unwrap()
+            })
+        });
+    }
+    group.finish();
+}
+
+criterion_group!(
+    benches,
+    bench_session_round_trip,
+    bench_get_request_section_size
+);
+criterion_main!(benches);
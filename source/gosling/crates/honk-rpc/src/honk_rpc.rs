@@ -1,14 +1,16 @@
 // standard
 use std::collections::VecDeque;
 use std::fmt::Debug;
-use std::io::{Cursor, ErrorKind};
+use std::io::{Cursor, ErrorKind, IoSlice, Write};
 #[cfg(test)]
 use std::net::{SocketAddr, TcpListener, TcpStream};
+use std::ops::Range;
 use std::option::Option;
 
 // extern crates
 use bson::doc;
 use bson::document::ValueAccessError;
+use bson::{RawBsonRef, RawDocument, RawDocumentBuf};
 
 use crate::byte_counter::ByteCounter;
 
@@ -70,6 +72,10 @@ pub enum Error {
     #[error("failed to parse bson Message document")]
     BsonDocumentParseFailed(#[source] bson::de::Error),
 
+    /// Failed to parse bson message in borrowed-parse mode
+    #[error("failed to parse raw bson Message document")]
+    RawBsonDocumentParseFailed(#[source] bson::raw::Error),
+
     /// Failed to convert bson document to Honk-RPC message
     #[error("failed to convert bson document to Message")]
     MessageConversionFailed(#[source] crate::honk_rpc::ErrorCode),
@@ -99,6 +105,10 @@ pub enum Error {
     /// Attempted to send a Honk-RPC `section` that is too large to fit in a message
     #[error("queued message section is too large to write; calculated size is {0} but must be less than {1}")]
     SectionTooLarge(usize, usize),
+
+    /// The session handling a client call terminated before its response was received
+    #[error("session terminated before a response was received")]
+    SessionTerminated(),
 }
 
 impl From<i32> for ErrorCode {
@@ -532,6 +542,244 @@ impl From<ResponseSection> for bson::document::Document {
     }
 }
 
+// Borrowed-parse mode sections; these reference the bytes of the received
+// message rather than owning copies of their fields
+
+// an empty bson document, used when a request omits its arguments
+static EMPTY_DOCUMENT_BYTES: [u8; 5] = [5u8, 0u8, 0u8, 0u8, 0u8];
+
+enum RawSection<'a> {
+    Error {
+        cookie: Option<RequestCookie>,
+        code: ErrorCode,
+    },
+    Request(RawRequestSection<'a>),
+    Response {
+        cookie: RequestCookie,
+        state: RequestState,
+        result: Option<RawBsonRef<'a>>,
+    },
+}
+
+struct RawRequestSection<'a> {
+    cookie: Option<RequestCookie>,
+    namespace: &'a str,
+    function: &'a str,
+    version: i32,
+    arguments: &'a RawDocument,
+}
+
+// gets an optional field from a received section
+fn get_raw_field<'a>(
+    section: &'a RawDocument,
+    key: &str,
+) -> Result<Option<RawBsonRef<'a>>, ErrorCode> {
+    section.get(key).map_err(|_| ErrorCode::SectionParseFailed)
+}
+
+impl<'a> TryFrom<RawBsonRef<'a>> for RawSection<'a> {
+    type Error = ErrorCode;
+
+    fn try_from(value: RawBsonRef<'a>) -> Result<Self, Self::Error> {
+        let section = match value {
+            RawBsonRef::Document(section) => section,
+            _ => return Err(ErrorCode::SectionParseFailed),
+        };
+
+        match get_raw_field(section, "id")? {
+            Some(RawBsonRef::Int32(ERROR_SECTION_ID)) => {
+                let cookie = match get_raw_field(section, "cookie")? {
+                    Some(RawBsonRef::Int64(cookie)) => Some(cookie),
+                    None => None,
+                    Some(_) => return Err(ErrorCode::SectionParseFailed),
+                };
+
+                let code = match get_raw_field(section, "code")? {
+                    Some(RawBsonRef::Int32(code)) => ErrorCode::from(code),
+                    _ => return Err(ErrorCode::SectionParseFailed),
+                };
+
+                // message is unused but must still be well-formed
+                match get_raw_field(section, "message")? {
+                    Some(RawBsonRef::String(_)) | None => (),
+                    Some(_) => return Err(ErrorCode::SectionParseFailed),
+                }
+
+                Ok(RawSection::Error { cookie, code })
+            }
+            Some(RawBsonRef::Int32(REQUEST_SECTION_ID)) => {
+                let cookie = match get_raw_field(section, "cookie")? {
+                    Some(RawBsonRef::Int64(cookie)) => Some(cookie),
+                    None => None,
+                    Some(_) => return Err(ErrorCode::SectionParseFailed),
+                };
+
+                let namespace = match get_raw_field(section, "namespace")? {
+                    Some(RawBsonRef::String(namespace)) => namespace,
+                    None => "",
+                    Some(_) => return Err(ErrorCode::SectionParseFailed),
+                };
+
+                let function = match get_raw_field(section, "function")? {
+                    Some(RawBsonRef::String("")) => return Err(ErrorCode::RequestFunctionInvalid),
+                    Some(RawBsonRef::String(function)) => function,
+                    _ => return Err(ErrorCode::SectionParseFailed),
+                };
+
+                let version = match get_raw_field(section, "version")? {
+                    Some(RawBsonRef::Int32(version)) => version,
+                    None => 0i32,
+                    Some(_) => return Err(ErrorCode::SectionParseFailed),
+                };
+
+                let arguments = match get_raw_field(section, "arguments")? {
+                    Some(RawBsonRef::Document(arguments)) => arguments,
+                    None => match RawDocument::from_bytes(&EMPTY_DOCUMENT_BYTES) {
+                        Ok(arguments) => arguments,
+                        Err(_) => unreachable!(),
+                    },
+                    Some(_) => return Err(ErrorCode::SectionParseFailed),
+                };
+
+                Ok(RawSection::Request(RawRequestSection {
+                    cookie,
+                    namespace,
+                    function,
+                    version,
+                    arguments,
+                }))
+            }
+            Some(RawBsonRef::Int32(RESPONSE_SECTION_ID)) => {
+                let cookie = match get_raw_field(section, "cookie")? {
+                    Some(RawBsonRef::Int64(cookie)) => cookie,
+                    _ => return Err(ErrorCode::SectionParseFailed),
+                };
+
+                let state = match get_raw_field(section, "state")? {
+                    Some(RawBsonRef::Int32(0i32)) => RequestState::Pending,
+                    Some(RawBsonRef::Int32(1i32)) => RequestState::Complete,
+                    Some(RawBsonRef::Int32(_)) => return Err(ErrorCode::ResponseStateInvalid),
+                    _ => return Err(ErrorCode::SectionParseFailed),
+                };
+
+                let result = get_raw_field(section, "result")?;
+
+                // if pending there should be no result
+                if state == RequestState::Pending && result.is_some() {
+                    return Err(ErrorCode::SectionParseFailed);
+                }
+
+                Ok(RawSection::Response {
+                    cookie,
+                    state,
+                    result,
+                })
+            }
+            Some(RawBsonRef::Int32(_)) => Err(ErrorCode::SectionIdUnknown),
+            _ => Err(ErrorCode::SectionParseFailed),
+        }
+    }
+}
+
+// verifies a received message's version and returns an iterator over its borrowed sections
+fn get_raw_sections(
+    message: &RawDocument,
+) -> Result<impl Iterator<Item = Result<RawSection<'_>, ErrorCode>>, ErrorCode> {
+    match message.get("honk_rpc") {
+        Ok(Some(RawBsonRef::Int32(HONK_RPC_VERSION))) => (),
+        Ok(Some(RawBsonRef::Int32(honk_rpc))) => {
+            return if let Some(_version) = i32_to_semver(honk_rpc) {
+                // some other semver we cannot handle
+                Err(ErrorCode::MessageVersionIncompatible)
+            } else {
+                // an invalid semver
+                Err(ErrorCode::MessageParseFailed)
+            };
+        }
+        _ => return Err(ErrorCode::MessageParseFailed),
+    }
+
+    let sections = match message.get("sections") {
+        Ok(Some(RawBsonRef::Array(sections))) => sections,
+        _ => return Err(ErrorCode::MessageParseFailed),
+    };
+
+    // messages must have at least one section
+    if sections.into_iter().next().is_none() {
+        return Err(ErrorCode::MessageParseFailed);
+    }
+
+    Ok(sections.into_iter().map(|section| match section {
+        Ok(section) => RawSection::try_from(section),
+        Err(_) => Err(ErrorCode::SectionParseFailed),
+    }))
+}
+
+// the position of a received request section's fields within its message, so
+// the request may be dispatched without parsing the message again
+struct RawRequestLocation {
+    // index of the message in Session::inbound_raw_requests
+    message: usize,
+    cookie: Option<RequestCookie>,
+    namespace: Range<usize>,
+    function: Range<usize>,
+    version: i32,
+    // None if the request omitted its arguments
+    arguments: Option<Range<usize>>,
+}
+
+impl RawRequestLocation {
+    fn new(message: usize, message_bytes: &[u8], request: &RawRequestSection) -> Self {
+        // the range of message_bytes occupied by part, which must borrow from it
+        let range_of = |part: &[u8]| -> Range<usize> {
+            let begin = part.as_ptr() as usize - message_bytes.as_ptr() as usize;
+            begin..begin + part.len()
+        };
+
+        Self {
+            message,
+            cookie: request.cookie,
+            // an omitted namespace defaults to the empty string
+            namespace: match request.namespace {
+                "" => 0..0,
+                namespace => range_of(namespace.as_bytes()),
+            },
+            function: range_of(request.function.as_bytes()),
+            version: request.version,
+            arguments: match request.arguments.as_bytes() {
+                arguments if arguments.as_ptr() == EMPTY_DOCUMENT_BYTES.as_ptr() => None,
+                arguments => Some(range_of(arguments)),
+            },
+        }
+    }
+
+    // rebuild the located request from the bytes of the message it was found in
+    fn get<'a>(&self, message_bytes: &'a [u8]) -> RawRequestSection<'a> {
+        let get_str =
+            |range: &Range<usize>| match std::str::from_utf8(&message_bytes[range.clone()]) {
+                Ok(string) => string,
+                // validated when the message was read
+                Err(_) => unreachable!(),
+            };
+        let arguments = match &self.arguments {
+            Some(arguments) => &message_bytes[arguments.clone()],
+            None => &EMPTY_DOCUMENT_BYTES[..],
+        };
+
+        RawRequestSection {
+            cookie: self.cookie,
+            namespace: get_str(&self.namespace),
+            function: get_str(&self.function),
+            version: self.version,
+            arguments: match RawDocument::from_bytes(arguments) {
+                Ok(arguments) => arguments,
+                // validated when the message was read
+                Err(_) => unreachable!(),
+            },
+        }
+    }
+}
+
 /// The `ApiSet` trait represents a set of APIs that can be remotely invoked by a connecting Honk-RPC client.
 /// # Example
 /// This exampe `ApiSet` implements two methods, `example::println()` and `example::async_println()`. The
@@ -649,6 +897,22 @@ pub trait ApiSet {
         request_cookie: Option<RequestCookie>,
     ) -> Option<Result<Option<bson::Bson>, ErrorCode>>;
 
+    /// Variant of [`ApiSet::exec_function()`] called instead when the `Session` is in borrowed-parse mode (see [`Session::set_borrowed_parse()`]). The `args` parameter is a view into the received message's buffer, so implementors can read arguments without the allocations required to build an owned `bson::document::Document`. The return values are the same as those of `exec_function()`.
+    ///
+    /// This method is optional; the default implementation converts `args` to an owned document and forwards the request to `exec_function()`.
+    fn exec_function_raw(
+        &mut self,
+        name: &str,
+        version: i32,
+        args: &bson::RawDocument,
+        request_cookie: Option<RequestCookie>,
+    ) -> Option<Result<Option<bson::Bson>, ErrorCode>> {
+        match bson::document::Document::try_from(args) {
+            Ok(args) => self.exec_function(name, version, args, request_cookie),
+            Err(_) => Some(Err(ErrorCode::BsonParseFailed)),
+        }
+    }
+
     /// Updates any internal state required to make forward progress on any requested
     /// remote procedure calls. Implementation of this method is optional and not needed
     /// if the implementor does not have any async functions. If left unimplemented, this
@@ -709,6 +973,18 @@ const FOOTER_SIZE: usize = 1usize;
 // The honk-rpc message overhead before the content of a single section is added
 const MIN_MESSAGE_SIZE: usize = HEADER_SIZE + HONK_RPC_SIZE + SECTIONS_SIZE + FOOTER_SIZE;
 
+// The maximum number of message read buffers a Session keeps around for re-use
+const MAX_SPARE_READ_BUFFERS: usize = 4usize;
+// The maximum number of section and message write buffers a Session keeps around for re-use
+const MAX_SPARE_WRITE_BUFFERS: usize = 16usize;
+// The maximum number of queued messages handed to a single write_vectored() call
+const MAX_WRITE_SLICES: usize = 16usize;
+
+// Bson element types used when framing outbound messages
+const BSON_TYPE_DOCUMENT: u8 = 0x03u8;
+const BSON_TYPE_ARRAY: u8 = 0x04u8;
+const BSON_TYPE_INT32: u8 = 0x10u8;
+
 /// Computes the overhead of the Honk-RPC message type. This method in conjunction with
 /// the other `get_*_section_size(..)` functions can be used to compute the size of a
 /// Honk-RPC message with exactly one section.
@@ -827,6 +1103,160 @@ pub fn get_response_section_size(result: Option<bson::Bson>) -> Result<usize, Er
     Ok(counter.bytes())
 }
 
+/// Computes the size in bytes a BSON document occupies once it is embedded as the
+/// value of the `key` element of a parent document. Adding this to the size of the
+/// parent document without the element yields the size of the parent with it, so
+/// the size of a section carrying a large caller-provided document can be computed
+/// without first cloning that document into the section.
+///
+/// Returns the size of the BSON-encoded element. If BSON encoding fails, an
+/// `Error::BsonWriteFailed` is returned.
+pub fn get_embedded_document_size(
+    key: &str,
+    document: &bson::document::Document,
+) -> Result<usize, Error> {
+    let mut counter: ByteCounter = Default::default();
+    document
+        .to_writer(&mut counter)
+        .map_err(Error::BsonWriteFailed)?;
+
+    // element type + key + null-terminator + document
+    Ok(1usize + key.len() + 1usize + counter.bytes())
+}
+
+// serialize a section to be packed into an outbound message
+fn serialize_section(
+    section: Section,
+    buffer: &mut Vec<u8>,
+    max_message_size: usize,
+) -> Result<(), Error> {
+    let max_section_size = max_message_size - MIN_MESSAGE_SIZE;
+
+    let section: bson::Document = section.into();
+    section
+        .to_writer(&mut *buffer)
+        .map_err(Error::BsonWriteFailed)?;
+    let section_size = buffer.len();
+
+    if section_size <= max_section_size {
+        Ok(())
+    } else {
+        Err(Error::SectionTooLarge(section_size, max_section_size))
+    }
+}
+
+// frame as many of the leading serialized sections as fit within max_message_size
+// into message and return how many were consumed; serialize_section() guarantees
+// the first section always fits
+fn pack_message(message: &mut Vec<u8>, sections: &[Vec<u8>], max_message_size: usize) -> usize {
+    // frame the message by hand around the already serialized sections;
+    // document and array sizes are filled in once known
+    message.extend_from_slice(&0i32.to_le_bytes());
+    message.push(BSON_TYPE_INT32);
+    message.extend_from_slice(b"honk_rpc\0");
+    message.extend_from_slice(&HONK_RPC_VERSION.to_le_bytes());
+    message.push(BSON_TYPE_ARRAY);
+    message.extend_from_slice(b"sections\0");
+    let sections_offset = message.len();
+    message.extend_from_slice(&0i32.to_le_bytes());
+
+    let mut section_count = 0usize;
+    for section in sections {
+        let entry_offset = message.len();
+        message.push(BSON_TYPE_DOCUMENT);
+        // writing to a Vec cannot fail
+        let _ = write!(message, "{}\0", section_count);
+        // + 2 for the array and document footers
+        if section_count > 0 && message.len() + section.len() + 2 > max_message_size {
+            message.truncate(entry_offset);
+            break;
+        }
+        message.extend_from_slice(section);
+        section_count += 1;
+    }
+    // array footer
+    message.push(0u8);
+    // document footer
+    message.push(0u8);
+
+    let sections_size = (message.len() - sections_offset - 1) as i32;
+    message[sections_offset..sections_offset + 4].copy_from_slice(&sections_size.to_le_bytes());
+    let message_size = message.len() as i32;
+    message[0..4].copy_from_slice(&message_size.to_le_bytes());
+    debug_assert!(message.len() <= max_message_size);
+
+    section_count
+}
+
+// build the outbound section (if any) reporting the result of a request
+fn get_request_result_section(
+    cookie: Option<RequestCookie>,
+    result: Option<Result<Option<bson::Bson>, ErrorCode>>,
+) -> Option<Section> {
+    match (cookie, result) {
+        // func found, invoked and succeeded
+        (Some(cookie), Some(Ok(result))) => Some(Section::Response(ResponseSection {
+            cookie,
+            state: RequestState::Complete,
+            result,
+        })),
+        // func found, invoked and failed
+        (cookie, Some(Err(error_code))) => Some(Section::Error(ErrorSection {
+            cookie,
+            code: error_code,
+            message: None,
+            data: None,
+        })),
+        // func found, called, and result is pending
+        (Some(cookie), None) => Some(Section::Response(ResponseSection {
+            cookie,
+            state: RequestState::Pending,
+            result: None,
+        })),
+        // no cookie so caller is not expecting a response
+        (None, _) => None,
+    }
+}
+
+#[cfg(feature = "async-session")]
+mod async_session;
+#[cfg(feature = "async-session")]
+pub use async_session::*;
+
+/// The heap allocations backing a [`Session`]'s message buffers and queues, detached from any stream.
+///
+/// A `SessionBuffers` is taken from a finished `Session` with [`Session::take_buffers()`] and handed to a new one with [`Session::with_buffers()`], so that owners which create and destroy many short-lived sessions can re-use the same allocations rather than growing fresh ones for every connection. All buffers are empty; only their capacity is retained.
+#[derive(Default)]
+pub struct SessionBuffers {
+    message_read_buffer: Vec<u8>,
+    spare_read_buffers: Vec<Vec<u8>>,
+    spare_write_buffers: Vec<Vec<u8>>,
+    message_write_buffers: VecDeque<Vec<u8>>,
+    outbound_sections: Vec<Vec<u8>>,
+    pending_sections: VecDeque<Section>,
+    inbound_requests: Vec<RequestSection>,
+    inbound_responses: VecDeque<Response>,
+    inbound_raw_requests: VecDeque<RawDocumentBuf>,
+    inbound_raw_request_locations: Vec<RawRequestLocation>,
+}
+
+impl SessionBuffers {
+    /// Returns the total capacity in bytes of the message read and write buffers held by this `SessionBuffers`. A `Session` keeps at most 5 message read buffers and 16 section and message write buffers, each of which grows to at most the `Session`'s maximum message size.
+    pub fn capacity(&self) -> usize {
+        self.message_read_buffer.capacity()
+            + self
+                .spare_read_buffers
+                .iter()
+                .map(Vec::capacity)
+                .sum::<usize>()
+            + self
+                .spare_write_buffers
+                .iter()
+                .map(Vec::capacity)
+                .sum::<usize>()
+    }
+}
+
 /// The object that handles the communication between two endpoints  using the
 /// Honk-RPC protocol. Provides methods for setting and getting configuration
 /// parameters, reading and processing message documents, and handling API
@@ -834,8 +1264,10 @@ pub fn get_response_section_size(result: Option<bson::Bson>) -> Result<usize, Er
 pub struct Session<RW> {
     // read-write stream
     stream: RW,
-    // we write outgoing data to an intermediate buffer to handle writer blocking
-    message_write_buffer: VecDeque<u8>,
+    // serialized messages waiting to be written, to handle writer blocking
+    message_write_buffers: VecDeque<Vec<u8>>,
+    // number of bytes of the front message_write_buffers entry already written
+    message_write_offset: usize,
 
     // message read data
 
@@ -850,15 +1282,23 @@ pub struct Session<RW> {
     inbound_requests: Vec<RequestSection>,
     // remote server's responses to local client's remote procedure calls
     inbound_responses: VecDeque<Response>,
+    // parse received messages in place rather than into owned documents
+    borrowed_parse: bool,
+    // received messages containing requests not yet handled (borrowed-parse mode)
+    inbound_raw_requests: VecDeque<RawDocumentBuf>,
+    // where in the above messages their requests are, in the order received
+    inbound_raw_request_locations: Vec<RawRequestLocation>,
+    // previously used message read buffers available for re-use
+    spare_read_buffers: Vec<Vec<u8>>,
 
     // message write data
 
-    // we serialize outgoing messages to this buffer first to verify size limitations
-    message_serialization_buffer: VecDeque<u8>,
     // the next request cookie to use when making a remote prodedure call
     next_cookie: RequestCookie,
-    // sections to be sent to the remote server
-    outbound_sections: Vec<bson::Document>,
+    // serialized sections to be sent to the remote server
+    outbound_sections: Vec<Vec<u8>>,
+    // previously used section and message write buffers available for re-use
+    spare_write_buffers: Vec<Vec<u8>>,
 
     // the maximum size of a message we've agreed to allow in the session
     max_message_size: usize,
@@ -867,6 +1307,14 @@ pub struct Session<RW> {
     max_wait_time: std::time::Duration,
     // last time a new message read began
     read_timestamp: std::time::Instant,
+    // the owner of the session enforces max_wait_time rather than the session itself
+    external_read_timeout: bool,
+    // data was read since the last take_read_progress() call
+    read_progress: bool,
+
+    // lifetime totals of bytes read from and written to stream
+    bytes_read: u64,
+    bytes_written: u64,
 }
 
 #[allow(dead_code)]
@@ -900,28 +1348,118 @@ where
         self.max_wait_time
     }
 
-    /// Creates a new `Session` using the given `stream`.
-    pub fn new(stream: RW) -> Self {
-        let mut message_write_buffer: VecDeque<u8> = Default::default();
-        message_write_buffer.reserve(DEFAULT_MAX_MESSAGE_SIZE);
+    /// Enables or disables external read timeouts. With external read timeouts enabled the `Session` neither reads the clock nor enforces `max_wait_time` itself; instead [`Session::take_read_progress()`] reports whether new data has arrived so that the owner of many sessions can enforce their timeouts from one shared timer. External read timeouts are disabled by default.
+    pub fn set_external_read_timeout(&mut self, external_read_timeout: bool) {
+        self.external_read_timeout = external_read_timeout;
+        self.read_timestamp = std::time::Instant::now();
+    }
+
+    /// Gets whether this `Session` leaves enforcing `max_wait_time` to its owner.
+    pub fn get_external_read_timeout(&self) -> bool {
+        self.external_read_timeout
+    }
+
+    /// Returns `true` if data has been read from the underlying `RW` since the previous call to this function.
+    pub fn take_read_progress(&mut self) -> bool {
+        std::mem::take(&mut self.read_progress)
+    }
+
+    /// Returns the total number of bytes this `Session` has read from the underlying `RW`.
+    pub fn get_bytes_read(&self) -> u64 {
+        self.bytes_read
+    }
+
+    /// Returns the total number of bytes this `Session` has written to the underlying `RW`.
+    pub fn get_bytes_written(&self) -> u64 {
+        self.bytes_written
+    }
 
-        let mut message_serialization_buffer: VecDeque<u8> = Default::default();
-        message_serialization_buffer.reserve(DEFAULT_MAX_MESSAGE_SIZE);
+    /// Enables or disables borrowed-parse mode. In borrowed-parse mode received messages are validated in place rather than converted to owned `bson::document::Document` objects, and requests are dispatched with [`ApiSet::exec_function_raw()`] using arguments which borrow from the received message's buffer. Message buffers are re-used between reads. Borrowed-parse mode is disabled by default.
+    pub fn set_borrowed_parse(&mut self, borrowed_parse: bool) {
+        self.borrowed_parse = borrowed_parse;
+    }
+
+    /// Gets whether this `Session` is in borrowed-parse mode.
+    pub fn get_borrowed_parse(&self) -> bool {
+        self.borrowed_parse
+    }
 
+    /// Creates a new `Session` using the given `stream`.
+    pub fn new(stream: RW) -> Self {
         Session {
             stream,
-            message_write_buffer,
+            message_write_buffers: Default::default(),
+            message_write_offset: 0usize,
             remaining_byte_count: None,
             message_read_buffer: Default::default(),
             pending_sections: Default::default(),
             inbound_requests: Default::default(),
             inbound_responses: Default::default(),
-            message_serialization_buffer,
+            borrowed_parse: false,
+            inbound_raw_requests: Default::default(),
+            inbound_raw_request_locations: Default::default(),
+            spare_read_buffers: Default::default(),
             next_cookie: Default::default(),
             outbound_sections: Default::default(),
+            spare_write_buffers: Default::default(),
             max_message_size: DEFAULT_MAX_MESSAGE_SIZE,
             max_wait_time: DEFAULT_MAX_WAIT_TIME,
             read_timestamp: std::time::Instant::now(),
+            external_read_timeout: false,
+            read_progress: false,
+            bytes_read: 0u64,
+            bytes_written: 0u64,
+        }
+    }
+
+    /// Creates a new `Session` using the given `stream` which re-uses the allocations in `buffers`.
+    pub fn with_buffers(stream: RW, buffers: SessionBuffers) -> Self {
+        let mut session = Self::new(stream);
+        session.message_read_buffer = buffers.message_read_buffer;
+        session.spare_read_buffers = buffers.spare_read_buffers;
+        session.spare_write_buffers = buffers.spare_write_buffers;
+        session.message_write_buffers = buffers.message_write_buffers;
+        session.outbound_sections = buffers.outbound_sections;
+        session.pending_sections = buffers.pending_sections;
+        session.inbound_requests = buffers.inbound_requests;
+        session.inbound_responses = buffers.inbound_responses;
+        session.inbound_raw_requests = buffers.inbound_raw_requests;
+        session.inbound_raw_request_locations = buffers.inbound_raw_request_locations;
+        session
+    }
+
+    /// Removes and returns this `Session`'s message buffers and queues for re-use by [`Session::with_buffers()`]. Any partially read message, unhandled received section and unwritten outbound message is discarded, so this is intended for sessions which are about to be dropped or converted with [`Session::into_stream()`].
+    pub fn take_buffers(&mut self) -> SessionBuffers {
+        self.remaining_byte_count = None;
+        self.message_write_offset = 0usize;
+
+        // raw messages and unwritten messages become spare buffers
+        while let Some(message) = self.inbound_raw_requests.pop_front() {
+            self.recycle_read_buffer(message.into_bytes());
+        }
+        self.inbound_raw_request_locations.clear();
+        while let Some(message) = self.message_write_buffers.pop_front() {
+            self.recycle_write_buffer(message);
+        }
+        while let Some(section) = self.outbound_sections.pop() {
+            self.recycle_write_buffer(section);
+        }
+        self.pending_sections.clear();
+        self.inbound_requests.clear();
+        self.inbound_responses.clear();
+        self.message_read_buffer.clear();
+
+        SessionBuffers {
+            message_read_buffer: std::mem::take(&mut self.message_read_buffer),
+            spare_read_buffers: std::mem::take(&mut self.spare_read_buffers),
+            spare_write_buffers: std::mem::take(&mut self.spare_write_buffers),
+            message_write_buffers: std::mem::take(&mut self.message_write_buffers),
+            outbound_sections: std::mem::take(&mut self.outbound_sections),
+            pending_sections: std::mem::take(&mut self.pending_sections),
+            inbound_requests: std::mem::take(&mut self.inbound_requests),
+            inbound_responses: std::mem::take(&mut self.inbound_responses),
+            inbound_raw_requests: std::mem::take(&mut self.inbound_raw_requests),
+            inbound_raw_request_locations: std::mem::take(&mut self.inbound_raw_request_locations),
         }
     }
 
@@ -930,13 +1468,39 @@ where
         self.stream
     }
 
+    /// Returns a reference to the underlying stream, e.g. to register it with an OS readiness notification mechanism.
+    pub fn get_stream(&self) -> &RW {
+        &self.stream
+    }
+
+    /// Returns `true` if this `Session` has received sections or queued outbound sections which the next [`Session::update()`] call will handle without first needing to read from the underlying `RW`.
+    pub fn has_pending_sections(&self) -> bool {
+        !self.pending_sections.is_empty()
+            || !self.inbound_raw_requests.is_empty()
+            || !self.inbound_requests.is_empty()
+            || !self.inbound_responses.is_empty()
+            || !self.outbound_sections.is_empty()
+    }
+
+    /// Returns `true` if serialized messages are waiting for the underlying `RW` to become writable.
+    pub fn has_pending_writes(&self) -> bool {
+        !self.message_write_buffers.is_empty()
+    }
+
+    /// Returns the point in time after which [`Session::update()`] will fail with [`Error::MessageReadTimedOut`] unless new data is read from the underlying `RW` first. Not maintained while external read timeouts are enabled.
+    pub fn get_read_deadline(&self) -> std::time::Instant {
+        self.read_timestamp + self.max_wait_time
+    }
+
     // read a block of bytes from the undelrying stream
     fn stream_read(&mut self, buffer: &mut [u8]) -> Result<usize, Error> {
         match self.stream.read(buffer) {
             Err(err) => {
                 if err.kind() == ErrorKind::WouldBlock || err.kind() == ErrorKind::TimedOut {
                     // abort if we've gone too long without a new message
-                    if std::time::Instant::now().duration_since(self.read_timestamp)
+                    if self.external_read_timeout {
+                        Ok(0)
+                    } else if std::time::Instant::now().duration_since(self.read_timestamp)
                         > self.max_wait_time
                     {
                         Err(Error::MessageReadTimedOut(self.max_wait_time))
@@ -951,8 +1515,13 @@ where
                 ErrorKind::UnexpectedEof,
             ))),
             Ok(count) => {
+                self.bytes_read += count as u64;
                 // update read_timestamp
-                self.read_timestamp = std::time::Instant::now();
+                if self.external_read_timeout {
+                    self.read_progress = true;
+                } else {
+                    self.read_timestamp = std::time::Instant::now();
+                }
                 Ok(count)
             }
         }
@@ -1012,8 +1581,8 @@ where
         }
     }
 
-    // read the remainder of a bson message
-    fn read_message(&mut self) -> Result<Option<Message>, Error> {
+    // read the remainder of a bson message and return its bytes once complete
+    fn read_message_bytes(&mut self) -> Result<Option<Vec<u8>>, Error> {
         // update remaining bytes to read for message
         self.read_message_size()?;
         // read the message bytes
@@ -1021,33 +1590,34 @@ where
             #[cfg(test)]
             println!("--- message requires {} more bytes", remaining);
 
-            let mut buffer = vec![0u8; remaining];
-            match self.stream_read(&mut buffer) {
+            // read directly into the end of our message buffer
+            let mut buffer = std::mem::take(&mut self.message_read_buffer);
+            let offset = buffer.len();
+            buffer.resize(offset + remaining, 0u8);
+            let result = self.stream_read(&mut buffer[offset..]);
+            // discard the part of the buffer which was not read into
+            let count = match &result {
+                Ok(count) => *count,
+                Err(_) => 0usize,
+            };
+            buffer.truncate(offset + count);
+            self.message_read_buffer = buffer;
+
+            match result {
                 Err(err) => Err(err),
                 Ok(0) => Ok(None),
                 Ok(count) => {
                     #[cfg(test)]
                     println!("<<< read {} bytes", count);
-                    // append read bytes
-                    self.message_read_buffer
-                        .extend_from_slice(&buffer[0..count]);
                     if remaining == count {
                         self.remaining_byte_count = None;
 
-                        let mut cursor = Cursor::new(std::mem::take(&mut self.message_read_buffer));
-                        let bson = bson::document::Document::from_reader(&mut cursor)
-                            .map_err(Error::BsonDocumentParseFailed)?;
-
-                        // take back our allocated vec and clear it
-                        self.message_read_buffer = cursor.into_inner();
-                        self.message_read_buffer.clear();
-
-                        #[cfg(test)]
-                        println!("<<< read message: {}", bson);
-
-                        Ok(Some(
-                            Message::try_from(bson).map_err(Error::MessageConversionFailed)?,
-                        ))
+                        // hand off the completed message and start the next in a spare buffer
+                        let spare_read_buffer = self.spare_read_buffers.pop().unwrap_or_default();
+                        Ok(Some(std::mem::replace(
+                            &mut self.message_read_buffer,
+                            spare_read_buffer,
+                        )))
                     } else {
                         // update the remaining byte count
                         self.remaining_byte_count = Some(remaining - count);
@@ -1060,20 +1630,147 @@ where
         }
     }
 
+    // return a message read buffer for use by future reads
+    fn recycle_read_buffer(&mut self, mut buffer: Vec<u8>) {
+        if self.spare_read_buffers.len() < MAX_SPARE_READ_BUFFERS {
+            buffer.clear();
+            self.spare_read_buffers.push(buffer);
+        }
+    }
+
+    // read the remainder of a bson message and convert it to an owned Message
+    fn read_message(&mut self) -> Result<Option<Message>, Error> {
+        if let Some(bytes) = self.read_message_bytes()? {
+            let mut cursor = Cursor::new(bytes.as_slice());
+            let bson = bson::document::Document::from_reader(&mut cursor);
+            self.recycle_read_buffer(bytes);
+            let bson = bson.map_err(Error::BsonDocumentParseFailed)?;
+
+            #[cfg(test)]
+            println!("<<< read message: {}", bson);
+
+            Ok(Some(
+                Message::try_from(bson).map_err(Error::MessageConversionFailed)?,
+            ))
+        } else {
+            Ok(None)
+        }
+    }
+
+    // read the remainder of a bson message and validate it in place, routing its
+    // sections as we go: errors and responses are queued for our client and
+    // requests are located for handle_requests() to dispatch; returns whether a
+    // message was read
+    fn read_raw_message(&mut self) -> Result<bool, Error> {
+        let message = match self.read_message_bytes()? {
+            Some(bytes) => {
+                RawDocumentBuf::from_bytes(bytes).map_err(Error::RawBsonDocumentParseFailed)?
+            }
+            None => return Ok(false),
+        };
+
+        #[cfg(test)]
+        println!("<<< read raw message: {:?}", message);
+
+        // a malformed section fails the whole message, so route nothing from it
+        let inbound_responses = self.inbound_responses.len();
+        let inbound_raw_request_locations = self.inbound_raw_request_locations.len();
+        if let Err(err) = self.route_raw_sections(&message) {
+            self.inbound_responses.truncate(inbound_responses);
+            self.inbound_raw_request_locations
+                .truncate(inbound_raw_request_locations);
+            return Err(err);
+        }
+
+        if self.inbound_raw_request_locations.len() > inbound_raw_request_locations {
+            self.inbound_raw_requests.push_back(message);
+        } else {
+            self.recycle_read_buffer(message.into_bytes());
+        }
+        Ok(true)
+    }
+
+    // route the sections of a received message; any requests are located as if
+    // the message will be pushed to the back of inbound_raw_requests
+    fn route_raw_sections(&mut self, message: &RawDocument) -> Result<(), Error> {
+        let message_index = self.inbound_raw_requests.len();
+        for section in get_raw_sections(message).map_err(Error::MessageConversionFailed)? {
+            match section.map_err(Error::MessageConversionFailed)? {
+                RawSection::Error { cookie, code } => {
+                    if let Some(cookie) = cookie {
+                        // error in response to a request
+                        self.inbound_responses.push_back(Response::Error {
+                            cookie,
+                            error_code: code,
+                        });
+                    } else {
+                        return Err(Error::UnknownErrorSectionReceived(code));
+                    }
+                }
+                RawSection::Request(request) => {
+                    // requests are handled in place once we have our apisets
+                    self.inbound_raw_request_locations
+                        .push(RawRequestLocation::new(
+                            message_index,
+                            message.as_bytes(),
+                            &request,
+                        ));
+                }
+                RawSection::Response {
+                    cookie,
+                    state: RequestState::Complete,
+                    result,
+                } => {
+                    // our client's responses must be owned to outlive the message
+                    let result = match result.map(bson::Bson::try_from).transpose() {
+                        Ok(result) => result,
+                        Err(_) => {
+                            return Err(Error::MessageConversionFailed(
+                                ErrorCode::SectionParseFailed,
+                            ))
+                        }
+                    };
+                    self.inbound_responses
+                        .push_back(Response::Success { cookie, result });
+                }
+                RawSection::Response {
+                    cookie,
+                    state: RequestState::Pending,
+                    ..
+                } => {
+                    self.inbound_responses
+                        .push_back(Response::Pending { cookie });
+                }
+            }
+        }
+        Ok(())
+    }
+
     // read and save of available sections
     fn read_sections(&mut self) -> Result<(), Error> {
         loop {
-            match self.read_message() {
-                Ok(Some(mut message)) => {
-                    self.pending_sections.extend(message.sections.drain(..));
-                }
-                Ok(None) => return Ok(()),
+            let result = if self.borrowed_parse {
+                self.read_raw_message()
+            } else {
+                self.read_message().map(|message| match message {
+                    Some(mut message) => {
+                        self.pending_sections.extend(message.sections.drain(..));
+                        true
+                    }
+                    None => false,
+                })
+            };
+            match result {
+                Ok(true) => (),
+                Ok(false) => return Ok(()),
                 Err(err) => {
                     match err {
                         // in the event of timeouts and IO errors we finish any remaining work
                         Error::MessageReadTimedOut(_) | Error::ReaderReadFailed(_) => {
                             // ensure no pending items to handle
-                            if self.pending_sections.is_empty() && self.inbound_responses.is_empty()
+                            if self.pending_sections.is_empty()
+                                && self.inbound_raw_requests.is_empty()
+                                && self.inbound_responses.is_empty()
                             {
                                 return Err(err);
                             }
@@ -1123,119 +1820,130 @@ where
             }
         }
 
+        // received messages' sections are routed as they are read in
+        // borrowed-parse mode, see read_raw_message()
+
         Ok(())
     }
 
-    // queue outbound section for packaging into a Honk-RPC message
-    fn push_outbound_section(&mut self, section: Section) -> Result<(), Error> {
-        let max_section_size = self.max_message_size - MIN_MESSAGE_SIZE;
-
-        let mut counter: ByteCounter = Default::default();
-        let section: bson::Document = section.into();
-        section
-            .to_writer(&mut counter)
-            .map_err(Error::BsonWriteFailed)?;
-        let section_size = counter.bytes();
+    // get an empty buffer to serialize a section or message into
+    fn take_write_buffer(&mut self) -> Vec<u8> {
+        self.spare_write_buffers.pop().unwrap_or_default()
+    }
 
-        if section_size <= max_section_size {
-            self.outbound_sections.push(section);
-            Ok(())
-        } else {
-            Err(Error::SectionTooLarge(section_size, max_section_size))
+    // return a section or message write buffer for use by future writes
+    fn recycle_write_buffer(&mut self, mut buffer: Vec<u8>) {
+        if self.spare_write_buffers.len() < MAX_SPARE_WRITE_BUFFERS {
+            buffer.clear();
+            self.spare_write_buffers.push(buffer);
         }
     }
 
-    // package outbound sections into a message, and serialize message to the message_write_buffer
-    fn serialize_messages(&mut self) -> Result<(), Error> {
-        // if no pending sections there is nothing to do
-        if self.outbound_sections.is_empty() {
-            return Ok(());
+    // queue outbound section for packaging into a Honk-RPC message
+    fn push_outbound_section(&mut self, section: Section) -> Result<(), Error> {
+        let mut buffer = self.take_write_buffer();
+        match serialize_section(section, &mut buffer, self.max_message_size) {
+            Ok(()) => {
+                self.outbound_sections.push(buffer);
+                Ok(())
+            }
+            Err(err) => {
+                self.recycle_write_buffer(buffer);
+                Err(err)
+            }
         }
-
-        // build message and convert to bson to send
-        let message = Message {
-            honk_rpc: HONK_RPC_VERSION,
-            sections: Default::default(),
-        };
-        let mut message = bson::document::Document::from(message);
-        message.insert("sections", std::mem::take(&mut self.outbound_sections));
-        self.serialize_messages_impl(message)
     }
 
-    // pack sections into messages and serialise them to buffer
-    fn serialize_messages_impl(
-        &mut self,
-        mut message: bson::document::Document,
-    ) -> Result<(), Error> {
-        self.message_serialization_buffer.clear();
-        message
-            .to_writer(&mut self.message_serialization_buffer)
-            .map_err(Error::BsonWriteFailed)?;
-
-        if self.message_serialization_buffer.len() > self.max_message_size {
-            // if we can't split a message anymore then we have a problem
-            let sections = message.get_array_mut("sections").unwrap();
-            assert!(sections.len() > 1);
+    // package outbound sections into as few messages as possible, and queue them for writing
+    fn serialize_messages(&mut self) -> Result<(), Error> {
+        let mut outbound_sections = std::mem::take(&mut self.outbound_sections);
 
-            let right = doc! {
-                "honk_rpc" : HONK_RPC_VERSION,
-                "sections" : sections.split_off(sections.len() / 2),
-            };
-            let left = message;
+        let mut packed = 0usize;
+        while packed < outbound_sections.len() {
+            let mut message = self.take_write_buffer();
+            packed += pack_message(
+                &mut message,
+                &outbound_sections[packed..],
+                self.max_message_size,
+            );
 
-            self.serialize_messages_impl(left)?;
-            self.serialize_messages_impl(right)?;
-        } else {
             #[cfg(test)]
-            println!(">>> write message: {:?}", message);
-            // copy the serialized message into the pending write buffer
-            self.message_write_buffer
-                .append(&mut self.message_serialization_buffer);
+            println!(">>> write message: {:?}", RawDocument::from_bytes(&message));
+            self.message_write_buffers.push_back(message);
+        }
+
+        for section in outbound_sections.drain(..) {
+            self.recycle_write_buffer(section);
         }
+        // keep the vec's allocation around for the next batch
+        self.outbound_sections = outbound_sections;
 
         Ok(())
     }
 
     // write data to stream and remove from write buffer
     fn write_pending_data(&mut self) -> Result<(), Error> {
-        let bytes_written = self.write_pending_data_impl()?;
+        self.write_pending_data_impl()?;
         self.stream.flush().map_err(Error::WriterWriteFailed)?;
-        // removes the written bytes
-        self.message_write_buffer.drain(0..bytes_written);
-        // and shuffles the data so it is contiguous
-        self.message_write_buffer.make_contiguous();
 
         Ok(())
     }
 
-    fn write_pending_data_impl(&mut self) -> Result<usize, Error> {
-        // write pending data
-        let (mut pending_data, empty): (&[u8], &[u8]) = self.message_write_buffer.as_slices();
-        assert!(empty.is_empty());
-        let pending_bytes: usize = pending_data.len();
-        let mut bytes_written: usize = 0usize;
+    fn write_pending_data_impl(&mut self) -> Result<(), Error> {
+        // write pending messages, several at a time without first copying them together
+        while !self.message_write_buffers.is_empty() {
+            let mut slices = [IoSlice::new(&[]); MAX_WRITE_SLICES];
+            let mut slice_count = 0usize;
+            for (slice, message) in slices.iter_mut().zip(self.message_write_buffers.iter()) {
+                *slice = if slice_count == 0 {
+                    IoSlice::new(&message[self.message_write_offset..])
+                } else {
+                    IoSlice::new(message)
+                };
+                slice_count += 1;
+            }
 
-        while bytes_written != pending_bytes {
-            match self.stream.write(pending_data) {
+            match self.stream.write_vectored(&slices[0..slice_count]) {
                 Err(err) => {
                     let kind = err.kind();
                     if kind == ErrorKind::WouldBlock || kind == ErrorKind::TimedOut {
-                        // no *additional* bytes written so return bytes written so far
-                        return Ok(bytes_written);
+                        // try again next update
+                        return Ok(());
                     } else {
                         return Err(Error::WriterWriteFailed(err));
                     }
                 }
+                Ok(0) => {
+                    return Err(Error::WriterWriteFailed(std::io::Error::from(
+                        ErrorKind::WriteZero,
+                    )))
+                }
                 Ok(count) => {
-                    bytes_written += count;
                     #[cfg(test)]
-                    println!(">>> sent {} of {} bytes", bytes_written, pending_bytes);
-                    pending_data = &pending_data[count..];
+                    println!(">>> sent {} bytes", count);
+                    self.bytes_written += count as u64;
+                    self.consume_written_bytes(count);
                 }
             }
         }
 
-        Ok(bytes_written)
+        Ok(())
+    }
+
+    // release fully written messages and advance the offset into a partially written one
+    fn consume_written_bytes(&mut self, mut count: usize) {
+        while let Some(message) = self.message_write_buffers.front() {
+            let remaining = message.len() - self.message_write_offset;
+            if count < remaining {
+                self.message_write_offset += count;
+                return;
+            }
+            count -= remaining;
+            self.message_write_offset = 0usize;
+            if let Some(message) = self.message_write_buffers.pop_front() {
+                self.recycle_write_buffer(message);
+            }
+        }
     }
 
     /// Read and process Honk-RPC message documents from connected peer, handle any new incoming Honk-RPC requests, update any in-progress async requests and write pending reponses, errors and requests to peer. This function must be called regularly for the `Session` to make forward progress.
@@ -1263,59 +1971,62 @@ where
         // first handle all of our inbound requests
         let mut inbound_requests = std::mem::take(&mut self.inbound_requests);
         for mut request in inbound_requests.drain(..) {
-            if let Ok(idx) =
+            let result = if let Ok(idx) =
                 apisets.binary_search_by(|probe| probe.namespace().cmp(&request.namespace))
             {
                 let apiset = match apisets.get_mut(idx) {
                     Some(apiset) => apiset,
                     None => unreachable!(),
                 };
-                match apiset.exec_function(
+                apiset.exec_function(
                     &request.function,
                     request.version,
                     std::mem::take(&mut request.arguments),
                     request.cookie,
-                ) {
-                    // func found, invoked and succeeded
-                    Some(Ok(result)) => {
-                        if let Some(cookie) = request.cookie {
-                            self.push_outbound_section(Section::Response(ResponseSection {
-                                cookie,
-                                state: RequestState::Complete,
-                                result,
-                            }))?;
-                        }
-                    }
-                    // func found, invoked and failed
-                    Some(Err(error_code)) => {
-                        self.push_outbound_section(Section::Error(ErrorSection {
-                            cookie: request.cookie,
-                            code: error_code,
-                            message: None,
-                            data: None,
-                        }))?;
-                    }
-                    // func found, called, and result is pending
-                    None => {
-                        if let Some(cookie) = request.cookie {
-                            self.push_outbound_section(Section::Response(ResponseSection {
-                                cookie,
-                                state: RequestState::Pending,
-                                result: None,
-                            }))?;
-                        }
-                    }
-                }
+                )
             } else {
                 // invalid namespace
-                self.push_outbound_section(Section::Error(ErrorSection {
-                    cookie: request.cookie,
-                    code: ErrorCode::RequestNamespaceInvalid,
-                    message: None,
-                    data: None,
-                }))?;
-            }
+                Some(Err(ErrorCode::RequestNamespaceInvalid))
+            };
+            self.push_request_result(request.cookie, result)?;
+        }
+
+        // then any requests still referencing their received message, located
+        // when the message was read
+        let mut inbound_raw_requests = std::mem::take(&mut self.inbound_raw_requests);
+        let mut inbound_raw_request_locations =
+            std::mem::take(&mut self.inbound_raw_request_locations);
+        for location in inbound_raw_request_locations.drain(..) {
+            let message = match inbound_raw_requests.get(location.message) {
+                Some(message) => message,
+                None => unreachable!(),
+            };
+            let request = location.get(message.as_bytes());
+            let result = if let Ok(idx) =
+                apisets.binary_search_by(|probe| probe.namespace().cmp(request.namespace))
+            {
+                let apiset = match apisets.get_mut(idx) {
+                    Some(apiset) => apiset,
+                    None => unreachable!(),
+                };
+                apiset.exec_function_raw(
+                    request.function,
+                    request.version,
+                    request.arguments,
+                    request.cookie,
+                )
+            } else {
+                // invalid namespace
+                Some(Err(ErrorCode::RequestNamespaceInvalid))
+            };
+            self.push_request_result(request.cookie, result)?;
+        }
+        for message in inbound_raw_requests.drain(..) {
+            self.recycle_read_buffer(message.into_bytes());
         }
+        // keep the queues' allocations around for the next batch
+        self.inbound_raw_requests = inbound_raw_requests;
+        self.inbound_raw_request_locations = inbound_raw_request_locations;
 
         // next send out async responses from apisets
         for apiset in apisets.iter_mut() {
@@ -1347,6 +2058,18 @@ where
         Ok(())
     }
 
+    // queue the outbound section for the result of a request
+    fn push_request_result(
+        &mut self,
+        cookie: Option<RequestCookie>,
+        result: Option<Result<Option<bson::Bson>, ErrorCode>>,
+    ) -> Result<(), Error> {
+        match get_request_result_section(cookie, result) {
+            Some(section) => self.push_outbound_section(section),
+            None => Ok(()),
+        }
+    }
+
     /// Performs a client call to a remote function. Returns a `RequestCookie` to associate this client call with a future `Response`.
     pub fn client_call(
         &mut self,
@@ -1520,6 +2243,97 @@ fn test_honk_client_read_write() -> anyhow::Result<()> {
     Ok(())
 }
 
+#[cfg(test)]
+// a stream which accepts at most max_write bytes per write and never has data to read
+struct TrickleStream {
+    written: Vec<u8>,
+    max_write: usize,
+}
+
+#[cfg(test)]
+impl std::io::Read for TrickleStream {
+    fn read(&mut self, _buf: &mut [u8]) -> std::io::Result<usize> {
+        Err(std::io::Error::from(ErrorKind::WouldBlock))
+    }
+}
+
+#[cfg(test)]
+impl std::io::Write for TrickleStream {
+    fn write(&mut self, buf: &[u8]) -> std::io::Result<usize> {
+        self.write_vectored(&[IoSlice::new(buf)])
+    }
+
+    fn write_vectored(&mut self, bufs: &[IoSlice<'_>]) -> std::io::Result<usize> {
+        let mut count = 0usize;
+        for buf in bufs {
+            let len = std::cmp::min(buf.len(), self.max_write - count);
+            self.written.extend_from_slice(&buf[0..len]);
+            count += len;
+        }
+        Ok(count)
+    }
+
+    fn flush(&mut self) -> std::io::Result<()> {
+        Ok(())
+    }
+}
+
+#[test]
+fn test_honk_coalesced_partial_writes() -> anyhow::Result<()> {
+    const REQUEST_COUNT: i64 = 200;
+
+    let mut session = Session::new(TrickleStream {
+        written: Default::default(),
+        max_write: 7,
+    });
+
+    println!("--- queue {} requests", REQUEST_COUNT);
+    for i in 0..REQUEST_COUNT {
+        let cookie = session.client_call("namespace", "function", 0, doc! {"val": i})?;
+        assert_eq!(cookie, i);
+    }
+
+    println!("--- serialize requests into messages");
+    session.serialize_messages()?;
+    let message_count = session.message_write_buffers.len();
+    // sections must be packed together but not exceed our message size limit
+    assert!(message_count > 1);
+    assert!(message_count < REQUEST_COUNT as usize / 10);
+    let mut expected: Vec<u8> = Default::default();
+    for message in session.message_write_buffers.iter() {
+        assert!(message.len() <= session.get_max_message_size());
+        expected.extend_from_slice(message);
+    }
+
+    println!("--- write messages 7 bytes at a time");
+    while session.has_pending_writes() {
+        session.write_pending_data()?;
+    }
+    assert_eq!(session.get_stream().written, expected);
+
+    println!("--- parse and verify written messages");
+    let mut cursor = Cursor::new(session.get_stream().written.as_slice());
+    let mut next_cookie: i64 = 0;
+    for _ in 0..message_count {
+        let message = bson::document::Document::from_reader(&mut cursor)?;
+        let message = Message::try_from(message)?;
+        for section in message.sections {
+            match section {
+                Section::Request(request) => {
+                    assert_eq!(request.cookie, Some(next_cookie));
+                    assert_eq!(request.arguments.get_i64("val")?, next_cookie);
+                    next_cookie += 1;
+                }
+                _ => panic!("was expecting a Request section"),
+            }
+        }
+    }
+    assert_eq!(next_cookie, REQUEST_COUNT);
+    assert_eq!(cursor.position() as usize, expected.len());
+
+    Ok(())
+}
+
 #[cfg(test)]
 struct TestApiSet {
     call_count: usize,
@@ -1634,3 +2448,122 @@ fn test_honk_timeout() -> anyhow::Result<()> {
     }
     Ok(())
 }
+
+#[test]
+fn test_honk_external_read_timeout() -> anyhow::Result<()> {
+    let socket_addr = SocketAddr::from(([127, 0, 0, 1], 0u16));
+    let listener = TcpListener::bind(socket_addr)?;
+    let socket_addr = listener.local_addr()?;
+
+    let alice_stream = TcpStream::connect(socket_addr)?;
+    alice_stream.set_nonblocking(true)?;
+    let (pat_stream, _socket_addr) = listener.accept()?;
+    pat_stream.set_nonblocking(true)?;
+
+    let mut alice = Session::new(alice_stream);
+    let mut alice_apiset = TestApiSet { call_count: 0usize };
+    let mut pat = Session::new(pat_stream);
+
+    // alice leaves enforcing max_wait_time to her owner so never times out herself
+    alice.set_max_wait_time(std::time::Duration::from_millis(10));
+    alice.set_external_read_timeout(true);
+    std::thread::sleep(std::time::Duration::from_millis(50));
+    alice.update(None)?;
+    assert!(!alice.take_read_progress());
+
+    // but reports when data arrives, once
+    pat.client_call("namespace", "function", 0, doc! {})?;
+    while alice_apiset.call_count != 1 {
+        pat.update(None)?;
+        alice.update(Some(&mut [&mut alice_apiset]))?;
+    }
+    assert!(alice.take_read_progress());
+    assert!(!alice.take_read_progress());
+
+    // everything pat wrote has been read by alice
+    assert!(pat.get_bytes_written() > 0);
+    assert_eq!(alice.get_bytes_read(), pat.get_bytes_written());
+
+    Ok(())
+}
+
+#[test]
+fn test_honk_session_buffers() -> anyhow::Result<()> {
+    let socket_addr = SocketAddr::from(([127, 0, 0, 1], 0u16));
+    let listener = TcpListener::bind(socket_addr)?;
+    let socket_addr = listener.local_addr()?;
+
+    let mut alice_buffers = SessionBuffers::default();
+    let mut pat_buffers = SessionBuffers::default();
+    // bounded by the spare buffer limits
+    let bound =
+        2 * (1 + MAX_SPARE_READ_BUFFERS + MAX_SPARE_WRITE_BUFFERS) * DEFAULT_MAX_MESSAGE_SIZE;
+
+    for round in 0..4 {
+        let alice_stream = TcpStream::connect(socket_addr)?;
+        alice_stream.set_nonblocking(true)?;
+        let (pat_stream, _socket_addr) = listener.accept()?;
+        pat_stream.set_nonblocking(true)?;
+
+        let mut alice = Session::with_buffers(alice_stream, alice_buffers);
+        let mut alice_apiset = TestApiSet { call_count: 0usize };
+        let mut pat = Session::with_buffers(pat_stream, pat_buffers);
+
+        for _ in 0..8 {
+            pat.client_call("namespace", "function", 0, doc! {})?;
+        }
+        while alice_apiset.call_count != 8 {
+            pat.update(None)?;
+            alice.update(Some(&mut [&mut alice_apiset]))?;
+        }
+        let mut responses = 0usize;
+        while responses != 8 {
+            alice.update(Some(&mut [&mut alice_apiset]))?;
+            pat.update(None)?;
+            while pat.client_next_response().is_some() {
+                responses += 1;
+            }
+        }
+
+        alice_buffers = alice.take_buffers();
+        pat_buffers = pat.take_buffers();
+        assert!(!alice.has_pending_sections() && !alice.has_pending_writes());
+
+        let capacity = alice_buffers.capacity() + pat_buffers.capacity();
+        assert!(capacity > 0 && capacity <= bound);
+
+        // an idle session hands back exactly the allocations it was given
+        let stream = TcpStream::connect(socket_addr)?;
+        let _ = listener.accept()?;
+        let alice_capacity = alice_buffers.capacity();
+        let mut alice = Session::with_buffers(stream, alice_buffers);
+        alice_buffers = alice.take_buffers();
+        assert_eq!(alice_buffers.capacity(), alice_capacity);
+        println!("--- round {} buffer capacity: {}", round, capacity);
+    }
+
+    Ok(())
+}
+
+#[test]
+fn test_embedded_document_size() -> anyhow::Result<()> {
+    let challenge = doc! {
+        "nonce" : bson::Bson::Binary(bson::Binary{subtype: bson::spec::BinarySubtype::Generic, bytes: vec![0u8; 32]}),
+        "label" : "challenge",
+    };
+
+    let without = doc! {
+        "cookie" : bson::Bson::Int32(0),
+    };
+    let with = doc! {
+        "cookie" : bson::Bson::Int32(0),
+        "challenge" : challenge.clone(),
+    };
+
+    let expected = get_response_section_size(Some(bson::Bson::Document(with)))?;
+    let computed = get_response_section_size(Some(bson::Bson::Document(without)))?
+        + get_embedded_document_size("challenge", &challenge)?;
+    assert_eq!(computed, expected);
+
+    Ok(())
+}
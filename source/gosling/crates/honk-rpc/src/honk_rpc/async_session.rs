@@ -0,0 +1,455 @@
+// standard
+use std::collections::BTreeMap;
+use std::future::Future;
+use std::io::Cursor;
+use std::pin::Pin;
+use std::task::Poll;
+
+// extern crates
+use tokio::io::{AsyncRead, AsyncReadExt, AsyncWrite, AsyncWriteExt};
+use tokio::sync::{mpsc, oneshot};
+use tokio::task::JoinSet;
+use tokio::time::Instant;
+
+// internal crates
+use crate::honk_rpc::*;
+
+/// The future returned by [`AsyncApiSet::exec_function()`], resolving to the result of a remote procedure call.
+pub type AsyncApiFuture =
+    Pin<Box<dyn Future<Output = Result<Option<bson::Bson>, ErrorCode>> + Send + 'static>>;
+
+/// The async counterpart of [`ApiSet`], used with an [`AsyncSession`]. Rather than deferring results to be polled for later with `ApiSet::update()` and `ApiSet::next_result()`, each request is handled by returning a future which resolves to its result.
+pub trait AsyncApiSet: Send {
+    /// Returns the namespace of this `AsyncApiSet`.
+    fn namespace(&self) -> &str;
+
+    /// Begins the execution of the requested remote procedure call. Calls to this function map directly to a received Honk-RPC request and take the same parameters as [`ApiSet::exec_function()`].
+    ///
+    /// The returned future is polled once by the `AsyncSession` as soon as it is returned; if it is already complete its result is sent immediately, otherwise a pending response is sent and the future is driven to completion as a task on the current tokio runtime.
+    fn exec_function(
+        &mut self,
+        name: &str,
+        version: i32,
+        args: bson::document::Document,
+        request_cookie: Option<RequestCookie>,
+    ) -> AsyncApiFuture;
+}
+
+// a client call queued by an AsyncClient for its AsyncSession to send
+struct ClientCall {
+    namespace: String,
+    function: String,
+    version: i32,
+    arguments: bson::document::Document,
+    responder: oneshot::Sender<Result<Response, Error>>,
+}
+
+/// A cloneable handle used to make client calls through an [`AsyncSession`]. Handles may be used from any task while the session is running.
+#[derive(Clone)]
+pub struct AsyncClient {
+    calls: mpsc::UnboundedSender<ClientCall>,
+}
+
+impl AsyncClient {
+    /// Performs a client call to a remote function. The returned future resolves once the remote server's final `Response::Success` or `Response::Error` has been received; pending responses are not reported. Fails with `Error::SessionTerminated` if the session stops running before the response arrives.
+    pub async fn client_call(
+        &self,
+        namespace: &str,
+        function: &str,
+        version: i32,
+        arguments: bson::document::Document,
+    ) -> Result<Response, Error> {
+        let (responder, response) = oneshot::channel();
+        self.calls
+            .send(ClientCall {
+                namespace: namespace.to_string(),
+                function: function.to_string(),
+                version,
+                arguments,
+                responder,
+            })
+            .map_err(|_| Error::SessionTerminated())?;
+
+        match response.await {
+            Ok(response) => response,
+            Err(_) => Err(Error::SessionTerminated()),
+        }
+    }
+}
+
+/// The async counterpart of [`Session`], built on tokio. Rather than being polled with `Session::update()`, an `AsyncSession` is driven by awaiting [`AsyncSession::run()`], which only wakes when the underlying stream is readable or writable, a client call is made, or a request handler completes.
+pub struct AsyncSession<S> {
+    stream: S,
+    // handle given out by client(), kept so calls may be queued before run()
+    client: AsyncClient,
+    // calls queued by our AsyncClient handles
+    calls: mpsc::UnboundedReceiver<ClientCall>,
+    // the maximum size of a message we've agreed to allow in the session
+    max_message_size: usize,
+    // the maximum amount of time the session is willing to wait to receive a message
+    // before terminating the session
+    max_wait_time: std::time::Duration,
+}
+
+impl<S> AsyncSession<S>
+where
+    S: AsyncRead + AsyncWrite,
+{
+    /// Creates a new `AsyncSession` using the given `stream`.
+    pub fn new(stream: S) -> Self {
+        let (calls_sender, calls) = mpsc::unbounded_channel();
+        AsyncSession {
+            stream,
+            client: AsyncClient {
+                calls: calls_sender,
+            },
+            calls,
+            max_message_size: DEFAULT_MAX_MESSAGE_SIZE,
+            max_wait_time: DEFAULT_MAX_WAIT_TIME,
+        }
+    }
+
+    /// Sets the maximum message size this `AsyncSession` is willing to read from the underlying stream. See [`Session::set_max_message_size()`].
+    pub fn set_max_message_size(&mut self, max_message_size: i32) -> Result<(), Error> {
+        if max_message_size < MIN_MESSAGE_SIZE as i32 {
+            // base size of a honk-rpc mssage
+            Err(Error::InvalidMaxMesageSize())
+        } else {
+            self.max_message_size = max_message_size as usize;
+            Ok(())
+        }
+    }
+
+    /// Gets the maximum allowed message size this `AsyncSession` is willing to read from the underlying stream. The default value is 4096 bytes.
+    pub fn get_max_message_size(&self) -> usize {
+        self.max_message_size
+    }
+
+    /// Sets the maximum amount of time this `AsyncSession` is willing to wait for a new Honk-RPC message on the underlying stream. [`AsyncSession::run()`] fails after `max_wait_time` has elapsed without receiving any new Honk-RPC message documents.
+    pub fn set_max_wait_time(&mut self, max_wait_time: std::time::Duration) {
+        self.max_wait_time = max_wait_time;
+    }
+
+    /// Gets the maximum amount this `AsyncSession` is willing to wait for a new Honk-RPC message. The default value is 60 seconds.
+    pub fn get_max_wait_time(&self) -> std::time::Duration {
+        self.max_wait_time
+    }
+
+    /// Returns a handle for making client calls through this `AsyncSession`.
+    pub fn client(&self) -> AsyncClient {
+        self.client.clone()
+    }
+
+    /// Runs the session, routing received requests to `apisets` and sending the responses to calls made through this session's [`AsyncClient`] handles. As with [`Session::update()`], `apisets` must be sorted by namespace.
+    ///
+    /// Request handlers' futures are spawned onto the current tokio runtime, so this function must be called from within one. It returns `Ok(())` once the remote end closes the stream between messages, and otherwise runs until the session fails. Calls which are still awaiting a response when it returns fail with `Error::SessionTerminated`.
+    pub async fn run(self, apisets: &mut [&mut dyn AsyncApiSet]) -> Result<(), Error> {
+        let AsyncSession {
+            stream,
+            client,
+            mut calls,
+            max_message_size,
+            max_wait_time,
+        } = self;
+        // only handles given out by client() keep our call queue open
+        drop(client);
+
+        let (reader, writer) = tokio::io::split(stream);
+
+        // the in-progress read of the next message, which takes ownership of the reader
+        // (and its buffer) and hands both back once complete
+        let read = read_message(reader, max_message_size, Vec::new());
+        tokio::pin!(read);
+        // the in-progress write of our outbound messages, if any
+        let write = write_messages(writer, Vec::new());
+        tokio::pin!(write);
+        let mut writing = true;
+        let mut idle_writer = None;
+
+        let timeout = tokio::time::sleep(max_wait_time);
+        tokio::pin!(timeout);
+
+        // serialized sections to be sent to the remote server
+        let mut outbound_sections: Vec<Vec<u8>> = Default::default();
+        // our client's calls awaiting their response
+        let mut pending_calls: BTreeMap<RequestCookie, oneshot::Sender<Result<Response, Error>>> =
+            Default::default();
+        // the next request cookie to use when making a remote prodedure call
+        let mut next_cookie: RequestCookie = Default::default();
+        // request handlers which did not complete when first polled
+        let mut in_flight: JoinSet<(Option<RequestCookie>, Result<Option<bson::Bson>, ErrorCode>)> =
+            JoinSet::new();
+
+        loop {
+            tokio::select! {
+                (reader, result) = &mut read => {
+                    let buffer = match result? {
+                        Some(buffer) => buffer,
+                        // remote end closed the stream
+                        None => return Ok(()),
+                    };
+                    let bson = bson::document::Document::from_reader(&mut Cursor::new(
+                        buffer.as_slice(),
+                    ));
+                    // begin reading the next message into the same buffer
+                    read.set(read_message(reader, max_message_size, buffer));
+                    timeout.as_mut().reset(Instant::now() + max_wait_time);
+
+                    let bson = bson.map_err(Error::BsonDocumentParseFailed)?;
+                    let message =
+                        Message::try_from(bson).map_err(Error::MessageConversionFailed)?;
+                    for section in message.sections {
+                        match section {
+                            Section::Error(error) => {
+                                if let Some(cookie) = error.cookie {
+                                    // error in response to a request
+                                    if let Some(responder) = pending_calls.remove(&cookie) {
+                                        let _ = responder.send(Ok(Response::Error {
+                                            cookie,
+                                            error_code: error.code,
+                                        }));
+                                    }
+                                } else {
+                                    return Err(Error::UnknownErrorSectionReceived(error.code));
+                                }
+                            }
+                            Section::Request(request) => {
+                                // request to route to our apisets
+                                let cookie = request.cookie;
+                                let mut result: AsyncApiFuture = if let Ok(idx) = apisets
+                                    .binary_search_by(|probe| {
+                                        probe.namespace().cmp(&request.namespace)
+                                    }) {
+                                    let apiset = match apisets.get_mut(idx) {
+                                        Some(apiset) => apiset,
+                                        None => unreachable!(),
+                                    };
+                                    apiset.exec_function(
+                                        &request.function,
+                                        request.version,
+                                        request.arguments,
+                                        cookie,
+                                    )
+                                } else {
+                                    // invalid namespace
+                                    Box::pin(std::future::ready(Err(
+                                        ErrorCode::RequestNamespaceInvalid,
+                                    )))
+                                };
+
+                                // send the result now if the handler completed synchronously,
+                                // otherwise tell the caller it is pending
+                                if let Some(result) = poll_once(&mut result).await {
+                                    push_request_result(
+                                        &mut outbound_sections,
+                                        cookie,
+                                        Some(result),
+                                        max_message_size,
+                                    )?;
+                                } else {
+                                    push_request_result(
+                                        &mut outbound_sections,
+                                        cookie,
+                                        None,
+                                        max_message_size,
+                                    )?;
+                                    in_flight.spawn(async move { (cookie, result.await) });
+                                }
+                            }
+                            Section::Response(response) => {
+                                // response to our client; only final responses are reported
+                                if response.state == RequestState::Complete {
+                                    if let Some(responder) =
+                                        pending_calls.remove(&response.cookie)
+                                    {
+                                        let _ = responder.send(Ok(Response::Success {
+                                            cookie: response.cookie,
+                                            result: response.result,
+                                        }));
+                                    }
+                                }
+                            }
+                        }
+                    }
+                }
+                Some(result) = in_flight.join_next() => {
+                    let (cookie, result) = match result {
+                        Ok(result) => result,
+                        Err(err) => match err.try_into_panic() {
+                            // propagate handler panics as if the handler ran inline
+                            Ok(panic) => std::panic::resume_unwind(panic),
+                            Err(_) => return Err(Error::SessionTerminated()),
+                        },
+                    };
+                    push_request_result(
+                        &mut outbound_sections,
+                        cookie,
+                        Some(result),
+                        max_message_size,
+                    )?;
+                }
+                Some(call) = calls.recv() => {
+                    // always make sure we have a new cookie
+                    let cookie = next_cookie;
+                    next_cookie += 1;
+
+                    let mut buffer: Vec<u8> = Default::default();
+                    match serialize_section(
+                        Section::Request(RequestSection {
+                            cookie: Some(cookie),
+                            namespace: call.namespace,
+                            function: call.function,
+                            version: call.version,
+                            arguments: call.arguments,
+                        }),
+                        &mut buffer,
+                        max_message_size,
+                    ) {
+                        Ok(()) => {
+                            outbound_sections.push(buffer);
+                            pending_calls.insert(cookie, call.responder);
+                        }
+                        // only this call fails, the session itself is unaffected
+                        Err(err) => {
+                            let _ = call.responder.send(Err(err));
+                        }
+                    }
+                }
+                (writer, result) = &mut write, if writing => {
+                    result?;
+                    idle_writer = Some(writer);
+                    writing = false;
+                }
+                () = &mut timeout => {
+                    return Err(Error::MessageReadTimedOut(max_wait_time));
+                }
+            }
+
+            // begin writing any newly queued sections once the previous write is done
+            if !writing && !outbound_sections.is_empty() {
+                let writer = match idle_writer.take() {
+                    Some(writer) => writer,
+                    None => unreachable!(),
+                };
+                let mut messages: Vec<Vec<u8>> = Default::default();
+                let mut packed = 0usize;
+                while packed < outbound_sections.len() {
+                    let mut message: Vec<u8> = Default::default();
+                    packed +=
+                        pack_message(&mut message, &outbound_sections[packed..], max_message_size);
+                    messages.push(message);
+                }
+                outbound_sections.clear();
+
+                write.set(write_messages(writer, messages));
+                writing = true;
+            }
+        }
+    }
+}
+
+// serialize the result of a request (if any) to be sent to the remote client
+fn push_request_result(
+    outbound_sections: &mut Vec<Vec<u8>>,
+    cookie: Option<RequestCookie>,
+    result: Option<Result<Option<bson::Bson>, ErrorCode>>,
+    max_message_size: usize,
+) -> Result<(), Error> {
+    if let Some(section) = get_request_result_section(cookie, result) {
+        let mut buffer: Vec<u8> = Default::default();
+        serialize_section(section, &mut buffer, max_message_size)?;
+        outbound_sections.push(buffer);
+    }
+    Ok(())
+}
+
+// poll a future once, returning its output if it is already complete
+async fn poll_once<F: Future + Unpin>(future: &mut F) -> Option<F::Output> {
+    std::future::poll_fn(|cx| {
+        Poll::Ready(match Pin::new(&mut *future).poll(cx) {
+            Poll::Ready(output) => Some(output),
+            Poll::Pending => None,
+        })
+    })
+    .await
+}
+
+// read the next message into buffer, handing back the reader once done
+async fn read_message<R: AsyncRead + Unpin>(
+    mut reader: R,
+    max_message_size: usize,
+    buffer: Vec<u8>,
+) -> (R, Result<Option<Vec<u8>>, Error>) {
+    let result = read_message_bytes(&mut reader, max_message_size, buffer).await;
+    (reader, result)
+}
+
+// read a complete bson message, returning None if the stream closes before it begins
+async fn read_message_bytes<R: AsyncRead + Unpin>(
+    reader: &mut R,
+    max_message_size: usize,
+    mut buffer: Vec<u8>,
+) -> Result<Option<Vec<u8>>, Error> {
+    let mut header = [0u8; 4];
+    let mut count = 0usize;
+    while count < header.len() {
+        match reader
+            .read(&mut header[count..])
+            .await
+            .map_err(Error::ReaderReadFailed)?
+        {
+            0 if count == 0 => return Ok(None),
+            0 => {
+                return Err(Error::ReaderReadFailed(
+                    std::io::ErrorKind::UnexpectedEof.into(),
+                ))
+            }
+            read => count += read,
+        }
+    }
+
+    let size = i32::from_le_bytes(header);
+    if size <= header.len() as i32 {
+        return Err(Error::BsonDocumentSizeTooSmall(size));
+    }
+    if size as usize > max_message_size {
+        return Err(Error::BsonDocumentSizeTooLarge(
+            size,
+            max_message_size as i32,
+        ));
+    }
+
+    buffer.clear();
+    buffer.extend_from_slice(&header);
+    buffer.resize(size as usize, 0u8);
+    reader
+        .read_exact(&mut buffer[header.len()..])
+        .await
+        .map_err(Error::ReaderReadFailed)?;
+    Ok(Some(buffer))
+}
+
+// write and flush each message in turn, handing back the writer once done
+async fn write_messages<W: AsyncWrite + Unpin>(
+    mut writer: W,
+    messages: Vec<Vec<u8>>,
+) -> (W, Result<(), Error>) {
+    let result = write_message_bytes(&mut writer, messages).await;
+    (writer, result)
+}
+
+async fn write_message_bytes<W: AsyncWrite + Unpin>(
+    writer: &mut W,
+    messages: Vec<Vec<u8>>,
+) -> Result<(), Error> {
+    if messages.is_empty() {
+        return Ok(());
+    }
+    for message in messages {
+        writer
+            .write_all(&message)
+            .await
+            .map_err(Error::WriterWriteFailed)?;
+    }
+    writer.flush().await.map_err(Error::WriterFlushFailed)
+}
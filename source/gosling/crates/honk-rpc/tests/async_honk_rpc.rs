@@ -0,0 +1,147 @@
+#![cfg(feature = "async-session")]
+
+// standard
+use std::time::Duration;
+
+// extern crates
+use bson::doc;
+use tokio::net::{TcpListener, TcpStream};
+
+// internal crates
+use honk_rpc::honk_rpc::*;
+
+const RUNTIME_ERROR_INVALID_ARG: ErrorCode = ErrorCode::Runtime(1i32);
+
+struct TestAsyncApiSet {}
+
+impl AsyncApiSet for TestAsyncApiSet {
+    fn namespace(&self) -> &str {
+        "test"
+    }
+
+    fn exec_function(
+        &mut self,
+        name: &str,
+        version: i32,
+        mut args: bson::document::Document,
+        _request_cookie: Option<RequestCookie>,
+    ) -> AsyncApiFuture {
+        let val = match args.get_mut("val") {
+            Some(bson::Bson::String(val)) => std::mem::take(val),
+            _ => return Box::pin(std::future::ready(Err(RUNTIME_ERROR_INVALID_ARG))),
+        };
+
+        match (name, version) {
+            // returns the same string arg sent
+            ("echo", 0) => Box::pin(std::future::ready(Ok(Some(bson::Bson::String(val))))),
+            // same as echo but takes awhile and appends ' - Delayed!' to source string before returning
+            ("delay_echo", 0) => Box::pin(async move {
+                tokio::time::sleep(Duration::from_millis(50)).await;
+                Ok(Some(bson::Bson::String(format!("{} - Delayed!", val))))
+            }),
+            _ => Box::pin(std::future::ready(Err(ErrorCode::RequestFunctionInvalid))),
+        }
+    }
+}
+
+fn expect_string(response: Response) -> String {
+    match response {
+        Response::Success {
+            result: Some(bson::Bson::String(result)),
+            ..
+        } => result,
+        Response::Success { cookie, result } => {
+            panic!(
+                "received unexpected result: {:?}, cookie: {}",
+                result, cookie
+            );
+        }
+        Response::Error { cookie, error_code } => {
+            panic!(
+                "received unexpected error: {}, cookie: {}",
+                error_code, cookie
+            );
+        }
+        Response::Pending { cookie } => {
+            panic!("received unexpected pending, cookie: {}", cookie);
+        }
+    }
+}
+
+fn expect_error(response: Response) -> ErrorCode {
+    match response {
+        Response::Error { error_code, .. } => error_code,
+        _ => panic!("received unexpected non-error response"),
+    }
+}
+
+#[tokio::test]
+async fn test_honk_async_client_apiset() -> anyhow::Result<()> {
+    let listener = TcpListener::bind("127.0.0.1:0").await?;
+    let socket_addr = listener.local_addr()?;
+
+    let stream1 = TcpStream::connect(socket_addr).await?;
+    let (stream2, _socket_addr) = listener.accept().await?;
+
+    let alice = AsyncSession::new(stream1);
+    let pat = AsyncSession::new(stream2);
+    let client = pat.client();
+
+    let mut test_api_set = TestAsyncApiSet {};
+    let alice_apisets: &mut [&mut dyn AsyncApiSet] = &mut [&mut test_api_set];
+    let pat_apisets: &mut [&mut dyn AsyncApiSet] = &mut [];
+    let alice_run = alice.run(alice_apisets);
+    let pat_run = pat.run(pat_apisets);
+
+    let calls = async {
+        println!("--- pat calling test::echo(val: \"Hello Alice!\")");
+        let response = client
+            .client_call("test", "echo", 0, doc! {"val" : "Hello Alice!"})
+            .await?;
+        assert_eq!(expect_string(response), "Hello Alice!");
+
+        println!(
+            "--- pat calling test::echo(string: \"Hello Alice!\"), should fail because bad arg"
+        );
+        let response = client
+            .client_call("test", "echo", 0, doc! {"string" : "Hello Alice!"})
+            .await?;
+        assert_eq!(expect_error(response), RUNTIME_ERROR_INVALID_ARG);
+
+        println!(
+            "--- pat calling foo::echo(val: \"Hello Alice!\"), should fail because bad namespace"
+        );
+        let response = client
+            .client_call("foo", "echo", 0, doc! {"val" : "Hello Alice!"})
+            .await?;
+        assert_eq!(expect_error(response), ErrorCode::RequestNamespaceInvalid);
+
+        println!("--- pat calling test::delay_echo(val) while test::echo(val) is in flight");
+        let (delayed, immediate) = tokio::join!(
+            client.client_call("test", "delay_echo", 0, doc! {"val" : "Hello Delayed?"}),
+            client.client_call("test", "echo", 0, doc! {"val" : "Hello Immediate!"}),
+        );
+        assert_eq!(expect_string(delayed?), "Hello Delayed? - Delayed!");
+        assert_eq!(expect_string(immediate?), "Hello Immediate!");
+
+        Ok::<(), Error>(())
+    };
+
+    tokio::select! {
+        result = alice_run => panic!("alice stopped running: {:?}", result),
+        result = pat_run => panic!("pat stopped running: {:?}", result),
+        result = calls => result?,
+    }
+
+    // both sessions have been dropped
+    println!("--- pat calling test::echo(val) after session terminated");
+    match client
+        .client_call("test", "echo", 0, doc! {"val" : "Hello Alice!"})
+        .await
+    {
+        Err(Error::SessionTerminated()) => (),
+        _ => panic!("expected client call to fail after session termination"),
+    }
+
+    Ok(())
+}
@@ -359,3 +359,137 @@ fn test_honk_client_apiset() -> anyhow::Result<()> {
 
     Ok(())
 }
+
+// echoes requests using only their borrowed arguments
+#[derive(Default)]
+struct RawEchoApiSet {
+    exec_function_count: usize,
+    exec_function_raw_count: usize,
+}
+
+impl ApiSet for RawEchoApiSet {
+    fn namespace(&self) -> &str {
+        "raw"
+    }
+
+    fn exec_function(
+        &mut self,
+        _name: &str,
+        _version: i32,
+        _args: bson::document::Document,
+        _request_cookie: Option<RequestCookie>,
+    ) -> Option<Result<Option<bson::Bson>, ErrorCode>> {
+        self.exec_function_count += 1;
+        Some(Err(RUNTIME_ERROR_NOT_IMPLEMENTED))
+    }
+
+    fn exec_function_raw(
+        &mut self,
+        name: &str,
+        version: i32,
+        args: &bson::RawDocument,
+        _request_cookie: Option<RequestCookie>,
+    ) -> Option<Result<Option<bson::Bson>, ErrorCode>> {
+        self.exec_function_raw_count += 1;
+        match (name, version, args.get_str("val")) {
+            ("echo", 0, Ok(val)) => Some(Ok(Some(bson::Bson::String(val.to_string())))),
+            ("echo", 0, Err(_)) => Some(Err(RUNTIME_ERROR_INVALID_ARG)),
+            _ => Some(Err(ErrorCode::RequestFunctionInvalid)),
+        }
+    }
+}
+
+#[test]
+fn test_honk_client_apiset_borrowed_parse() -> anyhow::Result<()> {
+    let socket_addr = SocketAddr::from(([127, 0, 0, 1], 0u16));
+    let listener = TcpListener::bind(socket_addr)?;
+    let socket_addr = listener.local_addr()?;
+
+    let stream1 = TcpStream::connect(socket_addr)?;
+    stream1.set_nonblocking(true)?;
+    let (stream2, _socket_addr) = listener.accept()?;
+    stream2.set_nonblocking(true)?;
+
+    let mut alice = Session::new(stream1);
+    alice.set_borrowed_parse(true);
+    assert!(alice.get_borrowed_parse());
+    let mut pat = Session::new(stream2);
+    pat.set_borrowed_parse(true);
+
+    // "raw" < "test" so our apisets are sorted by namespace
+    let mut raw_echo_api_set: RawEchoApiSet = Default::default();
+    let mut test_api_set: TestApiSet = Default::default();
+    let alice_apisets: &mut [&mut dyn ApiSet] = &mut [&mut raw_echo_api_set, &mut test_api_set];
+
+    println!("--- pat calling raw::echo(val), test::echo(val), test::delay_echo(val) and raw::echo(string)");
+    let raw_echo_cookie = pat.client_call("raw", "echo", 0, doc! {"val" : "Hello Raw!"})?;
+    let echo_cookie = pat.client_call("test", "echo", 0, doc! {"val" : "Hello Owned!"})?;
+    let delay_echo_cookie =
+        pat.client_call("test", "delay_echo", 0, doc! {"val" : "Hello Delayed?"})?;
+    let bad_arg_cookie = pat.client_call("raw", "echo", 0, doc! {"string" : "Hello Raw!"})?;
+    let bad_namespace_cookie = pat.client_call("missing", "echo", 0, doc! {})?;
+
+    println!("--- pat waits for responses from alice");
+    let mut raw_echo_handled: bool = false;
+    let mut echo_handled: bool = false;
+    let mut delay_echo_acked: bool = false;
+    let mut delay_echo_handled: bool = false;
+    let mut bad_arg_handled: bool = false;
+    let mut bad_namespace_handled: bool = false;
+    while !(raw_echo_handled
+        && echo_handled
+        && delay_echo_acked
+        && delay_echo_handled
+        && bad_arg_handled
+        && bad_namespace_handled)
+    {
+        alice.update(Some(alice_apisets))?;
+        pat.update(None)?;
+        for response in pat.client_drain_responses() {
+            match response {
+                Response::Pending { cookie } => {
+                    assert_eq!(cookie, delay_echo_cookie);
+                    delay_echo_acked = true;
+                }
+                Response::Success { cookie, result } => {
+                    let result = match result {
+                        Some(bson::Bson::String(result)) => result,
+                        result => panic!("received unexpected result: {:?}", result),
+                    };
+                    if cookie == raw_echo_cookie {
+                        assert_eq!(result, "Hello Raw!");
+                        raw_echo_handled = true;
+                    } else if cookie == echo_cookie {
+                        assert_eq!(result, "Hello Owned!");
+                        echo_handled = true;
+                    } else if cookie == delay_echo_cookie {
+                        assert_eq!(result, "Hello Delayed? - Delayed!");
+                        delay_echo_handled = true;
+                    } else {
+                        panic!("received unexpected success, cookie: {}", cookie);
+                    }
+                }
+                Response::Error { cookie, error_code } => {
+                    if cookie == bad_arg_cookie {
+                        assert_eq!(error_code, RUNTIME_ERROR_INVALID_ARG);
+                        bad_arg_handled = true;
+                    } else if cookie == bad_namespace_cookie {
+                        assert_eq!(error_code, ErrorCode::RequestNamespaceInvalid);
+                        bad_namespace_handled = true;
+                    } else {
+                        panic!(
+                            "received unexpected error: {}, cookie: {}",
+                            error_code, cookie
+                        );
+                    }
+                }
+            }
+        }
+    }
+
+    // borrowed requests never fall back to the owned path when implemented
+    assert_eq!(raw_echo_api_set.exec_function_count, 0);
+    assert_eq!(raw_echo_api_set.exec_function_raw_count, 2);
+
+    Ok(())
+}
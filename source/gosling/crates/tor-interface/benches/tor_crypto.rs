@@ -0,0 +1,155 @@
+// extern crates
+use bench_common::{report_allocations, CountingAllocator};
+use criterion::{black_box, criterion_group, criterion_main, BenchmarkId, Criterion, Throughput};
+
+// internal crates
+use tor_interface::tor_crypto::*;
+
+#[global_allocator]
+static GLOBAL: CountingAllocator = CountingAllocator;
+
+// message sizes exercised by the sign/verify benchmarks
+const MESSAGE_SIZES: [usize; 3] = [32, 1024, 16 * 1024];
+// batch sizes exercised by the batch verification benchmark
+const BATCH_SIZES: [usize; 3] = [1, 8, 64];
+
+fn bench_keygen(c: &mut Criterion) {
+    let mut group = c.benchmark_group("keygen");
+
+    report_allocations("keygen/ed25519", 100, || {
+        black_box(Ed25519PrivateKey::generate());
+    });
+    group.bench_function("ed25519", |b| b.iter(Ed25519PrivateKey::generate));
+
+    report_allocations("keygen/x25519", 100, || {
+        black_box(X25519PrivateKey::generate());
+    });
+    group.bench_function("x25519", |b| b.iter(X25519PrivateKey::generate));
+
+    group.finish();
+}
+
+fn bench_sign_verify(c: &mut Criterion) {
+    let private_key = Ed25519PrivateKey::generate();
+    let public_key = Ed25519PublicKey::from_private_key(&private_key);
+
+    let mut group = c.benchmark_group("ed25519_sign");
+    for size in MESSAGE_SIZES {
+        let message = vec![0u8; size];
+        report_allocations(&format!("ed25519_sign/{}", size), 100, || {
+            black_box(private_key.sign_message(&message));
+        });
+        group.throughput(Throughput::Bytes(size as u64));
+        group.bench_with_input(BenchmarkId::from_parameter(size), &message, |b, message| {
+            b.iter(|| private_key.sign_message(message))
+        });
+    }
+    group.finish();
+
+    let mut group = c.benchmark_group("ed25519_verify");
+    for size in MESSAGE_SIZES {
+        let message = vec![0u8; size];
+        let signature = private_key.sign_message(&message);
+        report_allocations(&format!("ed25519_verify/{}", size), 100, || {
+            assert!(signature.verify(&message, &public_key));
+        });
+        group.throughput(Throughput::Bytes(size as u64));
+        group.bench_with_input(BenchmarkId::from_parameter(size), &message, |b, message| {
+            b.iter(|| signature.verify(message, &public_key))
+        });
+    }
+    group.finish();
+
+    let mut group = c.benchmark_group("ed25519_verify_batch");
+    for count in BATCH_SIZES {
+        let message = [0u8; 32];
+        let keys: Vec<(Ed25519Signature, Ed25519PublicKey)> = (0..count)
+            .map(|_| {
+                let private_key = Ed25519PrivateKey::generate();
+                (
+                    private_key.sign_message(&message),
+                    Ed25519PublicKey::from_private_key(&private_key),
+                )
+            })
+            .collect();
+        let batch: Vec<(&[u8], &Ed25519Signature, &Ed25519PublicKey)> = keys
+            .iter()
+            .map(|(signature, public_key)| (message.as_slice(), signature, public_key))
+            .collect();
+
+        report_allocations(&format!("ed25519_verify_batch/{}", count), 100, || {
+            assert!(Ed25519Signature::verify_batch(&batch));
+        });
+        group.throughput(Throughput::Elements(count as u64));
+        group.bench_with_input(BenchmarkId::from_parameter(count), &batch, |b, batch| {
+            b.iter(|| Ed25519Signature::verify_batch(batch))
+        });
+    }
+    group.finish();
+}
+
+fn bench_conversions(c: &mut Criterion) {
+    let mut group = c.benchmark_group("conversions");
+
+    let private_key = Ed25519PrivateKey::generate();
+    let public_key = Ed25519PublicKey::from_private_key(&private_key);
+    let service_id = V3OnionServiceId::from_public_key(&public_key);
+    let service_id_string = service_id.to_string();
+
+    report_allocations("conversions/service_id_from_public_key", 100, || {
+        black_box(V3OnionServiceId::from_public_key(&public_key));
+    });
+    group.bench_function("service_id_from_public_key", |b| {
+        b.iter(|| V3OnionServiceId::from_public_key(&public_key))
+    });
+
+    // parse from a string each iteration so the cached public key is not used
+    report_allocations("conversions/public_key_from_service_id", 100, || {
+        let service_id = V3OnionServiceId::from_string(&service_id_string).unwrap();
+        black_box(Ed25519PublicKey::from_service_id(&service_id).unwrap());
+    });
+    group.bench_function("public_key_from_service_id", |b| {
+        b.iter(|| {
+            let service_id = V3OnionServiceId::from_string(&service_id_string).unwrap();
+            Ed25519PublicKey::from_service_id(&service_id).unwrap()
+        })
+    });
+
+    report_allocations("conversions/service_id_from_string", 100, || {
+        black_box(V3OnionServiceId::from_string(&service_id_string).unwrap());
+    });
+    group.bench_function("service_id_from_string", |b| {
+        b.iter(|| V3OnionServiceId::from_string(&service_id_string).unwrap())
+    });
+
+    let x25519_private_key = X25519PrivateKey::generate();
+    let x25519_public_key = X25519PublicKey::from_private_key(&x25519_private_key);
+    let x25519_base32 = x25519_public_key.to_base32();
+
+    report_allocations("conversions/x25519_to_base32", 100, || {
+        black_box(x25519_public_key.to_base32());
+    });
+    group.bench_function("x25519_to_base32", |b| {
+        b.iter(|| x25519_public_key.to_base32())
+    });
+
+    report_allocations("conversions/x25519_from_base32", 100, || {
+        black_box(X25519PublicKey::from_base32(&x25519_base32).unwrap());
+    });
+    group.bench_function("x25519_from_base32", |b| {
+        b.iter(|| X25519PublicKey::from_base32(&x25519_base32).unwrap())
+    });
+
+    let key_blob = private_key.to_key_blob();
+    report_allocations("conversions/ed25519_from_key_blob", 100, || {
+        black_box(Ed25519PrivateKey::from_key_blob(&key_blob).unwrap());
+    });
+    group.bench_function("ed25519_from_key_blob", |b| {
+        b.iter(|| Ed25519PrivateKey::from_key_blob(&key_blob).unwrap())
+    });
+
+    group.finish();
+}
+
+criterion_group!(benches, bench_keygen, bench_sign_verify, bench_conversions);
+criterion_main!(benches);
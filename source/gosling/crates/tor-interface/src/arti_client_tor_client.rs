@@ -1,15 +1,12 @@
 // standard
 use std::net::SocketAddr;
-use std::ops::DerefMut;
 use std::path::{Path, PathBuf};
-use std::sync::atomic::{AtomicBool, Ordering};
 use std::sync::{Arc, Mutex};
 
 //extern
 use arti_client::config::{CfgPath, TorClientConfigBuilder};
-use arti_client::{BootstrapBehavior, DangerouslyIntoTorAddr, IntoTorAddr, TorClient};
+use arti_client::{BootstrapBehavior, DangerouslyIntoTorAddr, DataStream, IntoTorAddr, TorClient};
 use fs_mistrust::Mistrust;
-use tokio::io::{AsyncReadExt, AsyncWriteExt};
 use tokio::net::{TcpListener, TcpStream};
 use tokio::runtime;
 use tokio_stream::StreamExt;
@@ -49,6 +46,15 @@ pub enum Error {
     #[error("unable to convert tokio::TcpStream to std::net::TcpStream")]
     TcpStreamIntoFailed(#[source] std::io::Error),
 
+    #[error("unable to convert std::net::TcpStream to tokio::TcpStream")]
+    TcpStreamFromStdFailed(#[source] std::io::Error),
+
+    #[error("unable to get TCP stream's local address")]
+    TcpStreamLocalAddrFailed(#[source] std::io::Error),
+
+    #[error("unable to configure TCP stream")]
+    TcpStreamConfigurationFailed(#[source] std::io::Error),
+
     #[error("arti-client config-builder error: {0}")]
     ArtiClientConfigBuilderError(#[source] arti_client::config::ConfigBuildError),
 
@@ -93,60 +99,133 @@ pub struct ArtiClientTorClient {
     arti_client: TorClient<PreferredRuntime>,
     state_dir: PathBuf,
     fs_mistrust: Mistrust,
-    pending_events: Arc<Mutex<Vec<TorEvent>>>,
+    pending_events: Arc<Mutex<PendingEvents>>,
+    has_event_waker: bool,
+    next_connect_handle: ConnectHandle,
+    loopback: Arc<tokio::sync::Mutex<LoopbackPairer>>,
+}
+
+// events produced by our background tasks, waiting to be returned from update()
+#[derive(Default)]
+struct PendingEvents {
+    events: Vec<TorEvent>,
+    waker: Option<TorEventWaker>,
 }
 
-// used to forward traffic to/from arti to local tcp streams
-async fn forward_stream<R, W>(alive: Arc<AtomicBool>, mut reader: R, mut writer: W) -> ()
-where
-    R: AsyncReadExt + Unpin,
-    W: AsyncWriteExt + Unpin,
-{
-    // allow 100ms timeout on reads to verify writer is still good
-    let read_timeout = std::time::Duration::from_millis(100);
-    // allow additional retries in the event the other half of the pump
-    // dies; keep pumping data until our read times out 3 times
-    let mut remaining_retries = 3;
-    let mut buf = [0u8; 1024];
-
-    loop {
-        if !alive.load(Ordering::Relaxed) && remaining_retries == 0 {
-            break;
+impl PendingEvents {
+    fn push(&mut self, event: TorEvent) {
+        self.events.push(event);
+        if let Some(waker) = self.waker.as_ref() {
+            waker();
         }
+    }
+}
 
-        tokio::select! {
-            count = reader.read(&mut buf) => match count {
-                // end of stream
-                Ok(0) => break,
-                // read N bytes
-                Ok(count) => {
-                    // forward traffic
-                    match writer.write_all(&buf[0..count]).await {
-                        Ok(()) => (),
-                        Err(_err) => break,
-                    }
-                    match writer.flush().await {
-                        Ok(()) => (),
-                        Err(_err) => break,
-                    }
-                },
-                // read failed
-                Err(_err) => break,
-            },
-            _ = tokio::time::sleep(read_timeout.clone()) => match writer.flush().await {
-                Ok(()) => {
-                    // so long as our writer and reader are good, we should
-                    // allow a few additional data pump attempts
-                    if !alive.load(Ordering::Relaxed) {
-                        remaining_retries -= 1;
-                    }
-                },
-                Err(_err) => break,
+// Hands out connected pairs of loopback tcp streams from a single listener
+// rather than binding a new listener for every outbound connection. The
+// returned OnionStream must wrap a real socket (callers poll it and hand its
+// descriptor to foreign code) so one loopback hop remains.
+struct LoopbackPairer {
+    listener: TcpListener,
+    socket_addr: SocketAddr,
+}
+
+impl LoopbackPairer {
+    async fn new() -> Result<Self, Error> {
+        // try to bind to a local address, let OS pick our port
+        let socket_addr = SocketAddr::from(([127, 0, 0, 1], 0u16));
+        let listener = TcpListener::bind(socket_addr)
+            .await
+            .map_err(Error::TcpListenerBindFailed)?;
+        let socket_addr = listener
+            .local_addr()
+            .map_err(Error::TcpListenerLocalAddrFailed)?;
+        Ok(Self {
+            listener,
+            socket_addr,
+        })
+    }
+
+    // returns the (client, server) ends of a new loopback connection; callers
+    // must serialise calls so the only pending connection is the one just made
+    async fn pair(&self) -> Result<(std::net::TcpStream, TcpStream), Error> {
+        let client_stream = TcpStream::connect(self.socket_addr)
+            .await
+            .map_err(Error::TcpStreamConnectFailed)?;
+        let client_addr = client_stream
+            .local_addr()
+            .map_err(Error::TcpStreamLocalAddrFailed)?;
+        let server_stream = loop {
+            let (server_stream, peer_addr) = self
+                .listener
+                .accept()
+                .await
+                .map_err(Error::TcpListenerAcceptFailed)?;
+            // drop any connection which is not our own
+            if peer_addr == client_addr {
+                break server_stream;
             }
+        };
+
+        // the client end is handed to callers as a blocking std stream
+        let client_stream = client_stream
+            .into_std()
+            .map_err(Error::TcpStreamIntoFailed)?;
+        client_stream
+            .set_nonblocking(false)
+            .map_err(Error::TcpStreamConfigurationFailed)?;
+        Ok((client_stream, server_stream))
+    }
+}
+
+// used to forward traffic to/from arti to local tcp streams; a single task
+// copies in both directions until either side closes, flushing the arti
+// stream whenever the local socket has nothing more to read
+async fn forward_stream(mut data_stream: DataStream, mut tcp_stream: TcpStream) {
+    let _ = tcp_stream.set_nodelay(true);
+    let _ = tokio::io::copy_bidirectional(&mut data_stream, &mut tcp_stream).await;
+}
+
+// connect to target and forward traffic between the returned data stream
+// and a local tcp socket
+async fn connect_impl(
+    arti_client: TorClient<PreferredRuntime>,
+    loopback: Arc<tokio::sync::Mutex<LoopbackPairer>>,
+    target: TargetAddr,
+) -> Result<OnionStream, tor_provider::Error> {
+    // connect to onion service
+    let arti_target = match target.clone() {
+        TargetAddr::Socket(socket_addr) => socket_addr.into_tor_addr_dangerously(),
+        TargetAddr::Domain(domain_addr) => {
+            (domain_addr.domain(), domain_addr.port()).into_tor_addr()
         }
+        TargetAddr::OnionService(OnionAddr::V3(OnionAddrV3 {
+            service_id,
+            virt_port,
+        })) => (format!("{}.onion", service_id), virt_port).into_tor_addr(),
     }
-    // signal pump death
-    alive.store(false, Ordering::Relaxed);
+    .map_err(Error::ArtiClientTorAddrError)?;
+
+    let data_stream = arti_client
+        .connect(arti_target)
+        .await
+        .map_err(Error::ArtiClientError)?;
+
+    // client stream will ultimately be returned from connect(); the async lock
+    // serialises pairing without blocking a runtime thread while we wait
+    let (stream, server_stream) = loopback.lock().await.pair().await?;
+    stream
+        .set_nodelay(true)
+        .map_err(Error::TcpStreamConfigurationFailed)?;
+
+    // now spawn a new task to forward traffic to/from the arti data stream
+    tokio::task::spawn(forward_stream(data_stream, server_stream));
+
+    Ok(OnionStream {
+        stream,
+        local_addr: None,
+        peer_addr: Some(target),
+    })
 }
 
 impl ArtiClientTorClient {
@@ -196,26 +275,38 @@ impl ArtiClientTorClient {
             // https://gitlab.torproject.org/tpo/core/arti/-/issues/1356
         })?;
 
-        let pending_events = std::vec![TorEvent::LogReceived {
-            line: "Starting arti-client TorProvider".to_string()
-        }];
+        let pending_events = PendingEvents {
+            events: std::vec![TorEvent::LogReceived {
+                line: "Starting arti-client TorProvider".to_string()
+            }],
+            waker: None,
+        };
         let pending_events = Arc::new(Mutex::new(pending_events));
 
+        let loopback = tokio_runtime.block_on(LoopbackPairer::new())?;
+        let loopback = Arc::new(tokio::sync::Mutex::new(loopback));
+
         Ok(Self {
             tokio_runtime,
             arti_client,
             state_dir,
             fs_mistrust,
             pending_events,
+            has_event_waker: false,
+            next_connect_handle: Default::default(),
+            loopback,
         })
     }
 }
 
 impl TorProvider for ArtiClientTorClient {
     fn update(&mut self) -> Result<Vec<TorEvent>, tor_provider::Error> {
-        std::thread::sleep(std::time::Duration::from_millis(16));
+        // without an event waker our caller is busy-polling so throttle it
+        if !self.has_event_waker {
+            std::thread::sleep(std::time::Duration::from_millis(16));
+        }
         match self.pending_events.lock() {
-            Ok(mut pending_events) => Ok(std::mem::take(pending_events.deref_mut())),
+            Ok(mut pending_events) => Ok(std::mem::take(&mut pending_events.events)),
             Err(_) => {
                 unreachable!("another thread panicked while holding this pending_events mutex")
             }
@@ -292,73 +383,43 @@ impl TorProvider for ArtiClientTorClient {
             return Err(Error::NotImplemented().into());
         }
 
-        // connect to onion service
-        let arti_target = match target.clone() {
-            TargetAddr::Socket(socket_addr) => socket_addr.into_tor_addr_dangerously(),
-            TargetAddr::Domain(domain_addr) => {
-                (domain_addr.domain(), domain_addr.port()).into_tor_addr()
-            }
-            TargetAddr::OnionService(OnionAddr::V3(OnionAddrV3 {
-                service_id,
-                virt_port,
-            })) => (format!("{}.onion", service_id), virt_port).into_tor_addr(),
+        let arti_client = self.arti_client.clone();
+        let loopback = self.loopback.clone();
+        self.tokio_runtime
+            .block_on(async move { connect_impl(arti_client, loopback, target).await })
+    }
+
+    fn connect_async(
+        &mut self,
+        target: TargetAddr,
+        circuit: Option<CircuitToken>,
+    ) -> Result<ConnectHandle, tor_provider::Error> {
+        // stream isolation not implemented yet
+        if circuit.is_some() {
+            return Err(Error::NotImplemented().into());
         }
-        .map_err(Error::ArtiClientTorAddrError)?;
 
+        let handle = self.next_connect_handle;
+        self.next_connect_handle += 1;
+
+        // connect in the background and signal the result through pending_events
         let arti_client = self.arti_client.clone();
-        let data_stream = self
-            .tokio_runtime
-            .block_on(async move { arti_client.connect(arti_target).await })
-            .map_err(Error::ArtiClientError)?;
-
-        // start a task to forward traffic from returned data stream
-        // and tcp socket
-        let client_stream = self.tokio_runtime.block_on(async move {
-            let (data_reader, data_writer) = data_stream.split();
-
-            // try to bind to a local address, let OS pick our port
-            let socket_addr = SocketAddr::from(([127, 0, 0, 1], 0u16));
-            let server_listener = TcpListener::bind(socket_addr)
-                .await
-                .map_err(Error::TcpListenerBindFailed)?;
-            // await future after a client connects
-            let server_accept_future = server_listener.accept();
-            let socket_addr = server_listener
-                .local_addr()
-                .map_err(Error::TcpListenerLocalAddrFailed)?;
-
-            // client stream will ultimatley be returned from connect()
-            let client_stream = TcpStream::connect(socket_addr)
-                .await
-                .map_err(Error::TcpStreamConnectFailed)?;
-            // client has connected so now get the server's tcp stream
-            let (server_stream, _socket_addr) = server_accept_future
-                .await
-                .map_err(Error::TcpListenerAcceptFailed)?;
-            let (tcp_reader, tcp_writer) = server_stream.into_split();
-
-            // now spawn new tasks to forward traffic to/from local listener
-            let pump_alive = Arc::new(AtomicBool::new(true));
-            tokio::task::spawn({
-                let pump_alive = pump_alive.clone();
-                async move {
-                    forward_stream(pump_alive, tcp_reader, data_writer).await;
+        let loopback = self.loopback.clone();
+        let pending_events = self.pending_events.clone();
+        self.tokio_runtime.spawn(async move {
+            let event = match connect_impl(arti_client, loopback, target).await {
+                Ok(stream) => TorEvent::ConnectComplete { handle, stream },
+                Err(error) => TorEvent::ConnectFailed { handle, error },
+            };
+            match pending_events.lock() {
+                Ok(mut pending_events) => pending_events.push(event),
+                Err(_) => {
+                    unreachable!("another thread panicked while holding this pending_events mutex")
                 }
-            });
-            tokio::task::spawn(async move {
-                forward_stream(pump_alive, data_reader, tcp_writer).await;
-            });
-            Ok::<TcpStream, tor_provider::Error>(client_stream)
-        })?;
+            }
+        });
 
-        let stream = client_stream
-            .into_std()
-            .map_err(Error::TcpStreamIntoFailed)?;
-        Ok(OnionStream {
-            stream,
-            local_addr: None,
-            peer_addr: Some(target),
-        })
+        Ok(handle)
     }
 
     fn listener(
@@ -492,28 +553,13 @@ impl TorProvider for ArtiClientTorClient {
                                     // TODO: probably not our problem
                                     _ => continue,
                                 };
-                            let (data_reader, data_writer) = data_stream.split();
-
-                            let (tcp_reader, tcp_writer) =
-                                match TcpStream::connect(socket_addr).await {
-                                    Ok(tcp_stream) => tcp_stream.into_split(),
-                                    // TODO: possibly our problem?
-                                    _ => continue,
-                                };
-                            // now spawn new tasks to forward traffic to/from the onion listener
-
-                            let pump_alive = Arc::new(AtomicBool::new(true));
-                            // read from connected client and write to local socket
-                            tokio::task::spawn({
-                                let pump_alive = pump_alive.clone();
-                                async move {
-                                    forward_stream(pump_alive, data_reader, tcp_writer).await;
-                                }
-                            });
-                            // read from local socket and write to connected client
-                            tokio::task::spawn(async move {
-                                forward_stream(pump_alive, tcp_reader, data_writer).await;
-                            });
+                            let tcp_stream = match TcpStream::connect(socket_addr).await {
+                                Ok(tcp_stream) => tcp_stream,
+                                // TODO: possibly our problem?
+                                _ => continue,
+                            };
+                            // now spawn a new task to forward traffic to/from the onion listener
+                            tokio::task::spawn(forward_stream(data_stream, tcp_stream));
                         } else {
                             // either requesting the wrong port or the wrong type of stream request
                             let _ = stream_request.shutdown_circuit();
@@ -532,4 +578,21 @@ impl TorProvider for ArtiClientTorClient {
     }
 
     fn release_token(&mut self, _token: CircuitToken) {}
+
+    fn set_event_waker(&mut self, waker: TorEventWaker) -> bool {
+        match self.pending_events.lock() {
+            Ok(mut pending_events) => {
+                // events queued before now still need to be signalled
+                if !pending_events.events.is_empty() {
+                    waker();
+                }
+                pending_events.waker = Some(waker);
+            }
+            Err(_) => {
+                unreachable!("another thread panicked while holding this pending_events mutex")
+            }
+        }
+        self.has_event_waker = true;
+        true
+    }
 }
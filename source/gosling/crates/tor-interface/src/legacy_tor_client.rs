@@ -2,16 +2,22 @@
 use std::collections::BTreeMap;
 use std::convert::From;
 use std::default::Default;
-use std::net::{SocketAddr, TcpListener};
+use std::io::{Read, Write};
+use std::net::{SocketAddr, TcpListener, TcpStream};
 use std::option::Option;
+#[cfg(unix)]
+use std::os::unix::fs::DirBuilderExt;
+#[cfg(unix)]
+use std::os::unix::io::OwnedFd;
+#[cfg(unix)]
+use std::os::unix::net::{UnixListener, UnixStream};
+#[cfg(unix)]
+use std::path::Path;
 use std::path::PathBuf;
 use std::string::ToString;
-use std::sync::{atomic, Arc};
+use std::sync::{atomic, mpsc, Arc, Mutex};
 use std::time::Duration;
 
-// extern crates
-use socks::Socks5Stream;
-
 // internal crates
 use crate::censorship_circumvention::*;
 use crate::legacy_tor_control_stream::*;
@@ -62,6 +68,9 @@ pub enum Error {
     #[error("failed to add client auth for onion service")]
     OnionClientAuthAddFailed(#[source] crate::legacy_tor_controller::Error),
 
+    #[error("failed to fetch onion service descriptor")]
+    HsFetchFailed(#[source] crate::legacy_tor_controller::Error),
+
     #[error("failed to remove client auth from onion service")]
     OnionClientAuthRemoveFailed(#[source] crate::legacy_tor_controller::Error),
 
@@ -77,12 +86,27 @@ pub enum Error {
     #[error("unable to connect to socks listener")]
     Socks5ConnectionFailed(#[source] std::io::Error),
 
+    #[error("unable to spawn connect thread")]
+    ConnectThreadSpawnFailed(#[source] std::io::Error),
+
     #[error("unable to bind TCP listener")]
     TcpListenerBindFailed(#[source] std::io::Error),
 
     #[error("unable to get TCP listener's local address")]
     TcpListenerLocalAddrFailed(#[source] std::io::Error),
 
+    #[error("unix-domain sockets are not supported on this platform")]
+    UnixDomainSocketsNotSupported(),
+
+    #[error("unable to create unix-domain socket directory")]
+    UnixSocketDirectoryCreationFailed(#[source] std::io::Error),
+
+    #[error("unix-domain socket path must be shorter than 104 bytes and must not contain whitespace or '\"': {0:?}")]
+    UnixSocketPathInvalid(PathBuf),
+
+    #[error("unable to bind unix-domain socket listener")]
+    UnixListenerBindFailed(#[source] std::io::Error),
+
     #[error("failed to create onion service")]
     AddOnionFailed(#[source] crate::legacy_tor_controller::Error),
 
@@ -126,6 +150,7 @@ impl From<Error> for crate::tor_provider::Error {
 //
 // CircuitToken Implementation
 //
+#[derive(Clone)]
 struct LegacyCircuitToken {
     username: String,
     password: String,
@@ -161,6 +186,8 @@ pub enum LegacyTorClientConfig {
         allowed_ports: Option<Vec<u16>>,
         pluggable_transports: Option<Vec<PluggableTransportConfig>>,
         bridge_lines: Option<Vec<BridgeLine>>,
+        /// Connect to the tor daemon's SOCKS listener and have it forward onion-service connections over unix-domain sockets in the data directory rather than loopback TCP ports; only supported on unix, see [`OnionStream`]
+        unix_domain_sockets: bool,
     },
     SystemTor {
         tor_socks_addr: SocketAddr,
@@ -173,22 +200,113 @@ pub enum LegacyTorClientConfig {
 // LegacyTorClient
 //
 
+// the socks listener, socks target and circuit credentials for a socks5_connect()
+type Socks5ConnectArgs = (
+    LegacySocketAddr,
+    socks::TargetAddr,
+    Option<LegacyCircuitToken>,
+);
+
+// a connect_async() request waiting for a ConnectPool thread
+type ConnectJob = Box<dyn FnOnce() + Send>;
+
+// The threads running connect_async() requests' blocking socks5 connects. Threads
+// are spawned as requests arrive, up to MAX_CONNECT_THREADS; further requests queue
+// until one of them is free. Idle threads exit once the pool is dropped.
+struct ConnectPool {
+    job_sender: mpsc::Sender<ConnectJob>,
+    job_receiver: Arc<Mutex<mpsc::Receiver<ConnectJob>>>,
+    // requests queued or running
+    jobs: Arc<atomic::AtomicUsize>,
+    threads: usize,
+}
+
+impl ConnectPool {
+    // each thread holds at most one socks5 connect open, so this caps the number of
+    // in-flight connects; tor itself builds their circuits concurrently
+    const MAX_CONNECT_THREADS: usize = 32;
+
+    fn new() -> Self {
+        let (job_sender, job_receiver) = mpsc::channel();
+        Self {
+            job_sender,
+            job_receiver: Arc::new(Mutex::new(job_receiver)),
+            jobs: Default::default(),
+            threads: 0,
+        }
+    }
+
+    fn run(&mut self, job: ConnectJob) -> Result<(), Error> {
+        let jobs = self.jobs.fetch_add(1, atomic::Ordering::Relaxed) + 1;
+        if jobs > self.threads && self.threads < Self::MAX_CONNECT_THREADS {
+            let job_receiver = Arc::clone(&self.job_receiver);
+            let jobs = Arc::clone(&self.jobs);
+            let spawned = std::thread::Builder::new()
+                .name(format!("legacy-tor-connect-{}", self.threads))
+                .spawn(move || loop {
+                    let job = match job_receiver.lock() {
+                        Ok(job_receiver) => job_receiver.recv(),
+                        Err(_) => return,
+                    };
+                    match job {
+                        Ok(job) => {
+                            job();
+                            jobs.fetch_sub(1, atomic::Ordering::Relaxed);
+                        }
+                        // the pool has been dropped
+                        Err(_) => return,
+                    }
+                });
+            match spawned {
+                Ok(_) => self.threads += 1,
+                // the existing threads get to the job eventually
+                Err(_) if self.threads > 0 => (),
+                Err(err) => {
+                    self.jobs.fetch_sub(1, atomic::Ordering::Relaxed);
+                    return Err(Error::ConnectThreadSpawnFailed(err));
+                }
+            }
+        }
+
+        // the threads only go away once job_sender is dropped
+        match self.job_sender.send(job) {
+            Ok(()) => Ok(()),
+            Err(_) => unreachable!(),
+        }
+    }
+}
+
 /// A `LegacyTorClient` implements the [`TorProvider`] trait using a legacy c-tor daemon backend.
 ///
 /// The tor process can either be launched and owned by `LegacyTorClient`, or it can use an already running tor-daemon. When using an already runnng tor-daemon, the [`TorProvider::bootstrap()`] automatically succeeds, presuming the connected tor-daemon has successfully bootstrapped.
 ///
+/// An owned tor daemon is shut down cleanly when the `LegacyTorClient` is dropped, persisting its state to the data directory; a later `LegacyTorClient` using the same data directory bootstraps from this state and the cached directory documents rather than from scratch.
+///
 /// The minimum supported c-tor is version 0.4.6.1.
 pub struct LegacyTorClient {
     daemon: Option<LegacyTorProcess>,
     version: LegacyTorVersion,
     controller: LegacyTorController,
     bootstrapped: bool,
-    socks_listener: Option<SocketAddr>,
+    socks_listener: Option<LegacySocketAddr>,
+    // directory of our onion-service target sockets when using unix-domain sockets
+    #[cfg(unix)]
+    unix_socket_directory: Option<PathBuf>,
+    #[cfg(unix)]
+    unix_socket_counter: usize,
     // list of open onion services and their is_active flag
     onion_services: Vec<(V3OnionServiceId, Arc<atomic::AtomicBool>)>,
     // our list of circuit tokens for the tor daemon
     circuit_token_counter: usize,
     circuit_tokens: BTreeMap<CircuitToken, LegacyCircuitToken>,
+    // in-flight connect_async() requests run on connect_pool and report back over
+    // this channel
+    connect_handle_counter: ConnectHandle,
+    connect_pool: ConnectPool,
+    connect_sender: mpsc::Sender<(ConnectHandle, Result<OnionStream, Error>)>,
+    connect_receiver: mpsc::Receiver<(ConnectHandle, Result<OnionStream, Error>)>,
+    // signals background connects and log lines are ready
+    event_waker: Option<TorEventWaker>,
 }
 
 impl LegacyTorClient {
@@ -234,7 +352,7 @@ impl LegacyTorClient {
                     None,
                     controller,
                     tor_control_passwd.clone(),
-                    Some(tor_socks_addr.clone()),
+                    Some(LegacySocketAddr::Tcp(*tor_socks_addr)),
                 )
             }
         };
@@ -266,15 +384,41 @@ impl LegacyTorClient {
         }
 
         // configure tor client
+        #[cfg(unix)]
+        let mut unix_socket_directory: Option<PathBuf> = None;
         if let LegacyTorClientConfig::BundledTor {
             data_directory,
             proxy_settings,
             allowed_ports,
             pluggable_transports,
             bridge_lines,
+            unix_domain_sockets,
             ..
         } = config
         {
+            // configure unix-domain sockets
+            #[cfg(not(unix))]
+            if unix_domain_sockets {
+                return Err(Error::UnixDomainSocketsNotSupported());
+            }
+            #[cfg(unix)]
+            if unix_domain_sockets {
+                // tor refuses to listen on sockets in a directory other users can access
+                let mut socket_directory = data_directory.clone();
+                socket_directory.push("sockets");
+                std::fs::DirBuilder::new()
+                    .recursive(true)
+                    .mode(0o700)
+                    .create(&socket_directory)
+                    .map_err(Error::UnixSocketDirectoryCreationFailed)?;
+
+                let socks_path = unix_socket_path(&socket_directory, UNIX_SOCKS_SOCKET_NAME)?;
+                controller
+                    .setconf(&[("SocksPort", LegacySocketAddr::Unix(socks_path).to_string())])
+                    .map_err(Error::SetConfFailed)?;
+                unix_socket_directory = Some(socket_directory);
+            }
+
             // configure proxy
             match proxy_settings {
                 Some(ProxyConfig::Socks4(Socks4ProxyConfig { address })) => {
@@ -432,20 +576,40 @@ impl LegacyTorClient {
             }
         }
 
+        // there is no need to query tor for a socks listener we configured ourselves
+        #[cfg(unix)]
+        let socks_listener = match &unix_socket_directory {
+            Some(unix_socket_directory) => Some(LegacySocketAddr::Unix(
+                unix_socket_directory.join(UNIX_SOCKS_SOCKET_NAME),
+            )),
+            None => socks_listener,
+        };
+
         // register for STATUS_CLIENT async events
         controller
             .setevents(&["STATUS_CLIENT", "HS_DESC"])
             .map_err(Error::SetEventsFailed)?;
 
+        let (connect_sender, connect_receiver) = mpsc::channel();
+
         Ok(LegacyTorClient {
             daemon,
             version,
             controller,
             bootstrapped: false,
             socks_listener,
+            #[cfg(unix)]
+            unix_socket_directory,
+            #[cfg(unix)]
+            unix_socket_counter: 0usize,
             onion_services: Default::default(),
             circuit_token_counter: 0usize,
             circuit_tokens: Default::default(),
+            connect_handle_counter: 0usize,
+            connect_pool: ConnectPool::new(),
+            connect_sender,
+            connect_receiver,
+            event_waker: None,
         })
     }
 
@@ -453,24 +617,335 @@ impl LegacyTorClient {
     pub fn version(&mut self) -> LegacyTorVersion {
         self.version.clone()
     }
+
+    // resolve everything needed to open a socks5 connection to target
+    fn socks5_connect_args(
+        &mut self,
+        target: &TargetAddr,
+        circuit: Option<CircuitToken>,
+    ) -> Result<Socks5ConnectArgs, Error> {
+        if !self.bootstrapped {
+            return Err(Error::LegacyTorNotBootstrapped());
+        }
+
+        if self.socks_listener.is_none() {
+            let mut listeners = self
+                .controller
+                .getinfo_net_listeners_socks()
+                .map_err(Error::GetInfoNetListenersSocksFailed)?;
+            if listeners.is_empty() {
+                return Err(Error::NoSocksListenersFound());
+            }
+            self.socks_listener = Some(listeners.swap_remove(0));
+        }
+
+        let socks_listener = match &self.socks_listener {
+            Some(socks_listener) => socks_listener.clone(),
+            None => unreachable!(),
+        };
+
+        // our target
+        let socks_target = match target.clone() {
+            TargetAddr::Socket(socket_addr) => socks::TargetAddr::Ip(socket_addr),
+            TargetAddr::Domain(domain_addr) => {
+                socks::TargetAddr::Domain(domain_addr.domain().to_string(), domain_addr.port())
+            }
+            TargetAddr::OnionService(OnionAddr::V3(OnionAddrV3 {
+                service_id,
+                virt_port,
+            })) => socks::TargetAddr::Domain(format!("{}.onion", service_id), virt_port),
+        };
+
+        // our circuit credentials
+        let circuit = match &circuit {
+            None => None,
+            Some(circuit) => match self.circuit_tokens.get(circuit) {
+                Some(circuit) => Some(circuit.clone()),
+                None => return Err(Error::CircuitTokenInvalid()),
+            },
+        };
+
+        Ok((socks_listener, socks_target, circuit))
+    }
+
+    // bind a local socket for an onion-service to forward its connections to
+    fn bind_onion_target(&mut self) -> Result<OnionTarget, Error> {
+        #[cfg(unix)]
+        if let Some(unix_socket_directory) = &self.unix_socket_directory {
+            let name = format!("onion-{}", self.unix_socket_counter);
+            self.unix_socket_counter += 1;
+            let path = unix_socket_path(unix_socket_directory, &name)?;
+            // remove any socket left behind by a previous process
+            let _ = std::fs::remove_file(&path);
+            let listener = UnixListener::bind(&path).map_err(Error::UnixListenerBindFailed)?;
+            return Ok(OnionTarget {
+                listener: listener.into(),
+                addr: LegacySocketAddr::Unix(path.clone()),
+                socket_file: Some(UnixSocketFile(path)),
+            });
+        }
+
+        // try to bind to a local address, let OS pick our port
+        let socket_addr = SocketAddr::from(([127, 0, 0, 1], 0u16));
+        let listener = TcpListener::bind(socket_addr).map_err(Error::TcpListenerBindFailed)?;
+        let socket_addr = listener
+            .local_addr()
+            .map_err(Error::TcpListenerLocalAddrFailed)?;
+        Ok(OnionTarget {
+            listener: listener.into(),
+            addr: LegacySocketAddr::Tcp(socket_addr),
+            #[cfg(unix)]
+            socket_file: None,
+        })
+    }
+
+    // wrap a started onion-service's target in an OnionListener which marks the
+    // onion-service inactive (and removes any socket file) when dropped
+    fn onion_listener(
+        target: OnionTarget,
+        onion_addr: OnionAddr,
+        is_active: Arc<atomic::AtomicBool>,
+    ) -> OnionListener {
+        #[cfg(unix)]
+        let data = (is_active, target.socket_file);
+        #[cfg(not(unix))]
+        let data = (is_active, ());
+        OnionListener::new(target.listener, onion_addr, data, |(is_active, _)| {
+            is_active.store(false, atomic::Ordering::Relaxed);
+        })
+    }
+}
+
+// a bound local socket an onion-service forwards its connections to
+struct OnionTarget {
+    listener: OnionListenerSocket,
+    addr: LegacySocketAddr,
+    // removed once the OnionListener using it is dropped
+    #[cfg(unix)]
+    socket_file: Option<UnixSocketFile>,
+}
+
+// removes a unix-domain socket's file when dropped
+#[cfg(unix)]
+struct UnixSocketFile(PathBuf);
+
+#[cfg(unix)]
+impl Drop for UnixSocketFile {
+    fn drop(&mut self) {
+        let _ = std::fs::remove_file(&self.0);
+    }
+}
+
+#[cfg(unix)]
+const UNIX_SOCKS_SOCKET_NAME: &str = "socks";
+
+// tor's port-config syntax cannot express paths containing whitespace or
+// quotes, and socket paths are limited by sockaddr_un's size (104 bytes on
+// some platforms)
+#[cfg(unix)]
+fn unix_socket_path(directory: &Path, name: &str) -> Result<PathBuf, Error> {
+    const MAX_UNIX_SOCKET_PATH_LENGTH: usize = 104;
+    let path = directory.join(name);
+    match path.to_str() {
+        Some(path_str)
+            if path_str.len() < MAX_UNIX_SOCKET_PATH_LENGTH
+                && !path_str.contains(|c: char| c.is_whitespace() || c == '"') =>
+        {
+            Ok(path)
+        }
+        _ => Err(Error::UnixSocketPathInvalid(path)),
+    }
+}
+
+// the longest a socks5 connect may wait on tor's socks listener; this matches tor's
+// own default SocksTimeout, so only a stalled listener should ever reach it
+const SOCKS_TIMEOUT: Duration = Duration::from_secs(120);
+
+// open a socks5 connection to target through tor's socks listener; this
+// blocks until the circuit is built or the connection fails or times out
+fn socks5_connect(
+    socks_listener: LegacySocketAddr,
+    socks_target: socks::TargetAddr,
+    circuit: Option<&LegacyCircuitToken>,
+    target: TargetAddr,
+) -> Result<OnionStream, Error> {
+    // readwrite stream
+    let stream = match socks_listener {
+        LegacySocketAddr::Tcp(socks_listener) => {
+            tcp_socks5_connect(&socks_listener, &socks_target, circuit)
+        }
+        // see OnionStream's documentation
+        #[cfg(unix)]
+        LegacySocketAddr::Unix(socks_listener) => {
+            unix_socks5_connect(&socks_listener, &socks_target, circuit)
+                .map(|stream| TcpStream::from(OwnedFd::from(stream)))
+        }
+    }
+    .map_err(Error::Socks5ConnectionFailed)?;
+
+    Ok(OnionStream {
+        stream,
+        local_addr: None,
+        peer_addr: Some(target),
+    })
+}
+
+fn tcp_socks5_connect(
+    socks_listener: &SocketAddr,
+    socks_target: &socks::TargetAddr,
+    circuit: Option<&LegacyCircuitToken>,
+) -> Result<TcpStream, std::io::Error> {
+    let mut stream = TcpStream::connect_timeout(socks_listener, SOCKS_TIMEOUT)?;
+    stream.set_read_timeout(Some(SOCKS_TIMEOUT))?;
+    stream.set_write_timeout(Some(SOCKS_TIMEOUT))?;
+    socks5_handshake(&mut stream, socks_target, circuit)?;
+    stream.set_read_timeout(None)?;
+    stream.set_write_timeout(None)?;
+    Ok(stream)
+}
+
+#[cfg(unix)]
+fn unix_socks5_connect(
+    socks_listener: &Path,
+    socks_target: &socks::TargetAddr,
+    circuit: Option<&LegacyCircuitToken>,
+) -> Result<UnixStream, std::io::Error> {
+    let mut stream = UnixStream::connect(socks_listener)?;
+    stream.set_read_timeout(Some(SOCKS_TIMEOUT))?;
+    stream.set_write_timeout(Some(SOCKS_TIMEOUT))?;
+    socks5_handshake(&mut stream, socks_target, circuit)?;
+    stream.set_read_timeout(None)?;
+    stream.set_write_timeout(None)?;
+    Ok(stream)
+}
+
+// the socks crate neither speaks to unix-domain socket proxies nor lets us time
+// out its connects, so this is a minimal SOCKS5 CONNECT (RFC 1928) with optional
+// username/password authentication (RFC 1929) over an already open stream
+fn socks5_handshake<S: Read + Write>(
+    stream: &mut S,
+    socks_target: &socks::TargetAddr,
+    circuit: Option<&LegacyCircuitToken>,
+) -> Result<(), std::io::Error> {
+    use std::io::{Error, ErrorKind};
+
+    const SOCKS_VERSION: u8 = 5u8;
+    const NO_AUTHENTICATION: u8 = 0u8;
+    const USERNAME_PASSWORD: u8 = 2u8;
+    const USERNAME_PASSWORD_VERSION: u8 = 1u8;
+    const CONNECT: u8 = 1u8;
+    const IPV4: u8 = 1u8;
+    const DOMAIN_NAME: u8 = 3u8;
+    const IPV6: u8 = 4u8;
+    const SUCCEEDED: u8 = 0u8;
+
+    let invalid_data = |msg: &str| Error::new(ErrorKind::InvalidData, msg.to_string());
+    let length_prefixed = |buffer: &mut Vec<u8>, bytes: &[u8]| -> Result<(), Error> {
+        let length = u8::try_from(bytes.len())
+            .map_err(|_| Error::new(ErrorKind::InvalidInput, "socks field too long"))?;
+        buffer.push(length);
+        buffer.extend_from_slice(bytes);
+        Ok(())
+    };
+
+    // method selection
+    let method = match circuit {
+        None => NO_AUTHENTICATION,
+        Some(_) => USERNAME_PASSWORD,
+    };
+    stream.write_all(&[SOCKS_VERSION, 1u8, method])?;
+    let mut reply = [0u8; 2];
+    stream.read_exact(&mut reply)?;
+    if reply != [SOCKS_VERSION, method] {
+        return Err(invalid_data("socks authentication method rejected"));
+    }
+
+    // authentication
+    if let Some(circuit) = circuit {
+        let mut request = vec![USERNAME_PASSWORD_VERSION];
+        length_prefixed(&mut request, circuit.username.as_bytes())?;
+        length_prefixed(&mut request, circuit.password.as_bytes())?;
+        stream.write_all(&request)?;
+        stream.read_exact(&mut reply)?;
+        if reply[1] != SUCCEEDED {
+            return Err(Error::new(
+                ErrorKind::PermissionDenied,
+                "socks authentication failed",
+            ));
+        }
+    }
+
+    // connect request
+    let mut request = vec![SOCKS_VERSION, CONNECT, 0u8];
+    let port = match socks_target {
+        socks::TargetAddr::Ip(SocketAddr::V4(socket_addr)) => {
+            request.push(IPV4);
+            request.extend_from_slice(&socket_addr.ip().octets());
+            socket_addr.port()
+        }
+        socks::TargetAddr::Ip(SocketAddr::V6(socket_addr)) => {
+            request.push(IPV6);
+            request.extend_from_slice(&socket_addr.ip().octets());
+            socket_addr.port()
+        }
+        socks::TargetAddr::Domain(domain, port) => {
+            request.push(DOMAIN_NAME);
+            length_prefixed(&mut request, domain.as_bytes())?;
+            *port
+        }
+    };
+    request.extend_from_slice(&port.to_be_bytes());
+    stream.write_all(&request)?;
+
+    // connect reply; blocks until tor has built the circuit
+    let mut reply = [0u8; 4];
+    stream.read_exact(&mut reply)?;
+    if reply[0] != SOCKS_VERSION {
+        return Err(invalid_data("unexpected socks version"));
+    }
+    if reply[1] != SUCCEEDED {
+        return Err(Error::new(
+            ErrorKind::ConnectionRefused,
+            format!("socks connect failed with reply {}", reply[1]),
+        ));
+    }
+    // skip the bound address
+    let bound_addr_length = match reply[3] {
+        IPV4 => 4usize,
+        IPV6 => 16usize,
+        DOMAIN_NAME => {
+            let mut length = [0u8; 1];
+            stream.read_exact(&mut length)?;
+            length[0] as usize
+        }
+        _ => return Err(invalid_data("unexpected socks address type")),
+    };
+    let mut bound_addr = vec![0u8; bound_addr_length + 2];
+    stream.read_exact(&mut bound_addr)?;
+
+    Ok(())
 }
 
 impl TorProvider for LegacyTorClient {
     fn update(&mut self) -> Result<Vec<TorEvent>, tor_provider::Error> {
+        // remove onion services with no active listeners
+        let mut inactive_service_ids: Vec<V3OnionServiceId> = Default::default();
         let mut i = 0;
         while i < self.onion_services.len() {
-            // remove onion services with no active listeners
             if !self.onion_services[i].1.load(atomic::Ordering::Relaxed) {
                 let entry = self.onion_services.swap_remove(i);
-                let service_id = entry.0;
-
-                self.controller
-                    .del_onion(&service_id)
-                    .map_err(Error::DelOnionFailed)?;
+                inactive_service_ids.push(entry.0);
             } else {
                 i += 1;
             }
         }
+        for result in self
+            .controller
+            .del_onion_batch(&inactive_service_ids)
+            .map_err(Error::DelOnionFailed)?
+        {
+            result.map_err(Error::DelOnionFailed)?;
+        }
 
         let mut events: Vec<TorEvent> = Default::default();
         for async_event in self
@@ -524,6 +999,17 @@ impl TorProvider for LegacyTorClient {
             }
         }
 
+        // results of any finished connect_async() requests
+        while let Ok((handle, result)) = self.connect_receiver.try_recv() {
+            events.push(match result {
+                Ok(stream) => TorEvent::ConnectComplete { handle, stream },
+                Err(error) => TorEvent::ConnectFailed {
+                    handle,
+                    error: error.into(),
+                },
+            });
+        }
+
         if let Some(daemon) = &mut self.daemon {
             // bundled tor gives us log-lines
             for log_line in daemon.wait_log_lines().iter_mut() {
@@ -560,6 +1046,40 @@ impl TorProvider for LegacyTorClient {
             .map_err(Error::OnionClientAuthAddFailed)?)
     }
 
+    fn add_client_auth_batch(
+        &mut self,
+        client_auths: &[(&V3OnionServiceId, &X25519PrivateKey)],
+    ) -> Result<(), tor_provider::Error> {
+        for result in self
+            .controller
+            .onion_client_auth_add_batch(client_auths, &Default::default())
+            .map_err(Error::OnionClientAuthAddFailed)?
+        {
+            result.map_err(Error::OnionClientAuthAddFailed)?;
+        }
+        Ok(())
+    }
+
+    // fetching a descriptor also tells tor to expect onion-service traffic, so it
+    // keeps internal circuits built for the rendezvous of the following connect
+    fn prefetch_descriptors(
+        &mut self,
+        service_ids: &[&V3OnionServiceId],
+    ) -> Result<(), tor_provider::Error> {
+        if !self.bootstrapped {
+            return Err(Error::LegacyTorNotBootstrapped().into());
+        }
+
+        for result in self
+            .controller
+            .hsfetch_batch(service_ids)
+            .map_err(Error::HsFetchFailed)?
+        {
+            result.map_err(Error::HsFetchFailed)?;
+        }
+        Ok(())
+    }
+
     fn remove_client_auth(
         &mut self,
         service_id: &V3OnionServiceId,
@@ -576,61 +1096,40 @@ impl TorProvider for LegacyTorClient {
         target: TargetAddr,
         circuit: Option<CircuitToken>,
     ) -> Result<OnionStream, tor_provider::Error> {
-        if !self.bootstrapped {
-            return Err(Error::LegacyTorNotBootstrapped().into());
-        }
-
-        if self.socks_listener.is_none() {
-            let mut listeners = self
-                .controller
-                .getinfo_net_listeners_socks()
-                .map_err(Error::GetInfoNetListenersSocksFailed)?;
-            if listeners.is_empty() {
-                return Err(Error::NoSocksListenersFound())?;
-            }
-            self.socks_listener = Some(listeners.swap_remove(0));
-        }
-
-        let socks_listener = match self.socks_listener {
-            Some(socks_listener) => socks_listener,
-            None => unreachable!(),
-        };
-
-        // our target
-        let socks_target = match target.clone() {
-            TargetAddr::Socket(socket_addr) => socks::TargetAddr::Ip(socket_addr),
-            TargetAddr::Domain(domain_addr) => {
-                socks::TargetAddr::Domain(domain_addr.domain().to_string(), domain_addr.port())
-            }
-            TargetAddr::OnionService(OnionAddr::V3(OnionAddrV3 {
-                service_id,
-                virt_port,
-            })) => socks::TargetAddr::Domain(format!("{}.onion", service_id), virt_port),
-        };
+        let (socks_listener, socks_target, circuit) = self.socks5_connect_args(&target, circuit)?;
+        Ok(socks5_connect(
+            socks_listener,
+            socks_target,
+            circuit.as_ref(),
+            target,
+        )?)
+    }
 
-        // readwrite stream
-        let stream = match &circuit {
-            None => Socks5Stream::connect(socks_listener, socks_target),
-            Some(circuit) => {
-                if let Some(circuit) = self.circuit_tokens.get(circuit) {
-                    Socks5Stream::connect_with_password(
-                        socks_listener,
-                        socks_target,
-                        &circuit.username,
-                        &circuit.password,
-                    )
-                } else {
-                    return Err(Error::CircuitTokenInvalid())?;
+    // connect to an onion service on a connect pool thread; the resulting
+    // OnionStream is returned as a TorEvent from update()
+    fn connect_async(
+        &mut self,
+        target: TargetAddr,
+        circuit: Option<CircuitToken>,
+    ) -> Result<ConnectHandle, tor_provider::Error> {
+        let (socks_listener, socks_target, circuit) = self.socks5_connect_args(&target, circuit)?;
+
+        let handle = self.connect_handle_counter;
+        self.connect_handle_counter += 1;
+
+        let connect_sender = self.connect_sender.clone();
+        let event_waker = self.event_waker.clone();
+        self.connect_pool.run(Box::new(move || {
+            let result = socks5_connect(socks_listener, socks_target, circuit.as_ref(), target);
+            // receiver only goes away when the LegacyTorClient is dropped
+            if connect_sender.send((handle, result)).is_ok() {
+                if let Some(event_waker) = event_waker {
+                    event_waker();
                 }
             }
-        }
-        .map_err(Error::Socks5ConnectionFailed)?;
+        }))?;
 
-        Ok(OnionStream {
-            stream: stream.into_inner(),
-            local_addr: None,
-            peer_addr: Some(target),
-        })
+        Ok(handle)
     }
 
     // stand up an onion service and return an LegacyOnionListener
@@ -644,12 +1143,7 @@ impl TorProvider for LegacyTorClient {
             return Err(Error::LegacyTorNotBootstrapped().into());
         }
 
-        // try to bind to a local address, let OS pick our port
-        let socket_addr = SocketAddr::from(([127, 0, 0, 1], 0u16));
-        let listener = TcpListener::bind(socket_addr).map_err(Error::TcpListenerBindFailed)?;
-        let socket_addr = listener
-            .local_addr()
-            .map_err(Error::TcpListenerLocalAddrFailed)?;
+        let target = self.bind_onion_target()?;
 
         let mut flags = AddOnionFlags {
             discard_pk: true,
@@ -672,7 +1166,7 @@ impl TorProvider for LegacyTorClient {
                 &flags,
                 None,
                 virt_port,
-                Some(socket_addr),
+                Some(&target.addr),
                 authorized_clients,
             )
             .map_err(Error::AddOnionFailed)?;
@@ -681,9 +1175,92 @@ impl TorProvider for LegacyTorClient {
         self.onion_services
             .push((service_id, Arc::clone(&is_active)));
 
-        Ok(OnionListener::new(listener, onion_addr, is_active, |is_active| {
-            is_active.store(false, atomic::Ordering::Relaxed);
-        }))
+        Ok(Self::onion_listener(target, onion_addr, is_active))
+    }
+
+    // stand up multiple onion services with a single pipelined batch of
+    // ADD_ONION commands
+    fn listener_batch(
+        &mut self,
+        listeners: &[(&Ed25519PrivateKey, u16, Option<&[X25519PublicKey]>)],
+    ) -> Result<Vec<OnionListener>, tor_provider::Error> {
+        if !self.bootstrapped {
+            return Err(Error::LegacyTorNotBootstrapped().into());
+        }
+
+        let mut targets: Vec<OnionTarget> = Vec::with_capacity(listeners.len());
+        for _ in listeners.iter() {
+            targets.push(self.bind_onion_target()?);
+        }
+
+        let discard_pk_flags = AddOnionFlags {
+            discard_pk: true,
+            ..Default::default()
+        };
+        let v3_auth_flags = AddOnionFlags {
+            discard_pk: true,
+            v3_auth: true,
+            ..Default::default()
+        };
+
+        let batch: Vec<AddOnionArgs> = listeners
+            .iter()
+            .zip(targets.iter())
+            .map(
+                |((private_key, virt_port, authorized_clients), target)| AddOnionArgs {
+                    key: Some(*private_key),
+                    flags: if authorized_clients.is_some() {
+                        &v3_auth_flags
+                    } else {
+                        &discard_pk_flags
+                    },
+                    max_streams: None,
+                    virt_port: *virt_port,
+                    target: Some(&target.addr),
+                    client_auth: *authorized_clients,
+                },
+            )
+            .collect();
+
+        // start onion services
+        let results = self
+            .controller
+            .add_onion_batch(&batch)
+            .map_err(Error::AddOnionFailed)?;
+
+        // any onion services which were started are stopped again on failure
+        // when their listeners in result are dropped
+        let mut result: Vec<OnionListener> = Vec::with_capacity(listeners.len());
+        let mut error: Option<Error> = None;
+        for ((add_onion_result, target), (private_key, virt_port, _)) in results
+            .into_iter()
+            .zip(targets.into_iter())
+            .zip(listeners.iter())
+        {
+            match add_onion_result {
+                Ok((_, service_id)) => {
+                    let is_active = Arc::new(atomic::AtomicBool::new(true));
+                    self.onion_services
+                        .push((service_id, Arc::clone(&is_active)));
+
+                    let onion_addr = OnionAddr::V3(OnionAddrV3::new(
+                        V3OnionServiceId::from_private_key(private_key),
+                        *virt_port,
+                    ));
+                    result.push(Self::onion_listener(target, onion_addr, is_active));
+                }
+                Err(err) => {
+                    if error.is_none() {
+                        error = Some(Error::AddOnionFailed(err));
+                    }
+                }
+            }
+        }
+
+        match error {
+            Some(error) => Err(error.into()),
+            None => Ok(result),
+        }
     }
 
     fn generate_token(&mut self) -> CircuitToken {
@@ -697,4 +1274,39 @@ impl TorProvider for LegacyTorClient {
     fn release_token(&mut self, circuit_token: CircuitToken) {
         self.circuit_tokens.remove(&circuit_token);
     }
+
+    fn set_event_waker(&mut self, waker: TorEventWaker) -> bool {
+        // async control-port events are signalled by the control stream
+        // becoming readable, see event_sources()
+        if let Some(daemon) = &self.daemon {
+            daemon.set_log_waker(Arc::clone(&waker));
+        }
+        self.event_waker = Some(waker);
+        true
+    }
+
+    fn event_sources(&self) -> Vec<&TcpStream> {
+        vec![self.controller.get_control_stream().get_stream()]
+    }
+
+    fn has_pending_events(&self) -> bool {
+        // async control-port events read along with the replies to our commands
+        self.controller.has_pending_async_replies()
+    }
+}
+
+impl Drop for LegacyTorClient {
+    fn drop(&mut self) {
+        // ask an owned daemon to shut down cleanly so that it flushes its state
+        // file (guards, etc) to the data directory; a LegacyTorClient created
+        // later with the same data directory then bootstraps from these and its
+        // cached directory documents rather than from scratch. The daemon is
+        // killed if it does not exit in time
+        const HALT_TIMEOUT: Duration = Duration::from_secs(2);
+        if let Some(daemon) = &mut self.daemon {
+            if self.controller.signal("HALT").is_ok() {
+                daemon.wait_for_exit(HALT_TIMEOUT);
+            }
+        }
+    }
 }
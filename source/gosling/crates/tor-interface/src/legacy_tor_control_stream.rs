@@ -1,15 +1,14 @@
 // standard
-use std::collections::VecDeque;
+use std::borrow::Cow;
 use std::default::Default;
 use std::io::{ErrorKind, Read, Write};
+#[cfg(test)]
+use std::net::TcpListener;
 use std::net::{SocketAddr, TcpStream};
 use std::option::Option;
 use std::string::ToString;
 use std::time::Duration;
 
-// extern crates
-use regex::Regex;
-
 #[derive(thiserror::Error, Debug)]
 pub enum Error {
     #[error("control stream read timeout must not be zero")]
@@ -21,9 +20,6 @@ pub enum Error {
     #[error("configure control port socket failed")]
     ConfigurationFailed(#[source] std::io::Error),
 
-    #[error("control port parsing regex creation failed")]
-    ParsingRegexCreationFailed(#[source] regex::Error),
-
     #[error("control port stream read failure")]
     ReadFailed(#[source] std::io::Error),
 
@@ -43,20 +39,91 @@ pub enum Error {
 pub(crate) struct LegacyControlStream {
     stream: TcpStream,
     closed_by_remote: bool,
+    // bytes read from the stream but not yet consumed
     pending_data: Vec<u8>,
-    pending_lines: VecDeque<String>,
-    pending_reply: Vec<String>,
+    // offset in pending_data of the beginning of the next unconsumed line
+    line_begin: usize,
+    // offset in pending_data to resume searching for a line terminator from
+    scan_offset: usize,
+    // reply currently being assembled
+    pending_reply: Option<Reply>,
     reading_multiline_value: bool,
-    // regexes used to parse control port responses
-    single_line_data: Regex,
-    multi_line_data: Regex,
-    end_reply_line: Regex,
 }
 
 type StatusCode = u32;
 pub(crate) struct Reply {
     pub status_code: StatusCode,
-    pub reply_lines: Vec<String>,
+    // the reply's lines (without their status code prefix) back to back
+    text: String,
+    // the end offset of each line in text
+    line_ends: Vec<usize>,
+}
+
+impl Reply {
+    fn new(status_code: StatusCode) -> Self {
+        Self {
+            status_code,
+            text: Default::default(),
+            line_ends: Default::default(),
+        }
+    }
+
+    fn push_line(&mut self, line: &str) {
+        self.text.push_str(line);
+        self.line_ends.push(self.text.len());
+    }
+
+    // append a line of multi-line data to the most recent line
+    fn extend_line(&mut self, line: &str) {
+        self.text.push('\n');
+        self.text.push_str(line);
+        match self.line_ends.last_mut() {
+            Some(line_end) => *line_end = self.text.len(),
+            // multi-line data always follows a multi-line start line
+            None => unreachable!(),
+        }
+    }
+
+    pub fn lines(&self) -> impl Iterator<Item = &str> {
+        let mut begin = 0usize;
+        self.line_ends.iter().map(move |&end| {
+            let line = &self.text[begin..end];
+            begin = end;
+            line
+        })
+    }
+
+    // the reply's lines joined by separator, only allocates for multi-line replies
+    pub fn join(&self, separator: &str) -> Cow<'_, str> {
+        if self.line_ends.len() == 1 {
+            Cow::Borrowed(self.text.as_str())
+        } else {
+            Cow::Owned(self.lines().collect::<Vec<&str>>().join(separator))
+        }
+    }
+
+    pub fn into_lines(self) -> Vec<String> {
+        self.lines().map(str::to_string).collect()
+    }
+}
+
+// status lines begin with a three digit status code followed by a ' ' (end of
+// reply), '-' (mid-reply) or '+' (beginning of multi-line data) separator
+fn parse_status_line(line: &[u8]) -> Option<(StatusCode, u8)> {
+    match line {
+        [a, b, c, separator, ..]
+            if a.is_ascii_digit()
+                && b.is_ascii_digit()
+                && c.is_ascii_digit()
+                && matches!(separator, b' ' | b'-' | b'+') =>
+        {
+            let status_code = (a - b'0') as StatusCode * 100
+                + (b - b'0') as StatusCode * 10
+                + (c - b'0') as StatusCode;
+            Some((status_code, *separator))
+        }
+        _ => None,
+    }
 }
 
 impl LegacyControlStream {
@@ -70,29 +137,23 @@ impl LegacyControlStream {
             .set_read_timeout(Some(read_timeout))
             .map_err(Error::ConfigurationFailed)?;
 
+        Ok(Self::from_stream(stream))
+    }
+
+    pub(crate) fn from_stream(stream: TcpStream) -> LegacyControlStream {
         // pre-allocate a kilobyte for the read buffer
         const READ_BUFFER_SIZE: usize = 1024;
         let pending_data = Vec::with_capacity(READ_BUFFER_SIZE);
 
-        let single_line_data =
-            Regex::new(r"^\d\d\d-.*").map_err(Error::ParsingRegexCreationFailed)?;
-        let multi_line_data =
-            Regex::new(r"^\d\d\d+.*").map_err(Error::ParsingRegexCreationFailed)?;
-        let end_reply_line =
-            Regex::new(r"^\d\d\d .*").map_err(Error::ParsingRegexCreationFailed)?;
-
-        Ok(LegacyControlStream {
+        LegacyControlStream {
             stream,
             closed_by_remote: false,
             pending_data,
-            pending_lines: Default::default(),
-            pending_reply: Default::default(),
+            line_begin: 0usize,
+            scan_offset: 0usize,
+            pending_reply: None,
             reading_multiline_value: false,
-            // regex
-            single_line_data,
-            multi_line_data,
-            end_reply_line,
-        })
+        }
     }
 
     #[cfg(test)]
@@ -100,9 +161,32 @@ impl LegacyControlStream {
         self.closed_by_remote
     }
 
-    fn read_line(&mut self) -> Result<Option<String>, Error> {
-        // read pending bytes from stream until we have a line to return
-        while self.pending_lines.is_empty() {
+    // returns the [begin, end) range in pending_data of the next \r\n
+    // terminated line; scanning resumes where the previous call stopped so
+    // each received byte is only searched once
+    fn read_line(&mut self) -> Result<Option<(usize, usize)>, Error> {
+        loop {
+            while let Some(index) = memchr::memchr(b'\n', &self.pending_data[self.scan_offset..]) {
+                let newline = self.scan_offset + index;
+                self.scan_offset = newline + 1;
+                // lines are terminated by \r\n, a lone \n is line content
+                if newline > self.line_begin && self.pending_data[newline - 1] == b'\r' {
+                    let line = (self.line_begin, newline - 1);
+                    self.line_begin = newline + 1;
+                    return Ok(Some(line));
+                }
+            }
+            self.scan_offset = self.pending_data.len();
+
+            // every complete line has been consumed, so only move any leftover
+            // partial line to the front of the buffer before reading more
+            if self.line_begin > 0 {
+                self.pending_data.drain(0..self.line_begin);
+                self.scan_offset -= self.line_begin;
+                self.line_begin = 0;
+            }
+
+            // read pending bytes from stream until we have a line to return
             let byte_count = self.pending_data.len();
             match self.stream.read_to_end(&mut self.pending_data) {
                 Err(err) => {
@@ -120,137 +204,86 @@ impl LegacyControlStream {
                 }
                 Ok(_count) => (),
             }
-
-            // split our read buffer into individual lines
-            let mut begin = 0;
-            for index in 1..self.pending_data.len() {
-                if self.pending_data[index - 1] == b'\r' && self.pending_data[index] == b'\n' {
-                    let end = index - 1;
-                    // view into byte vec of just the found line
-                    let line_view: &[u8] = &self.pending_data[begin..end];
-                    // convert to string
-                    let line_string =
-                        std::str::from_utf8(line_view).map_err(Error::InvalidResponse)?;
-
-                    // save in pending list
-                    self.pending_lines.push_back(line_string.to_string());
-                    // update begin (and skip over \r\n)
-                    begin = end + 2;
-                }
-            }
-            // leave any leftover bytes in the buffer for the next call
-            self.pending_data.drain(0..begin);
         }
-
-        Ok(self.pending_lines.pop_front())
     }
 
     pub fn read_reply(&mut self) -> Result<Option<Reply>, Error> {
         loop {
-            let current_line = match self.read_line()? {
+            let (begin, end) = match self.read_line()? {
                 Some(line) => line,
                 None => return Ok(None),
             };
+            // view into the read buffer of just the found line
+            let current_line = std::str::from_utf8(&self.pending_data[begin..end])
+                .map_err(Error::InvalidResponse)?;
 
-            // make sure the status code matches (if we are not in the
-            // middle of a multi-line read
-            if let Some(first_line) = self.pending_reply.first() {
-                if !self.reading_multiline_value {
-                    let first_status_code = &first_line[0..3];
-                    let current_status_code = &current_line[0..3];
-                    if first_status_code != current_status_code {
+            match parse_status_line(current_line.as_bytes()) {
+                Some((status_code, separator)) => {
+                    if self.reading_multiline_value {
+                        return Err(Error::ReplyParseFailed(
+                            "found reply line but still reading a multi-line reply".to_string(),
+                        ));
+                    }
+
+                    // make sure the status code matches
+                    let reply = self
+                        .pending_reply
+                        .get_or_insert_with(|| Reply::new(status_code));
+                    if reply.status_code != status_code {
                         return Err(Error::ReplyParseFailed(format!(
                             "mismatched status codes, {} != {}",
-                            first_status_code, current_status_code
+                            reply.status_code, status_code
                         )));
                     }
-                }
-            }
 
-            // end of a response
-            if self.end_reply_line.is_match(&current_line) {
-                if self.reading_multiline_value {
-                    return Err(Error::ReplyParseFailed(
-                        "found multi-line end reply but not reading a multi-line reply".to_string(),
-                    ));
-                }
-                self.pending_reply.push(current_line);
-                break;
-            // single line data from getinfo and friends
-            } else if self.single_line_data.is_match(&current_line) {
-                if self.reading_multiline_value {
-                    return Err(Error::ReplyParseFailed(
-                        "found single-line reply but still reading a multi-line reply".to_string(),
-                    ));
-                }
-                self.pending_reply.push(current_line);
-            // begin of multiline data from getinfo and friends
-            } else if self.multi_line_data.is_match(&current_line) {
-                if self.reading_multiline_value {
-                    return Err(Error::ReplyParseFailed(
-                        "found multi-line start reply but still reading a multi-line reply"
-                            .to_string(),
-                    ));
-                }
-                self.pending_reply.push(current_line);
-                self.reading_multiline_value = true;
-            // multiline data to be squashed to a single entry
-            } else {
-                if !self.reading_multiline_value {
-                    return Err(Error::ReplyParseFailed(
-                        "found a multi-line intermediate reply but not reading a multi-line reply"
-                            .to_string(),
-                    ));
+                    // strip the redundant status code from start of line
+                    reply.push_line(&current_line[4..]);
+
+                    match separator {
+                        // end of a response
+                        b' ' => return Ok(self.pending_reply.take()),
+                        // single line data from getinfo and friends
+                        b'-' => (),
+                        // begin of multiline data from getinfo and friends
+                        b'+' => self.reading_multiline_value = true,
+                        _ => unreachable!(),
+                    }
                 }
-                // don't bother writing the end of multiline token
-                if current_line == "." {
-                    self.reading_multiline_value = false;
-                } else {
-                    let multiline = match self.pending_reply.last_mut() {
-                        Some(multiline) => multiline,
-                        // if our logic here is right, then
-                        // self.reading_multiline_value == !self.pending_reply.is_empty()
-                        // should always be true regardless of the data received
-                        // from the control port
-                        None => unreachable!(),
-                    };
-                    multiline.push('\n');
-                    multiline.push_str(&current_line);
+                // multiline data to be squashed to a single entry
+                None => {
+                    if !self.reading_multiline_value {
+                        return Err(Error::ReplyParseFailed(
+                            "found a multi-line intermediate reply but not reading a multi-line reply"
+                                .to_string(),
+                        ));
+                    }
+                    // don't bother writing the end of multiline token
+                    if current_line == "." {
+                        self.reading_multiline_value = false;
+                    } else {
+                        match self.pending_reply.as_mut() {
+                            Some(reply) => reply.extend_line(current_line),
+                            // if our logic here is right, then
+                            // self.reading_multiline_value == self.pending_reply.is_some()
+                            // should always be true regardless of the data received
+                            // from the control port
+                            None => unreachable!(),
+                        }
+                    }
                 }
             }
         }
+    }
 
-        // take ownership of the reply lines
-        let mut reply_lines: Vec<String> = Default::default();
-        std::mem::swap(&mut self.pending_reply, &mut reply_lines);
-
-        // parse out the response code for easier matching
-        let status_code_string = match reply_lines.first() {
-            Some(line) => line[0..3].to_string(),
-            // the lines have already been parsed+validated in the above loop
-            None => unreachable!(),
-        };
-        let status_code: u32 = match status_code_string.parse() {
-            Ok(status_code) => status_code,
-            Err(_) => {
-                return Err(Error::ReplyParseFailed(format!(
-                    "unable to parse '{}' as status code",
-                    status_code_string
-                )))
-            }
-        };
-
-        // strip the redundant status code from start of lines
-        for line in reply_lines.iter_mut() {
-            if line.starts_with(&status_code_string) {
-                *line = line[4..].to_string();
-            }
-        }
+    // whether a complete line has already been read from the stream but not yet
+    // consumed; the stream does not become readable again for such lines
+    pub fn has_pending_line(&self) -> bool {
+        let unscanned = self.scan_offset.saturating_sub(1).max(self.line_begin);
+        memchr::memmem::find(&self.pending_data[unscanned..], b"\r\n").is_some()
+    }
 
-        Ok(Some(Reply {
-            status_code,
-            reply_lines,
-        }))
+    pub fn get_stream(&self) -> &TcpStream {
+        &self.stream
     }
 
     pub fn write(&mut self, cmd: &str) -> Result<(), Error> {
@@ -261,3 +294,48 @@ impl LegacyControlStream {
         Ok(())
     }
 }
+
+#[test]
+fn test_control_stream_read_reply() -> anyhow::Result<()> {
+    let listener = TcpListener::bind(SocketAddr::from(([127, 0, 0, 1], 0u16)))?;
+    let mut tor = TcpStream::connect(listener.local_addr()?)?;
+    let (stream, _socket_addr) = listener.accept()?;
+    stream.set_read_timeout(Some(Duration::from_millis(16)))?;
+    let mut control_stream = LegacyControlStream::from_stream(stream);
+
+    // nothing to read yet
+    assert!(control_stream.read_reply()?.is_none());
+
+    // reply split mid-line across reads
+    tor.write_all(b"250-version=0.4.8.10\r\n250-config-f")?;
+    assert!(control_stream.read_reply()?.is_none());
+    tor.write_all(b"ile=/etc/tor/torrc\r\n250 OK\r\n")?;
+    let reply = control_stream.read_reply()?.unwrap();
+    assert_eq!(reply.status_code, 250u32);
+    assert_eq!(
+        reply.lines().collect::<Vec<&str>>(),
+        ["version=0.4.8.10", "config-file=/etc/tor/torrc", "OK"]
+    );
+
+    // multi-line data followed by an async event in a single read
+    tor.write_all(b"250+config-text=\r\nControlPort auto\r\nSocksPort auto\r\n.\r\n250 OK\r\n650 STATUS_CLIENT NOTICE BOOTSTRAP PROGRESS=5\r\n")?;
+    let reply = control_stream.read_reply()?.unwrap();
+    assert_eq!(reply.status_code, 250u32);
+    assert_eq!(
+        reply.lines().collect::<Vec<&str>>(),
+        ["config-text=\nControlPort auto\nSocksPort auto", "OK"]
+    );
+    let reply = control_stream.read_reply()?.unwrap();
+    assert_eq!(reply.status_code, 650u32);
+    assert!(matches!(
+        reply.join(" "),
+        Cow::Borrowed("STATUS_CLIENT NOTICE BOOTSTRAP PROGRESS=5")
+    ));
+    assert!(control_stream.read_reply()?.is_none());
+
+    // mismatched status codes
+    tor.write_all(b"250-key=value\r\n251 OK\r\n")?;
+    assert!(control_stream.read_reply().is_err());
+
+    Ok(())
+}
@@ -1,9 +1,15 @@
 // standard
 use std::default::Default;
+#[cfg(test)]
+use std::io::Write;
 use std::net::SocketAddr;
+#[cfg(test)]
+use std::net::{TcpListener, TcpStream};
 use std::option::Option;
 #[cfg(test)]
 use std::path::Path;
+#[cfg(unix)]
+use std::path::PathBuf;
 use std::str::FromStr;
 use std::string::ToString;
 #[cfg(test)]
@@ -48,6 +54,26 @@ pub enum Error {
     TorVersionParseFailed(#[source] crate::legacy_tor_version::Error),
 }
 
+// A local socket tor may listen on or forward onion-service connections to
+#[derive(Clone, Debug, PartialEq)]
+pub(crate) enum LegacySocketAddr {
+    Tcp(SocketAddr),
+    #[cfg(unix)]
+    Unix(PathBuf),
+}
+
+// formatted as tor's port-config target syntax; callers must ensure unix
+// socket paths contain no whitespace or '"'
+impl std::fmt::Display for LegacySocketAddr {
+    fn fmt(&self, f: &mut std::fmt::Formatter) -> std::fmt::Result {
+        match self {
+            LegacySocketAddr::Tcp(socket_addr) => write!(f, "{}", socket_addr),
+            #[cfg(unix)]
+            LegacySocketAddr::Unix(path) => write!(f, "unix:{}", path.display()),
+        }
+    }
+}
+
 // Per-command data
 #[derive(Default)]
 pub(crate) struct AddOnionFlags {
@@ -58,6 +84,16 @@ pub(crate) struct AddOnionFlags {
     pub max_streams_close_circuit: bool,
 }
 
+// Arguments for a single ADD_ONION command, see LegacyTorController::add_onion_batch()
+pub(crate) struct AddOnionArgs<'a> {
+    pub key: Option<&'a Ed25519PrivateKey>,
+    pub flags: &'a AddOnionFlags,
+    pub max_streams: Option<u16>,
+    pub virt_port: u16,
+    pub target: Option<&'a LegacySocketAddr>,
+    pub client_auth: Option<&'a [X25519PublicKey]>,
+}
+
 #[derive(Default)]
 pub(crate) struct OnionClientAuthAddFlags {
     pub permanent: bool,
@@ -117,6 +153,17 @@ impl LegacyTorController {
         })
     }
 
+    pub fn get_control_stream(&self) -> &LegacyControlStream {
+        &self.control_stream
+    }
+
+    // whether async replies were received while waiting on a sync reply, or
+    // arrived in the same read as one; either way they are already out of the
+    // control stream's socket, so its becoming readable will not signal them
+    pub fn has_pending_async_replies(&self) -> bool {
+        !self.async_replies.is_empty() || self.control_stream.has_pending_line()
+    }
+
     // return curently available events, does not block waiting
     // for an event
     fn wait_async_replies(&mut self) -> Result<Vec<Reply>, Error> {
@@ -139,13 +186,14 @@ impl LegacyTorController {
         }
     }
 
-    fn reply_to_event(&self, reply: &mut Reply) -> Result<AsyncEvent, Error> {
+    fn reply_to_event(&self, reply: Reply) -> Result<AsyncEvent, Error> {
         if reply.status_code != 650u32 {
             return Err(Error::UnexpectedSynchonousReplyReceived());
         }
 
         // not sure this is what we want but yolo
-        let reply_text = reply.reply_lines.join(" ");
+        // (events are almost always a single line, which is matched in place)
+        let reply_text = reply.join(" ");
         if let Some(caps) = self.status_event_pattern.captures(&reply_text) {
             let severity = match caps.name("severity") {
                 Some(severity) => severity.as_str(),
@@ -205,17 +253,16 @@ impl LegacyTorController {
         }
 
         // no luck parsing reply, just return full text
-        let mut reply_lines: Vec<String> = Default::default();
-        std::mem::swap(&mut reply_lines, &mut reply.reply_lines);
-
-        Ok(AsyncEvent::Unknown { lines: reply_lines })
+        Ok(AsyncEvent::Unknown {
+            lines: reply.into_lines(),
+        })
     }
 
     pub fn wait_async_events(&mut self) -> Result<Vec<AsyncEvent>, Error> {
-        let mut async_replies = self.wait_async_replies()?;
-        let mut async_events: Vec<AsyncEvent> = Default::default();
+        let async_replies = self.wait_async_replies()?;
+        let mut async_events: Vec<AsyncEvent> = Vec::with_capacity(async_replies.len());
 
-        for reply in async_replies.iter_mut() {
+        for reply in async_replies.into_iter() {
             async_events.push(self.reply_to_event(reply)?);
         }
 
@@ -245,6 +292,25 @@ impl LegacyTorController {
         self.wait_sync_reply()
     }
 
+    // pipeline a sequence of commands: all of them are written in a single
+    // write before any replies are read, and tor replies to commands in the
+    // order they were received, so the returned replies are in command order
+    fn write_commands(&mut self, commands: &[String]) -> Result<Vec<Reply>, Error> {
+        if commands.is_empty() {
+            return Ok(Default::default());
+        }
+
+        self.control_stream
+            .write(&commands.join("\r\n"))
+            .map_err(Error::WriteCommandFailed)?;
+
+        let mut replies: Vec<Reply> = Vec::with_capacity(commands.len());
+        while replies.len() < commands.len() {
+            replies.push(self.wait_sync_reply()?);
+        }
+        Ok(replies)
+    }
+
     //
     // Tor Commands
     //
@@ -303,6 +369,13 @@ impl LegacyTorController {
         self.write_command(&command)
     }
 
+    // SIGNAL (3.7)
+    fn signal_cmd(&mut self, signal: &str) -> Result<Reply, Error> {
+        let command = format!("SIGNAL {}", signal);
+
+        self.write_command(&command)
+    }
+
     // GETINFO (3.9)
     fn getinfo_cmd(&mut self, keywords: &[&str]) -> Result<Reply, Error> {
         if keywords.is_empty() {
@@ -315,16 +388,28 @@ impl LegacyTorController {
         self.write_command(&command)
     }
 
+    // HSFETCH (3.26)
+    fn hsfetch_command(service_id: &&V3OnionServiceId) -> String {
+        format!("HSFETCH {}", service_id)
+    }
+
     // ADD_ONION (3.27)
-    fn add_onion_cmd(
-        &mut self,
-        key: Option<&Ed25519PrivateKey>,
-        flags: &AddOnionFlags,
-        max_streams: Option<u16>,
-        virt_port: u16,
-        target: Option<SocketAddr>,
-        client_auth: Option<&[X25519PublicKey]>,
-    ) -> Result<Reply, Error> {
+    fn add_onion_cmd(&mut self, args: &AddOnionArgs) -> Result<Reply, Error> {
+        let command = Self::add_onion_command(args);
+
+        self.write_command(&command)
+    }
+
+    fn add_onion_command(args: &AddOnionArgs) -> String {
+        let AddOnionArgs {
+            key,
+            flags,
+            max_streams,
+            virt_port,
+            target,
+            client_auth,
+        } = *args;
+
         let mut command_buffer = vec!["ADD_ONION".to_string()];
 
         // set our key or request a new one
@@ -374,19 +459,20 @@ impl LegacyTorController {
             }
         }
 
-        // finally send the command
-        let command = command_buffer.join(" ");
-
-        self.write_command(&command)
+        command_buffer.join(" ")
     }
 
     // DEL_ONION (3.38)
     fn del_onion_cmd(&mut self, service_id: &V3OnionServiceId) -> Result<Reply, Error> {
-        let command = format!("DEL_ONION {}", service_id);
+        let command = Self::del_onion_command(service_id);
 
         self.write_command(&command)
     }
 
+    fn del_onion_command(service_id: &V3OnionServiceId) -> String {
+        format!("DEL_ONION {}", service_id)
+    }
+
     // ONION_CLIENT_AUTH_ADD (3.30)
     fn onion_client_auth_add_cmd(
         &mut self,
@@ -395,6 +481,18 @@ impl LegacyTorController {
         client_name: Option<String>,
         flags: &OnionClientAuthAddFlags,
     ) -> Result<Reply, Error> {
+        let command =
+            Self::onion_client_auth_add_command(service_id, private_key, client_name, flags);
+
+        self.write_command(&command)
+    }
+
+    fn onion_client_auth_add_command(
+        service_id: &V3OnionServiceId,
+        private_key: &X25519PrivateKey,
+        client_name: Option<String>,
+        flags: &OnionClientAuthAddFlags,
+    ) -> String {
         let mut command_buffer = vec!["ONION_CLIENT_AUTH_ADD".to_string()];
 
         // set the onion service id
@@ -411,10 +509,7 @@ impl LegacyTorController {
             command_buffer.push("Flags=Permanent".to_string());
         }
 
-        // finally send command
-        let command = command_buffer.join(" ");
-
-        self.write_command(&command)
+        command_buffer.join(" ")
     }
 
     // ONION_CLIENT_AUTH_REMOVE (3.31)
@@ -436,7 +531,7 @@ impl LegacyTorController {
 
         match reply.status_code {
             250u32 => Ok(()),
-            code => Err(Error::CommandFailed(code, reply.reply_lines)),
+            code => Err(Error::CommandFailed(code, reply.into_lines())),
         }
     }
 
@@ -447,16 +542,16 @@ impl LegacyTorController {
         match reply.status_code {
             250u32 => {
                 let mut key_values: Vec<(String, String)> = Default::default();
-                for line in reply.reply_lines {
+                for line in reply.lines() {
                     match line.find('=') {
                         Some(index) => key_values
                             .push((line[0..index].to_string(), line[index + 1..].to_string())),
-                        None => key_values.push((line, String::new())),
+                        None => key_values.push((line.to_string(), String::new())),
                     }
                 }
                 Ok(key_values)
             }
-            code => Err(Error::CommandFailed(code, reply.reply_lines)),
+            code => Err(Error::CommandFailed(code, reply.into_lines())),
         }
     }
 
@@ -465,7 +560,7 @@ impl LegacyTorController {
 
         match reply.status_code {
             250u32 => Ok(()),
-            code => Err(Error::CommandFailed(code, reply.reply_lines)),
+            code => Err(Error::CommandFailed(code, reply.into_lines())),
         }
     }
 
@@ -474,7 +569,16 @@ impl LegacyTorController {
 
         match reply.status_code {
             250u32 => Ok(()),
-            code => Err(Error::CommandFailed(code, reply.reply_lines)),
+            code => Err(Error::CommandFailed(code, reply.into_lines())),
+        }
+    }
+
+    pub fn signal(&mut self, signal: &str) -> Result<(), Error> {
+        let reply = self.signal_cmd(signal)?;
+
+        match reply.status_code {
+            250u32 => Ok(()),
+            code => Err(Error::CommandFailed(code, reply.into_lines())),
         }
     }
 
@@ -484,20 +588,20 @@ impl LegacyTorController {
         match reply.status_code {
             250u32 => {
                 let mut key_values: Vec<(String, String)> = Default::default();
-                for line in reply.reply_lines {
+                for line in reply.lines() {
                     match line.find('=') {
                         Some(index) => key_values
                             .push((line[0..index].to_string(), line[index + 1..].to_string())),
                         None => {
                             if line != "OK" {
-                                key_values.push((line, String::new()))
+                                key_values.push((line.to_string(), String::new()))
                             }
                         }
                     }
                 }
                 Ok(key_values)
             }
-            code => Err(Error::CommandFailed(code, reply.reply_lines)),
+            code => Err(Error::CommandFailed(code, reply.into_lines())),
         }
     }
 
@@ -507,17 +611,52 @@ impl LegacyTorController {
         flags: &AddOnionFlags,
         max_streams: Option<u16>,
         virt_port: u16,
-        target: Option<SocketAddr>,
+        target: Option<&LegacySocketAddr>,
         client_auth: Option<&[X25519PublicKey]>,
     ) -> Result<(Option<Ed25519PrivateKey>, V3OnionServiceId), Error> {
-        let reply = self.add_onion_cmd(key, flags, max_streams, virt_port, target, client_auth)?;
+        let args = AddOnionArgs {
+            key,
+            flags,
+            max_streams,
+            virt_port,
+            target,
+            client_auth,
+        };
+        let reply = self.add_onion_cmd(&args)?;
+
+        Self::add_onion_reply(reply, &args)
+    }
+
+    // pipelined add_onion(); the outer Result fails if the control stream
+    // does, the inner Results are the per-onion-service results in order
+    #[allow(clippy::type_complexity)]
+    pub fn add_onion_batch(
+        &mut self,
+        batch: &[AddOnionArgs],
+    ) -> Result<Vec<Result<(Option<Ed25519PrivateKey>, V3OnionServiceId), Error>>, Error> {
+        let commands: Vec<String> = batch.iter().map(Self::add_onion_command).collect();
+        let replies = self.write_commands(&commands)?;
+
+        Ok(replies
+            .into_iter()
+            .zip(batch.iter())
+            .map(|(reply, args)| Self::add_onion_reply(reply, args))
+            .collect())
+    }
+
+    fn add_onion_reply(
+        reply: Reply,
+        args: &AddOnionArgs,
+    ) -> Result<(Option<Ed25519PrivateKey>, V3OnionServiceId), Error> {
+        let flags = args.flags;
+        let client_auth = args.client_auth;
 
         let mut private_key: Option<Ed25519PrivateKey> = None;
         let mut service_id: Option<V3OnionServiceId> = None;
 
         match reply.status_code {
             250u32 => {
-                for line in reply.reply_lines {
+                for line in reply.lines() {
                     if let Some(mut index) = line.find("ServiceID=") {
                         if service_id.is_some() {
                             return Err(Error::CommandReplyParseFailed(
@@ -567,7 +706,7 @@ impl LegacyTorController {
                     }
                 }
             }
-            code => return Err(Error::CommandFailed(code, reply.reply_lines)),
+            code => return Err(Error::CommandFailed(code, reply.into_lines())),
         }
 
         if flags.discard_pk {
@@ -593,15 +732,51 @@ impl LegacyTorController {
     pub fn del_onion(&mut self, service_id: &V3OnionServiceId) -> Result<(), Error> {
         let reply = self.del_onion_cmd(service_id)?;
 
+        Self::del_onion_reply(reply)
+    }
+
+    // pipelined del_onion(); the outer Result fails if the control stream
+    // does, the inner Results are the per-onion-service results in order
+    pub fn del_onion_batch(
+        &mut self,
+        service_ids: &[V3OnionServiceId],
+    ) -> Result<Vec<Result<(), Error>>, Error> {
+        let commands: Vec<String> = service_ids.iter().map(Self::del_onion_command).collect();
+        let replies = self.write_commands(&commands)?;
+
+        Ok(replies.into_iter().map(Self::del_onion_reply).collect())
+    }
+
+    fn del_onion_reply(reply: Reply) -> Result<(), Error> {
         match reply.status_code {
             250u32 => Ok(()),
-            code => Err(Error::CommandFailed(code, reply.reply_lines)),
+            code => Err(Error::CommandFailed(code, reply.into_lines())),
         }
     }
 
+    // pipelined HSFETCH; tor fetches the requested onion-service descriptors in
+    // the background and reports the outcome with HS_DESC async events. The
+    // outer Result fails if the control stream does, the inner Results are the
+    // per-onion-service results in order
+    pub fn hsfetch_batch(
+        &mut self,
+        service_ids: &[&V3OnionServiceId],
+    ) -> Result<Vec<Result<(), Error>>, Error> {
+        let commands: Vec<String> = service_ids.iter().map(Self::hsfetch_command).collect();
+        let replies = self.write_commands(&commands)?;
+
+        Ok(replies
+            .into_iter()
+            .map(|reply| match reply.status_code {
+                250u32 => Ok(()),
+                code => Err(Error::CommandFailed(code, reply.into_lines())),
+            })
+            .collect())
+    }
+
     // more specific encapulsation of specific command invocations
 
-    pub fn getinfo_net_listeners_socks(&mut self) -> Result<Vec<SocketAddr>, Error> {
+    pub fn getinfo_net_listeners_socks(&mut self) -> Result<Vec<LegacySocketAddr>, Error> {
         let response = self.getinfo(&["net/listeners/socks"])?;
         for (key, value) in response.iter() {
             if key.as_str() == "net/listeners/socks" {
@@ -610,7 +785,7 @@ impl LegacyTorController {
                 }
                 // get our list of double-quoted strings
                 let listeners: Vec<&str> = value.split(' ').collect();
-                let mut result: Vec<SocketAddr> = Default::default();
+                let mut result: Vec<LegacySocketAddr> = Default::default();
                 for socket_addr in listeners.iter() {
                     if !socket_addr.starts_with('\"') || !socket_addr.ends_with('\"') {
                         return Err(Error::CommandReplyParseFailed(format!(
@@ -621,8 +796,14 @@ impl LegacyTorController {
 
                     // remove leading/trailing double quote
                     let stripped = &socket_addr[1..socket_addr.len() - 1];
+                    // unix-domain socket listeners are reported as unix:PATH
+                    #[cfg(unix)]
+                    if let Some(path) = stripped.strip_prefix("unix:") {
+                        result.push(LegacySocketAddr::Unix(PathBuf::from(path)));
+                        continue;
+                    }
                     result.push(match SocketAddr::from_str(stripped) {
-                        Ok(result) => result,
+                        Ok(result) => LegacySocketAddr::Tcp(result),
                         Err(_) => {
                             return Err(Error::CommandReplyParseFailed(format!(
                                 "could not parse '{}' as socket address",
@@ -660,9 +841,34 @@ impl LegacyTorController {
     ) -> Result<(), Error> {
         let reply = self.onion_client_auth_add_cmd(service_id, private_key, client_name, flags)?;
 
+        Self::onion_client_auth_add_reply(reply)
+    }
+
+    // pipelined onion_client_auth_add(); the outer Result fails if the control
+    // stream does, the inner Results are the per-credential results in order
+    pub fn onion_client_auth_add_batch(
+        &mut self,
+        batch: &[(&V3OnionServiceId, &X25519PrivateKey)],
+        flags: &OnionClientAuthAddFlags,
+    ) -> Result<Vec<Result<(), Error>>, Error> {
+        let commands: Vec<String> = batch
+            .iter()
+            .map(|(service_id, private_key)| {
+                Self::onion_client_auth_add_command(service_id, private_key, None, flags)
+            })
+            .collect();
+        let replies = self.write_commands(&commands)?;
+
+        Ok(replies
+            .into_iter()
+            .map(Self::onion_client_auth_add_reply)
+            .collect())
+    }
+
+    fn onion_client_auth_add_reply(reply: Reply) -> Result<(), Error> {
         match reply.status_code {
             250u32..=252u32 => Ok(()),
-            code => Err(Error::CommandFailed(code, reply.reply_lines)),
+            code => Err(Error::CommandFailed(code, reply.into_lines())),
         }
     }
 
@@ -672,7 +878,7 @@ impl LegacyTorController {
 
         match reply.status_code {
             250u32..=251u32 => Ok(()),
-            code => Err(Error::CommandFailed(code, reply.reply_lines)),
+            code => Err(Error::CommandFailed(code, reply.into_lines())),
         }
     }
 }
@@ -777,6 +983,49 @@ fn test_tor_controller() -> anyhow::Result<()> {
         // delete our new onion
         tor_controller.del_onion(&service_id)?;
 
+        // add and delete a pipelined batch of onions
+        let flags = AddOnionFlags {
+            discard_pk: true,
+            ..Default::default()
+        };
+        let private_keys = [
+            Ed25519PrivateKey::generate(),
+            Ed25519PrivateKey::generate(),
+            Ed25519PrivateKey::generate(),
+        ];
+        let batch: Vec<AddOnionArgs> = private_keys
+            .iter()
+            .map(|private_key| AddOnionArgs {
+                key: Some(private_key),
+                flags: &flags,
+                max_streams: None,
+                virt_port: 22,
+                target: None,
+                client_auth: None,
+            })
+            .collect();
+        let mut service_ids: Vec<V3OnionServiceId> = Default::default();
+        for (result, private_key) in tor_controller
+            .add_onion_batch(&batch)?
+            .into_iter()
+            .zip(private_keys.iter())
+        {
+            let (_, service_id) = result?;
+            assert_eq!(service_id, V3OnionServiceId::from_private_key(private_key));
+            service_ids.push(service_id);
+        }
+        // an unknown onion fails without affecting the rest of the batch
+        service_ids.insert(1, service_id);
+        let results = tor_controller.del_onion_batch(&service_ids)?;
+        assert_eq!(results.len(), 4);
+        assert!(results[0].is_ok());
+        assert!(
+            results[1].is_err(),
+            "deleting deleted onion should have failed"
+        );
+        assert!(results[2].is_ok());
+        assert!(results[3].is_ok());
+
         println!("listeners: ");
         for sock_addr in tor_controller.getinfo_net_listeners_socks()?.iter() {
             println!(" {}", sock_addr);
@@ -817,3 +1066,43 @@ fn test_tor_controller() -> anyhow::Result<()> {
     }
     Ok(())
 }
+
+#[test]
+fn test_tor_controller_pending_async_replies() -> anyhow::Result<()> {
+    let listener = TcpListener::bind(SocketAddr::from(([127, 0, 0, 1], 0u16)))?;
+    let mut tor = TcpStream::connect(listener.local_addr()?)?;
+    let (stream, _socket_addr) = listener.accept()?;
+    stream.set_read_timeout(Some(Duration::from_millis(16)))?;
+    let mut tor_controller = LegacyTorController::new(LegacyControlStream::from_stream(stream))?;
+    assert!(!tor_controller.has_pending_async_replies());
+
+    // an event received while waiting on a sync reply is queued for later
+    tor.write_all(b"650 STATUS_CLIENT NOTICE CIRCUIT_ESTABLISHED\r\n")?;
+    tor.write_all(b"250 OK\r\n")?;
+    tor_controller.setevents(&["STATUS_CLIENT"])?;
+    assert!(tor_controller.has_pending_async_replies());
+    assert!(matches!(
+        tor_controller.wait_async_events()?.as_slice(),
+        [AsyncEvent::StatusClient { action, .. }] if action == "CIRCUIT_ESTABLISHED"
+    ));
+    assert!(!tor_controller.has_pending_async_replies());
+
+    // as is an event read along with a sync reply
+    let service_id = V3OnionServiceId::from_private_key(&Ed25519PrivateKey::generate());
+    tor.write_all(
+        format!(
+            "250 OK\r\n650 HS_DESC UPLOADED {} UNKNOWN $0000000000000000000000000000000000000000\r\n",
+            service_id
+        )
+        .as_bytes(),
+    )?;
+    tor_controller.setevents(&["STATUS_CLIENT", "HS_DESC"])?;
+    assert!(tor_controller.has_pending_async_replies());
+    assert!(matches!(
+        tor_controller.wait_async_events()?.as_slice(),
+        [AsyncEvent::HsDesc { action, hs_address }] if action == "UPLOADED" && *hs_address == service_id
+    ));
+    assert!(!tor_controller.has_pending_async_replies());
+
+    Ok(())
+}
@@ -21,6 +21,7 @@ use sha1::{Digest, Sha1};
 
 // internal crates
 use crate::tor_crypto::generate_password;
+use crate::tor_provider::TorEventWaker;
 
 #[derive(thiserror::Error, Debug)]
 pub enum Error {
@@ -107,6 +108,8 @@ pub(crate) struct LegacyTorProcess {
     password: String,
     // stdout data
     stdout_lines: Arc<Mutex<Vec<String>>>,
+    // called by the stdout reader thread after each new line
+    stdout_waker: Arc<Mutex<Option<TorEventWaker>>>,
 }
 
 impl LegacyTorProcess {
@@ -261,6 +264,10 @@ impl LegacyTorProcess {
             // to avoid orphaned tor daemon
             .arg("__OwningControllerProcess")
             .arg(process::id().to_string())
+            // a daemon restarted with an existing data directory may
+            // otherwise resume in the dormant state it was shut down in
+            .arg("DormantCanceledByStartup")
+            .arg("1")
             .spawn()
             .map_err(Error::LegacyTorProcessStartFailed)?;
 
@@ -288,9 +295,11 @@ impl LegacyTorProcess {
         };
 
         let stdout_lines: Arc<Mutex<Vec<String>>> = Default::default();
+        let stdout_waker: Arc<Mutex<Option<TorEventWaker>>> = Default::default();
 
         {
             let stdout_lines = Arc::downgrade(&stdout_lines);
+            let stdout_waker = Arc::clone(&stdout_waker);
             let stdout = BufReader::new(match process.stdout.take() {
                 Some(stdout) => stdout,
                 None => return Err(Error::LegacyTorProcessStdoutTakeFailed()),
@@ -299,7 +308,7 @@ impl LegacyTorProcess {
             std::thread::Builder::new()
                 .name("tor_stdout_reader".to_string())
                 .spawn(move || {
-                    LegacyTorProcess::read_stdout_task(&stdout_lines, stdout);
+                    LegacyTorProcess::read_stdout_task(&stdout_lines, &stdout_waker, stdout);
                 })
                 .map_err(Error::StdoutReadThreadSpawnFailed)?;
         }
@@ -309,17 +318,23 @@ impl LegacyTorProcess {
             process,
             password,
             stdout_lines,
+            stdout_waker,
         })
     }
 
     fn read_stdout_task(
         stdout_lines: &std::sync::Weak<Mutex<Vec<String>>>,
+        stdout_waker: &Mutex<Option<TorEventWaker>>,
         mut stdout: BufReader<ChildStdout>,
     ) {
         while let Some(stdout_lines) = stdout_lines.upgrade() {
             let mut line = String::default();
             // read line
-            if stdout.read_line(&mut line).is_ok() {
+            if let Ok(count) = stdout.read_line(&mut line) {
+                // tor's stdout has been closed
+                if count == 0 {
+                    break;
+                }
                 // remove trailing '\n'
                 line.pop();
                 // then acquire the lock on the line buffer
@@ -328,7 +343,41 @@ impl LegacyTorProcess {
                     Err(_) => unreachable!(),
                 };
                 stdout_lines.push(line);
+                drop(stdout_lines);
+                // and signal there is a new line to consume
+                let stdout_waker = match stdout_waker.lock() {
+                    Ok(stdout_waker) => stdout_waker,
+                    Err(_) => unreachable!(),
+                };
+                if let Some(stdout_waker) = stdout_waker.as_ref() {
+                    stdout_waker();
+                }
+            }
+        }
+    }
+
+    pub fn set_log_waker(&self, waker: TorEventWaker) {
+        let mut stdout_waker = match self.stdout_waker.lock() {
+            Ok(stdout_waker) => stdout_waker,
+            Err(_) => unreachable!(),
+        };
+        *stdout_waker = Some(waker);
+    }
+
+    // wait up to timeout for the tor process to exit on its own, returning
+    // whether it has
+    pub fn wait_for_exit(&mut self, timeout: Duration) -> bool {
+        let start = Instant::now();
+        loop {
+            match self.process.try_wait() {
+                Ok(Some(_status)) => return true,
+                Ok(None) => (),
+                Err(_) => return false,
+            }
+            if start.elapsed() >= timeout {
+                return false;
             }
+            std::thread::sleep(Duration::from_millis(10));
         }
     }
 
@@ -24,6 +24,8 @@ pub mod mock_tor_client;
 #[cfg(feature = "legacy-tor-provider")]
 /// Proxy settings
 pub mod proxy;
+/// A `TorProvider` shared by many clients, e.g. one tor daemon for many gosling contexts
+pub mod shared_tor_client;
 /// Tor-specific cryptographic primitives, operations, and conversion functions.
 pub mod tor_crypto;
 /// Traits and types for connecting to the Tor Network.
@@ -139,6 +139,7 @@ pub struct MockTorClient {
     client_auth_keys: BTreeMap<V3OnionServiceId, X25519PublicKey>,
     onion_services: Vec<(OnionAddr, Arc<atomic::AtomicBool>)>,
     loopback: TcpListener,
+    next_connect_handle: ConnectHandle,
 }
 
 impl MockTorClient {
@@ -157,6 +158,7 @@ impl MockTorClient {
             client_auth_keys: Default::default(),
             onion_services: Default::default(),
             loopback: listener,
+            next_connect_handle: Default::default(),
         }
     }
 }
@@ -229,6 +231,19 @@ impl TorProvider for MockTorClient {
         Ok(())
     }
 
+    // the mock tor network has no descriptors to fetch, so just log each request as
+    // tor would
+    fn prefetch_descriptors(
+        &mut self,
+        service_ids: &[&V3OnionServiceId],
+    ) -> Result<(), tor_provider::Error> {
+        for service_id in service_ids {
+            let line = format!("[notice] MockTorClient prefetching descriptor for {service_id}");
+            self.events.push(TorEvent::LogReceived { line });
+        }
+        Ok(())
+    }
+
     fn remove_client_auth(
         &mut self,
         service_id: &V3OnionServiceId,
@@ -273,6 +288,25 @@ impl TorProvider for MockTorClient {
         }
     }
 
+    fn connect_async(
+        &mut self,
+        target: TargetAddr,
+        circuit: Option<CircuitToken>,
+    ) -> Result<ConnectHandle, tor_provider::Error> {
+        let handle = self.next_connect_handle;
+        self.next_connect_handle += 1;
+
+        // connections on the mock tor network are local and never block
+        // for long, so connect now and report the result on next update()
+        let event = match self.connect(target, circuit) {
+            Ok(stream) => TorEvent::ConnectComplete { handle, stream },
+            Err(error) => TorEvent::ConnectFailed { handle, error },
+        };
+        self.events.push(event);
+
+        Ok(handle)
+    }
+
     fn listener(
         &mut self,
         private_key: &Ed25519PrivateKey,
@@ -325,6 +359,16 @@ impl TorProvider for MockTorClient {
     }
 
     fn release_token(&mut self, _token: CircuitToken) {}
+
+    fn set_event_waker(&mut self, _waker: TorEventWaker) -> bool {
+        // every mock event is produced synchronously by one of our own
+        // methods so there is never anything to wake the caller up for
+        true
+    }
+
+    fn has_pending_events(&self) -> bool {
+        !self.events.is_empty()
+    }
 }
 
 impl Drop for MockTorClient {
@@ -0,0 +1,810 @@
+// standard
+use std::collections::{BTreeMap, VecDeque};
+use std::net::TcpStream;
+use std::sync::{Arc, Mutex, MutexGuard, TryLockError};
+use std::time::Duration;
+
+// internal crates
+use crate::tor_crypto::*;
+use crate::tor_provider;
+use crate::tor_provider::*;
+
+/// [`SharedTorClient`]-specific error type
+#[derive(thiserror::Error, Debug)]
+pub enum Error {
+    #[error("failed to clone the shared tor provider's event sources")]
+    EventSourceCloneFailed(#[source] std::io::Error),
+
+    #[error("invalid circuit token")]
+    CircuitTokenInvalid(),
+}
+
+impl From<Error> for crate::tor_provider::Error {
+    fn from(error: Error) -> Self {
+        crate::tor_provider::Error::Generic(error.to_string())
+    }
+}
+
+//
+// Shared State
+//
+
+type ClientId = usize;
+
+// log lines kept for a client which is not calling update(); older lines are dropped
+const MAX_QUEUED_LOG_LINES: usize = 1024;
+// how often a blocking connect() checks whether its connect_async() has finished
+const CONNECT_POLL_INTERVAL: Duration = Duration::from_millis(16);
+
+#[derive(Default)]
+struct ClientState {
+    // events routed to this client waiting for its next update()
+    events: Vec<TorEvent>,
+    // log lines routed to this client waiting for its next update(), oldest first
+    log_lines: VecDeque<String>,
+    // bootstrap progress is only reported to clients which asked for it
+    bootstrap_requested: bool,
+    // the circuit used when connect() is not given one
+    default_circuit: CircuitToken,
+    // circuit tokens generated by this client and how many times each
+    circuit_tokens: BTreeMap<CircuitToken, usize>,
+    // client auth credentials added by this client and how many times each
+    client_auths: BTreeMap<V3OnionServiceId, usize>,
+}
+
+struct SharedState {
+    bootstrap_started: bool,
+    bootstrapped: bool,
+    next_client_id: ClientId,
+    clients: BTreeMap<ClientId, ClientState>,
+    // the clients which started each onion service
+    onion_service_owners: BTreeMap<V3OnionServiceId, ClientId>,
+    // the clients waiting on each connect_async() request
+    connect_owners: BTreeMap<ConnectHandle, ClientId>,
+    // client auth credentials are per tor process, so only remove them once unused
+    client_auth_counts: BTreeMap<V3OnionServiceId, usize>,
+}
+
+impl SharedState {
+    // distribute the events returned by the shared TorProvider to their clients and
+    // return the ids of the clients which received any
+    fn route_events(&mut self, events: Vec<TorEvent>) -> Vec<ClientId> {
+        let mut recipients: Vec<ClientId> = Default::default();
+        let mut push = |client_id: ClientId, client: &mut ClientState, event: TorEvent| {
+            client.events.push(event);
+            if !recipients.contains(&client_id) {
+                recipients.push(client_id);
+            }
+        };
+
+        for event in events {
+            match event {
+                TorEvent::BootstrapStatus {
+                    progress,
+                    tag,
+                    summary,
+                } => {
+                    for (client_id, client) in self.clients.iter_mut() {
+                        if client.bootstrap_requested {
+                            let event = TorEvent::BootstrapStatus {
+                                progress,
+                                tag: tag.clone(),
+                                summary: summary.clone(),
+                            };
+                            push(*client_id, client, event);
+                        }
+                    }
+                }
+                TorEvent::BootstrapComplete => {
+                    self.bootstrapped = true;
+                    for (client_id, client) in self.clients.iter_mut() {
+                        if client.bootstrap_requested {
+                            push(*client_id, client, TorEvent::BootstrapComplete);
+                        }
+                    }
+                }
+                TorEvent::LogReceived { line } => {
+                    for (client_id, client) in self.clients.iter_mut() {
+                        if client.log_lines.len() == MAX_QUEUED_LOG_LINES {
+                            client.log_lines.pop_front();
+                        }
+                        client.log_lines.push_back(line.clone());
+                        if !recipients.contains(client_id) {
+                            recipients.push(*client_id);
+                        }
+                    }
+                }
+                TorEvent::OnionServicePublished { service_id } => {
+                    // descriptors are re-published periodically so keep the owner
+                    if let Some(client_id) = self.onion_service_owners.get(&service_id) {
+                        if let Some(client) = self.clients.get_mut(client_id) {
+                            push(
+                                *client_id,
+                                client,
+                                TorEvent::OnionServicePublished { service_id },
+                            );
+                        }
+                    }
+                }
+                TorEvent::ConnectComplete { handle, stream } => {
+                    // streams for clients which have since gone away are closed here
+                    if let Some(client_id) = self.connect_owners.remove(&handle) {
+                        if let Some(client) = self.clients.get_mut(&client_id) {
+                            push(
+                                client_id,
+                                client,
+                                TorEvent::ConnectComplete { handle, stream },
+                            );
+                        }
+                    }
+                }
+                TorEvent::ConnectFailed { handle, error } => {
+                    if let Some(client_id) = self.connect_owners.remove(&handle) {
+                        if let Some(client) = self.clients.get_mut(&client_id) {
+                            push(client_id, client, TorEvent::ConnectFailed { handle, error });
+                        }
+                    }
+                }
+            }
+        }
+        recipients
+    }
+
+    fn client(&mut self, client_id: ClientId) -> &mut ClientState {
+        match self.clients.get_mut(&client_id) {
+            Some(client) => client,
+            None => unreachable!("shared tor client {} not registered", client_id),
+        }
+    }
+
+    // take every event routed to a client
+    fn take_events(&mut self, client_id: ClientId) -> Vec<TorEvent> {
+        let client = self.client(client_id);
+        let mut events: Vec<TorEvent> =
+            Vec::with_capacity(client.log_lines.len() + client.events.len());
+        events.extend(
+            client
+                .log_lines
+                .drain(..)
+                .map(|line| TorEvent::LogReceived { line }),
+        );
+        events.append(&mut client.events);
+        events
+    }
+
+    fn has_events(&self, client_id: ClientId) -> bool {
+        self.clients
+            .get(&client_id)
+            .is_some_and(|client| !client.events.is_empty() || !client.log_lines.is_empty())
+    }
+}
+
+// The shared TorProvider and the state routing its events are locked separately:
+// calls to the TorProvider may block on tor (e.g. ADD_ONION on a legacy tor's
+// control port), and a client's update() must not wait on another client's call.
+// Whenever both are needed, tor_provider is locked first.
+struct Shared {
+    tor_provider: Mutex<Box<dyn TorProvider>>,
+    state: Mutex<SharedState>,
+    // kept apart from state so the shared TorProvider may call wakers from any thread
+    wakers: Arc<Mutex<BTreeMap<ClientId, TorEventWaker>>>,
+    // whether the shared TorProvider supports wakers
+    has_waker: bool,
+    // duplicates of the shared TorProvider's event sources
+    event_sources: Vec<TcpStream>,
+}
+
+impl Shared {
+    fn lock(&self) -> MutexGuard<'_, SharedState> {
+        match self.state.lock() {
+            Ok(state) => state,
+            Err(_) => {
+                unreachable!("another thread panicked while holding the shared tor client's lock")
+            }
+        }
+    }
+
+    fn lock_tor_provider(&self) -> MutexGuard<'_, Box<dyn TorProvider>> {
+        match self.tor_provider.lock() {
+            Ok(tor_provider) => tor_provider,
+            Err(_) => {
+                unreachable!("another thread panicked while holding the shared tor provider's lock")
+            }
+        }
+    }
+
+    // the shared TorProvider, unless another client is using it
+    fn try_lock_tor_provider(&self) -> Option<MutexGuard<'_, Box<dyn TorProvider>>> {
+        match self.tor_provider.try_lock() {
+            Ok(tor_provider) => Some(tor_provider),
+            Err(TryLockError::WouldBlock) => None,
+            Err(TryLockError::Poisoned(_)) => {
+                unreachable!("another thread panicked while holding the shared tor provider's lock")
+            }
+        }
+    }
+
+    // unlock the shared TorProvider; if the call just made read events from tor
+    // without returning them, the clients waiting on tor would not notice, so wake
+    // them all to update()
+    fn unlock_tor_provider(&self, tor_provider: MutexGuard<'_, Box<dyn TorProvider>>) {
+        let has_pending_events = tor_provider.has_pending_events();
+        drop(tor_provider);
+        if has_pending_events {
+            let wakers: Vec<TorEventWaker> = lock_wakers(&self.wakers).values().cloned().collect();
+            for waker in wakers {
+                waker();
+            }
+        }
+    }
+
+    fn wake(&self, client_ids: &[ClientId]) {
+        let wakers: Vec<TorEventWaker> = {
+            let wakers = lock_wakers(&self.wakers);
+            client_ids
+                .iter()
+                .filter_map(|client_id| wakers.get(client_id).cloned())
+                .collect()
+        };
+        for waker in wakers {
+            waker();
+        }
+    }
+}
+
+fn lock_wakers(
+    wakers: &Mutex<BTreeMap<ClientId, TorEventWaker>>,
+) -> MutexGuard<'_, BTreeMap<ClientId, TorEventWaker>> {
+    match wakers.lock() {
+        Ok(wakers) => wakers,
+        Err(_) => {
+            unreachable!("another thread panicked while holding the shared tor client's lock")
+        }
+    }
+}
+
+//
+// SharedTorProvider
+//
+
+/// A `SharedTorProvider` lets many [`SharedTorClient`]s (e.g. one per gosling context) use a single underlying [`TorProvider`], so a process hosting many identities runs one tor daemon, with one bootstrap, consensus and control connection, rather than one each.
+///
+/// Each client receives only its own [`TorEvent`]s: [`TorEvent::OnionServicePublished`] goes to the client which started the onion service, [`TorEvent::ConnectComplete`] and [`TorEvent::ConnectFailed`] go to the client which called [`TorProvider::connect_async()`], bootstrap progress goes to every client which called [`TorProvider::bootstrap()`], and log lines go to every client. Connections made by different clients never share circuits: each client connects over its own [`CircuitToken`] unless given another token it generated itself.
+///
+/// Calls into the underlying `TorProvider` which may block on tor (e.g. [`TorProvider::listener()`] waiting on a legacy tor daemon's control port) are made one client at a time, but a client's [`TorProvider::update()`] never waits on another client's call: it returns the events already routed to it instead.
+///
+/// The underlying `TorProvider` is dropped once this `SharedTorProvider` and all of its clients have been dropped.
+#[derive(Clone)]
+pub struct SharedTorProvider {
+    shared: Arc<Shared>,
+}
+
+impl SharedTorProvider {
+    /// Construct a new `SharedTorProvider` taking ownership of `tor_provider`.
+    pub fn new(mut tor_provider: Box<dyn TorProvider>) -> Result<Self, Error> {
+        let event_sources = tor_provider
+            .event_sources()
+            .into_iter()
+            .map(TcpStream::try_clone)
+            .collect::<Result<Vec<TcpStream>, std::io::Error>>()
+            .map_err(Error::EventSourceCloneFailed)?;
+
+        // background events may be for any client, so wake them all
+        let wakers: Arc<Mutex<BTreeMap<ClientId, TorEventWaker>>> = Default::default();
+        let has_waker = {
+            let wakers = Arc::downgrade(&wakers);
+            tor_provider.set_event_waker(Arc::new(move || {
+                if let Some(wakers) = wakers.upgrade() {
+                    let wakers: Vec<TorEventWaker> =
+                        lock_wakers(&wakers).values().cloned().collect();
+                    for waker in wakers {
+                        waker();
+                    }
+                }
+            }))
+        };
+
+        Ok(Self {
+            shared: Arc::new(Shared {
+                tor_provider: Mutex::new(tor_provider),
+                state: Mutex::new(SharedState {
+                    bootstrap_started: false,
+                    bootstrapped: false,
+                    next_client_id: 0,
+                    clients: Default::default(),
+                    onion_service_owners: Default::default(),
+                    connect_owners: Default::default(),
+                    client_auth_counts: Default::default(),
+                }),
+                wakers,
+                has_waker,
+                event_sources,
+            }),
+        })
+    }
+
+    /// Create a new [`SharedTorClient`] using this `SharedTorProvider`'s underlying [`TorProvider`].
+    pub fn client(&self) -> SharedTorClient {
+        let default_circuit = self.shared.lock_tor_provider().generate_token();
+        let mut state = self.shared.lock();
+        let client_id = state.next_client_id;
+        state.next_client_id += 1;
+        state.clients.insert(
+            client_id,
+            ClientState {
+                default_circuit,
+                ..Default::default()
+            },
+        );
+
+        SharedTorClient {
+            shared: Arc::clone(&self.shared),
+            client_id,
+        }
+    }
+}
+
+//
+// SharedTorClient
+//
+
+/// A `SharedTorClient` implements the [`TorProvider`] trait as one of many clients of a [`SharedTorProvider`].
+///
+/// Dropping a `SharedTorClient` releases its circuit tokens and removes the client auth credentials no other client of the same `SharedTorProvider` still uses. Its onion services are stopped as usual when their [`OnionListener`]s are dropped.
+pub struct SharedTorClient {
+    shared: Arc<Shared>,
+    client_id: ClientId,
+}
+
+impl SharedTorClient {
+    // the circuit token to pass to the shared TorProvider for a connect request
+    fn circuit(
+        state: &mut SharedState,
+        client_id: ClientId,
+        circuit: Option<CircuitToken>,
+    ) -> Result<CircuitToken, Error> {
+        let client = state.client(client_id);
+        match circuit {
+            None => Ok(client.default_circuit),
+            Some(circuit) if client.circuit_tokens.contains_key(&circuit) => Ok(circuit),
+            Some(_) => Err(Error::CircuitTokenInvalid()),
+        }
+    }
+
+    // record client auth credentials once the shared TorProvider has accepted them
+    fn add_client_auth_refs<'a>(
+        state: &mut SharedState,
+        client_id: ClientId,
+        service_ids: impl Iterator<Item = &'a V3OnionServiceId>,
+    ) {
+        for service_id in service_ids {
+            *state
+                .client_auth_counts
+                .entry(service_id.clone())
+                .or_default() += 1;
+            *state
+                .client(client_id)
+                .client_auths
+                .entry(service_id.clone())
+                .or_default() += 1;
+        }
+    }
+
+    // forget one reference to service_id's client auth credentials and return
+    // true if no client references them anymore
+    fn release_client_auth_ref(state: &mut SharedState, service_id: &V3OnionServiceId) -> bool {
+        match state.client_auth_counts.get_mut(service_id) {
+            Some(count) if *count > 1 => {
+                *count -= 1;
+                false
+            }
+            Some(_) => {
+                state.client_auth_counts.remove(service_id);
+                true
+            }
+            None => true,
+        }
+    }
+}
+
+impl TorProvider for SharedTorClient {
+    fn update(&mut self) -> Result<Vec<TorEvent>, tor_provider::Error> {
+        let (events, recipients) = {
+            // rather than wait on another client's call to the shared TorProvider,
+            // return the events already routed to us; our next update() polls it
+            let tor_provider = self.shared.try_lock_tor_provider();
+            let events = match tor_provider {
+                Some(mut tor_provider) => tor_provider.update()?,
+                None => Default::default(),
+            };
+            let mut state = self.shared.lock();
+            let mut recipients = state.route_events(events);
+            recipients.retain(|client_id| *client_id != self.client_id);
+            (state.take_events(self.client_id), recipients)
+        };
+
+        // the other clients may be blocked waiting on events we just took for them
+        self.shared.wake(&recipients);
+
+        Ok(events)
+    }
+
+    fn bootstrap(&mut self) -> Result<(), tor_provider::Error> {
+        let mut tor_provider = self.shared.lock_tor_provider();
+        if !self.shared.lock().bootstrap_started {
+            tor_provider.bootstrap()?;
+            self.shared.lock().bootstrap_started = true;
+        }
+        self.shared.unlock_tor_provider(tor_provider);
+
+        let mut state = self.shared.lock();
+        let bootstrapped = state.bootstrapped;
+        let client = state.client(self.client_id);
+        if !client.bootstrap_requested {
+            client.bootstrap_requested = true;
+            // clients which arrive late are told straight away
+            if bootstrapped {
+                client.events.push(TorEvent::BootstrapComplete);
+            }
+        }
+        Ok(())
+    }
+
+    fn add_client_auth(
+        &mut self,
+        service_id: &V3OnionServiceId,
+        client_auth: &X25519PrivateKey,
+    ) -> Result<(), tor_provider::Error> {
+        let mut tor_provider = self.shared.lock_tor_provider();
+        let result = tor_provider.add_client_auth(service_id, client_auth);
+        if result.is_ok() {
+            Self::add_client_auth_refs(
+                &mut self.shared.lock(),
+                self.client_id,
+                std::iter::once(service_id),
+            );
+        }
+        self.shared.unlock_tor_provider(tor_provider);
+        result
+    }
+
+    fn add_client_auth_batch(
+        &mut self,
+        client_auths: &[(&V3OnionServiceId, &X25519PrivateKey)],
+    ) -> Result<(), tor_provider::Error> {
+        let mut tor_provider = self.shared.lock_tor_provider();
+        let result = tor_provider.add_client_auth_batch(client_auths);
+        if result.is_ok() {
+            Self::add_client_auth_refs(
+                &mut self.shared.lock(),
+                self.client_id,
+                client_auths.iter().map(|(service_id, _)| *service_id),
+            );
+        }
+        self.shared.unlock_tor_provider(tor_provider);
+        result
+    }
+
+    fn prefetch_descriptors(
+        &mut self,
+        service_ids: &[&V3OnionServiceId],
+    ) -> Result<(), tor_provider::Error> {
+        let mut tor_provider = self.shared.lock_tor_provider();
+        let result = tor_provider.prefetch_descriptors(service_ids);
+        self.shared.unlock_tor_provider(tor_provider);
+        result
+    }
+
+    fn remove_client_auth(
+        &mut self,
+        service_id: &V3OnionServiceId,
+    ) -> Result<(), tor_provider::Error> {
+        // locked first so no other client adds these credentials before we remove them
+        let mut tor_provider = self.shared.lock_tor_provider();
+        let unused = {
+            let mut state = self.shared.lock();
+            let client_auths = &mut state.client(self.client_id).client_auths;
+            match client_auths.get_mut(service_id) {
+                Some(count) if *count > 1 => *count -= 1,
+                Some(_) => {
+                    client_auths.remove(service_id);
+                }
+                // never added by us, so leave any other client's credentials alone
+                None => return Ok(()),
+            }
+            Self::release_client_auth_ref(&mut state, service_id)
+        };
+        let result = if unused {
+            tor_provider.remove_client_auth(service_id)
+        } else {
+            Ok(())
+        };
+        self.shared.unlock_tor_provider(tor_provider);
+        result
+    }
+
+    // built on the shared TorProvider's connect_async() so that other clients may use
+    // it while this connect waits on tor; the locks are only held to poll for the result
+    fn connect(
+        &mut self,
+        target: TargetAddr,
+        circuit: Option<CircuitToken>,
+    ) -> Result<OnionStream, tor_provider::Error> {
+        let handle = self.connect_async(target, circuit)?;
+        loop {
+            let (result, recipients) = {
+                // another client using the shared TorProvider routes our result
+                // should it poll the TorProvider before we do
+                let tor_provider = self.shared.try_lock_tor_provider();
+                let events = match tor_provider {
+                    Some(mut tor_provider) => tor_provider.update()?,
+                    None => Default::default(),
+                };
+                let mut state = self.shared.lock();
+                let mut recipients = state.route_events(events);
+                recipients.retain(|client_id| *client_id != self.client_id);
+
+                // leave our other events for our next update()
+                let events = &mut state.client(self.client_id).events;
+                let result = events
+                    .iter()
+                    .position(|event| match event {
+                        TorEvent::ConnectComplete {
+                            handle: completed, ..
+                        } => *completed == handle,
+                        TorEvent::ConnectFailed { handle: failed, .. } => *failed == handle,
+                        _ => false,
+                    })
+                    .map(|result| events.remove(result));
+                (result, recipients)
+            };
+            self.shared.wake(&recipients);
+
+            match result {
+                Some(TorEvent::ConnectComplete { stream, .. }) => return Ok(stream),
+                Some(TorEvent::ConnectFailed { error, .. }) => return Err(error),
+                _ => std::thread::sleep(CONNECT_POLL_INTERVAL),
+            }
+        }
+    }
+
+    fn connect_async(
+        &mut self,
+        target: TargetAddr,
+        circuit: Option<CircuitToken>,
+    ) -> Result<ConnectHandle, tor_provider::Error> {
+        let circuit = Self::circuit(&mut self.shared.lock(), self.client_id, circuit)?;
+        // the owner is recorded before the TorProvider is unlocked and may be polled
+        // for the result
+        let mut tor_provider = self.shared.lock_tor_provider();
+        let result = tor_provider.connect_async(target, Some(circuit));
+        if let Ok(handle) = result {
+            self.shared
+                .lock()
+                .connect_owners
+                .insert(handle, self.client_id);
+        }
+        self.shared.unlock_tor_provider(tor_provider);
+        result
+    }
+
+    fn listener(
+        &mut self,
+        private_key: &Ed25519PrivateKey,
+        virt_port: u16,
+        authorised_clients: Option<&[X25519PublicKey]>,
+    ) -> Result<OnionListener, tor_provider::Error> {
+        // the owner is recorded before the TorProvider is unlocked and may be polled
+        // for the onion service's publication
+        let mut tor_provider = self.shared.lock_tor_provider();
+        let result = tor_provider.listener(private_key, virt_port, authorised_clients);
+        if result.is_ok() {
+            self.shared.lock().onion_service_owners.insert(
+                V3OnionServiceId::from_private_key(private_key),
+                self.client_id,
+            );
+        }
+        self.shared.unlock_tor_provider(tor_provider);
+        result
+    }
+
+    fn listener_batch(
+        &mut self,
+        listeners: &[(&Ed25519PrivateKey, u16, Option<&[X25519PublicKey]>)],
+    ) -> Result<Vec<OnionListener>, tor_provider::Error> {
+        let mut tor_provider = self.shared.lock_tor_provider();
+        let result = tor_provider.listener_batch(listeners);
+        if result.is_ok() {
+            let mut state = self.shared.lock();
+            for (private_key, _virt_port, _authorised_clients) in listeners.iter() {
+                state.onion_service_owners.insert(
+                    V3OnionServiceId::from_private_key(private_key),
+                    self.client_id,
+                );
+            }
+        }
+        self.shared.unlock_tor_provider(tor_provider);
+        result
+    }
+
+    fn generate_token(&mut self) -> CircuitToken {
+        let circuit_token = self.shared.lock_tor_provider().generate_token();
+        *self
+            .shared
+            .lock()
+            .client(self.client_id)
+            .circuit_tokens
+            .entry(circuit_token)
+            .or_default() += 1;
+        circuit_token
+    }
+
+    fn release_token(&mut self, token: CircuitToken) {
+        let unused = {
+            let mut state = self.shared.lock();
+            let circuit_tokens = &mut state.client(self.client_id).circuit_tokens;
+            match circuit_tokens.get_mut(&token) {
+                Some(count) if *count > 1 => {
+                    *count -= 1;
+                    false
+                }
+                Some(_) => {
+                    circuit_tokens.remove(&token);
+                    true
+                }
+                None => false,
+            }
+        };
+        // tokens are private to their client, so no other client can be using it
+        if unused {
+            self.shared.lock_tor_provider().release_token(token);
+        }
+    }
+
+    fn set_event_waker(&mut self, waker: TorEventWaker) -> bool {
+        lock_wakers(&self.shared.wakers).insert(self.client_id, waker);
+        self.shared.has_waker
+    }
+
+    fn event_sources(&self) -> Vec<&TcpStream> {
+        self.shared.event_sources.iter().collect()
+    }
+
+    fn has_pending_events(&self) -> bool {
+        // events the shared TorProvider holds may be for any client, so whichever
+        // client updates first routes them to the rest and wakes them; a client
+        // busy with the TorProvider wakes everyone once done should any remain
+        self.shared.lock().has_events(self.client_id)
+            || self
+                .shared
+                .try_lock_tor_provider()
+                .is_some_and(|tor_provider| tor_provider.has_pending_events())
+    }
+}
+
+impl Drop for SharedTorClient {
+    fn drop(&mut self) {
+        lock_wakers(&self.shared.wakers).remove(&self.client_id);
+
+        let mut tor_provider = self.shared.lock_tor_provider();
+        let (client, unused_client_auths) = {
+            let mut state = self.shared.lock();
+            let client = match state.clients.remove(&self.client_id) {
+                Some(client) => client,
+                None => return,
+            };
+            let client_id = self.client_id;
+            state
+                .onion_service_owners
+                .retain(|_service_id, owner| *owner != client_id);
+            state
+                .connect_owners
+                .retain(|_handle, owner| *owner != client_id);
+
+            let mut unused_client_auths: Vec<V3OnionServiceId> = Default::default();
+            for (service_id, count) in client.client_auths.iter() {
+                for _ in 0..*count {
+                    if Self::release_client_auth_ref(&mut state, service_id) {
+                        unused_client_auths.push(service_id.clone());
+                    }
+                }
+            }
+            (client, unused_client_auths)
+        };
+
+        tor_provider.release_token(client.default_circuit);
+        for circuit_token in client.circuit_tokens.into_keys() {
+            tor_provider.release_token(circuit_token);
+        }
+        for service_id in unused_client_auths {
+            // nothing to report a failure to from here
+            let _ = tor_provider.remove_client_auth(&service_id);
+        }
+        self.shared.unlock_tor_provider(tor_provider);
+    }
+}
+
+#[test]
+#[cfg(feature = "mock-tor-provider")]
+fn test_mock_shared_routing() -> Result<(), tor_provider::Error> {
+    use crate::mock_tor_client::MockTorClient;
+
+    let shared_tor_provider = SharedTorProvider::new(Box::new(MockTorClient::new()))?;
+    let mut alice = shared_tor_provider.client();
+    let mut bob = shared_tor_provider.client();
+
+    // the shared TorProvider is only bootstrapped once
+    alice.bootstrap()?;
+    let events = alice.update()?;
+    assert!(events
+        .iter()
+        .any(|event| matches!(event, TorEvent::BootstrapComplete)));
+    assert!(events
+        .iter()
+        .any(|event| matches!(event, TorEvent::LogReceived { .. })));
+    // and bob is not told about bootstrap progress until they ask
+    let events = bob.update()?;
+    assert!(events
+        .iter()
+        .all(|event| matches!(event, TorEvent::LogReceived { .. })));
+    bob.bootstrap()?;
+    let events = bob.update()?;
+    assert!(matches!(events.as_slice(), [TorEvent::BootstrapComplete]));
+
+    // only alice hears about alice's onion service
+    let private_key = Ed25519PrivateKey::generate();
+    let service_id = V3OnionServiceId::from_private_key(&private_key);
+    let _listener = alice.listener(&private_key, 1234, None)?;
+    assert!(bob.update()?.is_empty());
+    let events = alice.update()?;
+    assert!(matches!(events.as_slice(),
+        [TorEvent::OnionServicePublished { service_id: published }] if *published == service_id));
+
+    // and only bob hears about bob's connect
+    let handle = bob.connect_async((service_id, 1234).into(), None)?;
+    assert!(alice.update()?.is_empty());
+    let events = bob.update()?;
+    assert!(matches!(events.as_slice(),
+        [TorEvent::ConnectComplete { handle: completed, .. }] if *completed == handle));
+
+    // a client's update() does not wait on another client's call to the shared
+    // TorProvider
+    {
+        let _tor_provider = shared_tor_provider.shared.lock_tor_provider();
+        assert!(bob.update()?.is_empty());
+        assert!(!bob.has_pending_events());
+    }
+
+    // circuit tokens are private to the client which generated them
+    let circuit_token = alice.generate_token();
+    let target: TargetAddr = "127.0.0.1:80".parse()?;
+    assert!(bob.connect(target.clone(), Some(circuit_token)).is_err());
+    alice.connect(target, Some(circuit_token))?;
+    alice.release_token(circuit_token);
+
+    // log lines queued for a client which never updates are capped
+    for i in 0..2 * MAX_QUEUED_LOG_LINES {
+        let line = i.to_string();
+        shared_tor_provider
+            .shared
+            .lock()
+            .route_events(vec![TorEvent::LogReceived { line }]);
+    }
+    let events = bob.update()?;
+    assert_eq!(events.len(), MAX_QUEUED_LOG_LINES);
+    assert!(
+        matches!(&events[0], TorEvent::LogReceived { line } if *line == MAX_QUEUED_LOG_LINES.to_string())
+    );
+    assert!(alice.update()?.len() <= MAX_QUEUED_LOG_LINES);
+
+    // dropped clients no longer receive events
+    drop(alice);
+    assert_eq!(shared_tor_provider.shared.lock().clients.len(), 1);
+    assert!(shared_tor_provider
+        .shared
+        .lock()
+        .onion_service_owners
+        .is_empty());
+
+    Ok(())
+}
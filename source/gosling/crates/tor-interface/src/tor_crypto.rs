@@ -1,8 +1,10 @@
 // standard
 use std::convert::TryInto;
 use std::str;
+use std::sync::{Arc, OnceLock};
 
 // extern crates
+use curve25519_dalek::edwards::CompressedEdwardsY;
 use curve25519_dalek::Scalar;
 use data_encoding::{BASE32_NOPAD, BASE64};
 use data_encoding_macro::new_encoding;
@@ -126,8 +128,17 @@ pub(crate) fn generate_password(length: usize) -> String {
 /// An ed25519 private key.
 ///
 /// This key type is used with [`crate::tor_provider::TorProvider`] trait for hosting onion-services and can be convertd to an [`Ed25519PublicKey`]. It can also be used to sign messages and create an [`Ed25519Signature`].
+///
+/// Clones share the same underlying key material, so cloning is cheap and values derived from the key (e.g. its [`V3OnionServiceId`]) are only calculated once.
 pub struct Ed25519PrivateKey {
+    key: Arc<Ed25519PrivateKeyData>,
+}
+
+// the key material shared by clones of an Ed25519PrivateKey
+struct Ed25519PrivateKeyData {
     expanded_keypair: pk::ed25519::ExpandedKeypair,
+    // calculated on first use
+    service_id: OnceLock<V3OnionServiceId>,
 }
 
 /// An ed25519 public key.
@@ -148,6 +159,8 @@ pub struct Ed25519Signature {
 #[derive(Clone)]
 pub struct X25519PrivateKey {
     secret_key: pk::curve25519::StaticSecret,
+    // calculated on first use
+    public_key: OnceLock<pk::curve25519::PublicKey>,
 }
 
 /// An x25519 public key
@@ -157,9 +170,12 @@ pub struct X25519PublicKey {
 }
 
 /// A v3 onion-service id
-#[derive(Clone, PartialEq, Eq, Hash, PartialOrd, Ord)]
+#[derive(Clone)]
 pub struct V3OnionServiceId {
     data: [u8; V3_ONION_SERVICE_ID_STRING_LENGTH],
+    // the ed25519 public key encoded in data; calculated on first use unless
+    // the service id was created from the key
+    public_key: OnceLock<Ed25519PublicKey>,
 }
 
 /// An enum representing a single bit
@@ -216,8 +232,15 @@ impl Ed25519PrivateKey {
         let csprng = &mut OsRng;
         let keypair = pk::ed25519::Keypair::generate(csprng);
 
+        Ed25519PrivateKey::from_expanded_keypair(pk::ed25519::ExpandedKeypair::from(&keypair))
+    }
+
+    fn from_expanded_keypair(expanded_keypair: pk::ed25519::ExpandedKeypair) -> Ed25519PrivateKey {
         Ed25519PrivateKey {
-            expanded_keypair: pk::ed25519::ExpandedKeypair::from(&keypair),
+            key: Arc::new(Ed25519PrivateKeyData {
+                expanded_keypair,
+                service_id: OnceLock::new(),
+            }),
         }
     }
 
@@ -249,7 +272,7 @@ impl Ed25519PrivateKey {
         }
 
         if let Some(expanded_keypair) = pk::ed25519::ExpandedKeypair::from_secret_key_bytes(*raw) {
-            Ok(Ed25519PrivateKey { expanded_keypair })
+            Ok(Ed25519PrivateKey::from_expanded_keypair(expanded_keypair))
         } else {
             Err(Error::KeyInvalid)
         }
@@ -327,9 +350,7 @@ impl Ed25519PrivateKey {
             convert_curve25519_to_ed25519_private(&x25519_private.secret_key)
         {
             Ok((
-                Ed25519PrivateKey {
-                    expanded_keypair: result,
-                },
+                Ed25519PrivateKey::from_expanded_keypair(result),
                 match signbit {
                     0u8 => SignBit::Zero,
                     1u8 => SignBit::One,
@@ -351,7 +372,7 @@ impl Ed25519PrivateKey {
     /// Write `Ed25519PrivateKey` to a c-tor key blob formatted [`String`].
     pub fn to_key_blob(&self) -> String {
         let mut key_blob = ED25519_PRIVATE_KEY_KEYBLOB_HEADER.to_string();
-        key_blob.push_str(&BASE64.encode(&self.expanded_keypair.to_secret_key_bytes()));
+        key_blob.push_str(&BASE64.encode(&self.key.expanded_keypair.to_secret_key_bytes()));
 
         key_blob
     }
@@ -360,18 +381,18 @@ impl Ed25519PrivateKey {
     /// ## ⚠ Warning ⚠
     ///Only ever sign messages the private key owner controls the contents of!
     pub fn sign_message(&self, message: &[u8]) -> Ed25519Signature {
-        let signature = self.expanded_keypair.sign(message);
+        let signature = self.key.expanded_keypair.sign(message);
         Ed25519Signature { signature }
     }
 
     /// Convert this private key to an array of bytes.
     pub fn to_bytes(&self) -> [u8; ED25519_PRIVATE_KEY_SIZE] {
-        self.expanded_keypair.to_secret_key_bytes()
+        self.key.expanded_keypair.to_secret_key_bytes()
     }
 
     #[cfg(feature = "arti-client-tor-provider")]
     pub(crate) fn inner(&self) -> &pk::ed25519::ExpandedKeypair {
-        &self.expanded_keypair
+        &self.key.expanded_keypair
     }
 }
 
@@ -383,9 +404,8 @@ impl PartialEq for Ed25519PrivateKey {
 
 impl Clone for Ed25519PrivateKey {
     fn clone(&self) -> Ed25519PrivateKey {
-        match Ed25519PrivateKey::from_raw(&self.to_bytes()) {
-            Ok(ed25519_private_key) => ed25519_private_key,
-            Err(_) => unreachable!(),
+        Ed25519PrivateKey {
+            key: Arc::clone(&self.key),
         }
     }
 }
@@ -410,6 +430,10 @@ impl Ed25519PublicKey {
 
     /// Construct an `Ed25519PublicKey` from a [`V3OnionServiceId`].
     pub fn from_service_id(service_id: &V3OnionServiceId) -> Result<Ed25519PublicKey, Error> {
+        if let Some(public_key) = service_id.public_key.get() {
+            return Ok(public_key.clone());
+        }
+
         // decode base32 encoded service id
         let mut decoded_service_id = [0u8; V3_ONION_SERVICE_ID_RAW_SIZE];
         let decoded_byte_count =
@@ -429,21 +453,25 @@ impl Ed25519PublicKey {
             )));
         }
 
-        Ed25519PublicKey::from_raw(
+        let public_key = Ed25519PublicKey::from_raw(
             decoded_service_id[0..ED25519_PUBLIC_KEY_SIZE]
                 .try_into()
                 .unwrap(),
-        )
+        )?;
+        // another thread may have beaten us to it, but the results are the same
+        let _ = service_id.public_key.set(public_key.clone());
+        Ok(public_key)
     }
 
     /// Construct an `Ed25519PublicKey` from an [`Ed25519PrivateKey`].
     pub fn from_private_key(private_key: &Ed25519PrivateKey) -> Ed25519PublicKey {
         Ed25519PublicKey {
-            public_key: *private_key.expanded_keypair.public(),
+            public_key: *private_key.key.expanded_keypair.public(),
         }
     }
 
-    fn from_public_x25519(
+    /// Construct the [`Ed25519PublicKey`] which verifies signatures made by an [`X25519PrivateKey`] converted to an [`Ed25519PrivateKey`] and [`SignBit`] (see [`Ed25519Signature::verify_x25519()`]).
+    pub fn from_public_x25519(
         public_x25519: &X25519PublicKey,
         signbit: SignBit,
     ) -> Result<Ed25519PublicKey, Error> {
@@ -509,6 +537,30 @@ impl Ed25519Signature {
         false
     }
 
+    /// Verify a batch of `(message, signature, public key)` triples at once, which is considerably cheaper per signature than calling [`Ed25519Signature::verify()`] on each. Returns `true` only if every signature in the batch is valid; the batch as a whole fails if any one signature is invalid, so callers needing to know which signature failed must fall back to verifying them individually.
+    pub fn verify_batch(batch: &[(&[u8], &Ed25519Signature, &Ed25519PublicKey)]) -> bool {
+        let mut messages: Vec<&[u8]> = Vec::with_capacity(batch.len());
+        let mut signatures: Vec<pk::ed25519::Signature> = Vec::with_capacity(batch.len());
+        let mut public_keys: Vec<pk::ed25519::PublicKey> = Vec::with_capacity(batch.len());
+        for (message, signature, public_key) in batch {
+            // verify() rejects small-order keys and signature R components, which
+            // the batch equation alone would not, so such batches must fail here
+            let signature_r = CompressedEdwardsY(*signature.signature.r_bytes());
+            match signature_r.decompress() {
+                Some(signature_r) if !signature_r.is_small_order() => (),
+                _ => return false,
+            }
+            if public_key.public_key.is_weak() {
+                return false;
+            }
+
+            messages.push(*message);
+            signatures.push(signature.signature);
+            public_keys.push(public_key.public_key);
+        }
+        ed25519_dalek::verify_batch(&messages, &signatures, &public_keys).is_ok()
+    }
+
     /// Convert this signature to an array of bytes
     pub fn to_bytes(&self) -> [u8; ED25519_SIGNATURE_SIZE] {
         self.signature.to_bytes()
@@ -534,6 +586,7 @@ impl X25519PrivateKey {
         let csprng = &mut OsRng;
         X25519PrivateKey {
             secret_key: pk::curve25519::StaticSecret::random_from_rng(csprng),
+            public_key: OnceLock::new(),
         }
     }
 
@@ -545,6 +598,7 @@ impl X25519PrivateKey {
         if raw[0] == raw[0] & 240 && raw[31] == (raw[31] & 127) | 64 {
             Ok(X25519PrivateKey {
                 secret_key: pk::curve25519::StaticSecret::from(*raw),
+                public_key: OnceLock::new(),
             })
         } else {
             Err(Error::KeyInvalid)
@@ -630,7 +684,9 @@ impl X25519PublicKey {
     /// Construct an `X25519PublicKey` from an [`X25519PrivateKey`].
     pub fn from_private_key(private_key: &X25519PrivateKey) -> X25519PublicKey {
         X25519PublicKey {
-            public_key: pk::curve25519::PublicKey::from(&private_key.secret_key),
+            public_key: *private_key
+                .public_key
+                .get_or_init(|| pk::curve25519::PublicKey::from(&private_key.secret_key)),
         }
     }
 
@@ -736,6 +792,7 @@ impl V3OnionServiceId {
         }
         Ok(V3OnionServiceId {
             data: service_id.as_bytes().try_into().unwrap(),
+            public_key: OnceLock::new(),
         })
     }
 
@@ -753,12 +810,19 @@ impl V3OnionServiceId {
         // panics on wrong buffer size, but given our constant buffer sizes should be fine
         ONION_BASE32.encode_mut(&raw_service_id, &mut service_id);
 
-        V3OnionServiceId { data: service_id }
+        V3OnionServiceId {
+            data: service_id,
+            public_key: OnceLock::from(public_key.clone()),
+        }
     }
 
     /// Create a `V3OnionServiceId` from an [`Ed25519PrivateKey`].
     pub fn from_private_key(private_key: &Ed25519PrivateKey) -> V3OnionServiceId {
-        Self::from_public_key(&Ed25519PublicKey::from_private_key(private_key))
+        private_key
+            .key
+            .service_id
+            .get_or_init(|| Self::from_public_key(&Ed25519PublicKey::from_private_key(private_key)))
+            .clone()
     }
 
     /// Determine if the provided string is a valid representation of a `V3OnionServiceId`
@@ -801,6 +865,33 @@ impl V3OnionServiceId {
     }
 }
 
+// service ids are compared by their string representation alone
+impl PartialEq for V3OnionServiceId {
+    fn eq(&self, other: &Self) -> bool {
+        self.data.eq(&other.data)
+    }
+}
+
+impl Eq for V3OnionServiceId {}
+
+impl std::hash::Hash for V3OnionServiceId {
+    fn hash<H: std::hash::Hasher>(&self, state: &mut H) {
+        self.data.hash(state);
+    }
+}
+
+impl PartialOrd for V3OnionServiceId {
+    fn partial_cmp(&self, other: &Self) -> Option<std::cmp::Ordering> {
+        Some(self.cmp(other))
+    }
+}
+
+impl Ord for V3OnionServiceId {
+    fn cmp(&self, other: &Self) -> std::cmp::Ordering {
+        self.data.cmp(&other.data)
+    }
+}
+
 impl std::fmt::Display for V3OnionServiceId {
     fn fmt(&self, f: &mut std::fmt::Formatter<'_>) -> std::fmt::Result {
         unsafe { write!(f, "{}", str::from_utf8_unchecked(&self.data)) }
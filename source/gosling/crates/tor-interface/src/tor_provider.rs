@@ -5,8 +5,14 @@ use std::convert::TryFrom;
 use std::io::{Read, Write};
 use std::net::{SocketAddr, TcpListener, TcpStream};
 use std::ops::{Deref, DerefMut};
+#[cfg(unix)]
+use std::os::unix::io::{AsFd, AsRawFd, BorrowedFd, OwnedFd, RawFd};
+#[cfg(unix)]
+use std::os::unix::net::UnixListener;
+#[cfg(windows)]
+use std::os::windows::io::{AsRawSocket, AsSocket, BorrowedSocket, RawSocket};
 use std::str::FromStr;
-use std::sync::OnceLock;
+use std::sync::{Arc, OnceLock};
 
 // extern crates
 use domain::base::name::Name;
@@ -266,11 +272,31 @@ pub enum TorEvent {
         /// The service-id of the onion-service which has been published.
         service_id: V3OnionServiceId,
     },
+    /// A connection started with [`TorProvider::connect_async()`] has been established.
+    ConnectComplete {
+        /// The handle returned by the associated [`TorProvider::connect_async()`] call.
+        handle: ConnectHandle,
+        /// The resulting stream.
+        stream: OnionStream,
+    },
+    /// A connection started with [`TorProvider::connect_async()`] has failed.
+    ConnectFailed {
+        /// The handle returned by the associated [`TorProvider::connect_async()`] call.
+        handle: ConnectHandle,
+        /// The failure reason.
+        error: Error,
+    },
 }
 
 /// A `CircuitToken` is used to specify circuits used to connect to clearnet services.
 pub type CircuitToken = usize;
 
+/// A `ConnectHandle` is used to refer to an in-flight [`TorProvider::connect_async()`] request.
+pub type ConnectHandle = usize;
+
+/// A `TorEventWaker` is used by a [`TorProvider`] to signal new [`TorEvent`]s are ready, see [`TorProvider::set_event_waker()`].
+pub type TorEventWaker = Arc<dyn Fn() + Send + Sync>;
+
 //
 // Onion Stream
 //
@@ -278,6 +304,9 @@ pub type CircuitToken = usize;
 /// A wrapper around a [`std::net::TcpStream`] with some Tor-specific customisations
 ///
 /// An onion-listener can be constructed using the [`TorProvider::connect()`] method.
+///
+/// On unix, a [`TorProvider`] may connect to the tor daemon over unix-domain sockets rather than loopback TCP (see [`LegacyTorClientConfig`](crate::legacy_tor_client::LegacyTorClientConfig)). The wrapped `TcpStream` then owns a unix-domain socket: reading, writing, timeouts, nonblocking mode, shutdown and cloning behave as usual, but TCP-specific methods such as [`TcpStream::peer_addr()`] or [`TcpStream::set_nodelay()`] fail.
+#[derive(Debug)]
 pub struct OnionStream {
     pub(crate) stream: TcpStream,
     pub(crate) local_addr: Option<OnionAddr>,
@@ -344,11 +373,31 @@ impl OnionStream {
 // Onion Listener
 //
 
+/// The local socket an [`OnionListener`]'s onion-service forwards connections to
+pub(crate) enum OnionListenerSocket {
+    Tcp(TcpListener),
+    #[cfg(unix)]
+    Unix(UnixListener),
+}
+
+impl From<TcpListener> for OnionListenerSocket {
+    fn from(listener: TcpListener) -> Self {
+        Self::Tcp(listener)
+    }
+}
+
+#[cfg(unix)]
+impl From<UnixListener> for OnionListenerSocket {
+    fn from(listener: UnixListener) -> Self {
+        Self::Unix(listener)
+    }
+}
+
 /// A wrapper around a [`std::net::TcpListener`] with some Tor-specific customisations.
 ///
-/// An onion-listener can be constructed using the [`TorProvider::listener()`] method.
+/// An onion-listener can be constructed using the [`TorProvider::listener()`] method. On unix, the underlying listener may instead be a unix-domain socket, in which case the accepted [`OnionStream`]s are too.
 pub struct OnionListener {
-    pub(crate) listener: TcpListener,
+    pub(crate) listener: OnionListenerSocket,
     pub(crate) onion_addr: OnionAddr,
     pub(crate) data: Option<Box<dyn Any + Send>>,
     pub(crate) drop: Option<Box<dyn FnMut(Box<dyn Any>) + Send>>,
@@ -357,7 +406,7 @@ pub struct OnionListener {
 impl OnionListener {
     /// Construct an `OnionListener`. The `data` and `drop` parameters are to allow custom `TorProvider` implementations their own data and cleanup procedures.
     pub(crate) fn new<T: 'static + Send>(
-        listener: TcpListener,
+        listener: impl Into<OnionListenerSocket>,
         onion_addr: OnionAddr,
         data: T,
         mut drop: impl FnMut(T) + 'static + Send) -> Self {
@@ -373,7 +422,7 @@ impl OnionListener {
         }));
 
         Self{
-            listener,
+            listener: listener.into(),
             onion_addr,
             data,
             drop,
@@ -382,13 +431,25 @@ impl OnionListener {
 
     /// Moves the underlying `TcpListener` into or out of nonblocking mode.
     pub fn set_nonblocking(&self, nonblocking: bool) -> Result<(), std::io::Error> {
-        self.listener.set_nonblocking(nonblocking)
+        match &self.listener {
+            OnionListenerSocket::Tcp(listener) => listener.set_nonblocking(nonblocking),
+            #[cfg(unix)]
+            OnionListenerSocket::Unix(listener) => listener.set_nonblocking(nonblocking),
+        }
     }
 
     /// Accept a new incoming connection from this listener.
     pub fn accept(&self) -> Result<Option<OnionStream>, std::io::Error> {
-        match self.listener.accept() {
-            Ok((stream, _socket_addr)) => Ok(Some(OnionStream {
+        let result = match &self.listener {
+            OnionListenerSocket::Tcp(listener) => listener.accept().map(|(stream, _)| stream),
+            // see OnionStream's documentation
+            #[cfg(unix)]
+            OnionListenerSocket::Unix(listener) => listener
+                .accept()
+                .map(|(stream, _)| TcpStream::from(OwnedFd::from(stream))),
+        };
+        match result {
+            Ok(stream) => Ok(Some(OnionStream {
                 stream,
                 local_addr: Some(self.onion_addr.clone()),
                 peer_addr: None,
@@ -404,6 +465,44 @@ impl OnionListener {
     }
 }
 
+#[cfg(unix)]
+impl AsRawFd for OnionListener {
+    fn as_raw_fd(&self) -> RawFd {
+        match &self.listener {
+            OnionListenerSocket::Tcp(listener) => listener.as_raw_fd(),
+            OnionListenerSocket::Unix(listener) => listener.as_raw_fd(),
+        }
+    }
+}
+
+#[cfg(unix)]
+impl AsFd for OnionListener {
+    fn as_fd(&self) -> BorrowedFd<'_> {
+        match &self.listener {
+            OnionListenerSocket::Tcp(listener) => listener.as_fd(),
+            OnionListenerSocket::Unix(listener) => listener.as_fd(),
+        }
+    }
+}
+
+#[cfg(windows)]
+impl AsRawSocket for OnionListener {
+    fn as_raw_socket(&self) -> RawSocket {
+        match &self.listener {
+            OnionListenerSocket::Tcp(listener) => listener.as_raw_socket(),
+        }
+    }
+}
+
+#[cfg(windows)]
+impl AsSocket for OnionListener {
+    fn as_socket(&self) -> BorrowedSocket<'_> {
+        match &self.listener {
+            OnionListenerSocket::Tcp(listener) => listener.as_socket(),
+        }
+    }
+}
+
 impl Drop for OnionListener {
     fn drop(&mut self) {
         if let (Some(data), Some(mut drop)) = (self.data.take(), self.drop.take()) {
@@ -424,6 +523,24 @@ pub trait TorProvider: Send {
         service_id: &V3OnionServiceId,
         client_auth: &X25519PrivateKey,
     ) -> Result<(), Error>;
+    /// Add multiple v3 onion-service authorisation credentials, see [`TorProvider::add_client_auth()`].
+    ///
+    /// Implementations may apply every credential with a single round-trip to their tor backend. The default implementation calls [`TorProvider::add_client_auth()`] for each credential in turn and stops at the first failure.
+    fn add_client_auth_batch(
+        &mut self,
+        client_auths: &[(&V3OnionServiceId, &X25519PrivateKey)],
+    ) -> Result<(), Error> {
+        for (service_id, client_auth) in client_auths.iter() {
+            self.add_client_auth(service_id, client_auth)?;
+        }
+        Ok(())
+    }
+    /// Ask this `TorProvider` to fetch the service-descriptors of the given onion-services ahead of connecting to them, so that a later [`TorProvider::connect()`] or [`TorProvider::connect_async()`] need not wait for the fetch. Any required client authorisation credentials should be added first. Descriptors are fetched in the background and failures to fetch them are not reported; a later connect simply fetches the descriptor again.
+    ///
+    /// The default implementation does nothing.
+    fn prefetch_descriptors(&mut self, _service_ids: &[&V3OnionServiceId]) -> Result<(), Error> {
+        Ok(())
+    }
     /// Remove a previously added client authorisation credential. This `TorProvider` will be unable to connect to the onion-service associated with the removed credentail.
     fn remove_client_auth(&mut self, service_id: &V3OnionServiceId) -> Result<(), Error>;
     /// Anonymously connect to the address specified by `target` over the Tor Network and return the associated [`OnionStream`].
@@ -438,6 +555,14 @@ pub trait TorProvider: Send {
         target: TargetAddr,
         circuit: Option<CircuitToken>,
     ) -> Result<OnionStream, Error>;
+    /// Begin anonymously connecting to the address specified by `target` over the Tor Network without blocking, and return a [`ConnectHandle`] identifying the request.
+    ///
+    /// The result is returned from a subsequent [`TorProvider::update()`] call as either a [`TorEvent::ConnectComplete`] or [`TorEvent::ConnectFailed`] event with the matching handle. The `circuit` parameter has the same semantics as in [`TorProvider::connect()`].
+    fn connect_async(
+        &mut self,
+        target: TargetAddr,
+        circuit: Option<CircuitToken>,
+    ) -> Result<ConnectHandle, Error>;
     /// Anonymously start an onion-service and return the associated [`OnionListener`].
     ///
     ///The resulting onion-service will not be reachable by clients until [`TorProvider::update()`] returns a [`TorEvent::OnionServicePublished`] event. The optional `authorised_clients` parameter may be used to require client authorisation keys to connect to resulting onion-service. For further information, see the Tor Project's onion-services [client-auth documentation](https://community.torproject.org/onion-services/advanced/client-auth).
@@ -447,8 +572,36 @@ pub trait TorProvider: Send {
         virt_port: u16,
         authorised_clients: Option<&[X25519PublicKey]>,
     ) -> Result<OnionListener, Error>;
+    /// Anonymously start multiple onion-services and return their associated [`OnionListener`]s in the same order, see [`TorProvider::listener()`]. Each entry of `listeners` is a `(private_key, virt_port, authorised_clients)` tuple.
+    ///
+    /// Implementations may start every onion-service with a single round-trip to their tor backend. If any onion-service fails to start, an error is returned and the onion-services which were started are stopped again. The default implementation calls [`TorProvider::listener()`] for each onion-service in turn.
+    #[allow(clippy::type_complexity)]
+    fn listener_batch(
+        &mut self,
+        listeners: &[(&Ed25519PrivateKey, u16, Option<&[X25519PublicKey]>)],
+    ) -> Result<Vec<OnionListener>, Error> {
+        let mut result: Vec<OnionListener> = Vec::with_capacity(listeners.len());
+        for (private_key, virt_port, authorised_clients) in listeners.iter() {
+            result.push(self.listener(private_key, *virt_port, *authorised_clients)?);
+        }
+        Ok(result)
+    }
     /// Create a new [`CircuitToken`].
     fn generate_token(&mut self) -> CircuitToken;
     /// Releaes a previously generated [`CircuitToken`].
     fn release_token(&mut self, token: CircuitToken);
+    /// Register a [`TorEventWaker`] which this `TorProvider` calls (from any thread) whenever new [`TorEvent`]s become available to [`TorProvider::update()`] in the background. Events produced synchronously by this `TorProvider`'s own methods (e.g. [`TorProvider::bootstrap()`] or [`TorProvider::listener()`]) do not trigger the waker.
+    ///
+    /// Returns `false` if this `TorProvider` does not support wakers, in which case callers must keep calling [`TorProvider::update()`] periodically.
+    fn set_event_waker(&mut self, _waker: TorEventWaker) -> bool {
+        false
+    }
+    /// Returns the sockets this `TorProvider` reads from in [`TorProvider::update()`]. Callers blocking on OS readiness notification should also wake up when any of these become readable.
+    fn event_sources(&self) -> Vec<&TcpStream> {
+        Default::default()
+    }
+    /// Returns whether this `TorProvider` already holds [`TorEvent`]s for [`TorProvider::update()`] which neither its [`TorEventWaker`] nor its [`TorProvider::event_sources()`] will signal, e.g. events received while waiting on the reply to one of its own methods. Callers blocking on OS readiness notification should call [`TorProvider::update()`] instead of blocking while this returns `true`.
+    fn has_pending_events(&self) -> bool {
+        false
+    }
 }
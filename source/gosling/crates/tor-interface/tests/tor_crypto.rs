@@ -54,6 +54,21 @@ fn test_crypto_ed25519() -> Result<(), anyhow::Error> {
     assert!(signature.verify(&message, &public_key));
     assert!(!signature.verify(&null_message, &public_key));
 
+    // derived values are cached, and shared between clones
+    let private_key_clone = private_key.clone();
+    assert_eq!(private_key, private_key_clone);
+    assert_eq!(service_id, V3OnionServiceId::from_private_key(&private_key));
+    assert_eq!(
+        service_id,
+        V3OnionServiceId::from_private_key(&private_key_clone)
+    );
+    assert_eq!(
+        public_key,
+        Ed25519PublicKey::from_service_id(&V3OnionServiceId::from_private_key(&private_key))?
+    );
+    assert_eq!(public_key, Ed25519PublicKey::from_service_id(&service_id)?);
+    assert_eq!(public_key, Ed25519PublicKey::from_service_id(&service_id)?);
+
     // some invalid service ids
     assert!(!V3OnionServiceId::is_valid(""));
     assert!(!V3OnionServiceId::is_valid(
@@ -129,6 +144,11 @@ fn test_crypto_x25519() -> Result<(), anyhow::Error> {
     let private_key = X25519PrivateKey::from_base64(&SECRET_BASE64)?;
     let public_key = X25519PublicKey::from_private_key(&private_key);
     assert_eq!(public_key.to_base32(), PUBLIC_BASE32);
+    assert_eq!(public_key, X25519PublicKey::from_private_key(&private_key));
+    assert_eq!(
+        public_key,
+        X25519PublicKey::from_private_key(&private_key.clone())
+    );
 
     let message = b"All around me are familiar faces";
 
@@ -137,3 +157,44 @@ fn test_crypto_x25519() -> Result<(), anyhow::Error> {
 
     Ok(())
 }
+
+#[test]
+fn test_crypto_ed25519_batch() -> Result<(), anyhow::Error> {
+    let message = b"Speak friend and enter";
+    let null_message = [0x00u8; 22];
+
+    let mut public_keys: Vec<Ed25519PublicKey> = Default::default();
+    let mut signatures: Vec<Ed25519Signature> = Default::default();
+    for _ in 0..8 {
+        let private_key = Ed25519PrivateKey::generate();
+        public_keys.push(Ed25519PublicKey::from_private_key(&private_key));
+        signatures.push(private_key.sign_message(message));
+    }
+
+    // signatures made with x25519 keys may be batched with their derived ed25519 keys
+    let private_key = X25519PrivateKey::generate();
+    let (signature, signbit) = private_key.sign_message(message)?;
+    public_keys.push(Ed25519PublicKey::from_public_x25519(
+        &X25519PublicKey::from_private_key(&private_key),
+        signbit,
+    )?);
+    signatures.push(signature);
+
+    let mut batch: Vec<(&[u8], &Ed25519Signature, &Ed25519PublicKey)> = signatures
+        .iter()
+        .zip(public_keys.iter())
+        .map(|(signature, public_key)| (message.as_slice(), signature, public_key))
+        .collect();
+    assert!(Ed25519Signature::verify_batch(&[]));
+    assert!(Ed25519Signature::verify_batch(&batch));
+
+    // a single bad signature fails the whole batch
+    batch[3].0 = &null_message;
+    assert!(!Ed25519Signature::verify_batch(&batch));
+    batch[3].0 = message;
+    batch.swap(0, 1);
+    batch[0].1 = batch[1].1;
+    assert!(!Ed25519Signature::verify_batch(&batch));
+
+    Ok(())
+}
@@ -24,6 +24,7 @@ use tor_interface::censorship_circumvention::*;
 use tor_interface::legacy_tor_client::*;
 #[cfg(feature = "mock-tor-provider")]
 use tor_interface::mock_tor_client::*;
+use tor_interface::shared_tor_client::*;
 use tor_interface::tor_crypto::*;
 use tor_interface::tor_provider::*;
 
@@ -324,6 +325,139 @@ pub(crate) fn authenticated_onion_service_test(
     Ok(())
 }
 
+#[allow(dead_code)]
+pub(crate) fn batch_onion_service_test(
+    mut server_provider: Box<dyn TorProvider>,
+    mut client_provider: Box<dyn TorProvider>,
+) -> anyhow::Result<()> {
+    server_provider.bootstrap()?;
+    client_provider.bootstrap()?;
+
+    let mut server_provider_bootstrap_complete = false;
+    let mut client_provider_bootstrap_complete = false;
+
+    while !server_provider_bootstrap_complete || !client_provider_bootstrap_complete {
+        for event in server_provider.update()?.iter() {
+            match event {
+                TorEvent::BootstrapComplete => {
+                    println!("Server Provider Bootstrap Complete!");
+                    server_provider_bootstrap_complete = true;
+                }
+                TorEvent::LogReceived { line } => {
+                    println!("--- {}", line);
+                }
+                _ => {}
+            }
+        }
+
+        for event in client_provider.update()?.iter() {
+            match event {
+                TorEvent::BootstrapComplete => {
+                    println!("Client Provider Bootstrap Complete!");
+                    client_provider_bootstrap_complete = true;
+                }
+                TorEvent::LogReceived { line } => {
+                    println!("--- {}", line);
+                }
+                _ => {}
+            }
+        }
+    }
+
+    // a batch of authenticated onion services
+    {
+        const SERVICE_COUNT: usize = 4usize;
+        const VIRT_PORT: u16 = 42069u16;
+
+        let private_keys: Vec<Ed25519PrivateKey> = (0..SERVICE_COUNT)
+            .map(|_| Ed25519PrivateKey::generate())
+            .collect();
+        let service_ids: Vec<V3OnionServiceId> = private_keys
+            .iter()
+            .map(V3OnionServiceId::from_private_key)
+            .collect();
+        let private_auth_keys: Vec<X25519PrivateKey> = (0..SERVICE_COUNT)
+            .map(|_| X25519PrivateKey::generate())
+            .collect();
+        let public_auth_keys: Vec<[X25519PublicKey; 1]> = private_auth_keys
+            .iter()
+            .map(|private_auth_key| [X25519PublicKey::from_private_key(private_auth_key)])
+            .collect();
+
+        println!("Starting and listening to batch of onion services");
+        let listener_args: Vec<(&Ed25519PrivateKey, u16, Option<&[X25519PublicKey]>)> =
+            private_keys
+                .iter()
+                .zip(public_auth_keys.iter())
+                .map(|(private_key, public_auth_key)| {
+                    (private_key, VIRT_PORT, Some(public_auth_key.as_slice()))
+                })
+                .collect();
+        let listeners = server_provider.listener_batch(&listener_args)?;
+        assert_eq!(listeners.len(), SERVICE_COUNT);
+
+        let mut unpublished: Vec<V3OnionServiceId> = service_ids.clone();
+        while !unpublished.is_empty() {
+            for event in server_provider.update()?.iter() {
+                match event {
+                    TorEvent::LogReceived { line } => {
+                        println!("--- {}", line);
+                    }
+                    TorEvent::OnionServicePublished { service_id } => {
+                        if let Some(index) = unpublished.iter().position(|id| id == service_id) {
+                            println!("Onion Service {} published", service_id);
+                            unpublished.swap_remove(index);
+                        }
+                    }
+                    _ => {}
+                }
+            }
+        }
+
+        println!("Add auth keys for batch of onion services");
+        let client_auths: Vec<(&V3OnionServiceId, &X25519PrivateKey)> =
+            service_ids.iter().zip(private_auth_keys.iter()).collect();
+        client_provider.add_client_auth_batch(&client_auths)?;
+
+        const MESSAGE: &str = "Hello World!";
+
+        for (service_id, listener) in service_ids.iter().zip(listeners.iter()) {
+            {
+                println!("Connecting to onion service {}", service_id);
+                let mut attempt_count = 0;
+                let mut client = loop {
+                    match client_provider.connect((service_id.clone(), VIRT_PORT).into(), None) {
+                        Ok(client) => break client,
+                        Err(err) => {
+                            println!("connect error: {:?}", err);
+                            attempt_count += 1;
+                            if attempt_count == 3 {
+                                panic!("failed to connect :(");
+                            }
+                        }
+                    }
+                };
+                println!("Client writing message: '{}'", MESSAGE);
+                client.write_all(MESSAGE.as_bytes())?;
+                client.flush()?;
+            }
+
+            if let Some(mut server) = listener.accept()? {
+                println!("Server reading message");
+                let mut buffer = Vec::new();
+                server.read_to_end(&mut buffer)?;
+                let msg = String::from_utf8(buffer)?;
+
+                assert_eq!(MESSAGE, msg);
+                println!("Message received: '{}'", msg);
+            } else {
+                panic!("no listener");
+            }
+        }
+    }
+    Ok(())
+}
+
 //
 // Mock TorProvider tests
 //
@@ -350,6 +484,23 @@ fn test_mock_authenticated_onion_service() -> anyhow::Result<()> {
     authenticated_onion_service_test(server_provider, client_provider)
 }
 
+#[test]
+#[cfg(feature = "mock-tor-provider")]
+fn test_mock_batch_onion_service() -> anyhow::Result<()> {
+    let server_provider = Box::new(MockTorClient::new());
+    let client_provider = Box::new(MockTorClient::new());
+    batch_onion_service_test(server_provider, client_provider)
+}
+
+#[test]
+#[cfg(feature = "mock-tor-provider")]
+fn test_mock_shared_onion_service() -> anyhow::Result<()> {
+    let shared_tor_provider = SharedTorProvider::new(Box::new(MockTorClient::new()))?;
+    let server_provider = Box::new(shared_tor_provider.client());
+    let client_provider = Box::new(shared_tor_provider.client());
+    basic_onion_service_test(server_provider, client_provider)
+}
+
 //
 // Legacy TorProvider tests
 //
@@ -369,11 +520,41 @@ fn test_legacy_bootstrap() -> anyhow::Result<()> {
         allowed_ports: None,
         pluggable_transports: None,
         bridge_lines: None,
+        unix_domain_sockets: false,
     };
 
     bootstrap_test(Box::new(LegacyTorClient::new(tor_config)?))
 }
 
+#[test]
+#[serial]
+#[cfg(feature = "legacy-tor-provider")]
+fn test_legacy_warm_restart() -> anyhow::Result<()> {
+    let tor_path = which::which(format!("tor{}", std::env::consts::EXE_SUFFIX))?;
+    let mut data_path = std::env::temp_dir();
+    data_path.push("test_legacy_warm_restart");
+
+    let tor_config = LegacyTorClientConfig::BundledTor {
+        tor_bin_path: tor_path,
+        data_directory: data_path.clone(),
+        proxy_settings: None,
+        allowed_ports: None,
+        pluggable_transports: None,
+        bridge_lines: None,
+        unix_domain_sockets: false,
+    };
+
+    // dropping the client shuts tor down cleanly, persisting its state
+    bootstrap_test(Box::new(LegacyTorClient::new(tor_config.clone())?))?;
+    assert!(
+        data_path.join("state").exists(),
+        "tor should have written its state file on shutdown"
+    );
+
+    // which a new client with the same data directory bootstraps from
+    bootstrap_test(Box::new(LegacyTorClient::new(tor_config)?))
+}
+
 #[test]
 #[serial]
 #[cfg(feature = "legacy-tor-provider")]
@@ -408,6 +589,7 @@ fn test_legacy_pluggable_transport_bootstrap() -> anyhow::Result<()> {
         allowed_ports: None,
         pluggable_transports: Some(vec![pluggable_transport]),
         bridge_lines: Some(vec![bridge_line]),
+        unix_domain_sockets: false,
     };
 
     bootstrap_test(Box::new(LegacyTorClient::new(tor_config)?))
@@ -428,6 +610,7 @@ fn test_legacy_onion_service() -> anyhow::Result<()> {
         allowed_ports: None,
         pluggable_transports: None,
         bridge_lines: None,
+        unix_domain_sockets: false,
     };
     let server_provider = Box::new(LegacyTorClient::new(tor_config)?);
 
@@ -440,6 +623,42 @@ fn test_legacy_onion_service() -> anyhow::Result<()> {
         allowed_ports: None,
         pluggable_transports: None,
         bridge_lines: None,
+        unix_domain_sockets: false,
+    };
+    let client_provider = Box::new(LegacyTorClient::new(tor_config)?);
+
+    basic_onion_service_test(server_provider, client_provider)
+}
+
+#[test]
+#[serial]
+#[cfg(all(unix, feature = "legacy-tor-provider"))]
+fn test_legacy_unix_domain_socket_onion_service() -> anyhow::Result<()> {
+    let tor_path = which::which(format!("tor{}", std::env::consts::EXE_SUFFIX))?;
+
+    let mut data_path = std::env::temp_dir();
+    data_path.push("test_legacy_unix_domain_socket_onion_service_server");
+    let tor_config = LegacyTorClientConfig::BundledTor {
+        tor_bin_path: tor_path.clone(),
+        data_directory: data_path,
+        proxy_settings: None,
+        allowed_ports: None,
+        pluggable_transports: None,
+        bridge_lines: None,
+        unix_domain_sockets: true,
+    };
+    let server_provider = Box::new(LegacyTorClient::new(tor_config)?);
+
+    let mut data_path = std::env::temp_dir();
+    data_path.push("test_legacy_unix_domain_socket_onion_service_client");
+    let tor_config = LegacyTorClientConfig::BundledTor {
+        tor_bin_path: tor_path,
+        data_directory: data_path,
+        proxy_settings: None,
+        allowed_ports: None,
+        pluggable_transports: None,
+        bridge_lines: None,
+        unix_domain_sockets: true,
     };
     let client_provider = Box::new(LegacyTorClient::new(tor_config)?);
 
@@ -461,6 +680,7 @@ fn test_legacy_authenticated_onion_service() -> anyhow::Result<()> {
         allowed_ports: None,
         pluggable_transports: None,
         bridge_lines: None,
+        unix_domain_sockets: false,
     };
     let server_provider = Box::new(LegacyTorClient::new(tor_config)?);
 
@@ -473,12 +693,73 @@ fn test_legacy_authenticated_onion_service() -> anyhow::Result<()> {
         allowed_ports: None,
         pluggable_transports: None,
         bridge_lines: None,
+        unix_domain_sockets: false,
     };
     let client_provider = Box::new(LegacyTorClient::new(tor_config)?);
 
     authenticated_onion_service_test(server_provider, client_provider)
 }
 
+#[test]
+#[serial]
+#[cfg(feature = "legacy-tor-provider")]
+fn test_legacy_batch_onion_service() -> anyhow::Result<()> {
+    let tor_path = which::which(format!("tor{}", std::env::consts::EXE_SUFFIX))?;
+
+    let mut data_path = std::env::temp_dir();
+    data_path.push("test_legacy_batch_onion_service_server");
+    let tor_config = LegacyTorClientConfig::BundledTor {
+        tor_bin_path: tor_path.clone(),
+        data_directory: data_path,
+        proxy_settings: None,
+        allowed_ports: None,
+        pluggable_transports: None,
+        bridge_lines: None,
+        unix_domain_sockets: false,
+    };
+    let server_provider = Box::new(LegacyTorClient::new(tor_config)?);
+
+    let mut data_path = std::env::temp_dir();
+    data_path.push("test_legacy_batch_onion_service_client");
+    let tor_config = LegacyTorClientConfig::BundledTor {
+        tor_bin_path: tor_path,
+        data_directory: data_path,
+        proxy_settings: None,
+        allowed_ports: None,
+        pluggable_transports: None,
+        bridge_lines: None,
+        unix_domain_sockets: false,
+    };
+    let client_provider = Box::new(LegacyTorClient::new(tor_config)?);
+
+    batch_onion_service_test(server_provider, client_provider)
+}
+
+#[test]
+#[serial]
+#[cfg(feature = "legacy-tor-provider")]
+fn test_legacy_shared_onion_service() -> anyhow::Result<()> {
+    let tor_path = which::which(format!("tor{}", std::env::consts::EXE_SUFFIX))?;
+
+    // one tor daemon for both the server and the client
+    let mut data_path = std::env::temp_dir();
+    data_path.push("test_legacy_shared_onion_service");
+    let tor_config = LegacyTorClientConfig::BundledTor {
+        tor_bin_path: tor_path,
+        data_directory: data_path,
+        proxy_settings: None,
+        allowed_ports: None,
+        pluggable_transports: None,
+        bridge_lines: None,
+        unix_domain_sockets: false,
+    };
+    let shared_tor_provider = SharedTorProvider::new(Box::new(LegacyTorClient::new(tor_config)?))?;
+    let server_provider = Box::new(shared_tor_provider.client());
+    let client_provider = Box::new(shared_tor_provider.client());
+
+    basic_onion_service_test(server_provider, client_provider)
+}
+
 //
 // System Legacy TorProvider tests
 //
@@ -701,6 +982,7 @@ fn test_mixed_arti_client_legacy_onion_service() -> anyhow::Result<()> {
         allowed_ports: None,
         pluggable_transports: None,
         bridge_lines: None,
+        unix_domain_sockets: false,
     };
     let client_provider = Box::new(LegacyTorClient::new(tor_config)?);
 
@@ -722,6 +1004,7 @@ fn test_mixed_legacy_arti_client_onion_service() -> anyhow::Result<()> {
         allowed_ports: None,
         pluggable_transports: None,
         bridge_lines: None,
+        unix_domain_sockets: false,
     };
     let server_provider = Box::new(LegacyTorClient::new(tor_config)?);
 
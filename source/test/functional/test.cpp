@@ -31,6 +31,10 @@ constexpr static uint8_t challenge_response_bson[] = {
 const std::string endpointName("endpoint_name");
 const std::string channelName("channel_name");
 
+// our contexts share a thread, so each may only block briefly while waiting
+// for work or it would starve the other
+constexpr static uint32_t WAIT_EVENTS_TIMEOUT_MILLISECONDS = 10;
+
 static void create_client_identity_handshake(unique_ptr<gosling_context> &ctx) {
 
   const auto challenge_response_size_callback =
@@ -164,11 +168,12 @@ static void create_server_identity_handshake(unique_ptr<gosling_context> &ctx) {
           ctx.get(), verify_challenge_response_callback, throw_on_error()));
 }
 
-static void create_server_endpoint_handshake(unique_ptr<gosling_context> &ctx) {
-  const auto channel_supported_callback =
-      [](gosling_context *context, size_t handshake_handle,
-         const gosling_v3_onion_service_id *client_service_id,
-         const char *channel_name, size_t channel_name_length) -> bool {
+// endpoint server callbacks registered through the compile-time binding tier
+struct endpoint_server_handler {
+  static bool endpoint_server_channel_supported(
+      gosling_context *context, size_t handshake_handle,
+      const gosling_v3_onion_service_id *client_service_id,
+      std::string_view channel_name) {
     REQUIRE(context != nullptr);
     REQUIRE(client_service_id != nullptr);
     cout << "--- channel_supported_callback: { context: " << context
@@ -176,16 +181,13 @@ static void create_server_endpoint_handshake(unique_ptr<gosling_context> &ctx) {
          << ", client_service_id: " << client_service_id << ", channel_name: '"
          << channel_name << "' }" << endl;
 
-    if (string(channel_name, channel_name_length) == channelName) {
-      return true;
-    }
-
-    return false;
-  };
+    return channel_name == channelName;
+  }
+};
 
-  REQUIRE_NOTHROW(
-      ::gosling_context_set_endpoint_server_channel_supported_callback(
-          ctx.get(), channel_supported_callback, throw_on_error()));
+static void create_server_endpoint_handshake(unique_ptr<gosling_context> &ctx) {
+  REQUIRE_NOTHROW(bind_callbacks<endpoint_server_handler>(ctx.get(),
+                                                          throw_on_error()));
 }
 
 enum gosling_tor_provider_type {
@@ -274,6 +276,8 @@ void gosling_cpp_demo_impl(
       ::gosling_context_bootstrap_tor(alice_context.get(), throw_on_error()));
 
   while (!alice_bootstrap_complete) {
+    REQUIRE_NOTHROW(::gosling_context_wait_events(
+        alice_context.get(), WAIT_EVENTS_TIMEOUT_MILLISECONDS, throw_on_error()));
     REQUIRE_NOTHROW(
         ::gosling_context_poll_events(alice_context.get(), throw_on_error()));
   }
@@ -293,6 +297,8 @@ void gosling_cpp_demo_impl(
                                                           throw_on_error()));
 
   while (!alice_identity_server_ready) {
+    REQUIRE_NOTHROW(::gosling_context_wait_events(
+        alice_context.get(), WAIT_EVENTS_TIMEOUT_MILLISECONDS, throw_on_error()));
     REQUIRE_NOTHROW(
         ::gosling_context_poll_events(alice_context.get(), throw_on_error()));
   }
@@ -311,8 +317,12 @@ void gosling_cpp_demo_impl(
       ::gosling_context_bootstrap_tor(pat_context.get(), throw_on_error()));
 
   while (!pat_bootstrap_complete) {
+    REQUIRE_NOTHROW(::gosling_context_wait_events(
+        alice_context.get(), WAIT_EVENTS_TIMEOUT_MILLISECONDS, throw_on_error()));
     REQUIRE_NOTHROW(
         ::gosling_context_poll_events(alice_context.get(), throw_on_error()));
+    REQUIRE_NOTHROW(::gosling_context_wait_events(
+        pat_context.get(), WAIT_EVENTS_TIMEOUT_MILLISECONDS, throw_on_error()));
     REQUIRE_NOTHROW(
         ::gosling_context_poll_events(pat_context.get(), throw_on_error()));
   }
@@ -413,8 +423,12 @@ void gosling_cpp_demo_impl(
   REQUIRE(pat_begin_identity_handshake_succeeded);
 
   while (!alice_endpoint_request_complete) {
+    REQUIRE_NOTHROW(::gosling_context_wait_events(
+        alice_context.get(), WAIT_EVENTS_TIMEOUT_MILLISECONDS, throw_on_error()));
     REQUIRE_NOTHROW(
         ::gosling_context_poll_events(alice_context.get(), throw_on_error()));
+    REQUIRE_NOTHROW(::gosling_context_wait_events(
+        pat_context.get(), WAIT_EVENTS_TIMEOUT_MILLISECONDS, throw_on_error()));
     REQUIRE_NOTHROW(
         ::gosling_context_poll_events(pat_context.get(), throw_on_error()));
   }
@@ -439,8 +453,12 @@ void gosling_cpp_demo_impl(
       pat_onion_auth_public_key.get(), throw_on_error()));
 
   while (!alice_endpoint_published || !pat_endpoint_request_complete) {
+    REQUIRE_NOTHROW(::gosling_context_wait_events(
+        pat_context.get(), WAIT_EVENTS_TIMEOUT_MILLISECONDS, throw_on_error()));
     REQUIRE_NOTHROW(
         ::gosling_context_poll_events(pat_context.get(), throw_on_error()));
+    REQUIRE_NOTHROW(::gosling_context_wait_events(
+        alice_context.get(), WAIT_EVENTS_TIMEOUT_MILLISECONDS, throw_on_error()));
     REQUIRE_NOTHROW(
         ::gosling_context_poll_events(alice_context.get(), throw_on_error()));
   }
@@ -523,8 +541,12 @@ void gosling_cpp_demo_impl(
 
   // wait for both channels to be open
   while (!pat_channel_request_complete || !alice_channel_request_complete) {
+    REQUIRE_NOTHROW(::gosling_context_wait_events(
+        alice_context.get(), WAIT_EVENTS_TIMEOUT_MILLISECONDS, throw_on_error()));
     REQUIRE_NOTHROW(
         ::gosling_context_poll_events(alice_context.get(), throw_on_error()));
+    REQUIRE_NOTHROW(::gosling_context_wait_events(
+        pat_context.get(), WAIT_EVENTS_TIMEOUT_MILLISECONDS, throw_on_error()));
     REQUIRE_NOTHROW(
         ::gosling_context_poll_events(pat_context.get(), throw_on_error()));
   }
@@ -707,6 +729,25 @@ void gosling_cpp_demo_legacy_tor_provider() {
 }
 #endif // GOSLING_HAVE_LEGACY_TOR_PROVIDER
 
+TEST_CASE("gosling_cpp_error_code") {
+  // gosling::error keeps the message without throwing
+  gosling::error error;
+  REQUIRE_NOTHROW(::gosling_library_init(nullptr, error));
+  REQUIRE(error);
+  REQUIRE(!error.message().empty());
+  REQUIRE(error.code().category() == gosling::error_category());
+
+  // failures assign the error code and successes clear it
+  unique_ptr<gosling_ed25519_private_key> private_key;
+  std::error_code ec;
+  REQUIRE_NOTHROW(::gosling_library_init(nullptr, assign_error_code(ec)));
+  REQUIRE(ec);
+  REQUIRE_NOTHROW(::gosling_ed25519_private_key_generate(
+      out(private_key), assign_error_code(ec)));
+  REQUIRE(!ec);
+  REQUIRE(private_key.get() != nullptr);
+}
+
 TEST_CASE("gosling_cpp_demo") {
   // init gosling library statically so gosling objects with static lifetime
   // destruct in the right order
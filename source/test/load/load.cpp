@@ -0,0 +1,813 @@
+#include "precomp.hpp"
+
+using namespace std;
+using namespace gosling;
+
+//
+// gosling_load: runs many concurrent identity and endpoint handshakes between
+// contexts on the mock tor provider and reports throughput, latency and
+// resource usage as JSON
+//
+// Each session is an identity handshake from a client context to a server
+// context, the server publishing the endpoint server it granted, and an
+// endpoint handshake from the client to that endpoint server. Contexts are
+// driven with gosling_context_poll_events_batch() and are partitioned across
+// the requested number of threads; every context is both a client and a
+// server.
+//
+
+// platform specific wrappers for tcp stream stuffs
+#if defined(GOSLING_PLATFORM_WINDOWS)
+typedef SOCKET gosling_tcp_socket_t;
+static void close_tcp_socket(gosling_tcp_socket_t stream) {
+  ::closesocket(stream);
+}
+#elif (defined(GOSLING_PLATFORM_MACOS) || defined(GOSLING_PLATFORM_LINUX))
+typedef int gosling_tcp_socket_t;
+static void close_tcp_socket(gosling_tcp_socket_t stream) { ::close(stream); }
+#endif
+
+// simple bson document: { msg : "hello world" }
+constexpr static uint8_t challenge_bson[] = {
+    // document length 26 == 0x0000001a
+    0x1a, 0x00, 0x00, 0x00,
+    // string msg
+    0x02, 'm', 's', 'g', 0x00,
+    // strlen("hello world\x00") 12 = 0x0000000c
+    0x0c, 0x00, 0x00, 0x00,
+    // "hello world"
+    'h', 'e', 'l', 'l', 'o', ' ', 'w', 'o', 'r', 'l', 'd', 0x00,
+    // document null-terminator
+    0x00};
+
+// empty bson document
+constexpr static uint8_t challenge_response_bson[] = {
+    // document length 5 == 0x00000005
+    0x05, 0x00, 0x00, 0x00,
+    // document null-terminator
+    0x00};
+
+const std::string endpointName("endpoint_name");
+const std::string channelName("channel_name");
+
+// each thread drives several contexts, so each may only block briefly while
+// waiting for work or it would starve the others
+constexpr static uint32_t WAIT_EVENTS_TIMEOUT_MILLISECONDS = 1;
+// number of events taken from a context per poll
+constexpr static size_t EVENTS_PER_POLL = 64;
+
+typedef std::chrono::steady_clock clock_type;
+
+static uint64_t microseconds_since(clock_type::time_point start) {
+  return std::chrono::duration_cast<std::chrono::microseconds>(
+             clock_type::now() - start)
+      .count();
+}
+
+//
+// Command-line options
+//
+
+struct options {
+  // number of contexts
+  size_t contexts = 4;
+  // total number of sessions to run
+  size_t handshakes = 256;
+  // maximum number of sessions each context has in progress as a client
+  size_t concurrency = 16;
+  // number of threads driving the contexts
+  size_t threads = 1;
+  // give up on sessions which have not finished by then
+  uint32_t timeout_seconds = 600;
+  // where to write the JSON report, stdout if empty
+  std::string output;
+};
+
+static void print_usage(const char *argv0) {
+  cerr << "usage: " << argv0 << " [options]\n"
+       << "  --contexts N     number of contexts (default 4, at least 2)\n"
+       << "  --handshakes N   total number of identity and endpoint handshake\n"
+       << "                   sessions (default 256)\n"
+       << "  --concurrency N  maximum sessions in progress per client context\n"
+       << "                   (default 16)\n"
+       << "  --threads N      number of threads driving the contexts\n"
+       << "                   (default 1)\n"
+       << "  --timeout N      seconds to wait for the contexts to start, and\n"
+       << "                   then for the sessions (default 600)\n"
+       << "  --output PATH    write the JSON report to PATH rather than\n"
+       << "                   stdout\n";
+}
+
+static bool parse_options(int argc, char **argv, options &opts) {
+  for (int i = 1; i < argc; ++i) {
+    const std::string arg(argv[i]);
+    if (i + 1 >= argc) {
+      return false;
+    }
+    const char *value = argv[++i];
+    try {
+      if (arg == "--contexts") {
+        opts.contexts = std::stoul(value);
+      } else if (arg == "--handshakes") {
+        opts.handshakes = std::stoul(value);
+      } else if (arg == "--concurrency") {
+        opts.concurrency = std::stoul(value);
+      } else if (arg == "--threads") {
+        opts.threads = std::stoul(value);
+      } else if (arg == "--timeout") {
+        opts.timeout_seconds = static_cast<uint32_t>(std::stoul(value));
+      } else if (arg == "--output") {
+        opts.output = value;
+      } else {
+        return false;
+      }
+    } catch (const std::logic_error &) {
+      return false;
+    }
+  }
+  return opts.contexts >= 2 && opts.concurrency > 0 && opts.threads > 0 &&
+         opts.timeout_seconds > 0;
+}
+
+//
+// Nodes
+//
+
+// an identity handshake begun by a client
+struct identity_handshake {
+  size_t server;
+  clock_type::time_point start;
+};
+
+// an endpoint granted to a client, waiting on the identity handshake
+// completing and the endpoint server being published
+struct pending_endpoint {
+  clock_type::time_point session_start;
+  unique_ptr<gosling_v3_onion_service_id> endpoint_service_id;
+  unique_ptr<gosling_x25519_private_key> client_auth_private_key;
+  bool identity_handshake_completed = false;
+  bool endpoint_server_published = false;
+};
+
+// an endpoint handshake begun by a client
+struct endpoint_handshake {
+  clock_type::time_point session_start;
+  clock_type::time_point start;
+};
+
+// an endpoint server started for a client
+struct endpoint_server {
+  size_t client;
+  unique_ptr<gosling_ed25519_private_key> endpoint_private_key;
+};
+
+struct node;
+
+// state shared by every thread; nodes and identities are not modified once
+// the load begins
+struct load_test {
+  options opts;
+  std::vector<unique_ptr<node>> nodes;
+  std::unordered_map<std::string, size_t> identities;
+  // sessions which have completed or failed
+  std::atomic<size_t> finished{0};
+  // a thread could not drive its contexts
+  std::atomic<bool> aborted{false};
+};
+
+struct node {
+  size_t index = 0;
+  unique_ptr<gosling_context> context;
+  unique_ptr<gosling_v3_onion_service_id> identity;
+
+  // endpoint servers published for this node's sessions, posted by the
+  // servers' threads
+  std::mutex mailbox_mutex;
+  std::vector<std::string> mailbox;
+
+  //
+  // client state, only used by the node's thread
+  //
+
+  // number of sessions this node should begin
+  size_t sessions = 0;
+  size_t sessions_begun = 0;
+  size_t sessions_in_progress = 0;
+  std::unordered_map<size_t, identity_handshake> identity_handshakes;
+  // keyed by endpoint service id
+  std::unordered_map<std::string, pending_endpoint> pending_endpoints;
+  // published endpoint servers whose identity handshake has not yet completed
+  std::unordered_set<std::string> published_endpoints;
+  std::unordered_map<size_t, endpoint_handshake> endpoint_handshakes;
+
+  //
+  // server state, only used by the node's thread
+  //
+
+  // keyed by endpoint service id
+  std::unordered_map<std::string, endpoint_server> endpoint_servers;
+
+  //
+  // results
+  //
+
+  size_t sessions_completed = 0;
+  size_t client_failures = 0;
+  size_t server_failures = 0;
+  // gosling functions which failed while handling events
+  size_t errors = 0;
+  std::vector<uint64_t> identity_latencies;
+  std::vector<uint64_t> endpoint_latencies;
+  std::vector<uint64_t> session_latencies;
+};
+
+static unique_ptr<node> create_node(size_t index) {
+  auto n = std::make_unique<node>();
+  n->index = index;
+
+  unique_ptr<gosling_tor_provider_config> tor_provider_config;
+  ::gosling_tor_provider_config_new_mock_client_config(
+      out(tor_provider_config), throw_on_error());
+  unique_ptr<gosling_tor_provider> tor_provider;
+  ::gosling_tor_provider_from_tor_provider_config(
+      out(tor_provider), tor_provider_config.get(), throw_on_error());
+
+  unique_ptr<gosling_ed25519_private_key> private_key;
+  ::gosling_ed25519_private_key_generate(out(private_key), throw_on_error());
+  ::gosling_v3_onion_service_id_from_ed25519_private_key(
+      out(n->identity), private_key.get(), throw_on_error());
+
+  ::gosling_context_init(out(n->context),        // out_context
+                         tor_provider.release(), // tor_provider
+                         420,                    // identity port
+                         420,                    // endpoint port
+                         private_key.get(),      // identity private key
+                         throw_on_error());
+  return n;
+}
+
+// a session is finished, successfully or not
+static void finish_session(load_test &test, node &n) {
+  n.sessions_in_progress--;
+  test.finished++;
+}
+
+// begin the endpoint handshake of a session once its identity handshake has
+// completed and the endpoint server it was granted is published
+static void begin_endpoint_handshake(load_test &test, node &n,
+                                     const std::string &endpoint) {
+  auto it = n.pending_endpoints.find(endpoint);
+  if (it == n.pending_endpoints.end() ||
+      !it->second.identity_handshake_completed ||
+      !it->second.endpoint_server_published) {
+    return;
+  }
+
+  auto &pending = it->second;
+  try {
+    const auto handle = ::gosling_context_begin_endpoint_handshake(
+        n.context.get(), pending.endpoint_service_id.get(),
+        pending.client_auth_private_key.get(), channelName.data(),
+        channelName.size(), throw_on_error());
+    n.endpoint_handshakes.emplace(
+        handle, endpoint_handshake{pending.session_start, clock_type::now()});
+  } catch (const std::exception &ex) {
+    cerr << "--- node " << n.index
+         << " failed to begin endpoint handshake: " << ex.what() << endl;
+    n.client_failures++;
+    finish_session(test, n);
+  }
+  n.pending_endpoints.erase(it);
+}
+
+// begin identity handshakes up to the node's concurrency limit, rotating
+// through the other nodes' identity servers
+static void begin_identity_handshakes(load_test &test, node &n) {
+  const size_t node_count = test.nodes.size();
+  while (n.sessions_begun < n.sessions &&
+         n.sessions_in_progress < test.opts.concurrency) {
+    const size_t server =
+        (n.index + 1 + n.sessions_begun % (node_count - 1)) % node_count;
+    n.sessions_begun++;
+    n.sessions_in_progress++;
+    try {
+      const auto handle = ::gosling_context_begin_identity_handshake(
+          n.context.get(), test.nodes[server]->identity.get(),
+          endpointName.data(), endpointName.size(), throw_on_error());
+      n.identity_handshakes.emplace(
+          handle, identity_handshake{server, clock_type::now()});
+    } catch (const std::exception &ex) {
+      cerr << "--- node " << n.index
+           << " failed to begin identity handshake: " << ex.what() << endl;
+      n.client_failures++;
+      finish_session(test, n);
+    }
+  }
+}
+
+// take the endpoint servers other nodes have published for us
+static void drain_mailbox(load_test &test, node &n) {
+  std::vector<std::string> mailbox;
+  {
+    std::lock_guard<std::mutex> lock(n.mailbox_mutex);
+    std::swap(mailbox, n.mailbox);
+  }
+  for (const auto &endpoint : mailbox) {
+    auto it = n.pending_endpoints.find(endpoint);
+    if (it == n.pending_endpoints.end()) {
+      n.published_endpoints.insert(endpoint);
+    } else {
+      it->second.endpoint_server_published = true;
+      begin_endpoint_handshake(test, n, endpoint);
+    }
+  }
+}
+
+static void handle_event(load_test &test, node &n, const gosling_event &event) {
+  gosling_context *context = n.context.get();
+  const size_t handle = event.handle;
+
+  switch (event.event_type) {
+  //
+  // client events
+  //
+  case GOSLING_EVENT_TYPE_IDENTITY_CLIENT_CHALLENGE_RECEIVED: {
+    ::gosling_context_identity_client_handle_challenge_received(
+        context, handle, challenge_response_bson,
+        sizeof(challenge_response_bson), throw_on_error());
+    break;
+  }
+  case GOSLING_EVENT_TYPE_IDENTITY_CLIENT_HANDSHAKE_COMPLETED: {
+    const auto &data = event.data.identity_client_handshake_completed;
+    auto it = n.identity_handshakes.find(handle);
+    if (it == n.identity_handshakes.end()) {
+      break;
+    }
+    n.identity_latencies.push_back(microseconds_since(it->second.start));
+
+    const auto endpoint = to_string(data.endpoint_service_id);
+    auto &pending = n.pending_endpoints[endpoint];
+    pending.session_start = it->second.start;
+    ::gosling_v3_onion_service_id_clone(out(pending.endpoint_service_id),
+                                        data.endpoint_service_id,
+                                        throw_on_error());
+    ::gosling_x25519_private_key_clone(out(pending.client_auth_private_key),
+                                       data.client_auth_private_key,
+                                       throw_on_error());
+    pending.identity_handshake_completed = true;
+    pending.endpoint_server_published =
+        n.published_endpoints.erase(endpoint) > 0;
+    n.identity_handshakes.erase(it);
+
+    begin_endpoint_handshake(test, n, endpoint);
+    break;
+  }
+  case GOSLING_EVENT_TYPE_IDENTITY_CLIENT_HANDSHAKE_FAILED: {
+    cerr << "--- node " << n.index << " identity client handshake failed: "
+         << ::gosling_error_get_message(event.data.handshake_failed.reason)
+         << endl;
+    if (n.identity_handshakes.erase(handle) > 0) {
+      n.client_failures++;
+      finish_session(test, n);
+    }
+    break;
+  }
+  case GOSLING_EVENT_TYPE_ENDPOINT_CLIENT_HANDSHAKE_COMPLETED: {
+    close_tcp_socket(event.data.endpoint_client_handshake_completed.stream);
+    auto it = n.endpoint_handshakes.find(handle);
+    if (it == n.endpoint_handshakes.end()) {
+      break;
+    }
+    n.endpoint_latencies.push_back(microseconds_since(it->second.start));
+    n.session_latencies.push_back(
+        microseconds_since(it->second.session_start));
+    n.endpoint_handshakes.erase(it);
+    n.sessions_completed++;
+    finish_session(test, n);
+    break;
+  }
+  case GOSLING_EVENT_TYPE_ENDPOINT_CLIENT_HANDSHAKE_FAILED: {
+    cerr << "--- node " << n.index << " endpoint client handshake failed: "
+         << ::gosling_error_get_message(event.data.handshake_failed.reason)
+         << endl;
+    if (n.endpoint_handshakes.erase(handle) > 0) {
+      n.client_failures++;
+      finish_session(test, n);
+    }
+    break;
+  }
+  //
+  // server events
+  //
+  case GOSLING_EVENT_TYPE_IDENTITY_SERVER_ENDPOINT_REQUEST_RECEIVED: {
+    const auto &data = event.data.identity_server_endpoint_request_received;
+    const bool endpoint_supported =
+        std::string(data.requested_endpoint, data.requested_endpoint_length) ==
+        endpointName;
+    ::gosling_context_identity_server_handle_endpoint_request_received(
+        context, handle, true, endpoint_supported, challenge_bson,
+        sizeof(challenge_bson), throw_on_error());
+    break;
+  }
+  case GOSLING_EVENT_TYPE_IDENTITY_SERVER_CHALLENGE_RESPONSE_RECEIVED: {
+    const auto &data = event.data.identity_server_challenge_response_received;
+    const bool challenge_response_valid =
+        data.challenge_response_size == sizeof(challenge_response_bson) &&
+        std::equal(data.challenge_response,
+                   data.challenge_response + data.challenge_response_size,
+                   challenge_response_bson);
+    ::gosling_context_identity_server_handle_challenge_response_received(
+        context, handle, challenge_response_valid, throw_on_error());
+    break;
+  }
+  case GOSLING_EVENT_TYPE_IDENTITY_SERVER_HANDSHAKE_COMPLETED: {
+    const auto &data = event.data.identity_server_handshake_completed;
+    auto client = test.identities.find(to_string(data.client_service_id));
+    if (client == test.identities.end()) {
+      n.server_failures++;
+      break;
+    }
+
+    unique_ptr<gosling_v3_onion_service_id> endpoint_service_id;
+    ::gosling_v3_onion_service_id_from_ed25519_private_key(
+        out(endpoint_service_id), data.endpoint_private_key, throw_on_error());
+    endpoint_server server{client->second, {}};
+    ::gosling_ed25519_private_key_clone(out(server.endpoint_private_key),
+                                        data.endpoint_private_key,
+                                        throw_on_error());
+
+    ::gosling_context_start_endpoint_server(
+        context, data.endpoint_private_key, data.endpoint_name,
+        data.endpoint_name_length, data.client_service_id,
+        data.client_auth_public_key, throw_on_error());
+    n.endpoint_servers.emplace(to_string(endpoint_service_id.get()),
+                               std::move(server));
+    break;
+  }
+  case GOSLING_EVENT_TYPE_ENDPOINT_SERVER_PUBLISHED: {
+    const auto endpoint =
+        to_string(event.data.endpoint_server_published.endpoint_service_id);
+    auto it = n.endpoint_servers.find(endpoint);
+    if (it == n.endpoint_servers.end()) {
+      break;
+    }
+    node &client = *test.nodes[it->second.client];
+    std::lock_guard<std::mutex> lock(client.mailbox_mutex);
+    client.mailbox.push_back(endpoint);
+    break;
+  }
+  case GOSLING_EVENT_TYPE_ENDPOINT_SERVER_CHANNEL_REQUEST_RECEIVED: {
+    const auto &data = event.data.endpoint_server_channel_request_received;
+    const bool channel_supported =
+        std::string(data.requested_channel, data.requested_channel_length) ==
+        channelName;
+    ::gosling_context_endpoint_server_handle_channel_request_received(
+        context, handle, channel_supported, throw_on_error());
+    break;
+  }
+  case GOSLING_EVENT_TYPE_ENDPOINT_SERVER_HANDSHAKE_COMPLETED: {
+    const auto &data = event.data.endpoint_server_handshake_completed;
+    close_tcp_socket(data.stream);
+    // each endpoint server serves a single session
+    auto it = n.endpoint_servers.find(to_string(data.endpoint_service_id));
+    if (it != n.endpoint_servers.end()) {
+      ::gosling_context_stop_endpoint_server(
+          context, it->second.endpoint_private_key.get(), throw_on_error());
+      n.endpoint_servers.erase(it);
+    }
+    break;
+  }
+  case GOSLING_EVENT_TYPE_IDENTITY_SERVER_HANDSHAKE_REJECTED:
+  case GOSLING_EVENT_TYPE_IDENTITY_SERVER_HANDSHAKE_FAILED:
+  case GOSLING_EVENT_TYPE_ENDPOINT_SERVER_HANDSHAKE_REJECTED:
+  case GOSLING_EVENT_TYPE_ENDPOINT_SERVER_HANDSHAKE_FAILED: {
+    n.server_failures++;
+    break;
+  }
+  default:
+    break;
+  }
+}
+
+// update the node's context and handle its events, returning the number of
+// events handled
+static size_t poll_node(load_test &test, node &n,
+                        std::vector<gosling_event> &events) {
+  const size_t count = ::gosling_context_poll_events_batch(
+      n.context.get(), events.data(), events.size(), throw_on_error());
+  for (size_t i = 0; i < count; ++i) {
+    try {
+      handle_event(test, n, events[i]);
+    } catch (const std::exception &ex) {
+      cerr << "--- node " << n.index << " failed to handle event "
+           << events[i].event_type << ": " << ex.what() << endl;
+      n.errors++;
+    }
+  }
+  return count;
+}
+
+//
+// Setup
+//
+
+// bootstrap every node and publish its identity server, returns the number of
+// identity servers published by the deadline
+static size_t start_nodes(load_test &test, clock_type::time_point deadline) {
+  std::vector<gosling_event> events(EVENTS_PER_POLL);
+
+  for (auto &n : test.nodes) {
+    ::gosling_context_bootstrap_tor(n->context.get(), throw_on_error());
+  }
+
+  size_t published = 0;
+  while (published < test.nodes.size() && clock_type::now() < deadline) {
+    for (auto &n : test.nodes) {
+      ::gosling_context_wait_events(
+          n->context.get(), WAIT_EVENTS_TIMEOUT_MILLISECONDS, throw_on_error());
+      const size_t count = ::gosling_context_poll_events_batch(
+          n->context.get(), events.data(), events.size(), throw_on_error());
+      for (size_t i = 0; i < count; ++i) {
+        switch (events[i].event_type) {
+        case GOSLING_EVENT_TYPE_TOR_BOOTSTRAP_COMPLETED:
+          ::gosling_context_start_identity_server(n->context.get(),
+                                                  throw_on_error());
+          break;
+        case GOSLING_EVENT_TYPE_IDENTITY_SERVER_PUBLISHED:
+          published++;
+          break;
+        default:
+          break;
+        }
+      }
+    }
+  }
+  return published;
+}
+
+//
+// Load
+//
+
+static void run_thread(load_test &test, size_t thread_index,
+                       clock_type::time_point deadline) {
+  std::vector<node *> nodes;
+  for (size_t i = thread_index; i < test.nodes.size(); i += test.opts.threads) {
+    nodes.push_back(test.nodes[i].get());
+  }
+  if (nodes.empty()) {
+    return;
+  }
+
+  std::vector<gosling_event> events(EVENTS_PER_POLL);
+  size_t next_wait = 0;
+  try {
+    while (test.finished < test.opts.handshakes && !test.aborted &&
+           clock_type::now() < deadline) {
+      size_t event_count = 0;
+      for (node *n : nodes) {
+        begin_identity_handshakes(test, *n);
+        drain_mailbox(test, *n);
+        event_count += poll_node(test, *n, events);
+      }
+
+      // nothing happened, so briefly wait on one of our contexts
+      if (event_count == 0) {
+        node *n = nodes[next_wait++ % nodes.size()];
+        ::gosling_context_wait_events(n->context.get(),
+                                      WAIT_EVENTS_TIMEOUT_MILLISECONDS,
+                                      throw_on_error());
+      }
+    }
+  } catch (const std::exception &ex) {
+    cerr << "--- thread " << thread_index << " failed: " << ex.what() << endl;
+    test.aborted = true;
+  }
+}
+
+//
+// Report
+//
+
+struct resource_usage {
+  double user_seconds = 0.0;
+  double system_seconds = 0.0;
+  uint64_t peak_rss_bytes = 0;
+};
+
+static resource_usage get_resource_usage() {
+  resource_usage usage;
+#if defined(GOSLING_PLATFORM_WINDOWS)
+  FILETIME creation_time, exit_time, kernel_time, user_time;
+  if (::GetProcessTimes(::GetCurrentProcess(), &creation_time, &exit_time,
+                        &kernel_time, &user_time)) {
+    // FILETIMEs count 100 nanosecond intervals
+    const auto to_seconds = [](const FILETIME &time) -> double {
+      return ((uint64_t(time.dwHighDateTime) << 32) | time.dwLowDateTime) /
+             1e7;
+    };
+    usage.user_seconds = to_seconds(user_time);
+    usage.system_seconds = to_seconds(kernel_time);
+  }
+  PROCESS_MEMORY_COUNTERS counters;
+  if (::GetProcessMemoryInfo(::GetCurrentProcess(), &counters,
+                             sizeof(counters))) {
+    usage.peak_rss_bytes = counters.PeakWorkingSetSize;
+  }
+#elif (defined(GOSLING_PLATFORM_MACOS) || defined(GOSLING_PLATFORM_LINUX))
+  struct rusage rusage;
+  if (::getrusage(RUSAGE_SELF, &rusage) == 0) {
+    const auto to_seconds = [](const struct timeval &time) -> double {
+      return time.tv_sec + time.tv_usec / 1e6;
+    };
+    usage.user_seconds = to_seconds(rusage.ru_utime);
+    usage.system_seconds = to_seconds(rusage.ru_stime);
+#if defined(GOSLING_PLATFORM_MACOS)
+    // bytes on macOS
+    usage.peak_rss_bytes = rusage.ru_maxrss;
+#else
+    // kilobytes on Linux
+    usage.peak_rss_bytes = uint64_t(rusage.ru_maxrss) * 1024;
+#endif
+  }
+#endif
+  return usage;
+}
+
+// the nearest-rank q-th quantile of sorted samples, or 0 if there are none
+static uint64_t quantile(const std::vector<uint64_t> &sorted, double q) {
+  if (sorted.empty()) {
+    return 0;
+  }
+  const auto rank = static_cast<size_t>(std::ceil(q * sorted.size()));
+  return sorted[std::clamp<size_t>(rank, 1, sorted.size()) - 1];
+}
+
+static void write_latencies(std::ostream &stream, const char *name,
+                            std::vector<uint64_t> samples) {
+  std::sort(samples.begin(), samples.end());
+  stream << "  \"" << name << "\": {"
+         << "\"count\": " << samples.size()
+         << ", \"p50\": " << quantile(samples, 0.5)
+         << ", \"p99\": " << quantile(samples, 0.99)
+         << ", \"p999\": " << quantile(samples, 0.999)
+         << ", \"max\": " << (samples.empty() ? 0 : samples.back()) << "},\n";
+}
+
+static void write_report(std::ostream &stream, const load_test &test,
+                         double wall_seconds, const resource_usage &before,
+                         const resource_usage &after) {
+  size_t completed = 0;
+  size_t client_failures = 0;
+  size_t server_failures = 0;
+  size_t errors = 0;
+  std::vector<uint64_t> identity_latencies;
+  std::vector<uint64_t> endpoint_latencies;
+  std::vector<uint64_t> session_latencies;
+  // the contexts' own update timings, merged
+  gosling_histogram update = {};
+  bool metrics_enabled = false;
+  for (const auto &n : test.nodes) {
+    completed += n->sessions_completed;
+    client_failures += n->client_failures;
+    server_failures += n->server_failures;
+    errors += n->errors;
+    identity_latencies.insert(identity_latencies.end(),
+                              n->identity_latencies.begin(),
+                              n->identity_latencies.end());
+    endpoint_latencies.insert(endpoint_latencies.end(),
+                              n->endpoint_latencies.begin(),
+                              n->endpoint_latencies.end());
+    session_latencies.insert(session_latencies.end(),
+                             n->session_latencies.begin(),
+                             n->session_latencies.end());
+
+    const auto metrics = context_get_metrics(n->context.get());
+    metrics_enabled = metrics.enabled;
+    for (size_t i = 0; i < GOSLING_HISTOGRAM_BUCKETS; ++i) {
+      update.buckets[i] += metrics.update.buckets[i];
+    }
+    update.sum_microseconds += metrics.update.sum_microseconds;
+  }
+
+  stream << "{\n"
+         << "  \"contexts\": " << test.opts.contexts << ",\n"
+         << "  \"threads\": " << test.opts.threads << ",\n"
+         << "  \"concurrency\": " << test.opts.concurrency << ",\n"
+         << "  \"handshakes\": " << test.opts.handshakes << ",\n"
+         << "  \"completed\": " << completed << ",\n"
+         << "  \"client_failures\": " << client_failures << ",\n"
+         << "  \"server_failures\": " << server_failures << ",\n"
+         << "  \"errors\": " << errors << ",\n"
+         << "  \"wall_seconds\": " << wall_seconds << ",\n"
+         << "  \"sessions_per_second\": "
+         << (wall_seconds > 0.0 ? completed / wall_seconds : 0.0) << ",\n";
+  // latencies in microseconds
+  write_latencies(stream, "identity_handshake_latency_us", identity_latencies);
+  write_latencies(stream, "endpoint_handshake_latency_us", endpoint_latencies);
+  write_latencies(stream, "session_latency_us", session_latencies);
+  if (metrics_enabled) {
+    stream << "  \"context_update_latency_us\": {"
+           << "\"count\": " << histogram_count(update)
+           << ", \"p50\": " << histogram_quantile(update, 0.5)
+           << ", \"p99\": " << histogram_quantile(update, 0.99)
+           << ", \"p999\": " << histogram_quantile(update, 0.999) << "},\n";
+  }
+  stream << "  \"cpu_user_seconds\": "
+         << after.user_seconds - before.user_seconds << ",\n"
+         << "  \"cpu_system_seconds\": "
+         << after.system_seconds - before.system_seconds << ",\n"
+         << "  \"peak_rss_bytes\": " << after.peak_rss_bytes << "\n"
+         << "}" << endl;
+}
+
+//
+// Main
+//
+
+static int run(const options &opts) {
+#ifndef GOSLING_HAVE_MOCK_TOR_PROVIDER
+  cerr << "gosling_load requires cgosling built with the mock tor provider"
+       << endl;
+  return EXIT_FAILURE;
+#else
+  // the library must outlive every gosling object
+  unique_ptr<gosling_library> library;
+  ::gosling_library_init(out(library), throw_on_error());
+
+  load_test test;
+  test.opts = opts;
+  for (size_t i = 0; i < opts.contexts; ++i) {
+    test.nodes.push_back(create_node(i));
+    test.identities.emplace(to_string(test.nodes.back()->identity.get()), i);
+  }
+  for (size_t i = 0; i < opts.contexts; ++i) {
+    test.nodes[i]->sessions =
+        opts.handshakes / opts.contexts + (i < opts.handshakes % opts.contexts);
+  }
+
+  cerr << "--- starting " << opts.contexts << " contexts" << endl;
+  const size_t published = start_nodes(
+      test, clock_type::now() + std::chrono::seconds(opts.timeout_seconds));
+  if (published < opts.contexts) {
+    cerr << "--- timed out with " << opts.contexts - published
+         << " contexts unpublished" << endl;
+    return EXIT_FAILURE;
+  }
+
+  cerr << "--- running " << opts.handshakes << " sessions on " << opts.threads
+       << " threads" << endl;
+  const auto before = get_resource_usage();
+  const auto start = clock_type::now();
+  const auto deadline = start + std::chrono::seconds(opts.timeout_seconds);
+  {
+    std::vector<std::thread> threads;
+    for (size_t i = 0; i < opts.threads; ++i) {
+      threads.emplace_back(run_thread, std::ref(test), i, deadline);
+    }
+    for (auto &thread : threads) {
+      thread.join();
+    }
+  }
+  const double wall_seconds =
+      std::chrono::duration<double>(clock_type::now() - start).count();
+  const auto after = get_resource_usage();
+
+  if (opts.output.empty()) {
+    write_report(cout, test, wall_seconds, before, after);
+  } else {
+    std::ofstream output(opts.output);
+    write_report(output, test, wall_seconds, before, after);
+  }
+
+  if (test.aborted) {
+    return EXIT_FAILURE;
+  }
+  if (test.finished < opts.handshakes) {
+    cerr << "--- timed out with " << opts.handshakes - test.finished
+         << " sessions unfinished" << endl;
+    return EXIT_FAILURE;
+  }
+  for (const auto &n : test.nodes) {
+    if (n->client_failures > 0 || n->server_failures > 0 || n->errors > 0) {
+      return EXIT_FAILURE;
+    }
+  }
+  return EXIT_SUCCESS;
+#endif // GOSLING_HAVE_MOCK_TOR_PROVIDER
+}
+
+int main(int argc, char **argv) {
+  options opts;
+  if (!parse_options(argc, argv, opts)) {
+    print_usage(argv[0]);
+    return EXIT_FAILURE;
+  }
+
+  try {
+    return run(opts);
+  } catch (const std::exception &ex) {
+    cerr << "error: " << ex.what() << endl;
+    return EXIT_FAILURE;
+  }
+}
@@ -0,0 +1 @@
+#include "precomp.hpp"
\ No newline at end of file
@@ -0,0 +1,29 @@
+// C++
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cmath>
+#include <cstdint>
+#include <cstdlib>
+#include <fstream>
+#include <iostream>
+#include <mutex>
+#include <sstream>
+#include <string>
+#include <thread>
+#include <unordered_map>
+#include <unordered_set>
+#include <vector>
+
+// Gosling
+#include <cgosling.hpp>
+
+// per-platform includes
+#if defined(GOSLING_PLATFORM_WINDOWS)
+#include <windows.h>
+// psapi.h requires windows.h
+#include <psapi.h>
+#elif (defined(GOSLING_PLATFORM_MACOS) || defined(GOSLING_PLATFORM_LINUX))
+#include <sys/resource.h>
+#include <unistd.h>
+#endif